@@ -27,8 +27,8 @@
  * hops to them for a bat interface. It is available in the batman_adv directory
  * under the Linux debug filesystem.
  *
- * Understanding implementation of functions using that file requires knowledge
- * of the syntax of the originators file.
+ * The functions using that file are answered from an originator table, see
+ * pg_batman_adv_originators.
  */
 
 #ifdef __linux
@@ -44,25 +44,24 @@
 *******************************************************************************/
 
 #include <errno.h>
-#include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
 #include "batman_adv.h"
+#include "batman_adv_debugfs.h"
+#include "batman_adv_originators.h"
+#include "batman_adv_shm.h"
 #include "linux.h"
 #include "meshutil.h"
+#include "trace.h"
 
 /*******************************************************************************
 *   CONSTANT DEFINITIONS                                                       *
 *******************************************************************************/
 
-/** String in a batman_adv interface originator table indicating that no
- * nodes are available.
- */
-#define NO_NODES_IN_RANGE_STR "No batman nodes in range ...\n"
-
 /// Path to the root of the directory containting Linux kernel modules.
 #define KERNEL_MODULE_ROOT "/lib/modules/"
 
@@ -77,9 +76,6 @@
 /// Path to the sys filesystem directory containing virtual network devices.
 #define VIRTUAL_NETWORK_IF_PATH_ROOT "/sys/devices/virtual/net/"
 
-/// Originators file field header for interface names
-#define BATMAN_ADV_ORIGINATORS_IFNAME_HEADER "outgoingIF"
-
 /*******************************************************************************
 *   STATIC HELPER FUNCTION DEFINITIONS                                         *
 *******************************************************************************/
@@ -96,7 +92,7 @@ static bool interface_dependent_path(const char  *const path_root,
 
    if (!interface_name) {
       if(!suffix) {
-         *path_string = calloc(strlen(path_root) + 1
+         *path_string = mu_calloc(strlen(path_root) + 1
                               + strlen("bat0") + 1, sizeof(char));
          if(!*path_string) {
             MU_SET_ERROR(error, errno);
@@ -107,7 +103,7 @@ static bool interface_dependent_path(const char  *const path_root,
          strcat(*path_string, "bat0");
          return true;
       } else {
-         *path_string = calloc(strlen(path_root)+ 1
+         *path_string = mu_calloc(strlen(path_root)+ 1
                               + strlen("bat0")
                               + strlen(suffix) + 1, sizeof(char));
          if(!*path_string) {
@@ -123,7 +119,7 @@ static bool interface_dependent_path(const char  *const path_root,
 
    } else {
       if(!suffix) {
-         *path_string = calloc(strlen(path_root) + 1
+         *path_string = mu_calloc(strlen(path_root) + 1
                               + strlen(interface_name) + 1,
                               sizeof(char));
          if(!*path_string) {
@@ -136,7 +132,7 @@ static bool interface_dependent_path(const char  *const path_root,
          strcat(*path_string, interface_name);
          return true;
       } else {
-         *path_string = calloc(strlen(path_root) + 1
+         *path_string = mu_calloc(strlen(path_root) + 1
                               + strlen(interface_name)
                               + strlen(suffix) + 1,
                               sizeof(char));
@@ -154,43 +150,100 @@ static bool interface_dependent_path(const char  *const path_root,
    }
 }
 
-static char *batman_adv_originators_file_path(const char  *const interface_name,
-                                                    int   *const error)
+/* Reads a one line sysfs file and strips the trailing new-line. */
+static char *read_line(const char *const path, int *const error)
 {
-   char *debugfs_root = mu_linux_debugfs_mount_point(NULL);
-   char *batman_debugfs_dir = NULL;
-   char *bat_interface_originators_file = NULL;
+   char   *line   = NULL;
+   size_t  length = 0;
 
-   if (!debugfs_root) {
-      MU_SET_ERROR(error, errno);
-      return 0;
+   line = mu_linux_read_file(path, &length, error);
+   if (line && length && line[length - 1] == '\n') {
+      line[length - 1] = '\0';
+   }
+   return line;
+}
+
+static void free_node_list(struct mu_bat_mesh_node *node)
+{
+   struct mu_bat_mesh_node *passed_node = NULL;
+
+   while (node) {
+      passed_node = node;
+      node = node->next;
+      mu_free(passed_node);
    }
+}
 
-   batman_debugfs_dir = calloc (strlen (debugfs_root)
-                                + strlen("/batman_adv/") + 1,
-                                sizeof (char));
+static bool prepend_node(      struct mu_bat_mesh_node **const first_node,
+                         const struct mu_mac_addr       *const mac_addr,
+                         const        bool                     dedupe,
+                                      int               *const n_nodes,
+                                      int               *const error)
+{
+   struct mu_bat_mesh_node *node = NULL;
+   char   address_tmp[MAC_ADDR_CHAR_REPRESENTATION_LEN + 1];
 
-   if (!batman_debugfs_dir) {
+   mu_mac_addr_to_str(mac_addr, address_tmp);
+
+   if (dedupe) {
+      for (node = *first_node; node; node = node->next) {
+         if (!strcmp(node->mac_addr, address_tmp)) {
+            return true;
+         }
+      }
+   }
+
+   node = mu_malloc(sizeof(struct mu_bat_mesh_node));
+   if (!node) {
       MU_SET_ERROR(error, errno);
-      free (debugfs_root);
-      return 0;
+      return false;
    }
+   memcpy(node->mac_addr, address_tmp, sizeof(address_tmp));
+   node->next  = *first_node;
+   *first_node = node;
 
-   strcat (batman_debugfs_dir, debugfs_root);
-   strcat (batman_debugfs_dir, "/batman_adv/");
-   free (debugfs_root);
+   if (n_nodes) {
+      *n_nodes += 1;
+   }
+   return true;
+}
 
-   if (!interface_dependent_path(batman_debugfs_dir,
-                                 interface_name,
-                                 "/originators",
-                                 &bat_interface_originators_file,
-                                 error)) {
-      free (batman_debugfs_dir);
-      return NULL;
+/* Copies the originator entry of a node. An attached shared memory snapshot
+ * is searched in place, otherwise the table is acquired. Returns false if the
+ * node is not in the table or on error.
+ */
+static bool lookup_node(
+   const        char                      *const interface_name,
+   const struct mu_bat_mesh_node          *const node,
+         struct mu_badv_originator        *const originator,
+                int                       *const error)
+{
+   const struct mu_badv_originator *entry = NULL;
+   struct mu_badv_orig_table       *table = NULL;
+   struct mu_mac_addr               mac_addr;
+   bool                             found = false;
+
+   if (!mu_str_to_mac_addr(node->mac_addr, &mac_addr)) {
+      return false;
+   }
+
+   if (mu_badv_shm_find(interface_name, &mac_addr, originator, &found)) {
+      return found;
+   }
+
+   table = mu_badv_orig_table_acquire(interface_name, error);
+   if (!table) {
+      return false;
+   }
+
+   entry = mu_badv_orig_table_find(table, &mac_addr);
+   if (entry) {
+      *originator = *entry;
+      found       = true;
    }
 
-   free (batman_debugfs_dir);
-   return bat_interface_originators_file;
+   mu_badv_orig_table_release(table);
+   return found;
 }
 
 /*******************************************************************************
@@ -209,14 +262,16 @@ bool mu_badv_kmod_available(int *const error)
    size_t  module_name_length;
    char   *module_name = NULL;
 
+   MU_TRACE_CALL_START("");
    if (!uname(&system_version_info)) {
       module_name_length = (strlen(KERNEL_MODULE_ROOT)
                             + strlen(system_version_info.release)
                             + strlen(BATMAN_ADV_KMOD_PATH));
 
-      module_name = calloc(module_name_length + 1, sizeof(char));
+      module_name = mu_calloc(module_name_length + 1, sizeof(char));
       if(!module_name) {
          MU_SET_ERROR(error, errno);
+         MU_TRACE_CALL_DONE("", error);
          return false;
       }
 
@@ -225,18 +280,22 @@ bool mu_badv_kmod_available(int *const error)
       strcat(module_name, BATMAN_ADV_KMOD_PATH);
 
       if (!access(module_name, F_OK)) {
-         free(module_name);
+         mu_free(module_name);
+         MU_TRACE_CALL_DONE("", error);
          return true;
       } else if (errno == ENOENT) {
-         free(module_name);
+         mu_free(module_name);
+         MU_TRACE_CALL_DONE("", error);
          return false;
       } else {
          MU_SET_ERROR(error, errno);
-         free(module_name);
+         mu_free(module_name);
+         MU_TRACE_CALL_DONE("", error);
          return false;
       }
    } else {
       MU_SET_ERROR(error, errno);
+      MU_TRACE_CALL_DONE("", error);
       return false;
    }
 }
@@ -248,14 +307,18 @@ bool mu_badv_kmod_loaded(int *const error)
 {
    MU_SET_ERROR(error, 0);
 
+   MU_TRACE_CALL_START("");
    /// TODO: VERIFY! Checking the sys filesystem should work since 2010.0.0,
    ///       not before.
    if (!access(BATMAN_ADV_KMOD_VERSION_PATH, F_OK)) {
+      MU_TRACE_CALL_DONE("", error);
       return true;
    } else if (errno == ENOENT) {
+      MU_TRACE_CALL_DONE("", error);
       return false;
    } else {
       MU_SET_ERROR(error, errno);
+      MU_TRACE_CALL_DONE("", error);
       return false;
    }
 }
@@ -267,27 +330,12 @@ char *mu_badv_kmod_version(int *const error)
 {
    MU_SET_ERROR(error, 0);
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-
-   fp = fopen (BATMAN_ADV_KMOD_VERSION_PATH, "r");
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
+   char *version = NULL;
 
-   if ((read = getline(&line, &len, fp)) != -1) {
-      fclose(fp);
-      line[strlen(line)-1] = '\0'; // Remove new-line character.
-      return line;
-   } else {
-      MU_SET_ERROR(error, errno);
-      fclose(fp);
-      return NULL;
-   }
+   MU_TRACE_CALL_START("");
+   version = read_line(BATMAN_ADV_KMOD_VERSION_PATH, error);
+   MU_TRACE_CALL_DONE("", error);
+   return version;
 }
 
 /* Implementation notes:
@@ -299,24 +347,29 @@ bool mu_badv_if_available(const char *const interface_name, int *const error)
 
    char *bat_interface_path = NULL;
 
+   MU_TRACE_CALL_START(interface_name);
    if (!interface_dependent_path(VIRTUAL_NETWORK_IF_PATH_ROOT,
                                  interface_name,
                                  NULL,
                                  &bat_interface_path,
                                  error)) {
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
    // TODO: Checking the sys filesystem should work since 2010.0.0, not before.
    if (!access (bat_interface_path, F_OK)) {
-      free(bat_interface_path);
+      mu_free(bat_interface_path);
+      MU_TRACE_CALL_DONE(interface_name, error);
       return true;
    } else if (errno == ENOENT) {
-      free(bat_interface_path);
+      mu_free(bat_interface_path);
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    } else {
       MU_SET_ERROR(error, errno);
-      free(bat_interface_path);
+      mu_free(bat_interface_path);
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 }
@@ -331,12 +384,16 @@ bool mu_badv_if_up(const char *const interface_name, int *const error)
 
    char *bat_interface_operstate_file = NULL;
    char *bat_interface_carrier_file   = NULL;
+   char *line                         = NULL;
+   bool  up;
 
+   MU_TRACE_CALL_START(interface_name);
    if (!interface_dependent_path(VIRTUAL_NETWORK_IF_PATH_ROOT,
                                  interface_name,
                                  "/operstate",
                                  &bat_interface_operstate_file,
                                  error)) {
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
@@ -345,70 +402,43 @@ bool mu_badv_if_up(const char *const interface_name, int *const error)
                                  "/carrier",
                                  &bat_interface_carrier_file,
                                  error)) {
-      free (bat_interface_operstate_file);
+      mu_free (bat_interface_operstate_file);
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-
-   fp = fopen (bat_interface_operstate_file, "r");
-   free(bat_interface_operstate_file);
+   // Check operstate.
+   line = read_line(bat_interface_operstate_file, error);
+   mu_free(bat_interface_operstate_file);
 
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      free(bat_interface_carrier_file);
+   if (!line) {
+      mu_free(bat_interface_carrier_file);
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
-   // Check operstate.
-   if ((read = getline(&line, &len, fp)) != -1) {
-      fclose(fp);
-      if (!strcmp("false\n", line)) {
-         free(bat_interface_carrier_file);
-         free(line);
-         return false;
-      } else if (!strcmp("up\n", line)) {
-         ; // We still need to check carrier.
-      } else if (!strcmp("unknown\n", line)) {
-         ; // We still need to check carrier.
-      } else {
-         free(bat_interface_carrier_file);
-         free(line);
-         return false;
-      }
-   } else {
-      MU_SET_ERROR(error, errno);
-      free(bat_interface_carrier_file);
-      fclose(fp);
+   // We still need to check carrier if up or unknown.
+   up = !strcmp("up", line) || !strcmp("unknown", line);
+   mu_free(line);
+
+   if (!up) {
+      mu_free(bat_interface_carrier_file);
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
-   fp = fopen (bat_interface_carrier_file, "r");
-   free(bat_interface_carrier_file);
+   line = read_line(bat_interface_carrier_file, error);
+   mu_free(bat_interface_carrier_file);
 
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      free(line);
+   if (!line) {
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
-   if ((read = getline(&line, &len, fp)) != -1) {
-      fclose(fp);
-      if (!strcmp("1\n", line)) {
-         free(line);
-         return true;
-      } else {
-         free(line);
-         return false;
-      }
-   } else {
-      MU_SET_ERROR(error, errno);
-      fclose(fp);
-      return false;
-   }
+   up = !strcmp("1", line);
+   mu_free(line);
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return up;
 }
 
 /* Implementation notes:
@@ -419,88 +449,57 @@ char *mu_badv_if_hwaddr(const char *const interface_name, int *const error)
    MU_SET_ERROR(error, 0);
 
    char *bat_interface_address = NULL;
+   char *line                  = NULL;
 
+   MU_TRACE_CALL_START(interface_name);
    if (!interface_dependent_path(VIRTUAL_NETWORK_IF_PATH_ROOT,
                                  interface_name,
                                  "/address",
                                  &bat_interface_address,
                                  error)) {
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-
-   fp = fopen (bat_interface_address, "r");
-   free(bat_interface_address);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
-
-
-   if ((read = getline(&line, &len, fp)) != -1) {
-      fclose(fp);
-      line[strlen(line)-1] = '\0'; // Strip trailing new-line.
-      return line;
-   } else {
-      MU_SET_ERROR(error, errno);
-      fclose(fp);
-      return NULL;
-   }
+   line = read_line(bat_interface_address, error);
+   mu_free(bat_interface_address);
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return line;
 }
 
 /* Implementation notes:
- * - Parses the originators table in the bat interface directory under sysfs.
+ * - Counts the originators in the originator table and adds self.
  */
 /// TODO: Does the return value have to be unsigned?
 unsigned int mu_badv_mesh_n_nodes(const char *const interface_name,
                                         int  *const error)
 {
    MU_SET_ERROR(error, 0);
-   char *bat_interface_originators_file = batman_adv_originators_file_path(
-                                             interface_name,
-                                             error);
-
-   if(!bat_interface_originators_file) {
-      MU_SET_ERROR(error, errno);
-      return 0;
-   }
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
+   struct mu_badv_orig_table *table = NULL;
+   unsigned int               n_nodes;
+   size_t                     n_originators;
 
-   fp = fopen (bat_interface_originators_file, "r");
-   free(bat_interface_originators_file);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return 0;
+   MU_TRACE_CALL_START(interface_name);
+   if (mu_badv_shm_count(interface_name, &n_originators)) {
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return (unsigned int) n_originators + 1; // Add self.
    }
 
-   unsigned int counter = 0;
-
-   while ((read = getline(&line, &len, fp)) != -1) {
-      counter++;
-      if (!strcmp(line, NO_NODES_IN_RANGE_STR)) {
-         free(line);
-         fclose(fp);
-         return 1; // Count self as one node.
-      }
+   table = mu_badv_orig_table_acquire(interface_name, error);
+   if (!table) {
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return 0;
    }
 
-   free(line);
-   fclose(fp);
-   return counter - 2 + 1; // Remove two header lines and add self.
+   n_nodes = (unsigned int) table->n_originators + 1; // Add self.
+   mu_badv_orig_table_release(table);
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return n_nodes;
 }
 
 /* Implementation notes:
- * - Parses the originators table in the bat interface directory under sysfs.
+ * - Nodes are prepended, so the list is in reverse table order.
  */
 struct mu_bat_mesh_node *mu_badv_mesh_node_addresses(
    const char *const interface_name,
@@ -509,69 +508,37 @@ struct mu_bat_mesh_node *mu_badv_mesh_node_addresses(
 {
    MU_SET_ERROR(error, 0);
 
-   char *bat_interface_originators_file = batman_adv_originators_file_path(
-                                             interface_name,
-                                             error);
-
-   if(!bat_interface_originators_file) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
-
-
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-   struct mu_bat_mesh_node *first_node = NULL;
-   struct mu_bat_mesh_node *current_node = NULL;
-
-   fp = fopen (bat_interface_originators_file, "r");
-   free(bat_interface_originators_file);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
+   struct mu_badv_orig_table *table      = NULL;
+   struct mu_bat_mesh_node   *first_node = NULL;
 
+   MU_TRACE_CALL_START(interface_name);
    if(n_nodes) {
       *n_nodes = 0;
    }
-   int counter = 0;
 
-   while ((read = getline(&line, &len, fp)) != -1) {
-      counter++;
-      if (!strcmp(line, NO_NODES_IN_RANGE_STR)) {
-         free(line);
-         fclose(fp);
-         if(n_nodes) {
-            *n_nodes = 0; // This function does not count self.
-         }
-         return NULL;
-      }
+   table = mu_badv_orig_table_acquire(interface_name, error);
+   if (!table) {
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return NULL;
+   }
 
-      if (counter > 2) {
-         // Skip header lines.
-         if(n_nodes) {
-            *n_nodes += 1;
-         }
-         current_node = malloc(sizeof(struct mu_bat_mesh_node));
-         current_node->next = first_node;
-         /// TODO: Validate that a MAC-address is being read.
-         memcpy(current_node->mac_addr, line,
-                sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-         current_node->mac_addr[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-         first_node = current_node;
+   for (size_t i = 0; i < table->n_originators; i++) {
+      if (!prepend_node(&first_node, &table->originators[i].mac_addr, false,
+                        n_nodes, error)) {
+         free_node_list(first_node);
+         first_node = NULL;
+         break;
       }
    }
 
-   free(line);
-   fclose(fp);
+   mu_badv_orig_table_release(table);
+   MU_TRACE_CALL_DONE(interface_name, error);
    return first_node;
 }
 
 /* Implementation notes:
- * - Parses the originators table in the bat interface directory under sysfs.
+ * - With potential set the actual next hop of every originator is included
+ *   along with its potential next hops.
  */
 struct mu_bat_mesh_node *mu_badv_next_hop_addresses(
    const char *const interface_name,
@@ -581,143 +548,46 @@ struct mu_bat_mesh_node *mu_badv_next_hop_addresses(
 {
    MU_SET_ERROR(error, 0);
 
-   char *bat_interface_originators_file = batman_adv_originators_file_path(
-                                             interface_name,
-                                             error);
+   struct mu_badv_orig_table *table      = NULL;
+   struct mu_badv_originator *originator = NULL;
+   struct mu_bat_mesh_node   *first_node = NULL;
+   bool                       ok         = true;
 
-   if(!bat_interface_originators_file) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
+   MU_TRACE_CALL_START(interface_name);
+   if(n_nodes) {
+      *n_nodes = 0;
    }
 
-
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-   struct mu_bat_mesh_node *first_node   = NULL;
-   struct mu_bat_mesh_node *current_node = NULL;
-   char address_tmp[MAC_ADDR_CHAR_REPRESENTATION_LEN + 1];
-
-   fp = fopen (bat_interface_originators_file, "r");
-   free(bat_interface_originators_file);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
+   table = mu_badv_orig_table_acquire(interface_name, error);
+   if (!table) {
+      MU_TRACE_CALL_DONE(interface_name, error);
       return NULL;
    }
 
-   if(n_nodes) {
-      *n_nodes = 0;
+   for (size_t i = 0; ok && i < table->n_originators; i++) {
+      originator = &table->originators[i];
+      ok = prepend_node(&first_node, &originator->next_hop, true, n_nodes,
+                        error);
+      for (uint32_t j = 0; ok && potential && j < originator->n_hops; j++) {
+         ok = prepend_node(&first_node,
+                           &table->hops[originator->first_hop + j].mac_addr,
+                           true, n_nodes, error);
+      }
    }
-   int counter = 0;
-   bool duplicate = false;
 
-   while ((read = getline(&line, &len, fp)) != -1) {
-      #pragma message "TODO: Next hop retrieval not tested thoroughly."
-      counter++;
+   mu_badv_orig_table_release(table);
 
-      if (!strcmp(line, NO_NODES_IN_RANGE_STR)) {
-         free(line);
-         fclose(fp);
-         if(n_nodes) {
-            *n_nodes = 0;
-         }
-         return NULL;
-      }
-
-      if (counter > 2) {
-         if(!potential) { // Looking only for actual next hops.
-            memcpy(address_tmp, strchr(line, ')') + 2,
-                   sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-            address_tmp[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-
-            current_node = first_node;
-            while(current_node) { // Check if address already in linked list.
-               if(!strncmp(current_node->mac_addr,
-                           address_tmp,
-                           MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-                  duplicate = true;
-                  current_node = NULL;
-               } else {
-                  current_node = current_node->next;
-               }
-            }
-
-            if(!duplicate) {
-               if(n_nodes) {
-                  *n_nodes += 1;
-               }
-               current_node = malloc(sizeof(struct mu_bat_mesh_node));
-               current_node->next = first_node;
-               memcpy(current_node->mac_addr, address_tmp,
-                      sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-               current_node->mac_addr[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-               first_node = current_node;
-            } else {
-               duplicate = false;
-            }
-         } else { // Looking for potential and actual next hops.
-            char *tmp_line = NULL;
-
-            tmp_line = strchr(line, ']');
-            if(tmp_line) {
-               tmp_line = tmp_line + 2;
-            }
-
-            do {
-               if(tmp_line && strchr(tmp_line, '(')) { // Check that there is
-                                                       // still a MAC address
-                                                       // in tmp_line.
-                  memcpy(address_tmp, tmp_line + 1,
-                         sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-                  address_tmp[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-                  tmp_line = strchr(tmp_line, ')');
-                  if(tmp_line) {
-                     tmp_line = tmp_line + 1; // TODO: If we are at the last
-                                              //       address this lands us on
-                                              //       the last new-line char?!
-                  }
-               } else {
-                  tmp_line = NULL;
-               }
-
-               current_node = first_node;
-               while(current_node) { // Check if address already in linked list.
-                  if(!strncmp(current_node->mac_addr, address_tmp,
-                              MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-                     duplicate = true;
-                     current_node = NULL;
-                  } else {
-                     current_node = current_node->next;
-                  }
-               }
-
-               if(!duplicate) {
-                  if(n_nodes) {
-                     *n_nodes += 1;
-                  }
-                  current_node = malloc(sizeof(struct mu_bat_mesh_node));
-                  current_node->next = first_node;
-                  memcpy(current_node->mac_addr, address_tmp,
-                         sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-                  current_node->mac_addr[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-                  first_node = current_node;
-               } else {
-                  duplicate = false;
-               }
-            } while(tmp_line);
-         }
-      }
+   if (!ok) {
+      free_node_list(first_node);
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return NULL;
    }
-
-   free(line);
-   fclose(fp);
+   MU_TRACE_CALL_DONE(interface_name, error);
    return first_node;
 }
 
 /* Implementation notes:
- * - Compares a MAC address against mu_badv_next_hop_addresses.
+ * - Compares a MAC address against the next hops in the originator table.
  */
 bool mu_badv_node_is_next_hop(
    const        char             *const interface_name,
@@ -727,36 +597,38 @@ bool mu_badv_node_is_next_hop(
 {
    MU_SET_ERROR(error, 0);
 
-   struct mu_bat_mesh_node *next_hop_node = NULL;
-   struct mu_bat_mesh_node *passed_node   = NULL;
-   bool   node_status = false;
+   struct mu_badv_orig_table *table      = NULL;
+   struct mu_badv_originator *originator = NULL;
+   struct mu_mac_addr         mac_addr;
+   bool                       node_status = false;
 
-   if(!node) {
+   MU_TRACE_CALL_START(interface_name);
+   if(!node || !mu_str_to_mac_addr(node->mac_addr, &mac_addr)) {
       /// TODO: Set error to indicate that pointer was NULL?
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
    }
 
-   next_hop_node = mu_badv_next_hop_addresses(interface_name,
-                                              potential,
-                                              NULL,
-                                              error);
-   if (!next_hop_node) {
-      MU_SET_ERROR(error, errno);
+   table = mu_badv_orig_table_acquire(interface_name, error);
+   if (!table) {
+      MU_TRACE_CALL_DONE(interface_name, error);
       return false;
-   } else {
-      while(next_hop_node) {
-         if(!strncmp(next_hop_node->mac_addr,
-                     node->mac_addr,
-                     MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-            node_status = true;
-         }
-         passed_node = next_hop_node;
-         next_hop_node = next_hop_node->next;
-         free(passed_node);
-      }
+   }
 
-      return node_status;
+   for (size_t i = 0; !node_status && i < table->n_originators; i++) {
+      originator  = &table->originators[i];
+      node_status = mu_mac_addr_equal(&originator->next_hop, &mac_addr);
+      for (uint32_t j = 0; !node_status && potential && j < originator->n_hops;
+           j++) {
+         node_status = mu_mac_addr_equal(
+                          &table->hops[originator->first_hop + j].mac_addr,
+                          &mac_addr);
+      }
    }
+
+   mu_badv_orig_table_release(table);
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return node_status;
 }
 
 char *mu_badv_node_accessible_via_if(
@@ -766,77 +638,27 @@ char *mu_badv_node_accessible_via_if(
 {
    MU_SET_ERROR(error, 0);
 
+   struct mu_badv_originator originator;
+   char                     *iface = NULL;
+
+   MU_TRACE_CALL_START(interface_name);
    if(!node) {
       /// TODO: Set error to indicate that pointer was NULL?
+      MU_TRACE_CALL_DONE(interface_name, error);
       return NULL;
    }
 
-   char *bat_interface_originators_file = batman_adv_originators_file_path(
-                                             interface_name,
-                                             error);
-
-   if(!bat_interface_originators_file) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
-
-
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-
-   char *iface = NULL;
-
-   fp = fopen (bat_interface_originators_file, "r");
-   free(bat_interface_originators_file);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return 0;
-   }
-
-   char* tmp_line = NULL;
-   unsigned int counter = 0;
-
-   while ((read = getline(&line, &len, fp)) != -1) {
-      counter++;
-      if (counter > 2) {
-         if (!strncmp(line, node->mac_addr, MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-            tmp_line = strchr(line, '[');
-            if(!tmp_line) {
-               MU_SET_ERROR(error, errno);
-               free (line);
-               fclose (fp);
-               return NULL;
-            }
-
-            tmp_line = tmp_line + 1;
-
-            *strchr(tmp_line, ']') = '\0'; // End the string.
-
-            if (tmp_line[0] == ' ') { // If ifname preceded by space skip it!
-               tmp_line = strrchr(tmp_line, ' ');
-            }
-
-            iface = calloc((
-                     strnlen(tmp_line,
-                             strlen(BATMAN_ADV_ORIGINATORS_IFNAME_HEADER)) + 1),
-                     sizeof(char));
-            strncpy(iface, tmp_line,
-                       strnlen(tmp_line,
-                       strlen(BATMAN_ADV_ORIGINATORS_IFNAME_HEADER)));
-            tmp_line = NULL;
-            free (line);
-            fclose (fp);
-            return iface;
-         }
+   if (lookup_node(interface_name, node, &originator, error)) {
+      iface = mu_calloc(strlen(originator.outgoing_if) + 1, sizeof(char));
+      if (!iface) {
+         MU_SET_ERROR(error, errno);
+      } else {
+         strcpy(iface, originator.outgoing_if);
       }
    }
 
-   free (line);
-   fclose (fp);
-   return NULL;
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return iface;
 }
 
 double mu_badv_node_last_seen(
@@ -846,70 +668,22 @@ double mu_badv_node_last_seen(
 {
    MU_SET_ERROR(error, 0);
 
+   struct mu_badv_originator originator;
+   double                    last_seen = 0;
+
+   MU_TRACE_CALL_START(interface_name);
    if(!node) {
       /// TODO: Set error to indicate that pointer was NULL?
+      MU_TRACE_CALL_DONE(interface_name, error);
       return 0;
    }
 
-   char *bat_interface_originators_file = batman_adv_originators_file_path(
-                                             interface_name,
-                                             error);
-
-   if(!bat_interface_originators_file) {
-      MU_SET_ERROR(error, errno);
-      return 0;
+   if (lookup_node(interface_name, node, &originator, error)) {
+      last_seen = originator.last_seen_msecs / 1000.0;
    }
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-   double  last_seen;
-
-   fp = fopen (bat_interface_originators_file, "r");
-   free(bat_interface_originators_file);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return 0;
-   }
-
-   unsigned int counter = 0;
-   char* tmp_line = NULL;
-
-   while ((read = getline(&line, &len, fp)) != -1) {
-      counter++;
-      if (counter > 2) {
-         if (!strncmp(line, node->mac_addr, MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-            tmp_line = strchr(line, ' ');
-            if(!tmp_line) {
-               MU_SET_ERROR(error, errno);
-               free (line);
-               fclose (fp);
-               return 0;
-            }
-
-            *strchr(tmp_line, 's') = '\0'; // End the string.;
-
-            tmp_line = strrchr(tmp_line, ' ') + 1; // Skip to last whitespace + 1
-                                                   // before last seen value.
-
-            if (sscanf(tmp_line, "%lf", &last_seen) != 1) {
-               MU_SET_ERROR(error, errno);
-               last_seen = 0;
-            }
-
-            tmp_line = NULL;
-            free (line);
-            fclose (fp);
-            return last_seen;
-         }
-      }
-   }
-
-   free (line);
-   fclose (fp);
-   return 0;
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return last_seen;
 }
 
 struct mu_bat_mesh_node *mu_badv_node_next_hop(
@@ -919,69 +693,33 @@ struct mu_bat_mesh_node *mu_badv_node_next_hop(
 {
    MU_SET_ERROR(error, 0);
 
+   struct mu_badv_originator originator;
+   struct mu_bat_mesh_node  *next_hop_node = NULL;
+
+   MU_TRACE_CALL_START(interface_name);
    if(!node) {
       /// TODO: Set error to indicate that pointer was NULL?
+      MU_TRACE_CALL_DONE(interface_name, error);
       return NULL;
    }
 
-   char *bat_interface_originators_file = batman_adv_originators_file_path(
-                                             interface_name,
-                                             error);
-
-   if(!bat_interface_originators_file) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
-
-
-   struct mu_bat_mesh_node *next_hop_node = NULL;
-
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-
-   fp = fopen (bat_interface_originators_file, "r");
-   free(bat_interface_originators_file);
-
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return NULL;
-   }
-
-   unsigned int counter = 0;
-   char address_tmp[MAC_ADDR_CHAR_REPRESENTATION_LEN + 1];
-
-   while ((read = getline(&line, &len, fp)) != -1) {
-      counter++;
-      if (counter > 2) {
-         if (!strncmp(line, node->mac_addr, MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-            memcpy(address_tmp, strchr(line, ')') + 2,
-                   sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-            address_tmp[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-            if (!strncmp(address_tmp, node->mac_addr,
-                         MAC_ADDR_CHAR_REPRESENTATION_LEN)) {
-               next_hop_node = (struct mu_bat_mesh_node *) node;
-            } else {
-               next_hop_node = malloc(sizeof(struct mu_bat_mesh_node));
-               if(!next_hop_node) {
-                  MU_SET_ERROR(error, errno);
-                  fclose(fp);
-                  free(line);
-               }
-               memcpy(next_hop_node->mac_addr, address_tmp,
-                      sizeof(char) * MAC_ADDR_CHAR_REPRESENTATION_LEN);
-               next_hop_node->mac_addr[MAC_ADDR_CHAR_REPRESENTATION_LEN] = '\0';
-               next_hop_node->next = NULL;
-            }
-            break;
+   if (lookup_node(interface_name, node, &originator, error)) {
+      if (mu_mac_addr_equal(&originator.next_hop, &originator.mac_addr)) {
+         next_hop_node = (struct mu_bat_mesh_node *) node;
+      } else {
+         next_hop_node = mu_malloc(sizeof(struct mu_bat_mesh_node));
+         if(!next_hop_node) {
+            MU_SET_ERROR(error, errno);
+         } else {
+            mu_mac_addr_to_str(&originator.next_hop, next_hop_node->mac_addr);
+            next_hop_node->next = NULL;
          }
       }
    }
 
-   free (line);
-   fclose (fp);
+   MU_TRACE_CALL_DONE(interface_name, error);
    return next_hop_node;
 }
 
+
 #endif                          /* __linux */
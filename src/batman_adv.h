@@ -52,6 +52,10 @@
 #ifndef MESHUTIL_BATMAN_ADV_H
 #define MESHUTIL_BATMAN_ADV_H 1
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #ifdef __linux
 
 /*******************************************************************************
@@ -59,6 +63,7 @@
 *******************************************************************************/
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /*******************************************************************************
 *   CONSTANT DEFINITIONS                                                       *
@@ -78,6 +83,14 @@ struct mu_bat_mesh_node {
    struct mu_bat_mesh_node *next;
 };
 
+/** Kind of link metric found in a batman_adv table.
+ */
+enum mu_badv_metric_type {
+   MU_BADV_METRIC_NONE = 0,   ///< The table carries no link metric.
+   MU_BADV_METRIC_TQ,         ///< Transmit quality 0-255 (B.A.T.M.A.N. IV).
+   MU_BADV_METRIC_THROUGHPUT  ///< Throughput in kbit/s (B.A.T.M.A.N. V).
+};
+
 /*******************************************************************************
 *   PUBLIC API FUNCTION DECLARATIONS                                           *
 *******************************************************************************/
@@ -85,6 +98,8 @@ struct mu_bat_mesh_node {
 /**
  * @brief Test whether the batman_adv kernel module is available.
  *
+ * The system is probed on every call, see mu_badv_caps_get for a cached probe.
+ *
  * The function only checks for the module for the currently running kernel.
  *
  * @param *error [out] For setting error codes on function failure.
@@ -100,6 +115,8 @@ __attribute__ ((visibility("default")));
 /**
  * @brief Test whether the batman_adv kernel module is loaded.
  *
+ * The system is probed on every call, see mu_badv_caps_get for a cached probe.
+ *
  * @param *error [out] For setting error codes on function failure.
  *
  * @retval  true  The module is loaded.
@@ -113,10 +130,12 @@ __attribute__ ((visibility("default")));
 /**
  * @brief Get the kernel module version.
  *
+ * The system is probed on every call, see mu_badv_caps_get for a cached probe.
+ *
  * @param *error [out] For setting error codes on function failure.
  *
  * @return Pointer to kernel module version string. The pointer has to be
- *         free()'d by the caller.
+ *         mu_free()'d by the caller.
  *
  * @retval NULL Returned on failure.
  */
@@ -165,7 +184,7 @@ __attribute__ ((visibility("default")));
  * @param *error          [out] For setting error codes on function failure.
  *
  * @return Pointer to interface MAC address string. The pointer has to be
- *         free()'d by the caller.
+ *         mu_free()'d by the caller.
  *
  * @retval NULL Returned on failure.
  */
@@ -207,7 +226,7 @@ __attribute__ ((visibility("default")));
  * @param *error          [out] For setting error codes on function failure.
  *
  * @return Pointer to a linked list of nodes in the mesh. The links in this
- *         list have to be free()'d by the caller.
+ *         list have to be mu_free()'d by the caller.
  *
  * @retval NULL Returned on failure or when no nodes available.
  *
@@ -236,7 +255,7 @@ __attribute__ ((visibility("default")));
  * @param *error          [out] For setting error codes on function failure.
  *
  * @return Pointer to a linked list of next hop addresses. The links in this
- *         list have to be free()'d by the caller.
+ *         list have to be mu_free()'d by the caller.
  *
  * @retval NULL Returned on failure or when no nodes available.
  */
@@ -275,6 +294,9 @@ __attribute__ ((visibility("default")));
  * This referes to the (usually physical) interface attached to the bat
  * interface via which the node is visible.
  *
+ * To group many nodes by interface read an originator table and compare the
+ * if_id of its originators instead, see pg_batman_adv_originators.
+ *
  * @param *interface_name [in]  Name of the bat interface.
  * @param *node           [in]  The node that is being tested.
  * @param *error          [out] For setting error codes on function failure.
@@ -316,8 +338,8 @@ __attribute__ ((visibility("default")));
  * This is always an actual next hop, never a potential next hop.
  *
  * If self returns the passed pointer! So check always the return value
- * before calling free() on the returned pointer. Otherwise you might end up
- * calling free() twice on the same block of allocated memory.
+ * before calling mu_free() on the returned pointer. Otherwise you might end up
+ * calling mu_free() twice on the same block of allocated memory.
  *
  * @param *interface_name [in]  Name of the bat interface.
  * @param *node           [in]  The node that is being tested.
@@ -333,5 +355,30 @@ struct mu_bat_mesh_node
                                     int              *const error)
 __attribute__ ((visibility("default")));
 
+/**
+ * @brief Configure parallel parsing of large tables.
+ *
+ * Originators and dat_cache tables of at least min_bytes are split at line
+ * boundaries and parsed by several threads, which gives the same result as
+ * parsing them on the calling thread. By default tables from 1 MiB up are
+ * parsed by up to one thread per online CPU.
+ *
+ * Can be called at any time; parses in progress keep the old setting.
+ *
+ * @param max_threads [in] Most threads per table, 0 for one per online CPU
+ *                         and 1 to parse on the calling thread only.
+ * @param min_bytes   [in] Smallest table parsed in parallel, 0 for the
+ *                         default.
+ */
+void
+mu_badv_set_parallel_parse(const unsigned int max_threads,
+                           const size_t       min_bytes)
+__attribute__ ((visibility("default")));
+
 #endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif                          /* MESHUTIL_BATMAN_ADV_H */
@@ -0,0 +1,480 @@
+/** @file batman_adv_async.c
+ * meshutil API implementation for asynchronous originator table refreshes
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_async_impl   Asynchronous refresh implementation
+ *
+ * Each handle owns one worker thread which sleeps on a condition variable
+ * until a refresh is requested. The worker reads the table with
+ * mu_badv_orig_table_load, so an attached shared memory snapshot is used
+ * as well.
+ *
+ * The eventfd counter is 1 exactly while a result is ready: the worker writes
+ * it and mu_badv_refresh_collect drains it, both while holding the handle
+ * mutex, so the descriptor never signals a result which is already gone.
+ *
+ * The notify function is called with the mutex released. If it frees the
+ * handle, the worker cannot join itself: mu_badv_refresh_free then only marks
+ * the handle as orphaned and the worker releases it on its way out.
+ *
+ * Refreshes are numbered as the worker picks them up. A query waits on the
+ * done condition, which uses CLOCK_MONOTONIC, until the refresh it asked for
+ * has finished or a cancel bumps n_cancels. The worker copies every table it
+ * reads into last_good once queries are used, outside the mutex, so a query
+ * that misses its deadline answers with a copy made without touching debugfs.
+ * A cancelled refresh still runs to the end; the worker then drops its result.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batman_adv_async.h"
+#include "batman_adv_debugfs.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct mu_badv_refresh {
+   char                       interface_name[MU_IF_NAME_LEN];
+   int                        event_fd;
+   pthread_t                  worker;
+   pthread_mutex_t            mutex;
+   pthread_cond_t             cond;
+   bool                       requested;  ///< Not yet picked up by worker.
+   bool                       running;    ///< Worker is reading the table.
+   bool                       ready;      ///< Result waits for collection.
+   bool                       stop;
+   bool                       orphaned;   ///< Freed from the notify function.
+   bool                       cancel;     ///< Drop the result of the read.
+   struct mu_badv_orig_table *table;
+   int                        table_error;
+   pthread_cond_t             done;       ///< A refresh finished or cancel.
+   uint64_t                   n_started;  ///< Number of the latest refresh.
+   uint64_t                   n_finished; ///< Number of the last finished.
+   uint64_t                   n_cancels;
+   bool                       keep_last_good;
+   struct mu_badv_orig_table *last_good;
+   uint64_t                   last_good_refresh;
+   mu_badv_refresh_notify_fn  notify;
+   void                      *notify_ctx;
+   struct mu_badv_node_store *store;
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static void destroy_refresh(struct mu_badv_refresh *const refresh)
+{
+   mu_badv_orig_table_free(refresh->table);
+   mu_badv_orig_table_free(refresh->last_good);
+   pthread_cond_destroy(&refresh->done);
+   pthread_cond_destroy(&refresh->cond);
+   pthread_mutex_destroy(&refresh->mutex);
+   close(refresh->event_fd);
+   mu_free(refresh);
+}
+
+/// Called with the mutex held, ends a refresh a query may wait for.
+static void finish_refresh(struct mu_badv_refresh *const refresh,
+                           const uint64_t                number)
+{
+   refresh->running    = false;
+   refresh->cancel     = false;
+   refresh->n_finished = number;
+   pthread_cond_broadcast(&refresh->done);
+}
+
+/// Called with the mutex held; whether a start has to request a refresh.
+static bool needs_request(const struct mu_badv_refresh *const refresh)
+{
+   return !refresh->requested && (!refresh->running || refresh->cancel);
+}
+
+static void *refresh_worker(void *const arg)
+{
+   struct mu_badv_refresh    *refresh    = arg;
+   struct mu_badv_orig_table *table      = NULL;
+   struct mu_badv_orig_table *copy       = NULL;
+   uint64_t                   number     = 0;
+   bool                       keep       = false;
+   int                        error      = 0;
+   uint64_t                   one        = 1;
+   mu_badv_refresh_notify_fn  notify     = NULL;
+   void                      *notify_ctx = NULL;
+   struct mu_badv_node_store *store      = NULL;
+   bool                       orphaned   = false;
+
+   pthread_mutex_lock(&refresh->mutex);
+   for (;;) {
+      while (!refresh->requested && !refresh->stop) {
+         pthread_cond_wait(&refresh->cond, &refresh->mutex);
+      }
+      if (refresh->stop) {
+         break;
+      }
+      refresh->requested = false;
+      refresh->running   = true;
+      refresh->cancel    = false;
+      number             = ++refresh->n_started;
+      keep               = refresh->keep_last_good;
+      store              = refresh->store;
+      pthread_mutex_unlock(&refresh->mutex);
+
+      error = 0;
+      copy  = NULL;
+      table = mu_badv_orig_table_load(refresh->interface_name, &error);
+      if (!table && !error) {
+         error = EIO;
+      }
+      if (table) {
+         mu_badv_orig_table_index_reused(table);
+      }
+      if (table && store) {
+         mu_badv_node_store_sync(store, table, NULL);
+      }
+      if (table && keep) {
+         copy = mu_badv_orig_table_copy(table, NULL);
+      }
+
+      pthread_mutex_lock(&refresh->mutex);
+      if (refresh->cancel) {
+         finish_refresh(refresh, number);
+         mu_badv_orig_table_free(table);
+         mu_badv_orig_table_free(copy);
+         continue;
+      }
+      if (copy) {
+         mu_badv_orig_table_free(refresh->last_good);
+         refresh->last_good         = copy;
+         refresh->last_good_refresh = number;
+      }
+      finish_refresh(refresh, number);
+      mu_badv_orig_table_free(refresh->table);
+      refresh->table       = table;
+      refresh->table_error = error;
+      if (!refresh->ready) {
+         refresh->ready = true;
+         while (write(refresh->event_fd, &one, sizeof(one)) < 0
+                && errno == EINTR) {
+            ;
+         }
+      }
+
+      notify     = refresh->notify;
+      notify_ctx = refresh->notify_ctx;
+      if (notify) {
+         pthread_mutex_unlock(&refresh->mutex);
+         notify(notify_ctx);
+         pthread_mutex_lock(&refresh->mutex);
+      }
+   }
+   orphaned = refresh->orphaned;
+   pthread_mutex_unlock(&refresh->mutex);
+
+   if (orphaned) {
+      destroy_refresh(refresh);
+   }
+   return NULL;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Signals are blocked while the worker is created so it inherits an all
+ *   blocked mask and process directed signals go to the caller's threads.
+ */
+struct mu_badv_refresh *mu_badv_refresh_new(const char *const interface_name,
+                                                  int  *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const char *ifname = interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+   struct mu_badv_refresh *refresh = NULL;
+   sigset_t                all_signals;
+   sigset_t                old_signals;
+   pthread_condattr_t      done_attr;
+   int                     result;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+
+   refresh = mu_calloc(1, sizeof(struct mu_badv_refresh));
+   if (!refresh) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+   strcpy(refresh->interface_name, ifname);
+
+   refresh->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (refresh->event_fd < 0) {
+      MU_SET_ERROR(error, errno);
+      mu_free(refresh);
+      return NULL;
+   }
+
+   pthread_mutex_init(&refresh->mutex, NULL);
+   pthread_cond_init(&refresh->cond, NULL);
+   pthread_condattr_init(&done_attr);
+   pthread_condattr_setclock(&done_attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&refresh->done, &done_attr);
+   pthread_condattr_destroy(&done_attr);
+
+   sigfillset(&all_signals);
+   pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+   result = pthread_create(&refresh->worker, NULL, refresh_worker, refresh);
+   pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+   if (result) {
+      MU_SET_ERROR(error, result);
+      pthread_cond_destroy(&refresh->done);
+      pthread_cond_destroy(&refresh->cond);
+      pthread_mutex_destroy(&refresh->mutex);
+      close(refresh->event_fd);
+      mu_free(refresh);
+      return NULL;
+   }
+
+   return refresh;
+}
+
+void mu_badv_refresh_free(struct mu_badv_refresh *const refresh)
+{
+   if (!refresh) {
+      return;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   refresh->stop = true;
+   pthread_cond_signal(&refresh->cond);
+   if (pthread_equal(pthread_self(), refresh->worker)) {
+      refresh->orphaned = true;
+      pthread_detach(refresh->worker);
+      pthread_mutex_unlock(&refresh->mutex);
+      return;
+   }
+   pthread_mutex_unlock(&refresh->mutex);
+
+   pthread_join(refresh->worker, NULL);
+   destroy_refresh(refresh);
+}
+
+int mu_badv_refresh_fd(const struct mu_badv_refresh *const refresh)
+{
+   return refresh ? refresh->event_fd : -1;
+}
+
+void mu_badv_refresh_set_notify(struct mu_badv_refresh    *const refresh,
+                                mu_badv_refresh_notify_fn        notify,
+                                void                            *ctx)
+{
+   if (!refresh) {
+      return;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   refresh->notify     = notify;
+   refresh->notify_ctx = ctx;
+   pthread_mutex_unlock(&refresh->mutex);
+}
+
+void mu_badv_refresh_set_store(struct mu_badv_refresh    *const refresh,
+                               struct mu_badv_node_store *const store)
+{
+   if (!refresh) {
+      return;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   refresh->store = store;
+   pthread_mutex_unlock(&refresh->mutex);
+}
+
+bool mu_badv_refresh_start(struct mu_badv_refresh *const refresh,
+                           int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   if (!refresh) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   if (needs_request(refresh)) {
+      refresh->requested = true;
+      pthread_cond_signal(&refresh->cond);
+   }
+   pthread_mutex_unlock(&refresh->mutex);
+
+   return true;
+}
+
+struct mu_badv_orig_table *mu_badv_refresh_collect(
+   struct mu_badv_refresh *const refresh,
+   int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *table = NULL;
+   uint64_t                   count;
+
+   if (!refresh) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   if (!refresh->ready) {
+      pthread_mutex_unlock(&refresh->mutex);
+      MU_SET_ERROR(error, EAGAIN);
+      return NULL;
+   }
+
+   table = refresh->table;
+   if (!table) {
+      MU_SET_ERROR(error, refresh->table_error);
+   }
+   refresh->table = NULL;
+   refresh->ready = false;
+   while (read(refresh->event_fd, &count, sizeof(count)) < 0
+          && errno == EINTR) {
+      ;
+   }
+   pthread_mutex_unlock(&refresh->mutex);
+
+   return table;
+}
+
+/* Implementation notes:
+ * - The refresh waited for is the one in progress, unless it was cancelled,
+ *   or else the one requested. A result at least that new is fresh; when the
+ *   result waiting for collection is, it is taken rather than copied.
+ * - last_good is copied with the mutex held, so the worker cannot replace it
+ *   meanwhile.
+ */
+struct mu_badv_orig_table *mu_badv_refresh_query(
+   struct mu_badv_refresh *const refresh,
+   const uint64_t                deadline_ms,
+         bool                   *const stale,
+         int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *table    = NULL;
+   struct timespec            deadline = {
+      (time_t) (deadline_ms / 1000), (long) (deadline_ms % 1000) * 1000000
+   };
+   uint64_t                   number   = 0;
+   uint64_t                   n_cancels;
+   uint64_t                   count;
+
+   if (stale) {
+      *stale = false;
+   }
+   if (!refresh) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   refresh->keep_last_good = true;
+   if (needs_request(refresh)) {
+      refresh->requested = true;
+      pthread_cond_signal(&refresh->cond);
+   }
+   number    = refresh->n_started + (refresh->requested ? 1 : 0);
+   n_cancels = refresh->n_cancels;
+
+   while (refresh->n_finished < number && refresh->n_cancels == n_cancels) {
+      if (pthread_cond_timedwait(&refresh->done, &refresh->mutex, &deadline)
+          == ETIMEDOUT) {
+         break;
+      }
+   }
+
+   if (refresh->n_finished >= number && refresh->ready && refresh->table) {
+      table          = refresh->table;
+      refresh->table = NULL;
+      refresh->ready = false;
+      while (read(refresh->event_fd, &count, sizeof(count)) < 0
+             && errno == EINTR) {
+         ;
+      }
+   } else if (refresh->last_good) {
+      table = mu_badv_orig_table_copy(refresh->last_good, error);
+      if (table && stale) {
+         *stale = refresh->last_good_refresh < number;
+      }
+   } else if (refresh->n_cancels != n_cancels) {
+      MU_SET_ERROR(error, ECANCELED);
+   } else if (refresh->n_finished < number) {
+      MU_SET_ERROR(error, ETIMEDOUT);
+   } else {
+      MU_SET_ERROR(error, refresh->table_error ? refresh->table_error : EIO);
+   }
+   pthread_mutex_unlock(&refresh->mutex);
+
+   return table;
+}
+
+void mu_badv_refresh_cancel(struct mu_badv_refresh *const refresh)
+{
+   if (!refresh) {
+      return;
+   }
+
+   pthread_mutex_lock(&refresh->mutex);
+   if (refresh->requested || (refresh->running && !refresh->cancel)) {
+      refresh->requested = false;
+      refresh->cancel    = refresh->running;
+      refresh->n_cancels++;
+      pthread_cond_broadcast(&refresh->done);
+   }
+   pthread_mutex_unlock(&refresh->mutex);
+}
+
+#endif                          /* __linux */
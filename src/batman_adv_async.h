@@ -0,0 +1,265 @@
+/** @file batman_adv_async.h
+ * meshutil API for reading B.A.T.M.A.N. advanced originator tables without
+ * blocking the caller
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_async   Asynchronous refresh
+ *
+ * Reading a debugfs table can block for milliseconds while the kernel holds
+ * the table lock. An event loop thread should not wait for that. A refresh
+ * handle reads and parses the originators table on its own worker thread and
+ * signals completion through an eventfd, which can be added to epoll, poll
+ * or select like any other descriptor:
+ *
+ *     refresh = mu_badv_refresh_new("bat0", &error);
+ *     ev.events  = EPOLLIN;
+ *     ev.data.fd = mu_badv_refresh_fd(refresh);
+ *     epoll_ctl(epfd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+ *
+ *     mu_badv_refresh_start(refresh, &error);    // Returns immediately.
+ *     ...
+ *     // Descriptor became readable:
+ *     table = mu_badv_refresh_collect(refresh, &error);
+ *     ...
+ *     mu_badv_orig_table_free(table);
+ *
+ * The descriptor is readable as long as a result waits to be collected. Only
+ * the latest result is kept: if a refresh completes before the previous one
+ * was collected, the previous table is dropped.
+ *
+ * Instead of (or in addition to) polling the descriptor, a notify function
+ * can be set which the worker thread calls whenever a result is ready, e.g. to
+ * wake up another event loop or resume a coroutine.
+ *
+ * A control loop which has to act by a deadline can instead query the handle.
+ * A query starts a refresh and waits for it until the deadline, a time in
+ * milliseconds on CLOCK_MONOTONIC. If the refresh does not complete in time,
+ * fails or is cancelled, the table of the last refresh which succeeded is
+ * returned, marked as stale:
+ *
+ *     clock_gettime(CLOCK_MONOTONIC, &now);
+ *     deadline = now.tv_sec * 1000 + now.tv_nsec / 1000000 + 50;
+ *     table = mu_badv_refresh_query(refresh, deadline, &stale, &error);
+ *
+ * Another thread can give up on a refresh with mu_badv_refresh_cancel(). A
+ * read blocked in the kernel cannot be interrupted; its result is dropped when
+ * it returns and the queries waiting for it return at once.
+ *
+ * A handle can be used from several threads, the calls are serialized.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_ASYNC_H
+#define MESHUTIL_BATMAN_ADV_ASYNC_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batman_adv_node_store.h"
+#include "batman_adv_originators.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Opaque handle of an asynchronous originator table refresh.
+struct mu_badv_refresh;
+
+/// Called by the worker thread when a refresh result is ready.
+typedef void (*mu_badv_refresh_notify_fn)(void *ctx);
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Create a refresh handle and its worker thread.
+ *
+ * The worker thread blocks all signals, so signal handling of the caller is
+ * not affected.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the handle. Has to be released with
+ *         mu_badv_refresh_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_refresh
+*mu_badv_refresh_new(const char *const interface_name, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release a refresh handle.
+ *
+ * Waits for a read in progress to finish. An uncollected result is freed.
+ * Can be called from the notify function, the handle is then released when
+ * the notify function returns.
+ */
+void
+mu_badv_refresh_free(struct mu_badv_refresh *const refresh)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the completion descriptor of a refresh handle.
+ *
+ * The descriptor is non-blocking and becomes readable when a result can be
+ * collected. It is owned by the handle and must not be read or closed by the
+ * caller.
+ *
+ * @retval -1 refresh is NULL.
+ */
+int
+mu_badv_refresh_fd(const struct mu_badv_refresh *const refresh)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Set the function called when a refresh result is ready.
+ *
+ * The function is called on the worker thread, without any lock held, so it
+ * can call mu_badv_refresh_collect, mu_badv_refresh_start and
+ * mu_badv_refresh_free. It delays the next refresh until it returns.
+ *
+ * @param *refresh [in] The refresh handle.
+ * @param  notify  [in] The function, NULL to call none.
+ * @param *ctx     [in] Passed to the function as is.
+ */
+void
+mu_badv_refresh_set_notify(struct mu_badv_refresh    *const refresh,
+                           mu_badv_refresh_notify_fn        notify,
+                           void                            *ctx)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Set a node store to sync with every refreshed table.
+ *
+ * The worker thread syncs the store before it signals the result, so the
+ * store is up to date when the descriptor becomes readable. Takes effect
+ * with the next refresh; the store has to stay valid until the handle is
+ * freed.
+ *
+ * @param *refresh [in] The refresh handle.
+ * @param *store   [in] The node store, NULL for none.
+ */
+void
+mu_badv_refresh_set_store(struct mu_badv_refresh    *const refresh,
+                          struct mu_badv_node_store *const store)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Start reading the originators table in the background.
+ *
+ * Returns without waiting for the read. If a refresh is already in progress
+ * no second one is started, its result answers both requests.
+ *
+ * @param *refresh [in]  The refresh handle.
+ * @param *error   [out] For setting error codes on function failure.
+ *
+ * @retval true  A refresh is in progress.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_refresh_start(struct mu_badv_refresh *const refresh,
+                      int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Take the result of a completed refresh.
+ *
+ * Never blocks. After collecting, the descriptor is no longer readable until
+ * the next refresh completes.
+ *
+ * @param *refresh [in]  The refresh handle.
+ * @param *error   [out] For setting error codes on function failure.
+ *                       EAGAIN if no refresh has completed since the last
+ *                       collect, otherwise the error of the failed read.
+ *
+ * @return Pointer to the table. Has to be released with
+ *         mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_refresh_collect(struct mu_badv_refresh *const refresh,
+                         int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Refresh the originators table, waiting no longer than a deadline.
+ *
+ * Starts a refresh unless one is in progress, waits until it completes or
+ * the deadline passes and collects the result as mu_badv_refresh_collect()
+ * does. From the first query on the handle keeps a copy of every table read,
+ * which is returned with stale set when no fresh table can be had in time.
+ *
+ * @param *refresh     [in]  The refresh handle.
+ * @param  deadline_ms [in]  Time on CLOCK_MONOTONIC to wait until, in
+ *                           milliseconds. A past deadline does not wait.
+ * @param *stale       [out] Whether the table is the last good one rather
+ *                           than the result of this refresh. Can be NULL.
+ * @param *error       [out] For setting error codes on function failure.
+ *                           ETIMEDOUT or ECANCELED if the refresh did not
+ *                           complete and no table was read before, otherwise
+ *                           the error of the failed read.
+ *
+ * @return Pointer to the table. Has to be released with
+ *         mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_refresh_query(struct mu_badv_refresh *const refresh,
+                       const uint64_t                deadline_ms,
+                             bool                   *const stale,
+                             int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Give up on the refresh in progress.
+ *
+ * The result of the refresh is dropped and queries waiting for it return the
+ * last good table. A refresh started afterwards reads the table again. Does
+ * nothing if no refresh is in progress.
+ *
+ * @param *refresh [in] The refresh handle.
+ */
+void
+mu_badv_refresh_cancel(struct mu_badv_refresh *const refresh)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_ASYNC_H */
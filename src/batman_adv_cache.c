@@ -0,0 +1,449 @@
+/** @file batman_adv_cache.c
+ * meshutil API implementation for caching B.A.T.M.A.N. advanced originator
+ * tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_cache_impl   Originator table cache implementation
+ *
+ * Every interface with a time to live has an entry holding the current table.
+ * Entries are created by mu_badv_cache_set_ttl() and never freed, so the
+ * counters outlive turning the cache off.
+ *
+ * Cached tables count their users. A table which is replaced or dropped while
+ * in use is moved to the retired list and freed by its last user. Releasing a
+ * table therefore looks it up among the current and retired tables, which are
+ * few; tables not found there were not cached and are freed by the caller.
+ *
+ * Tables are read without the mutex held. A caller about to read a table
+ * opens a flight for the interface, which callers arriving during the read
+ * join: they wait on flight_cond and are handed the table of the leader.
+ * A table shared that way counts its users like a cached one, and one not
+ * cached is put on the retired list from the start, so it is released the
+ * same way and freed by its last user. The flight is closed when the table
+ * is published, later callers read again. It is freed by whoever leaves it
+ * last, leader or joined caller.
+ *
+ * A table read by a single caller and not cached is returned as is.
+ *
+ * n_tables lets release skip the mutex while no table is shared.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "batman_adv_cache.h"
+#include "batman_adv_debugfs.h"
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct cached_table {
+   struct cached_table       *next;    ///< Next retired table.
+   struct mu_badv_orig_table *table;
+          uint64_t            read_ms; ///< When reading started.
+          unsigned int        users;
+};
+
+/// A read of the table of an interface other callers wait for.
+struct flight {
+   struct flight             *next;
+          char                interface_name[MU_IF_NAME_LEN];
+          bool                done;    ///< table and error are set.
+   struct mu_badv_orig_table *table;   ///< Shared result, NULL on failure.
+          int                 error;
+          unsigned int        joined;  ///< Callers waiting for the read.
+          unsigned int        refs;    ///< Leader and joined not yet gone.
+};
+
+struct cache_entry {
+   struct cache_entry         *next;
+          char                 interface_name[MU_IF_NAME_LEN];
+          unsigned int         ttl_ms;
+   struct cached_table        *current;
+   struct mu_badv_cache_stats  stats;
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+static pthread_mutex_t      cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct cache_entry  *entries     = NULL;
+static struct cached_table *retired     = NULL;
+static struct flight       *flights     = NULL;
+static pthread_cond_t       flight_cond = PTHREAD_COND_INITIALIZER;
+
+/// Number of current and retired tables, read without the mutex.
+static unsigned int n_tables  = 0;
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static uint64_t now_ms(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static const char *if_name(const char *const interface_name)
+{
+   return interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+}
+
+/// Called with the mutex held.
+static struct cache_entry *find_entry(const char *const interface_name)
+{
+   struct cache_entry *entry = NULL;
+
+   for (entry = entries; entry; entry = entry->next) {
+      if (!strcmp(entry->interface_name, interface_name)) {
+         break;
+      }
+   }
+   return entry;
+}
+
+/// Called with the mutex held.
+static void free_cached(struct cached_table *const cached)
+{
+   mu_badv_orig_table_free(cached->table);
+   mu_free(cached);
+   __atomic_sub_fetch(&n_tables, 1, __ATOMIC_RELAXED);
+}
+
+/// Called with the mutex held. Frees the table unless it is in use.
+static void retire(struct cached_table *const cached)
+{
+   if (!cached) {
+      return;
+   }
+   if (!cached->users) {
+      free_cached(cached);
+      return;
+   }
+   cached->next = retired;
+   retired      = cached;
+}
+
+/// Called with the mutex held. Frees the flight once nobody uses it.
+static void leave_flight(struct flight *const flight)
+{
+   if (!--flight->refs) {
+      mu_free(flight);
+   }
+}
+
+/// Called with the mutex held. Waits for the read and takes its table.
+static struct mu_badv_orig_table *join_flight(struct flight *const flight,
+                                              int           *const error)
+{
+   struct mu_badv_orig_table *table = NULL;
+
+   flight->joined++;
+   flight->refs++;
+   while (!flight->done) {
+      pthread_cond_wait(&flight_cond, &cache_mutex);
+   }
+   table = flight->table;
+   if (!table) {
+      MU_SET_ERROR(error, flight->error);
+   }
+   leave_flight(flight);
+   return table;
+}
+
+/// Called with the mutex held. NULL if no memory, the caller reads alone.
+static struct flight *open_flight(const char *const interface_name)
+{
+   struct flight *flight = mu_calloc(1, sizeof(struct flight));
+
+   if (flight) {
+      strcpy(flight->interface_name, interface_name);
+      flight->refs = 1;
+      flight->next = flights;
+      flights      = flight;
+   }
+   return flight;
+}
+
+/// Called with the mutex held. Later callers read the table again.
+static void close_flight(const struct flight *const flight)
+{
+   struct flight **link = &flights;
+
+   while (*link != flight) {
+      link = &(*link)->next;
+   }
+   *link = flight->next;
+}
+
+/// Called with the mutex held.
+static struct flight *find_flight(const char *const interface_name)
+{
+   struct flight *flight = NULL;
+
+   for (flight = flights; flight; flight = flight->next) {
+      if (!strcmp(flight->interface_name, interface_name)) {
+         break;
+      }
+   }
+   return flight;
+}
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DEFINITIONS                                           *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - A table read after the cache was turned off is returned uncached, unless
+ *   callers joined its flight.
+ * - Failing to cache a table is not an error; it is returned uncached. The
+ *   callers which joined the flight then fail with ENOMEM.
+ * - Interface names which do not fit a flight are refused with ENAMETOOLONG
+ *   before anything is read.
+ * - Only tables read for the time to live are indexed, before other threads
+ *   can see them.
+ */
+struct mu_badv_orig_table *mu_badv_cache_acquire(
+   const char *const interface_name,
+         int  *const error)
+{
+   const char                *ifname     = if_name(interface_name);
+   struct cache_entry        *entry      = NULL;
+   struct cached_table       *cached     = NULL;
+   struct flight             *flight     = NULL;
+   struct mu_badv_orig_table *table      = NULL;
+   uint64_t                   now        = 0;
+   unsigned int               users      = 1;
+   int                        load_error = 0;
+   bool                       reused     = false;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+
+   pthread_mutex_lock(&cache_mutex);
+   entry = find_entry(ifname);
+   now   = now_ms();
+   if (entry && entry->ttl_ms && entry->current
+       && now - entry->current->read_ms < entry->ttl_ms) {
+      entry->current->users++;
+      entry->stats.hits++;
+      table = entry->current->table;
+      pthread_mutex_unlock(&cache_mutex);
+      return table;
+   }
+
+   flight = find_flight(ifname);
+   if (flight) {
+      if (entry) {
+         entry->stats.joined++;
+      }
+      table = join_flight(flight, error);
+      pthread_mutex_unlock(&cache_mutex);
+      return table;
+   }
+   if (entry) {
+      entry->stats.misses++;
+   }
+   reused = entry && entry->ttl_ms;
+   flight = open_flight(ifname);
+   pthread_mutex_unlock(&cache_mutex);
+
+   table = mu_badv_orig_table_load(interface_name, &load_error);
+   if (table) {
+      if (reused) {
+         mu_badv_orig_table_index_reused(table);
+      }
+      cached = mu_malloc(sizeof(struct cached_table));
+   } else if (!load_error) {
+      load_error = EIO;
+   }
+   MU_SET_ERROR(error, load_error);
+
+   pthread_mutex_lock(&cache_mutex);
+   entry = find_entry(ifname);
+   if (flight) {
+      close_flight(flight);
+      users += flight->joined;
+   }
+   if (cached && ((entry && entry->ttl_ms) || users > 1)) {
+      cached->table   = table;
+      cached->read_ms = now;
+      cached->users   = users;
+      if (entry && entry->ttl_ms) {
+         retire(entry->current);
+         cached->next   = NULL;
+         entry->current = cached;
+      } else {
+         cached->next = retired;
+         retired      = cached;
+      }
+      __atomic_add_fetch(&n_tables, 1, __ATOMIC_RELAXED);
+      cached = NULL;
+   } else if (users > 1) {
+      load_error = table ? ENOMEM : load_error;
+      users      = 1;
+   }
+   if (flight) {
+      flight->table = users > 1 ? table : NULL;
+      flight->error = load_error;
+      flight->done  = true;
+      pthread_cond_broadcast(&flight_cond);
+      leave_flight(flight);
+   }
+   pthread_mutex_unlock(&cache_mutex);
+
+   mu_free(cached);
+   return table;
+}
+
+bool mu_badv_cache_release(const struct mu_badv_orig_table *const table)
+{
+   struct cache_entry   *entry  = NULL;
+   struct cached_table **link   = NULL;
+   struct cached_table  *cached = NULL;
+
+   if (!__atomic_load_n(&n_tables, __ATOMIC_RELAXED)) {
+      return false;
+   }
+
+   pthread_mutex_lock(&cache_mutex);
+   for (entry = entries; entry; entry = entry->next) {
+      if (entry->current && entry->current->table == table) {
+         entry->current->users--;
+         pthread_mutex_unlock(&cache_mutex);
+         return true;
+      }
+   }
+   for (link = &retired; *link; link = &(*link)->next) {
+      cached = *link;
+      if (cached->table == table) {
+         if (!--cached->users) {
+            *link = cached->next;
+            free_cached(cached);
+         }
+         pthread_mutex_unlock(&cache_mutex);
+         return true;
+      }
+   }
+   pthread_mutex_unlock(&cache_mutex);
+
+   return false;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+bool mu_badv_cache_set_ttl(const char         *const interface_name,
+                           const unsigned int        ttl_ms,
+                                 int          *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const char         *ifname = if_name(interface_name);
+   struct cache_entry *entry  = NULL;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return false;
+   }
+
+   pthread_mutex_lock(&cache_mutex);
+   entry = find_entry(ifname);
+   if (!entry) {
+      entry = mu_calloc(1, sizeof(struct cache_entry));
+      if (!entry) {
+         MU_SET_ERROR(error, errno);
+         pthread_mutex_unlock(&cache_mutex);
+         return false;
+      }
+      strcpy(entry->interface_name, ifname);
+      entry->next = entries;
+      entries     = entry;
+   }
+
+   entry->ttl_ms = ttl_ms;
+   if (!ttl_ms) {
+      retire(entry->current);
+      entry->current = NULL;
+   }
+   pthread_mutex_unlock(&cache_mutex);
+
+   return true;
+}
+
+void mu_badv_cache_invalidate(const char *const interface_name)
+{
+   struct cache_entry *entry = NULL;
+
+   pthread_mutex_lock(&cache_mutex);
+   entry = find_entry(if_name(interface_name));
+   if (entry) {
+      retire(entry->current);
+      entry->current = NULL;
+   }
+   pthread_mutex_unlock(&cache_mutex);
+}
+
+bool mu_badv_cache_stats(const char                 *const interface_name,
+                               struct mu_badv_cache_stats *const stats)
+{
+   struct cache_entry *entry = NULL;
+
+   if (!stats) {
+      return false;
+   }
+
+   pthread_mutex_lock(&cache_mutex);
+   entry = find_entry(if_name(interface_name));
+   if (entry) {
+      *stats = entry->stats;
+   }
+   pthread_mutex_unlock(&cache_mutex);
+
+   return entry != NULL;
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,169 @@
+/** @file batman_adv_cache.h
+ * meshutil API for caching B.A.T.M.A.N. advanced originator tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_cache   Originator table cache
+ *
+ * The mesh and node functions of the batman_adv API, e.g.
+ * mu_badv_mesh_n_nodes() and mu_badv_node_last_seen(), read and parse the
+ * originators table on every call. With a time to live set for an interface
+ * they share one parsed table per process instead, which is read again once
+ * it is older than the time to live:
+ *
+ *     mu_badv_cache_set_ttl("bat0", 500, &error);
+ *     n_nodes   = mu_badv_mesh_n_nodes("bat0", &error);     // reads the table
+ *     last_seen = mu_badv_node_last_seen("bat0", node, &error); // cached
+ *
+ * The cache is off for all interfaces by default. It can be used from any
+ * number of threads; a table stays valid for the calls answered from it even
+ * when it is replaced meanwhile. Together with mu_badv_set_orig_index() the
+ * node functions look up a cached table with a single probe.
+ *
+ * With or without a time to live, calls made while another thread reads the
+ * table of the same interface wait for that read and share its table rather
+ * than reading and parsing the table again. A burst of calls from many
+ * threads therefore costs one read, and each call sees a table read no
+ * earlier than the call of the first.
+ *
+ * mu_badv_orig_table_read(), refresh handles, history writers and MAC filters
+ * always read a fresh table.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_CACHE_H
+#define MESHUTIL_BATMAN_ADV_CACHE_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** Counters of the cache of an interface.
+ */
+struct mu_badv_cache_stats {
+   uint64_t hits;                      ///< Calls answered from the cache.
+   uint64_t misses;                    ///< Calls which read the table.
+   uint64_t joined;                    ///< Calls which shared another read.
+};
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Set the time to live of the cached table of a bat interface.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param  ttl_ms         [in]  Longest time a table is used after it was
+ *                              read, 0 to turn the cache off and drop the
+ *                              cached table.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @retval true  The time to live was set.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_cache_set_ttl(const char         *const interface_name,
+                      const unsigned int        ttl_ms,
+                            int          *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Drop the cached table of a bat interface.
+ *
+ * The next call reads the table again.
+ */
+void
+mu_badv_cache_invalidate(const char *const interface_name)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the counters of the cache of a bat interface.
+ *
+ * Counters start when a time to live is first set for the interface and are
+ * kept when the cache is turned off.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *stats          [out] The counters.
+ *
+ * @retval true  stats was filled in.
+ * @retval false No time to live was ever set for the interface.
+ */
+bool
+mu_badv_cache_stats(const char                 *const interface_name,
+                          struct mu_badv_cache_stats *const stats)
+__attribute__ ((visibility("default")));
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DECLARATIONS                                          *
+*******************************************************************************/
+
+/**
+ * @brief PRIVATE Get the originator table of an interface from the cache.
+ *
+ * Reads the table if the cache is off or stale for the interface, or waits
+ * for the read of another caller in progress.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the table. Has to be handed back with
+ *         mu_badv_orig_table_release().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_cache_acquire(const char *const interface_name,
+                             int  *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Hand back a table got from the cache.
+ *
+ * @retval true  The table belongs to the cache.
+ * @retval false The table does not belong to the cache and was not touched.
+ */
+bool
+mu_badv_cache_release(const struct mu_badv_orig_table *const table)
+__attribute__ ((visibility("hidden")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_CACHE_H */
@@ -0,0 +1,339 @@
+/** @file batman_adv_caps.c
+ * meshutil API implementation for probing B.A.T.M.A.N. advanced capabilities
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "batman_adv.h"
+#include "batman_adv_caps.h"
+#include "batman_adv_debugfs.h"
+#include "linux.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Routing algorithm module parameter (since 2013.0.0).
+#define BATMAN_ADV_ROUTING_ALGO_PATH "/sys/module/batman_adv/parameters/routing_algo"
+
+/// Name of the batman_adv generic netlink family.
+#define BATMAN_ADV_GENL_NAME "batadv"
+
+/// Size of the buffer for the generic netlink controller reply.
+#define GENL_REPLY_BUFFER_SIZE 4096
+
+/// Room for "<interface>/<table>" after the batman_adv debugfs directory.
+#define TABLE_PATH_SUFFIX_LEN 320
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+static pthread_mutex_t     caps_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool                caps_valid = false;
+static struct mu_badv_caps caps_cache;
+
+/// Table files probed in a bat interface directory and their bits.
+static const struct {
+   const char   *name;
+   unsigned int  bit;
+} probed_tables[] = {
+   { BATMAN_ADV_ORIGINATORS_TABLE, MU_BADV_TABLE_ORIGINATORS       },
+   { BATMAN_ADV_NEIGHBORS_TABLE,   MU_BADV_TABLE_NEIGHBORS         },
+   { BATMAN_ADV_GATEWAYS_TABLE,    MU_BADV_TABLE_GATEWAYS          },
+   { BATMAN_ADV_DAT_CACHE_TABLE,   MU_BADV_TABLE_DAT_CACHE         },
+   { "transtable_local",           MU_BADV_TABLE_TRANSTABLE_LOCAL  },
+   { "transtable_global",          MU_BADV_TABLE_TRANSTABLE_GLOBAL },
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static void parse_version(struct mu_badv_caps *const caps)
+{
+   unsigned int *fields[] = { &caps->version_year,
+                              &caps->version_release,
+                              &caps->version_patch };
+   const char   *str = caps->version;
+
+   for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+      if (*str < '0' || *str > '9') {
+         return;
+      }
+      while (*str >= '0' && *str <= '9') {
+         *fields[i] = *fields[i] * 10 + (unsigned int) (*str - '0');
+         str++;
+      }
+      if (*str != '.') {
+         return;
+      }
+      str++;
+   }
+}
+
+static void copy_stripped(char *const dest, const char *const src)
+{
+   size_t length = strcspn(src, "\n");
+
+   if (length >= MU_BADV_CAPS_STR_LEN) {
+      length = MU_BADV_CAPS_STR_LEN - 1;
+   }
+   memcpy(dest, src, length);
+   dest[length] = '\0';
+}
+
+/* Asks the generic netlink controller for the id of the batadv family.
+ * Returns 0 if the family is not registered or on error.
+ */
+static int resolve_genl_family(void)
+{
+   struct {
+      struct nlmsghdr   nlh;
+      struct genlmsghdr genl;
+      char              attrs[NLA_HDRLEN + NLA_ALIGN(sizeof(BATMAN_ADV_GENL_NAME))];
+   } request;
+   struct sockaddr_nl  kernel = { .nl_family = AF_NETLINK };
+   struct nlattr      *attr   = (struct nlattr *) request.attrs;
+   char                reply[GENL_REPLY_BUFFER_SIZE];
+   struct nlmsghdr    *nlh    = (struct nlmsghdr *) reply;
+   ssize_t             length;
+   int                 remaining;
+   int                 family_id = 0;
+   int                 fd;
+
+   fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+   if (fd < 0) {
+      return 0;
+   }
+
+   memset(&request, 0, sizeof(request));
+   attr->nla_type = CTRL_ATTR_FAMILY_NAME;
+   attr->nla_len  = NLA_HDRLEN + sizeof(BATMAN_ADV_GENL_NAME);
+   memcpy(request.attrs + NLA_HDRLEN, BATMAN_ADV_GENL_NAME,
+          sizeof(BATMAN_ADV_GENL_NAME));
+   request.genl.cmd         = CTRL_CMD_GETFAMILY;
+   request.genl.version     = 1;
+   request.nlh.nlmsg_type   = GENL_ID_CTRL;
+   request.nlh.nlmsg_flags  = NLM_F_REQUEST;
+   request.nlh.nlmsg_seq    = 1;
+   request.nlh.nlmsg_len    = NLMSG_LENGTH(GENL_HDRLEN
+                                           + NLA_ALIGN(attr->nla_len));
+
+   if (sendto(fd, &request, request.nlh.nlmsg_len, 0,
+              (struct sockaddr *) &kernel, sizeof(kernel)) < 0) {
+      close(fd);
+      return 0;
+   }
+
+   length = recv(fd, reply, sizeof(reply), 0);
+   close(fd);
+
+   if (length < (ssize_t) NLMSG_LENGTH(GENL_HDRLEN)
+       || !NLMSG_OK(nlh, (size_t) length)
+       || nlh->nlmsg_type == NLMSG_ERROR) {
+      return 0;
+   }
+
+   attr      = (struct nlattr *) ((char *) NLMSG_DATA(nlh) + GENL_HDRLEN);
+   remaining = (int) nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+
+   while (remaining >= NLA_HDRLEN && attr->nla_len >= NLA_HDRLEN
+          && attr->nla_len <= remaining) {
+      if (attr->nla_type == CTRL_ATTR_FAMILY_ID) {
+         family_id = *(unsigned short *) ((char *) attr + NLA_HDRLEN);
+         break;
+      }
+      remaining -= NLA_ALIGN(attr->nla_len);
+      attr = (struct nlattr *) ((char *) attr + NLA_ALIGN(attr->nla_len));
+   }
+
+   return family_id;
+}
+
+/* Finds the first bat interface directory in debugfs and checks which
+ * tables it has. The set of tables depends on the module version and build
+ * options, not on the interface.
+ */
+static void probe_debugfs_tables(struct mu_badv_caps *const caps)
+{
+   char          *debugfs_root = mu_linux_debugfs_mount_point(NULL);
+   char          *path         = NULL;
+   DIR           *dir          = NULL;
+   struct dirent *entry        = NULL;
+   size_t         root_length;
+
+   if (!debugfs_root) {
+      return;
+   }
+
+   // Longest path: <root>/batman_adv/<interface>/<table>
+   root_length = strlen(debugfs_root) + strlen("/batman_adv/");
+   path = mu_calloc(root_length + TABLE_PATH_SUFFIX_LEN, sizeof(char));
+   if (!path) {
+      mu_free(debugfs_root);
+      return;
+   }
+   strcat(path, debugfs_root);
+   strcat(path, "/batman_adv/");
+   mu_free(debugfs_root);
+
+   dir = opendir(path);
+   if (!dir) {
+      mu_free(path);
+      return;
+   }
+   caps->features |= MU_BADV_FEATURE_DEBUGFS;
+
+   while ((entry = readdir(dir))) {
+      if (entry->d_name[0] == '.'
+          || strlen(entry->d_name) > TABLE_PATH_SUFFIX_LEN / 2) {
+         continue;
+      }
+
+      for (size_t i = 0; i < sizeof(probed_tables) / sizeof(probed_tables[0]);
+           i++) {
+         path[root_length] = '\0';
+         strcat(path, entry->d_name);
+         strcat(path, "/");
+         strcat(path, probed_tables[i].name);
+         if (!access(path, F_OK)) {
+            caps->tables |= probed_tables[i].bit;
+         } else if (!i) {
+            break; // Not a bat interface directory.
+         }
+      }
+
+      if (caps->tables) {
+         break;
+      }
+   }
+
+   closedir(dir);
+   mu_free(path);
+}
+
+static bool probe(struct mu_badv_caps *const caps, int *const error)
+{
+   char *version      = NULL;
+   char *routing_algo = NULL;
+   int   probe_error  = 0;
+
+   memset(caps, 0, sizeof(*caps));
+
+   if (mu_badv_kmod_available(NULL)) {
+      caps->features |= MU_BADV_FEATURE_KMOD_AVAILABLE;
+   }
+
+   if (!mu_badv_kmod_loaded(&probe_error)) {
+      MU_SET_ERROR(error, probe_error);
+      return !probe_error;
+   }
+   caps->features |= MU_BADV_FEATURE_KMOD_LOADED;
+
+   version = mu_badv_kmod_version(error);
+   if (!version) {
+      return false;
+   }
+   copy_stripped(caps->version, version);
+   mu_free(version);
+   parse_version(caps);
+
+   routing_algo = mu_linux_read_file(BATMAN_ADV_ROUTING_ALGO_PATH, NULL, NULL);
+   if (routing_algo) {
+      copy_stripped(caps->routing_algo, routing_algo);
+      mu_free(routing_algo);
+   }
+
+   caps->genl_family_id = resolve_genl_family();
+   if (caps->genl_family_id) {
+      caps->features |= MU_BADV_FEATURE_GENL;
+   }
+
+   probe_debugfs_tables(caps);
+   return true;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - The mutex is held while probing so concurrent first calls probe once.
+ * - A failed probe is not cached.
+ */
+bool mu_badv_caps_get(struct mu_badv_caps *const caps, int *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   bool ok = true;
+
+   if (!caps) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_CALL_START("");
+   pthread_mutex_lock(&caps_mutex);
+   if (!caps_valid) {
+      ok = probe(&caps_cache, error);
+      caps_valid = ok;
+   }
+   if (ok) {
+      *caps = caps_cache;
+   }
+   pthread_mutex_unlock(&caps_mutex);
+
+   MU_TRACE_CALL_DONE("", error);
+   return ok;
+}
+
+void mu_badv_caps_invalidate(void)
+{
+   pthread_mutex_lock(&caps_mutex);
+   caps_valid = false;
+   pthread_mutex_unlock(&caps_mutex);
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,134 @@
+/** @file batman_adv_caps.h
+ * meshutil API for probing B.A.T.M.A.N. advanced capabilities
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_caps   Capability probe
+ *
+ * mu_badv_kmod_available, mu_badv_kmod_loaded and mu_badv_kmod_version probe
+ * the file system on every call. The capability probe does all of these probes
+ * once per process and caches the result, including the parsed module
+ * version, the generic netlink family id, the routing algorithm and the tables
+ * available in debugfs. The cached result is kept until
+ * mu_badv_caps_invalidate is called, e.g. after loading the kernel module.
+ *
+ * The probe functions are thread safe.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_CAPS_H
+#define MESHUTIL_BATMAN_ADV_CAPS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// The kernel module is available for the running kernel.
+#define MU_BADV_FEATURE_KMOD_AVAILABLE (1u << 0)
+/// The kernel module is loaded.
+#define MU_BADV_FEATURE_KMOD_LOADED    (1u << 1)
+/// debugfs is mounted and has a batman_adv directory.
+#define MU_BADV_FEATURE_DEBUGFS        (1u << 2)
+/// The batadv generic netlink family is registered.
+#define MU_BADV_FEATURE_GENL           (1u << 3)
+
+#define MU_BADV_TABLE_ORIGINATORS       (1u << 0)
+#define MU_BADV_TABLE_NEIGHBORS         (1u << 1)
+#define MU_BADV_TABLE_GATEWAYS          (1u << 2)
+#define MU_BADV_TABLE_DAT_CACHE         (1u << 3)
+#define MU_BADV_TABLE_TRANSTABLE_LOCAL  (1u << 4)
+#define MU_BADV_TABLE_TRANSTABLE_GLOBAL (1u << 5)
+
+/// Length of the version and routing algorithm strings including the NUL.
+#define MU_BADV_CAPS_STR_LEN 32
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** Capabilities of the batman_adv kernel module.
+ *
+ * The version "2011.4.0" is split into year 2011, release 4 and patch 0.
+ * Fields that could not be probed are zero (genl_family_id and strings
+ * included).
+ */
+struct mu_badv_caps {
+   unsigned int version_year;
+   unsigned int version_release;
+   unsigned int version_patch;
+   unsigned int features;         ///< MU_BADV_FEATURE_* bits.
+   unsigned int tables;           ///< MU_BADV_TABLE_* bits.
+            int genl_family_id;   ///< Generic netlink family id of batadv.
+   char         version[MU_BADV_CAPS_STR_LEN];
+   char         routing_algo[MU_BADV_CAPS_STR_LEN];
+};
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Get the cached batman_adv capabilities.
+ *
+ * The first call (and the first call after mu_badv_caps_invalidate) probes
+ * the system, later calls only copy the cached result.
+ *
+ * A missing kernel module is not an error, it is reported by the features.
+ *
+ * @param *caps  [out] The capabilities.
+ * @param *error [out] For setting error codes on function failure.
+ *
+ * @retval true  caps was filled in.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_caps_get(struct mu_badv_caps *const caps, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Discard the cached capabilities.
+ *
+ * The next mu_badv_caps_get call probes the system again.
+ */
+void
+mu_badv_caps_invalidate(void)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_CAPS_H */
@@ -0,0 +1,448 @@
+/** @file batman_adv_dat.c
+ * meshutil API implementation for the B.A.T.M.A.N. advanced Distributed ARP
+ * Table
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_dat_impl   Distributed ARP Table implementation
+ *
+ * dat_cache lines look like
+ *
+ *      * 192.168.10.42   02:ba:7a:df:04:01   -1      0:05
+ *
+ * where the VID column is missing in versions before VLAN support and the
+ * last-seen column is printed as minutes:seconds.
+ *
+ * The index is an open addressing hash table with linear probing. Slots hold
+ * entry index + 1 (0 marks an empty slot) and the table is kept at most half
+ * full, so a lookup touches one or two slots on average.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batman_adv_dat.h"
+#include "batman_adv_debugfs.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Smallest number of hash slots allocated.
+#define DAT_INDEX_MIN_SLOTS 64
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Entries parsed from one chunk of the dat_cache table.
+struct dat_chunk {
+   struct mu_badv_dat_entry *entries;
+          size_t             n_entries;
+          int                error;
+};
+
+struct dat_parse {
+          struct dat_chunk  *chunks;
+   const  char             **bounds;
+};
+
+struct mu_badv_dat_index {
+          char               interface_name[MU_IF_NAME_LEN];
+   struct mu_badv_dat_entry *entries;
+          size_t             n_entries;
+          size_t             entries_capacity;
+          uint32_t          *slots;
+          size_t             slot_mask;   ///< Number of slots - 1.
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static size_t ipv4_hash(const uint32_t ipv4, const size_t slot_mask)
+{
+   return (size_t) (((uint64_t) ipv4 * 0x9e3779b97f4a7c15ULL) >> 32)
+          & slot_mask;
+}
+
+static const char *parse_ipv4(const char *str, uint32_t *const ipv4)
+{
+   unsigned char octets[4];
+   unsigned int  value;
+
+   str = mu_badv_skip_blanks(str);
+
+   for (int i = 0; i < 4; i++) {
+      if (*str < '0' || *str > '9') {
+         return NULL;
+      }
+      value = 0;
+      while (*str >= '0' && *str <= '9') {
+         value = value * 10 + (unsigned int) (*str - '0');
+         str++;
+      }
+      if (value > 255 || (i < 3 && *str++ != '.')) {
+         return NULL;
+      }
+      octets[i] = (unsigned char) value;
+   }
+
+   memcpy(ipv4, octets, sizeof(octets));
+   return str;
+}
+
+static const char *parse_int(const char *str, int *const value)
+{
+   bool negative = false;
+
+   str = mu_badv_skip_blanks(str);
+   if (*str == '-') {
+      negative = true;
+      str++;
+   }
+   if (*str < '0' || *str > '9') {
+      return NULL;
+   }
+   *value = 0;
+   while (*str >= '0' && *str <= '9') {
+      *value = *value * 10 + (*str - '0');
+      str++;
+   }
+   if (negative) {
+      *value = -*value;
+   }
+   return str;
+}
+
+static bool parse_dat_line(const char               *line,
+                           const char               *const end,
+                           struct mu_badv_dat_entry *const entry)
+{
+   int first, second, third;
+
+   line = mu_badv_skip_blanks(line);
+   if (*line != '*') {
+      return false;
+   }
+
+   if (!(line = parse_ipv4(line + 1, &entry->ipv4))) {
+      return false;
+   }
+   if (!(line = mu_badv_parse_mac(mu_badv_skip_blanks(line), end,
+                                  &entry->mac_addr))) {
+      return false;
+   }
+   if (!(line = parse_int(line, &first))) {
+      return false;
+   }
+
+   if (*line == ':') { // No VID column: "<mins>:<secs>".
+      entry->vid = MU_BADV_DAT_VID_UNTAGGED;
+      if (!parse_int(line + 1, &second)) {
+         return false;
+      }
+      entry->last_seen_secs = (uint32_t) (first * 60 + second);
+      return true;
+   }
+
+   entry->vid = (int16_t) first;
+   if (!(line = parse_int(line, &second)) || *line != ':') {
+      return false;
+   }
+   if (!parse_int(line + 1, &third)) {
+      return false;
+   }
+   entry->last_seen_secs = (uint32_t) (second * 60 + third);
+   return true;
+}
+
+static bool reserve(struct mu_badv_dat_index *const index,
+                    const size_t                    n_lines,
+                          int                *const error)
+{
+   struct mu_badv_dat_entry *entries = NULL;
+   uint32_t                 *slots   = NULL;
+   size_t                    n_slots = DAT_INDEX_MIN_SLOTS;
+
+   if (n_lines > index->entries_capacity) {
+      entries = mu_realloc(index->entries,
+                        n_lines * sizeof(struct mu_badv_dat_entry));
+      if (!entries) {
+         MU_SET_ERROR(error, errno);
+         return false;
+      }
+      index->entries          = entries;
+      index->entries_capacity = n_lines;
+   }
+
+   while (n_slots < n_lines * 2) {
+      n_slots *= 2;
+   }
+
+   if (n_slots - 1 > index->slot_mask || !index->slots) {
+      slots = mu_realloc(index->slots, n_slots * sizeof(uint32_t));
+      if (!slots) {
+         MU_SET_ERROR(error, errno);
+         return false;
+      }
+      index->slots     = slots;
+      index->slot_mask = n_slots - 1;
+   }
+
+   memset(index->slots, 0, (index->slot_mask + 1) * sizeof(uint32_t));
+   return true;
+}
+
+static void parse_chunk(void *const ctx, const size_t chunk)
+{
+   struct dat_parse *parse   = ctx;
+   struct dat_chunk *result  = &parse->chunks[chunk];
+   const  char      *start   = parse->bounds[chunk];
+   const  char      *end     = parse->bounds[chunk + 1];
+   const  char      *line    = NULL;
+   size_t            n_lines = mu_badv_count_delimiters(start, end, NULL) + 1;
+
+   result->n_entries = 0;
+   result->error     = 0;
+
+   result->entries = mu_malloc(n_lines * sizeof(struct mu_badv_dat_entry));
+   if (!result->entries) {
+      result->error = errno;
+      return;
+   }
+
+   for (line = start; line < end && *line; line = mu_badv_next_line(line)) {
+      if (parse_dat_line(line, end, &result->entries[result->n_entries])) {
+         result->n_entries++;
+      }
+   }
+}
+
+static void insert_entry(struct mu_badv_dat_index *const index)
+{
+   size_t slot = ipv4_hash(index->entries[index->n_entries].ipv4,
+                           index->slot_mask);
+
+   while (index->slots[slot]) {
+      slot = (slot + 1) & index->slot_mask;
+   }
+   index->slots[slot] = (uint32_t) ++index->n_entries;
+}
+
+/* Implementation notes:
+ * - The chunks are parsed in parallel into entry arrays of their own, which
+ *   are then copied and hashed in order, so the index is the same as from
+ *   parsing the buffer at once.
+ */
+static bool parse_parallel(struct mu_badv_dat_index *const index,
+                           const  char             **const bounds,
+                           const  size_t                   n_chunks,
+                                  int               *const error)
+{
+   struct dat_chunk chunks[MU_BADV_MAX_PARSE_CHUNKS];
+   struct dat_parse parse     = { chunks, bounds };
+   size_t           n_entries = 0;
+   bool             ok        = true;
+
+   mu_badv_parse_parallel(n_chunks, parse_chunk, &parse);
+
+   for (size_t i = 0; i < n_chunks && ok; i++) {
+      if (!chunks[i].entries) {
+         MU_SET_ERROR(error, chunks[i].error);
+         ok = false;
+      }
+      n_entries += chunks[i].n_entries;
+   }
+
+   ok = ok && reserve(index, n_entries + 1, error);
+
+   for (size_t i = 0; i < n_chunks && ok; i++) {
+      for (size_t e = 0; e < chunks[i].n_entries; e++) {
+         index->entries[index->n_entries] = chunks[i].entries[e];
+         insert_entry(index);
+      }
+   }
+
+   for (size_t i = 0; i < n_chunks; i++) {
+      mu_free(chunks[i].entries);
+   }
+   return ok;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_dat_index *mu_badv_dat_index_new(
+   const char *const interface_name,
+         int  *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const char *ifname = interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+   struct mu_badv_dat_index *index = NULL;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+
+   index = mu_calloc(1, sizeof(struct mu_badv_dat_index));
+   if (!index) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   strcpy(index->interface_name, ifname);
+   return index;
+}
+
+void mu_badv_dat_index_free(struct mu_badv_dat_index *const index)
+{
+   if (!index) {
+      return;
+   }
+   mu_free(index->entries);
+   mu_free(index->slots);
+   mu_free(index);
+}
+
+/* Implementation notes:
+ * - Reads the dat_cache table in one go and sizes the entries and slots by
+ *   its number of lines before parsing, so a refresh allocates at most twice.
+ * - Large tables are parsed in parallel, see parse_parallel.
+ */
+bool mu_badv_dat_index_refresh(struct mu_badv_dat_index *const index,
+                                      int               *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   char                     *buffer   = NULL;
+   const char               *line     = NULL;
+   const char               *bounds[MU_BADV_MAX_PARSE_CHUNKS + 1];
+   size_t                    length   = 0;
+   size_t                    n_chunks;
+   size_t                    n_lines  = 1;
+   bool                      ok       = true;
+
+   if (!index) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_CALL_START(index->interface_name);
+   index->n_entries = 0;
+
+   buffer = mu_badv_debugfs_read_table(index->interface_name,
+                                       BATMAN_ADV_DAT_CACHE_TABLE,
+                                       &length, error);
+   if (!buffer) {
+      MU_TRACE_CALL_DONE(index->interface_name, error);
+      return false;
+   }
+
+   MU_TRACE_PARSE_START(index->interface_name, BATMAN_ADV_DAT_CACHE_TABLE,
+                        length);
+   n_chunks = mu_badv_parse_chunks(buffer, length, bounds);
+   if (n_chunks > 1) {
+      ok = parse_parallel(index, bounds, n_chunks, error);
+      goto out;
+   }
+
+   n_lines += mu_badv_count_delimiters(buffer, buffer + length, NULL);
+
+   if (!reserve(index, n_lines, error)) {
+      ok = false;
+      goto out;
+   }
+
+   for (line = buffer; *line; line = mu_badv_next_line(line)) {
+      if (parse_dat_line(line, buffer + length,
+                         &index->entries[index->n_entries])) {
+         insert_entry(index);
+      }
+   }
+
+out:
+   MU_TRACE_PARSE_DONE(index->interface_name, BATMAN_ADV_DAT_CACHE_TABLE,
+                       index->n_entries);
+   MU_TRACE_CALL_DONE(index->interface_name, error);
+   mu_free(buffer);
+   return ok;
+}
+
+bool mu_badv_dat_lookup(const struct mu_badv_dat_index *const index,
+                        const        uint32_t                ipv4,
+                        const        int                     vid,
+                                     struct mu_badv_dat_entry *const entry)
+{
+   const struct mu_badv_dat_entry *candidate = NULL;
+   size_t                          slot;
+
+   if (!index || !index->n_entries) {
+      return false;
+   }
+
+   slot = ipv4_hash(ipv4, index->slot_mask);
+   while (index->slots[slot]) {
+      candidate = &index->entries[index->slots[slot] - 1];
+      if (candidate->ipv4 == ipv4
+          && (vid == MU_BADV_DAT_VID_ANY || candidate->vid == vid)) {
+         if (entry) {
+            *entry = *candidate;
+         }
+         return true;
+      }
+      slot = (slot + 1) & index->slot_mask;
+   }
+
+   return false;
+}
+
+const struct mu_badv_dat_entry *mu_badv_dat_index_entries(
+   const struct mu_badv_dat_index *const index,
+         size_t                   *const n_entries)
+{
+   if (!index) {
+      *n_entries = 0;
+      return NULL;
+   }
+   *n_entries = index->n_entries;
+   return index->entries;
+}
+
+#endif                          /* __linux */
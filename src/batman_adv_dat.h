@@ -0,0 +1,165 @@
+/** @file batman_adv_dat.h
+ * meshutil API for the B.A.T.M.A.N. advanced Distributed ARP Table
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_dat   Distributed ARP Table
+ *
+ * batman_adv caches the IPv4 to MAC address mappings it learns in the
+ * Distributed ARP Table (DAT). The dat_cache table of a bat interface lists
+ * them together with the VLAN and the time since the entry was last updated.
+ *
+ * A DAT index holds a parsed copy of the dat_cache table hashed by IPv4
+ * address. It is refreshed in bulk; memory is reused between refreshes and
+ * only grows when the table does. An index must not be refreshed while other
+ * threads look up entries in it.
+ *
+ * IPv4 addresses are passed in network byte order, i.e. as the s_addr member
+ * of struct in_addr.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_DAT_H
+#define MESHUTIL_BATMAN_ADV_DAT_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// VLAN id of entries that are not VLAN tagged.
+#define MU_BADV_DAT_VID_UNTAGGED (-1)
+
+/// VLAN id matching entries of any VLAN in mu_badv_dat_lookup().
+#define MU_BADV_DAT_VID_ANY (-2)
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** One entry of the Distributed ARP Table.
+ */
+struct mu_badv_dat_entry {
+          uint32_t    ipv4;            ///< IPv4 address, network byte order.
+   struct mu_mac_addr mac_addr;        ///< MAC address the IP resolves to.
+          int16_t     vid;             ///< VLAN id or MU_BADV_DAT_VID_UNTAGGED.
+          uint32_t    last_seen_secs;  ///< Age of the entry.
+};
+
+/// Opaque IPv4 keyed index over the dat_cache table.
+struct mu_badv_dat_index;
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Create an empty DAT index for a bat interface.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the index. Has to be released with
+ *         mu_badv_dat_index_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_dat_index
+*mu_badv_dat_index_new(const char *const interface_name, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release a DAT index.
+ */
+void
+mu_badv_dat_index_free(struct mu_badv_dat_index *const index)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Re-read the dat_cache table and rebuild the index.
+ *
+ * On failure the index is left empty.
+ *
+ * @param *index [in]  The DAT index.
+ * @param *error [out] For setting error codes on function failure.
+ *
+ * @retval true  The index was rebuilt.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_dat_index_refresh(struct mu_badv_dat_index *const index,
+                                 int               *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Look up the entry of an IPv4 address.
+ *
+ * @param *index [in]  The DAT index.
+ * @param  ipv4  [in]  IPv4 address in network byte order.
+ * @param  vid   [in]  VLAN id, MU_BADV_DAT_VID_UNTAGGED or
+ *                     MU_BADV_DAT_VID_ANY.
+ * @param *entry [out] The matching entry. Can be NULL.
+ *
+ * @retval true  An entry was found.
+ * @retval false The address is not in the index.
+ */
+bool
+mu_badv_dat_lookup(const struct mu_badv_dat_index *const index,
+                   const        uint32_t                ipv4,
+                   const        int                     vid,
+                                struct mu_badv_dat_entry *const entry)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get all entries of the index in table order.
+ *
+ * @param *index     [in]  The DAT index.
+ * @param *n_entries [out] Number of entries.
+ *
+ * @return Pointer to the entries. Owned by the index and valid until the next
+ *         refresh.
+ */
+const struct mu_badv_dat_entry
+*mu_badv_dat_index_entries(const struct mu_badv_dat_index *const index,
+                                 size_t                   *const n_entries)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_DAT_H */
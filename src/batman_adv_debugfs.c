@@ -0,0 +1,655 @@
+/** @file batman_adv_debugfs.c
+ * Internal helpers for the batman_adv debugfs tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "batman_adv_debugfs.h"
+#include "linux.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Directory of batman_adv under the debugfs mount point.
+#define BATMAN_ADV_DEBUGFS_DIR "/batman_adv/"
+
+/// Default size from which tables are parsed in parallel.
+#define PARALLEL_PARSE_MIN_BYTES (1024 * 1024)
+
+/// Smallest chunk worth a thread of its own.
+#define PARALLEL_PARSE_CHUNK_BYTES (256 * 1024)
+
+/// Most vectors counted into 8 bit lanes before they could overflow.
+#define COUNT_MAX_VECTORS 255
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct parse_job {
+   void   (*parse)(void *ctx, size_t chunk);
+   void    *ctx;
+   size_t   chunk;
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+/// 0 for one thread per online CPU.
+static unsigned int parallel_parse_max_threads = 0;
+static size_t       parallel_parse_min_bytes   = PARALLEL_PARSE_MIN_BYTES;
+
+/// One more than the value of a hex digit, 0 for other characters.
+static const unsigned char hex_values[256] = {
+   ['0'] =  1, ['1'] =  2, ['2'] =  3, ['3'] =  4, ['4'] =  5,
+   ['5'] =  6, ['6'] =  7, ['7'] =  8, ['8'] =  9, ['9'] = 10,
+   ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+   ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static void *parse_worker(void *const arg)
+{
+   struct parse_job *job = arg;
+
+   job->parse(job->ctx, job->chunk);
+   return NULL;
+}
+
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+
+/* Implementation notes:
+ * - Matches are counted in 8 bit lanes by subtracting the all-ones compare
+ *   results, and the lanes are summed every COUNT_MAX_VECTORS vectors. Only
+ *   whole vectors are counted; the rest is left to the caller.
+ */
+static const char *count_vectors(const char   *str,
+                                 const char   *const end,
+                                       size_t *const n_lines,
+                                       size_t *const n_parens)
+{
+#if defined(__AVX2__)
+   const  size_t  vector_size = sizeof(__m256i);
+   const __m256i  newline     = _mm256_set1_epi8('\n');
+   const __m256i  paren       = _mm256_set1_epi8('(');
+   __m256i        chars, lines, parens;
+#elif defined(__SSE2__)
+   const  size_t  vector_size = sizeof(__m128i);
+   const __m128i  newline     = _mm_set1_epi8('\n');
+   const __m128i  paren       = _mm_set1_epi8('(');
+   __m128i        chars, lines, parens;
+#else
+   const  size_t      vector_size = sizeof(uint8x16_t);
+   const  uint8x16_t  newline     = vdupq_n_u8('\n');
+   const  uint8x16_t  paren       = vdupq_n_u8('(');
+   uint8x16_t         chars, lines, parens;
+   uint64x2_t         sums;
+#endif
+   size_t n_vectors = 0;
+
+   while ((size_t) (end - str) >= vector_size) {
+      n_vectors = (size_t) (end - str) / vector_size;
+      if (n_vectors > COUNT_MAX_VECTORS) {
+         n_vectors = COUNT_MAX_VECTORS;
+      }
+#if defined(__AVX2__)
+      lines  = _mm256_setzero_si256();
+      parens = _mm256_setzero_si256();
+      for (size_t i = 0; i < n_vectors; i++, str += vector_size) {
+         chars  = _mm256_loadu_si256((const __m256i *) str);
+         lines  = _mm256_sub_epi8(lines, _mm256_cmpeq_epi8(chars, newline));
+         parens = _mm256_sub_epi8(parens, _mm256_cmpeq_epi8(chars, paren));
+      }
+      lines  = _mm256_sad_epu8(lines, _mm256_setzero_si256());
+      parens = _mm256_sad_epu8(parens, _mm256_setzero_si256());
+      for (int i = 0; i < 4; i++) {
+         *n_lines  += (size_t) _mm256_extract_epi64(lines, 0);
+         *n_parens += (size_t) _mm256_extract_epi64(parens, 0);
+         lines  = _mm256_permute4x64_epi64(lines, 0x39);
+         parens = _mm256_permute4x64_epi64(parens, 0x39);
+      }
+#elif defined(__SSE2__)
+      lines  = _mm_setzero_si128();
+      parens = _mm_setzero_si128();
+      for (size_t i = 0; i < n_vectors; i++, str += vector_size) {
+         chars  = _mm_loadu_si128((const __m128i *) str);
+         lines  = _mm_sub_epi8(lines, _mm_cmpeq_epi8(chars, newline));
+         parens = _mm_sub_epi8(parens, _mm_cmpeq_epi8(chars, paren));
+      }
+      lines  = _mm_sad_epu8(lines, _mm_setzero_si128());
+      parens = _mm_sad_epu8(parens, _mm_setzero_si128());
+      lines  = _mm_add_epi32(lines, _mm_srli_si128(lines, 8));
+      parens = _mm_add_epi32(parens, _mm_srli_si128(parens, 8));
+      *n_lines  += (size_t) _mm_cvtsi128_si32(lines);
+      *n_parens += (size_t) _mm_cvtsi128_si32(parens);
+#else
+      lines  = vdupq_n_u8(0);
+      parens = vdupq_n_u8(0);
+      for (size_t i = 0; i < n_vectors; i++, str += vector_size) {
+         chars  = vld1q_u8((const uint8_t *) str);
+         lines  = vsubq_u8(lines, vceqq_u8(chars, newline));
+         parens = vsubq_u8(parens, vceqq_u8(chars, paren));
+      }
+      sums       = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(lines)));
+      *n_lines  += (size_t) (vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+      sums       = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(parens)));
+      *n_parens += (size_t) (vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+#endif
+   }
+   return str;
+}
+
+#endif                          /* __AVX2__ || __SSE2__ || __ARM_NEON */
+
+static size_t parallel_parse_threads(const size_t length)
+{
+   unsigned int max_threads = __atomic_load_n(&parallel_parse_max_threads,
+                                              __ATOMIC_RELAXED);
+   size_t       min_bytes   = __atomic_load_n(&parallel_parse_min_bytes,
+                                              __ATOMIC_RELAXED);
+   long         n_cpus      = sysconf(_SC_NPROCESSORS_ONLN);
+   size_t       n_threads   = max_threads ? max_threads
+                                          : (n_cpus > 0 ? (size_t) n_cpus : 1);
+
+   if (length < min_bytes) {
+      return 1;
+   }
+   if (n_threads > length / PARALLEL_PARSE_CHUNK_BYTES) {
+      n_threads = length / PARALLEL_PARSE_CHUNK_BYTES;
+   }
+   if (n_threads > MU_BADV_MAX_PARSE_CHUNKS) {
+      n_threads = MU_BADV_MAX_PARSE_CHUNKS;
+   }
+   return n_threads ? n_threads : 1;
+}
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DEFINITIONS                                           *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - <debugfs>/batman_adv/<interface_name>/<table_name>
+ */
+char *mu_badv_debugfs_table_path(const char *const interface_name,
+                                 const char *const table_name,
+                                       int  *const error)
+{
+   const char *ifname = interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+   char *debugfs_root = mu_linux_debugfs_mount_point(NULL);
+   char *path = NULL;
+
+   if (!debugfs_root) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   path = mu_calloc(strlen(debugfs_root) + strlen(BATMAN_ADV_DEBUGFS_DIR)
+                 + strlen(ifname) + 1 + strlen(table_name) + 1,
+                 sizeof(char));
+   if (!path) {
+      MU_SET_ERROR(error, errno);
+      mu_free(debugfs_root);
+      return NULL;
+   }
+
+   strcat(path, debugfs_root);
+   strcat(path, BATMAN_ADV_DEBUGFS_DIR);
+   strcat(path, ifname);
+   strcat(path, "/");
+   strcat(path, table_name);
+
+   mu_free(debugfs_root);
+   return path;
+}
+
+char *mu_badv_debugfs_read_table(const char   *const interface_name,
+                                 const char   *const table_name,
+                                       size_t *const length,
+                                       int    *const error)
+{
+   char *path   = mu_badv_debugfs_table_path(interface_name, table_name, error);
+   char *buffer = NULL;
+
+   if (!path) {
+      return NULL;
+   }
+
+   buffer = mu_linux_read_file(path, length, error);
+   mu_free(path);
+   return buffer;
+}
+
+/* Implementation notes:
+ * - Complete lines are passed as they are read, the incomplete last one is
+ *   moved to the front of the buffer for the next read. A buffer without a
+ *   new-line is passed as a piece of a line and the buffer emptied; what is
+ *   read next up to the new-line continues it.
+ */
+bool mu_badv_debugfs_stream_table(const char   *const interface_name,
+                                  const char   *const table_name,
+                                        char   *const buffer,
+                                  const size_t        size,
+                                        void        (*line_fn)(const char *line,
+                                                               bool  continued,
+                                                               void       *ctx),
+                                        void   *const ctx,
+                                        int    *const error)
+{
+   char    *path      = mu_badv_debugfs_table_path(interface_name, table_name,
+                                                   error);
+   char    *line      = NULL;
+   char    *newline   = NULL;
+   size_t   used      = 0;
+   size_t   total     = 0;
+   bool     continued = false;
+   ssize_t  n;
+   int      fd;
+
+   if (!path) {
+      return false;
+   }
+
+   MU_TRACE_READ_START(path);
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      MU_SET_ERROR(error, errno);
+      MU_TRACE_READ_DONE(path, 0, error);
+      mu_free(path);
+      return false;
+   }
+
+   for (;;) {
+      n = read(fd, buffer + used, size - used - 1);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         MU_SET_ERROR(error, errno);
+         break;
+      }
+      total += (size_t) n;
+      used  += (size_t) n;
+      buffer[used] = '\0';
+
+      line = buffer;
+      while ((newline = memchr(line, '\n', used - (size_t) (line - buffer)))) {
+         *newline = '\0';
+         line_fn(line, continued, ctx);
+         continued = false;
+         line      = newline + 1;
+      }
+      used -= (size_t) (line - buffer);
+      memmove(buffer, line, used);
+
+      if (n == 0 || used == size - 1) {
+         buffer[used] = '\0';
+         if (used) {
+            line_fn(buffer, continued, ctx);
+         }
+         if (n == 0) {
+            break;
+         }
+         continued = true;
+         used      = 0;
+      }
+   }
+
+   close(fd);
+   MU_TRACE_READ_DONE(path, total, error);
+   mu_free(path);
+   return n == 0;
+}
+
+const char *mu_badv_skip_blanks(const char *str)
+{
+   while (*str == ' ' || *str == '\t') {
+      str++;
+   }
+   return str;
+}
+
+/* Implementation notes:
+ * - Same format as mu_str_to_mac_addr(), which is not used so the digits can
+ *   be converted inline; tables hold up to a dozen addresses per line.
+ * - Input shorter than an address is rejected before any digit is read, the
+ *   loop then stays within the MU_MAC_ADDR_STR_LEN characters checked.
+ */
+const char *mu_badv_parse_mac(const char         *const str,
+                              const char         *const end,
+                              struct mu_mac_addr *const addr)
+{
+   const unsigned char *digits = (const unsigned char *) str;
+   unsigned int         high   = 0;
+   unsigned int         low    = 0;
+
+   if (end - str < MU_MAC_ADDR_STR_LEN) {
+      return NULL;
+   }
+
+   for (int i = 0; i < MU_MAC_ADDR_LEN; i++, digits += 3) {
+      high = hex_values[digits[0]] - 1u;
+      low  = hex_values[digits[1]] - 1u;
+      if ((high | low) > 15) {
+         return NULL;
+      }
+      if (i < MU_MAC_ADDR_LEN - 1 && digits[2] != ':') {
+         return NULL;
+      }
+      addr->octet[i] = (unsigned char) (high << 4 | low);
+   }
+   return str + MU_MAC_ADDR_STR_LEN;
+}
+
+/* Implementation notes:
+ * - The kernel prints last-seen as "%4i.%03is".
+ */
+const char *mu_badv_parse_last_seen(const char *str,
+                                    uint32_t *const last_seen_msecs)
+{
+   uint32_t secs   = 0;
+   uint32_t msecs  = 0;
+   int      digits = 0;
+
+   str = mu_badv_skip_blanks(str);
+
+   if (*str < '0' || *str > '9') {
+      return NULL;
+   }
+   while (*str >= '0' && *str <= '9') {
+      secs = secs * 10 + (uint32_t) (*str - '0');
+      str++;
+   }
+
+   if (*str == '.') {
+      str++;
+      while (*str >= '0' && *str <= '9') {
+         if (digits < 3) {
+            msecs = msecs * 10 + (uint32_t) (*str - '0');
+            digits++;
+         }
+         str++;
+      }
+      for (; digits < 3; digits++) {
+         msecs *= 10;
+      }
+   }
+
+   if (*str != 's') {
+      return NULL;
+   }
+
+   *last_seen_msecs = secs * 1000 + msecs;
+   return str + 1;
+}
+
+/* Implementation notes:
+ * - B.A.T.M.A.N. V prints throughput in units of 100 kbit/s as "%9u.%1u"
+ *   Mbit/s, B.A.T.M.A.N. IV prints the TQ as "%3i".
+ * - A TQ printed exactly like that is converted without a loop, padding
+ *   counting as zeros; anything else takes the general path.
+ */
+const char *mu_badv_parse_metric(const char                 *str,
+                                 enum  mu_badv_metric_type *const type,
+                                 uint32_t                   *const metric)
+{
+   uint32_t value = 0;
+   uint32_t tenths = 0;
+   bool     decimal = false;
+   unsigned int hundreds, tens, ones;
+
+   str = mu_badv_skip_blanks(str);
+   if (*str != '(') {
+      return NULL;
+   }
+
+   if (str[1] && str[2] && str[3] && str[4] == ')') {
+      hundreds = (unsigned int) (str[1] - '0');
+      tens     = (unsigned int) (str[2] - '0');
+      ones     = (unsigned int) (str[3] - '0');
+      if (str[1] == ' ' && str[2] == ' ') {
+         hundreds = tens = 0;
+      } else if (str[1] == ' ') {
+         hundreds = 0;
+      }
+      if ((hundreds | tens | ones) < 10) {
+         *type   = MU_BADV_METRIC_TQ;
+         *metric = hundreds * 100 + tens * 10 + ones;
+         return str + 5;
+      }
+   }
+   str = mu_badv_skip_blanks(str + 1);
+
+   if (*str < '0' || *str > '9') {
+      return NULL;
+   }
+   while (*str >= '0' && *str <= '9') {
+      value = value * 10 + (uint32_t) (*str - '0');
+      str++;
+   }
+   if (*str == '.') {
+      decimal = true;
+      str++;
+      if (*str >= '0' && *str <= '9') {
+         tenths = (uint32_t) (*str - '0');
+      }
+      while (*str >= '0' && *str <= '9') {
+         str++;
+      }
+   }
+
+   str = mu_badv_skip_blanks(str);
+   if (*str != ')') {
+      return NULL;
+   }
+
+   if (decimal) {
+      *type   = MU_BADV_METRIC_THROUGHPUT;
+      *metric = value * 1000 + tenths * 100;
+   } else {
+      *type   = MU_BADV_METRIC_TQ;
+      *metric = value;
+   }
+   return str + 1;
+}
+
+const char *mu_badv_parse_ifname(const char *str, char *const ifname)
+{
+   size_t length = 0;
+
+   str = mu_badv_skip_blanks(str);
+   if (*str != '[') {
+      return NULL;
+   }
+   str = mu_badv_skip_blanks(str + 1);
+
+   while (*str && *str != ']' && *str != ' ' && *str != '\n') {
+      if (length < MU_IF_NAME_LEN - 1) {
+         ifname[length++] = *str;
+      }
+      str++;
+   }
+   ifname[length] = '\0';
+
+   str = mu_badv_skip_blanks(str);
+   if (*str != ']' || !length) {
+      return NULL;
+   }
+   return str + 1;
+}
+
+/* Implementation notes:
+ * - Both characters are counted in the same sweep, with SSE2 or AVX2 on x86
+ *   and NEON on ARM as far as the compiler targets them, see count_vectors().
+ */
+size_t mu_badv_count_delimiters(const char   *const start,
+                                const char   *const end,
+                                      size_t *const n_parens)
+{
+   const char *str      = start;
+   size_t      n_lines  = 0;
+   size_t      n_opens  = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+   str = count_vectors(str, end, &n_lines, &n_opens);
+#endif
+   for (; str < end; str++) {
+      if (*str == '\n') {
+         n_lines++;
+      } else if (*str == '(') {
+         n_opens++;
+      }
+   }
+
+   if (n_parens) {
+      *n_parens = n_opens;
+   }
+   return n_lines;
+}
+
+const char *mu_badv_next_line(const char *const str)
+{
+   const char *end = strchr(str, '\n');
+
+   return end ? end + 1 : str + strlen(str);
+}
+
+/* Implementation notes:
+ * - A boundary is moved past the next new-line character, so chunks start
+ *   at line starts. Boundaries falling into the same long line give empty
+ *   chunks, which are dropped.
+ */
+size_t mu_badv_parse_chunks(const char *const  buffer,
+                            const size_t       length,
+                            const char       **chunks)
+{
+   size_t      n_threads = parallel_parse_threads(length);
+   size_t      n_chunks  = 0;
+   const char *end       = buffer + length;
+   const char *bound     = NULL;
+
+   chunks[0] = buffer;
+   for (size_t i = 1; i < n_threads; i++) {
+      bound = buffer + length / n_threads * i;
+      if (bound <= chunks[n_chunks]) {
+         continue;
+      }
+      bound = memchr(bound - 1, '\n', (size_t) (end - bound + 1));
+      if (!bound || bound + 1 >= end) {
+         break;
+      }
+      if (bound + 1 > chunks[n_chunks]) {
+         chunks[++n_chunks] = bound + 1;
+      }
+   }
+   chunks[++n_chunks] = end;
+   return n_chunks;
+}
+
+/* Implementation notes:
+ * - The caller parses the first chunk itself. Workers block all signals
+ *   like the refresh workers. A chunk whose thread cannot be created is
+ *   parsed by the caller, so the parse cannot fail for lack of threads.
+ */
+void mu_badv_parse_parallel(const size_t   n_chunks,
+                            void         (*parse)(void *ctx, size_t chunk),
+                            void   *const  ctx)
+{
+   pthread_t        threads[MU_BADV_MAX_PARSE_CHUNKS];
+   struct parse_job jobs[MU_BADV_MAX_PARSE_CHUNKS];
+   bool             started[MU_BADV_MAX_PARSE_CHUNKS];
+   sigset_t         all_signals;
+   sigset_t         old_signals;
+
+   if (n_chunks > 1) {
+      sigfillset(&all_signals);
+      pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+      for (size_t i = 1; i < n_chunks; i++) {
+         jobs[i].parse = parse;
+         jobs[i].ctx   = ctx;
+         jobs[i].chunk = i;
+         started[i]    = !pthread_create(&threads[i], NULL, parse_worker,
+                                         &jobs[i]);
+      }
+      pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+   }
+
+   parse(ctx, 0);
+
+   for (size_t i = 1; i < n_chunks; i++) {
+      if (started[i]) {
+         pthread_join(threads[i], NULL);
+      } else {
+         parse(ctx, i);
+      }
+   }
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+void mu_badv_set_parallel_parse(const unsigned int max_threads,
+                                const size_t       min_bytes)
+{
+   __atomic_store_n(&parallel_parse_max_threads, max_threads,
+                    __ATOMIC_RELAXED);
+   __atomic_store_n(&parallel_parse_min_bytes,
+                    min_bytes ? min_bytes : PARALLEL_PARSE_MIN_BYTES,
+                    __ATOMIC_RELAXED);
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,272 @@
+/** @file batman_adv_debugfs.h
+ * Internal helpers for the batman_adv debugfs tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_DEBUGFS_H
+#define MESHUTIL_BATMAN_ADV_DEBUGFS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batman_adv.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Name of the bat interface assumed when NULL is passed as interface_name.
+#define BATMAN_ADV_DEFAULT_IF "bat0"
+
+/// Name of the originators table in the batman_adv debugfs directory.
+#define BATMAN_ADV_ORIGINATORS_TABLE "originators"
+
+/// Name of the neighbours table in the batman_adv debugfs directory.
+#define BATMAN_ADV_NEIGHBORS_TABLE "neighbors"
+
+/// Name of the gateways table in the batman_adv debugfs directory.
+#define BATMAN_ADV_GATEWAYS_TABLE "gateways"
+
+/// Name of the Distributed ARP Table in the batman_adv debugfs directory.
+#define BATMAN_ADV_DAT_CACHE_TABLE "dat_cache"
+
+/// Most chunks a table buffer is split into for parsing.
+#define MU_BADV_MAX_PARSE_CHUNKS 64
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DECLARATIONS                                          *
+*******************************************************************************/
+
+/**
+ * @brief PRIVATE Get the path of a table in the batman_adv debugfs directory.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *table_name     [in]  Name of the table file, e.g. "originators".
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the path. Has to be mu_free()'d by the caller.
+ *
+ * @retval NULL debugfs not mounted or other error occurred.
+ */
+char
+*mu_badv_debugfs_table_path(const char *const interface_name,
+                            const char *const table_name,
+                                  int  *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Read a table in the batman_adv debugfs directory into memory.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *table_name     [in]  Name of the table file, e.g. "originators".
+ * @param *length         [out] Number of bytes read. Can be NULL.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return NUL terminated table contents. Has to be mu_free()'d by the caller.
+ *
+ * @retval NULL An error occurred.
+ */
+char
+*mu_badv_debugfs_read_table(const char   *const interface_name,
+                            const char   *const table_name,
+                                  size_t *const length,
+                                  int    *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Read a table in the batman_adv debugfs directory line by
+ *        line through a fixed buffer.
+ *
+ * Lines longer than the buffer are passed in pieces of size - 1 bytes, cut
+ * anywhere, and a last piece with the rest.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *table_name     [in]  Name of the table file, e.g. "originators".
+ * @param *buffer         [in]  Room for size bytes, used for reading.
+ * @param  size           [in]  Size of buffer, at least 2.
+ * @param  line_fn        [in]  Called with every NUL terminated line, without
+ *                              its new-line character, or piece of a line.
+ *                              continued is set for every piece but the
+ *                              first.
+ * @param *ctx            [in]  Passed to line_fn as is.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @retval true  The whole table was read.
+ * @retval false An error occurred, some lines may have been passed.
+ */
+bool
+mu_badv_debugfs_stream_table(const char   *const interface_name,
+                             const char   *const table_name,
+                                   char   *const buffer,
+                             const size_t        size,
+                                   void        (*line_fn)(const char *line,
+                                                          bool  continued,
+                                                          void       *ctx),
+                                   void   *const ctx,
+                                   int    *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Skip blanks (spaces and tabs) in a table line.
+ *
+ * @return Pointer to the first non-blank character.
+ */
+const char
+*mu_badv_skip_blanks(const char *str)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Parse a MAC address at the start of str.
+ *
+ * Reads nothing at or past end, str need not be terminated.
+ *
+ * @param *str  [in]  Start of the address.
+ * @param *end  [in]  Past the last character that may be read.
+ * @param *addr [out] The parsed address.
+ *
+ * @return Pointer past the address or NULL if str does not start with one.
+ */
+const char
+*mu_badv_parse_mac(const char         *const str,
+                   const char         *const end,
+                   struct mu_mac_addr *const addr)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Parse a "<secs>.<msecs>s" last-seen field.
+ *
+ * Leading blanks are skipped.
+ *
+ * @return Pointer past the trailing 's' or NULL if no last-seen field found.
+ */
+const char
+*mu_badv_parse_last_seen(const char *str, uint32_t *const last_seen_msecs)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Parse a parenthesised link metric, "(255)" or "(  1.0)".
+ *
+ * A plain integer is a TQ value, a decimal value is a throughput in Mbit/s
+ * which is converted to kbit/s. Leading blanks are skipped.
+ *
+ * @return Pointer past the closing parenthesis or NULL on a parse error.
+ */
+const char
+*mu_badv_parse_metric(const char                  *str,
+                      enum   mu_badv_metric_type *const type,
+                      uint32_t                    *const metric)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Parse a bracketed interface name, "[      eth0]".
+ *
+ * Leading blanks are skipped. Names longer than MU_IF_NAME_LEN - 1 are
+ * truncated.
+ *
+ * @return Pointer past the closing bracket or NULL on a parse error.
+ */
+const char
+*mu_badv_parse_ifname(const char *str, char *const ifname)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Count the new-line and '(' characters of a table buffer.
+ *
+ * The buffer is swept once, with vector instructions where available; the
+ * counts size tables before they are parsed.
+ *
+ * @param *start    [in]  First character to count.
+ * @param *end      [in]  Past the last character to count.
+ * @param *n_parens [out] Number of '(' characters. Can be NULL.
+ *
+ * @return Number of new-line characters.
+ */
+size_t
+mu_badv_count_delimiters(const char   *const start,
+                         const char   *const end,
+                               size_t *const n_parens)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Return the start of the next line in a table buffer.
+ *
+ * @return Pointer past the next new-line character or to the terminating NUL.
+ */
+const char
+*mu_badv_next_line(const char *const str)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Split a table buffer into chunks of whole lines.
+ *
+ * The buffer is split into one chunk per thread set with
+ * mu_badv_set_parallel_parse() if it is at least as long as the threshold set
+ * there, otherwise it is a single chunk.
+ *
+ * @param *buffer [in]  NUL terminated table contents.
+ * @param  length [in]  Length of buffer without the NUL.
+ * @param **chunks [out] Room for MU_BADV_MAX_PARSE_CHUNKS + 1 pointers. Chunk
+ *                       i is chunks[i] up to chunks[i + 1]; every chunk
+ *                       starts at a line start and the last ends at the NUL.
+ *
+ * @return Number of chunks, at least 1.
+ */
+size_t
+mu_badv_parse_chunks(const char *const  buffer,
+                     const size_t       length,
+                     const char       **chunks)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Call a parse function for every chunk, in parallel.
+ *
+ * Chunk 0 is parsed on the calling thread, the others on threads of their
+ * own. Returns when all chunks are parsed.
+ *
+ * @param  n_chunks [in] Number of chunks, at most MU_BADV_MAX_PARSE_CHUNKS.
+ * @param  parse    [in] Called once with each chunk number.
+ * @param *ctx      [in] Passed to parse as is.
+ */
+void
+mu_badv_parse_parallel(const size_t   n_chunks,
+                       void         (*parse)(void *ctx, size_t chunk),
+                       void   *const  ctx)
+__attribute__ ((visibility("hidden")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_DEBUGFS_H */
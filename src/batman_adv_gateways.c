@@ -0,0 +1,434 @@
+/** @file batman_adv_gateways.c
+ * meshutil API implementation for the B.A.T.M.A.N. advanced gateways table
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_gateways_impl   Gateways table implementation
+ *
+ * Gateway lines look like
+ *
+ *     => 02:ba:7a:df:04:01 (255) 02:ba:7a:df:04:01 [      eth0]: 160 - 5MBit/1MBit
+ *
+ * in older versions which include the gateway class, and like
+ *
+ *     => 02:ba:7a:df:04:01 (255) 02:ba:7a:df:04:01 [      eth0]: 10.0/2.0 MBit
+ *
+ * in newer versions. With B.A.T.M.A.N. V the TQ is replaced by the throughput.
+ *
+ * The selector keeps a 64 bit FNV-1a hash of the raw table. A re-read table
+ * with the same hash and length is considered unchanged and is not parsed.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "batman_adv_debugfs.h"
+#include "batman_adv_gateways.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Marker of the currently selected gateway.
+#define SELECTED_GATEWAY_MARKER "=>"
+
+#define FNV1A_64_OFFSET_BASIS 14695981039346656037ULL
+#define FNV1A_64_PRIME        1099511628211ULL
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct mu_badv_gw_selector {
+   char                   interface_name[MU_IF_NAME_LEN];
+   unsigned int           refresh_interval_ms;
+   struct timespec        last_read;
+   bool                   read_once;
+   uint64_t               table_hash;
+   size_t                 table_length;
+   bool                   have_best;
+   struct mu_badv_gateway best;
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+/* Parses "<int>[.<tenth>][unit]" into tenths of the unit. *unit_kbit is set
+ * to 0 if the unit is missing and has to be taken from the following field.
+ */
+static const char *parse_bandwidth(const char *str,
+                                   uint32_t   *const tenths,
+                                   uint32_t   *const unit_kbit)
+{
+   uint32_t value = 0;
+
+   str = mu_badv_skip_blanks(str);
+   if (*str < '0' || *str > '9') {
+      return NULL;
+   }
+   while (*str >= '0' && *str <= '9') {
+      value = value * 10 + (uint32_t) (*str - '0');
+      str++;
+   }
+   value *= 10;
+   if (*str == '.') {
+      str++;
+      if (*str >= '0' && *str <= '9') {
+         value += (uint32_t) (*str - '0');
+      }
+      while (*str >= '0' && *str <= '9') {
+         str++;
+      }
+   }
+   *tenths = value;
+
+   str = mu_badv_skip_blanks(str);
+   if (!strncmp(str, "MBit", 4)) {
+      *unit_kbit = 1000;
+      str += 4;
+   } else if (!strncmp(str, "KBit", 4)) {
+      *unit_kbit = 1;
+      str += 4;
+   } else {
+      *unit_kbit = 0;
+   }
+   return str;
+}
+
+static void parse_bandwidths(const char *str,
+                             struct mu_badv_gateway *const gateway)
+{
+   const char *after_class = NULL;
+   uint32_t    down = 0, up = 0;
+   uint32_t    down_unit = 0, up_unit = 0;
+
+   str = mu_badv_skip_blanks(str);
+   if (*str != ':') {
+      return;
+   }
+
+   // Older versions print the gateway class first: "160 - 5MBit/1MBit".
+   after_class = str + 1;
+   while (*after_class == ' ' || (*after_class >= '0' && *after_class <= '9')) {
+      after_class++;
+   }
+   if (*after_class == '-') {
+      str = after_class;
+   }
+
+   if (!(str = parse_bandwidth(str + 1, &down, &down_unit)) || *str != '/') {
+      return;
+   }
+   if (!parse_bandwidth(str + 1, &up, &up_unit)) {
+      return;
+   }
+
+   if (!down_unit) {
+      down_unit = up_unit;
+   }
+   gateway->bandwidth_down_kbit = down * down_unit / 10;
+   gateway->bandwidth_up_kbit   = up * up_unit / 10;
+}
+
+static bool parse_gateway_line(const char             *line,
+                               const char             *const end,
+                               struct mu_badv_gateway *const gateway)
+{
+   memset(gateway, 0, sizeof(*gateway));
+   line = mu_badv_skip_blanks(line);
+
+   if (!strncmp(line, SELECTED_GATEWAY_MARKER,
+                strlen(SELECTED_GATEWAY_MARKER))) {
+      gateway->selected = true;
+      line = mu_badv_skip_blanks(line + strlen(SELECTED_GATEWAY_MARKER));
+   }
+
+   if (!(line = mu_badv_parse_mac(line, end, &gateway->mac_addr))) {
+      return false;
+   }
+   if (!(line = mu_badv_parse_metric(line, &gateway->metric_type,
+                                     &gateway->metric))) {
+      return false;
+   }
+   if (!(line = mu_badv_parse_mac(mu_badv_skip_blanks(line), end,
+                                  &gateway->next_hop))) {
+      return false;
+   }
+   if (!(line = mu_badv_parse_ifname(line, gateway->outgoing_if))) {
+      return false;
+   }
+
+   parse_bandwidths(line, gateway);
+   return true;
+}
+
+static struct mu_badv_gateway *parse_gateways(const char   *const buffer,
+                                              const size_t        length,
+                                                    size_t *const n_gateways,
+                                                    int    *const error)
+{
+   const char             *line     = NULL;
+   struct mu_badv_gateway *gateways = NULL;
+   struct mu_badv_gateway *tmp      = NULL;
+   size_t                  n_lines  = 1;
+   size_t                  count    = 0;
+
+   *n_gateways = 0;
+
+   for (line = buffer; *line; line++) {
+      if (*line == '\n') {
+         n_lines++;
+      }
+   }
+
+   gateways = mu_malloc(n_lines * sizeof(struct mu_badv_gateway));
+   if (!gateways) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   for (line = buffer; *line; line = mu_badv_next_line(line)) {
+      if (parse_gateway_line(line, buffer + length, &gateways[count])) {
+         count++;
+      }
+   }
+
+   if (!count) {
+      mu_free(gateways);
+      return NULL;
+   }
+
+   tmp = mu_realloc(gateways, count * sizeof(struct mu_badv_gateway));
+   if (tmp) {
+      gateways = tmp;
+   }
+
+   *n_gateways = count;
+   return gateways;
+}
+
+static uint64_t table_hash(const char *const buffer, const size_t length)
+{
+   uint64_t hash = FNV1A_64_OFFSET_BASIS;
+
+   for (size_t i = 0; i < length; i++) {
+      hash ^= (unsigned char) buffer[i];
+      hash *= FNV1A_64_PRIME;
+   }
+   return hash;
+}
+
+static long elapsed_ms(const struct timespec *const since,
+                       const struct timespec *const now)
+{
+   return (now->tv_sec - since->tv_sec) * 1000
+          + (now->tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static bool select_best(const struct mu_badv_gateway *const gateways,
+                        const size_t                        n_gateways,
+                              struct mu_badv_gateway *const best)
+{
+   const struct mu_badv_gateway *candidate = NULL;
+
+   for (size_t i = 0; i < n_gateways; i++) {
+      if (gateways[i].selected) {
+         candidate = &gateways[i];
+         break;
+      }
+      if (!candidate || gateways[i].metric > candidate->metric) {
+         candidate = &gateways[i];
+      }
+   }
+
+   if (!candidate) {
+      return false;
+   }
+   *best = *candidate;
+   return true;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_gateway *mu_badv_gateways(const char   *const interface_name,
+                                               size_t *const n_gateways,
+                                               int    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   char                   *buffer   = NULL;
+   struct mu_badv_gateway *gateways = NULL;
+   size_t                  length   = 0;
+   size_t                  count    = 0;
+
+   if (n_gateways) {
+      *n_gateways = 0;
+   }
+
+   MU_TRACE_CALL_START(interface_name);
+   buffer = mu_badv_debugfs_read_table(interface_name,
+                                       BATMAN_ADV_GATEWAYS_TABLE,
+                                       &length, error);
+   if (!buffer) {
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return NULL;
+   }
+
+   MU_TRACE_PARSE_START(interface_name, BATMAN_ADV_GATEWAYS_TABLE, length);
+   gateways = parse_gateways(buffer, length, &count, error);
+   MU_TRACE_PARSE_DONE(interface_name, BATMAN_ADV_GATEWAYS_TABLE, count);
+   mu_free(buffer);
+
+   if (n_gateways) {
+      *n_gateways = count;
+   }
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return gateways;
+}
+
+struct mu_badv_gw_selector *mu_badv_gw_selector_new(
+   const char         *const interface_name,
+   const unsigned int        refresh_interval_ms,
+         int          *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const char *ifname = interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+   struct mu_badv_gw_selector *selector = NULL;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+
+   selector = mu_calloc(1, sizeof(struct mu_badv_gw_selector));
+   if (!selector) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   strcpy(selector->interface_name, ifname);
+   selector->refresh_interval_ms = refresh_interval_ms;
+   return selector;
+}
+
+void mu_badv_gw_selector_free(struct mu_badv_gw_selector *const selector)
+{
+   mu_free(selector);
+}
+
+/* Implementation notes:
+ * - Within the refresh interval only clock_gettime() is called.
+ * - The table is parsed only when its hash or length changed.
+ * - A table which could not be parsed, e.g. for lack of memory, is not
+ *   remembered; the next call reads it again.
+ */
+bool mu_badv_gw_selector_best(struct mu_badv_gw_selector *const selector,
+                              struct mu_badv_gateway     *const gateway,
+                                     int                 *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct timespec         now;
+   char                   *buffer      = NULL;
+   size_t                  length      = 0;
+   uint64_t                hash;
+   struct mu_badv_gateway *gateways    = NULL;
+   size_t                  count       = 0;
+   int                     parse_error = 0;
+
+   if (!selector || !gateway) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   if (selector->read_once
+       && elapsed_ms(&selector->last_read, &now)
+          < (long) selector->refresh_interval_ms) {
+      if (selector->have_best) {
+         *gateway = selector->best;
+      }
+      return selector->have_best;
+   }
+
+   MU_TRACE_CALL_START(selector->interface_name);
+   buffer = mu_badv_debugfs_read_table(selector->interface_name,
+                                       BATMAN_ADV_GATEWAYS_TABLE,
+                                       &length, error);
+   if (!buffer) {
+      MU_TRACE_CALL_DONE(selector->interface_name, error);
+      return false;
+   }
+
+   hash = table_hash(buffer, length);
+
+   if (!selector->read_once
+       || hash != selector->table_hash
+       || length != selector->table_length) {
+      MU_TRACE_PARSE_START(selector->interface_name,
+                           BATMAN_ADV_GATEWAYS_TABLE, length);
+      gateways = parse_gateways(buffer, length, &count, &parse_error);
+      MU_TRACE_PARSE_DONE(selector->interface_name,
+                          BATMAN_ADV_GATEWAYS_TABLE, count);
+      if (parse_error) {
+         MU_SET_ERROR(error, parse_error);
+         mu_free(buffer);
+         MU_TRACE_CALL_DONE(selector->interface_name, error);
+         return false;
+      }
+      selector->have_best    = select_best(gateways, count, &selector->best);
+      selector->table_hash   = hash;
+      selector->table_length = length;
+      selector->read_once    = true;
+      mu_free(gateways);
+   }
+   mu_free(buffer);
+   selector->last_read = now;
+
+   if (selector->have_best) {
+      *gateway = selector->best;
+   }
+   MU_TRACE_CALL_DONE(selector->interface_name, error);
+   return selector->have_best;
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,152 @@
+/** @file batman_adv_gateways.h
+ * meshutil API for the B.A.T.M.A.N. advanced gateways table
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_gateways   Gateways table
+ *
+ * The gateways table lists the nodes announcing an uplink into the mesh. The
+ * gateway currently used by the own node (in gateway client mode) is marked
+ * as selected.
+ *
+ * gateway selector
+ *
+ * A gateway selector caches the best gateway of a bat interface. It re-reads
+ * the gateways table at most once per refresh interval and only recomputes the
+ * best gateway when the contents of the table changed, so it can be queried at
+ * a very high rate. A selector must not be used by multiple threads at once.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_GATEWAYS_H
+#define MESHUTIL_BATMAN_ADV_GATEWAYS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batman_adv.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** One entry of the gateways table.
+ */
+struct mu_badv_gateway {
+   struct mu_mac_addr          mac_addr;     ///< Address of the gateway.
+   struct mu_mac_addr          next_hop;     ///< Next hop towards it.
+   enum   mu_badv_metric_type  metric_type;  ///< Kind of metric.
+          uint32_t             metric;       ///< TQ or throughput in kbit/s.
+          uint32_t             bandwidth_down_kbit;
+          uint32_t             bandwidth_up_kbit;
+          bool                 selected;     ///< Currently used gateway.
+          char                 outgoing_if[MU_IF_NAME_LEN];
+};
+
+/// Opaque cached best gateway selector.
+struct mu_badv_gw_selector;
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Get the gateways announced in the mesh.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *n_gateways     [out] Number of entries in the returned array. Can be
+ *                              ignored by passing NULL.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to an array of gateways. The array has to be mu_free()'d
+ *         by the caller.
+ *
+ * @retval NULL Returned on failure or when no gateways available.
+ */
+struct mu_badv_gateway
+*mu_badv_gateways(const char   *const interface_name,
+                        size_t *const n_gateways,
+                        int    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Create a cached best gateway selector.
+ *
+ * @param *interface_name      [in]  Name of the bat interface.
+ * @param  refresh_interval_ms [in]  Minimum time between two reads of the
+ *                                   gateways table. 0 reads it on every query.
+ * @param *error               [out] For setting error codes on failure.
+ *
+ * @return Pointer to the selector. Has to be released with
+ *         mu_badv_gw_selector_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_gw_selector
+*mu_badv_gw_selector_new(const char     *const interface_name,
+                         const unsigned int    refresh_interval_ms,
+                               int      *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release a gateway selector.
+ */
+void
+mu_badv_gw_selector_free(struct mu_badv_gw_selector *const selector)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the best gateway.
+ *
+ * The gateway selected by batman_adv is the best gateway. If none is selected
+ * (e.g. gateway server mode) the gateway with the best metric is returned.
+ *
+ * @param *selector [in]  The gateway selector.
+ * @param *gateway  [out] The best gateway.
+ * @param *error    [out] For setting error codes on function failure.
+ *
+ * @retval true  A best gateway was found.
+ * @retval false No gateways available. Also returned if an error occurred!
+ */
+bool
+mu_badv_gw_selector_best(struct mu_badv_gw_selector *const selector,
+                         struct mu_badv_gateway     *const gateway,
+                                int                 *const error)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_GATEWAYS_H */
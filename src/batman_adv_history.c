@@ -0,0 +1,1357 @@
+/** @file batman_adv_history.c
+ * meshutil API implementation for recording and replaying B.A.T.M.A.N.
+ * advanced topology history
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_history_impl   Topology history implementation
+ *
+ * File format (integers are little endian, varint is LEB128):
+ *
+ *     file       = "MUTH" version:u8 reserved:u8[3] record*
+ *     record     = type:u8 length:varint timestamp_ms:u64 payload crc32:u32
+ *     keyframe   = metric_type:u8 last_seen_quantum:varint
+ *                  metric_quantum:varint interfaces entries
+ *     delta      = metric_type:u8 interfaces removed entries
+ *     interfaces = count:varint (length:u8 name)*
+ *     removed    = count:varint mac:u8[6]*
+ *     entries    = count:varint entry*
+ *     entry      = mac:u8[6] flags:u8 [next_hop:u8[6]] interface:varint
+ *                  age:varint metric:varint n_hops:varint
+ *                  (mac:u8[6] metric:varint)*
+ *
+ * length is the length of the payload, the crc32 covers the record up to the
+ * checksum. Entries are sorted by MAC address. The next hop is left out when
+ * it is the originator itself (flags bit 0). Times and metrics are stored in
+ * units of the quanta of the preceding keyframe. An originator is kept as the
+ * time it was last seen, the record timestamp minus its last-seen time, and
+ * encoded as the age of that time at the record timestamp. Interface names are
+ * referenced by their index in a dictionary which a keyframe starts and the
+ * interfaces of a delta extend. A delta lists the originators removed since
+ * the previous record and the ones added or changed.
+ *
+ * The writer keeps the last recorded table sorted and quantized and diffs the
+ * next one against it with a merge walk. Its last_seen_msecs fields hold the
+ * quantized seen-at times modulo 2^32, so an originator which is not seen
+ * again compares equal while its last-seen time grows. The reader keeps the
+ * same and turns them back into last-seen times at the timestamp of the last
+ * record applied. A keyframe is written instead of a
+ * delta every keyframe_interval records or when the delta would be more than
+ * half as large as the last keyframe.
+ *
+ * The reader maps the file and indexes the records when opening it. A query
+ * decodes the last keyframe before the timestamp and applies the deltas up to
+ * the timestamp.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batman_adv_history.h"
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+#define HISTORY_MAGIC      "MUTH"
+#define HISTORY_VERSION    2
+#define HISTORY_HEADER_LEN 8
+
+#define RECORD_KEYFRAME 'K'
+#define RECORD_DELTA    'D'
+
+/// Smallest record: type, length, timestamp and checksum.
+#define RECORD_MIN_LEN (1 + 1 + 8 + 4)
+
+/// Smallest encoded potential next hop: MAC address and a one byte metric.
+#define HOP_MIN_LEN (MU_MAC_ADDR_LEN + 1)
+
+#define ENTRY_NEXT_HOP_IS_SELF 0x01
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Growable output buffer. Writes after an allocation failure are dropped.
+struct byte_buffer {
+   unsigned char *data;
+   size_t         length;
+   size_t         capacity;
+   bool           failed;
+};
+
+/// Input cursor. Reads past the end set failed and return zeros.
+struct cursor {
+   const unsigned char *pos;
+   const unsigned char *end;
+         bool           failed;
+};
+
+struct record {
+   const unsigned char *payload;
+         size_t         payload_length;
+         size_t         length;           ///< Length of the whole record.
+         uint64_t       timestamp_ms;
+         unsigned char  type;
+};
+
+/// Interface name dictionary of a log.
+struct if_dictionary {
+   char   (*names)[MU_IF_NAME_LEN];
+   size_t   n_names;
+   size_t   capacity;
+};
+
+struct mu_badv_history_writer {
+          int                            fd;
+          off_t                          file_length;
+   struct mu_badv_history_config         config;
+   struct byte_buffer                    pending;
+   struct byte_buffer                    payload;
+   struct mu_badv_orig_table            *state;
+   struct if_dictionary                  ifs;
+          size_t                         n_ifs_recorded;
+          uint32_t                       records_since_keyframe;
+          size_t                         keyframe_length;
+          uint64_t                       last_timestamp_ms;
+};
+
+struct record_ref {
+   size_t   offset;
+   uint64_t timestamp_ms;
+   bool     keyframe;
+};
+
+struct mu_badv_history_reader {
+   unsigned char     *data;
+   size_t             length;
+   struct record_ref *records;
+   size_t             n_records;
+};
+
+/// Decoding state of a reader query.
+struct replay {
+   struct mu_badv_orig_table *state;
+   struct if_dictionary       ifs;
+          uint32_t            last_seen_quantum;
+          uint32_t            metric_quantum;
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static uint32_t crc32(const unsigned char *const data, const size_t length)
+{
+   uint32_t crc = 0xffffffffu;
+
+   for (size_t i = 0; i < length; i++) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; bit++) {
+         crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1));
+      }
+   }
+   return ~crc;
+}
+
+static void put_bytes(struct byte_buffer *const buffer,
+                      const void         *const data,
+                      const size_t              length)
+{
+   unsigned char *tmp      = NULL;
+   size_t         capacity = buffer->capacity ? buffer->capacity : 256;
+
+   if (buffer->failed) {
+      return;
+   }
+
+   if (buffer->length + length > buffer->capacity) {
+      while (capacity < buffer->length + length) {
+         capacity *= 2;
+      }
+      tmp = mu_realloc(buffer->data, capacity);
+      if (!tmp) {
+         buffer->failed = true;
+         return;
+      }
+      buffer->data     = tmp;
+      buffer->capacity = capacity;
+   }
+
+   memcpy(buffer->data + buffer->length, data, length);
+   buffer->length += length;
+}
+
+static void put_u8(struct byte_buffer *const buffer, const unsigned int value)
+{
+   unsigned char byte = (unsigned char) value;
+
+   put_bytes(buffer, &byte, 1);
+}
+
+static void put_le(struct byte_buffer *const buffer,
+                   const uint64_t            value,
+                   const size_t              size)
+{
+   unsigned char bytes[8];
+
+   for (size_t i = 0; i < size; i++) {
+      bytes[i] = (unsigned char) (value >> (8 * i));
+   }
+   put_bytes(buffer, bytes, size);
+}
+
+static void put_varint(struct byte_buffer *const buffer, uint64_t value)
+{
+   unsigned char bytes[10];
+   size_t        n = 0;
+
+   do {
+      bytes[n] = value & 0x7f;
+      value >>= 7;
+      if (value) {
+         bytes[n] |= 0x80;
+      }
+      n++;
+   } while (value);
+   put_bytes(buffer, bytes, n);
+}
+
+static void get_bytes(struct cursor *const cursor,
+                      void          *const data,
+                      const size_t         length)
+{
+   if (cursor->failed || (size_t) (cursor->end - cursor->pos) < length) {
+      cursor->failed = true;
+      memset(data, 0, length);
+      return;
+   }
+   memcpy(data, cursor->pos, length);
+   cursor->pos += length;
+}
+
+static unsigned int get_u8(struct cursor *const cursor)
+{
+   unsigned char byte;
+
+   get_bytes(cursor, &byte, 1);
+   return byte;
+}
+
+static uint64_t get_le(struct cursor *const cursor, const size_t size)
+{
+   unsigned char bytes[8];
+   uint64_t      value = 0;
+
+   get_bytes(cursor, bytes, size);
+   for (size_t i = 0; i < size; i++) {
+      value |= (uint64_t) bytes[i] << (8 * i);
+   }
+   return value;
+}
+
+static uint64_t get_varint(struct cursor *const cursor)
+{
+   uint64_t     value = 0;
+   unsigned int byte;
+
+   for (unsigned int shift = 0; shift < 64; shift += 7) {
+      byte   = get_u8(cursor);
+      value |= (uint64_t) (byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+         return value;
+      }
+   }
+   cursor->failed = true;
+   return 0;
+}
+
+/* Parses the record at the start of data. Returns false if it is torn or
+ * corrupt.
+ */
+static bool parse_record(const unsigned char *const data,
+                         const size_t               length,
+                               struct record *const record)
+{
+   struct cursor cursor = { data, data + length, false };
+   size_t        header_length;
+
+   record->type           = (unsigned char) get_u8(&cursor);
+   record->payload_length = (size_t) get_varint(&cursor);
+   record->timestamp_ms   = get_le(&cursor, 8);
+   header_length          = (size_t) (cursor.pos - data);
+
+   if (cursor.failed
+       || (record->type != RECORD_KEYFRAME && record->type != RECORD_DELTA)
+       || record->payload_length > length - header_length
+       || length - header_length - record->payload_length < 4) {
+      return false;
+   }
+
+   record->payload = cursor.pos;
+   record->length  = header_length + record->payload_length + 4;
+   cursor.pos     += record->payload_length;
+
+   return crc32(data, record->length - 4) == (uint32_t) get_le(&cursor, 4);
+}
+
+static bool valid_file_header(const unsigned char *const data,
+                              const size_t               length)
+{
+   return length >= HISTORY_HEADER_LEN
+          && !memcmp(data, HISTORY_MAGIC, strlen(HISTORY_MAGIC))
+          && data[strlen(HISTORY_MAGIC)] == HISTORY_VERSION;
+}
+
+static size_t intern_if(struct if_dictionary *const ifs,
+                        const char           *const name,
+                              bool           *const failed)
+{
+   char   (*tmp)[MU_IF_NAME_LEN] = NULL;
+
+   for (size_t i = 0; i < ifs->n_names; i++) {
+      if (!strcmp(ifs->names[i], name)) {
+         return i;
+      }
+   }
+
+   if (ifs->n_names == ifs->capacity) {
+      tmp = mu_realloc(ifs->names, (ifs->capacity ? ifs->capacity * 2 : 8)
+                                * sizeof(*ifs->names));
+      if (!tmp) {
+         *failed = true;
+         return 0;
+      }
+      ifs->names     = tmp;
+      ifs->capacity  = ifs->capacity ? ifs->capacity * 2 : 8;
+   }
+
+   strcpy(ifs->names[ifs->n_names], name);
+   return ifs->n_names++;
+}
+
+static int compare_mac(const struct mu_mac_addr *const a,
+                       const struct mu_mac_addr *const b)
+{
+   return memcmp(a->octet, b->octet, MU_MAC_ADDR_LEN);
+}
+
+static int compare_originator_ptr(const void *a, const void *b)
+{
+   return compare_mac(&(*(const struct mu_badv_originator *const *) a)->mac_addr,
+                      &(*(const struct mu_badv_originator *const *) b)->mac_addr);
+}
+
+static uint32_t quantize(const uint32_t value, const uint32_t quantum)
+{
+   return (uint32_t) (((uint64_t) value + quantum / 2) / quantum);
+}
+
+/// A timestamp in quanta, modulo 2^32.
+static uint32_t quantize_time(const uint64_t timestamp_ms,
+                              const uint32_t quantum)
+{
+   return (uint32_t) ((timestamp_ms + quantum / 2) / quantum);
+}
+
+/* Appends originator src of table from to table to, hops included. */
+static void copy_originator(      struct mu_badv_orig_table *const to,
+                            const struct mu_badv_orig_table *const from,
+                            const struct mu_badv_originator *const src)
+{
+   struct mu_badv_originator *dest = &to->originators[to->n_originators++];
+
+   *dest           = *src;
+   dest->first_hop = (uint32_t) to->n_hops;
+   memcpy(&to->hops[to->n_hops], &from->hops[src->first_hop],
+          src->n_hops * sizeof(struct mu_badv_hop));
+   to->n_hops += src->n_hops;
+}
+
+static bool originators_equal(const struct mu_badv_orig_table *const table_a,
+                              const struct mu_badv_originator *const a,
+                              const struct mu_badv_orig_table *const table_b,
+                              const struct mu_badv_originator *const b)
+{
+   const struct mu_badv_hop *hop_a = &table_a->hops[a->first_hop];
+   const struct mu_badv_hop *hop_b = &table_b->hops[b->first_hop];
+
+   if (!mu_mac_addr_equal(&a->next_hop, &b->next_hop)
+       || a->last_seen_msecs != b->last_seen_msecs
+       || a->metric != b->metric
+       || a->n_hops != b->n_hops
+       || strcmp(a->outgoing_if, b->outgoing_if)) {
+      return false;
+   }
+
+   for (uint32_t i = 0; i < a->n_hops; i++) {
+      if (!mu_mac_addr_equal(&hop_a[i].mac_addr, &hop_b[i].mac_addr)
+          || hop_a[i].metric != hop_b[i].metric) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/* Returns a copy of table sorted by MAC address with quantized values and
+ * seen-at times instead of last-seen times.
+ */
+static struct mu_badv_orig_table *normalize(
+   const struct mu_badv_orig_table     *const table,
+   const struct mu_badv_history_config *const config,
+   const        uint64_t                      timestamp_ms,
+         int                           *const error)
+{
+   struct mu_badv_orig_table        *copy   = NULL;
+   const struct mu_badv_originator **sorted = NULL;
+   struct mu_badv_originator        *entry  = NULL;
+
+   sorted = mu_malloc((table->n_originators + 1) * sizeof(*sorted));
+   if (!sorted) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+   for (size_t i = 0; i < table->n_originators; i++) {
+      sorted[i] = &table->originators[i];
+   }
+   qsort(sorted, table->n_originators, sizeof(*sorted), compare_originator_ptr);
+
+   copy = mu_badv_orig_table_alloc(table->n_originators, table->n_hops, error);
+   if (!copy) {
+      mu_free(sorted);
+      return NULL;
+   }
+   copy->metric_type = table->metric_type;
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      copy_originator(copy, table, sorted[i]);
+      entry = &copy->originators[copy->n_originators - 1];
+      entry->last_seen_msecs = quantize_time(
+         timestamp_ms > entry->last_seen_msecs
+         ? timestamp_ms - entry->last_seen_msecs : 0,
+         config->last_seen_quantum_ms);
+      entry->metric = quantize(entry->metric, config->metric_quantum);
+      for (uint32_t j = 0; j < entry->n_hops; j++) {
+         copy->hops[entry->first_hop + j].metric =
+            quantize(copy->hops[entry->first_hop + j].metric,
+                     config->metric_quantum);
+      }
+   }
+
+   mu_free(sorted);
+   return copy;
+}
+
+static void put_interfaces(      struct byte_buffer   *const buffer,
+                           const struct if_dictionary *const ifs,
+                           const size_t                      first)
+{
+   put_varint(buffer, ifs->n_names - first);
+   for (size_t i = first; i < ifs->n_names; i++) {
+      put_u8(buffer, (unsigned int) strlen(ifs->names[i]));
+      put_bytes(buffer, ifs->names[i], strlen(ifs->names[i]));
+   }
+}
+
+static void put_entry(      struct byte_buffer        *const buffer,
+                            struct if_dictionary      *const ifs,
+                      const struct mu_badv_orig_table *const table,
+                      const struct mu_badv_originator *const entry,
+                      const uint32_t                         now)
+{
+   const struct mu_badv_hop *hops    = &table->hops[entry->first_hop];
+   bool                      unused  = false;
+   bool                      is_self = mu_mac_addr_equal(&entry->next_hop,
+                                                         &entry->mac_addr);
+
+   put_bytes(buffer, entry->mac_addr.octet, MU_MAC_ADDR_LEN);
+   put_u8(buffer, is_self ? ENTRY_NEXT_HOP_IS_SELF : 0);
+   if (!is_self) {
+      put_bytes(buffer, entry->next_hop.octet, MU_MAC_ADDR_LEN);
+   }
+   put_varint(buffer, intern_if(ifs, entry->outgoing_if, &unused));
+   put_varint(buffer, (uint32_t) (now - entry->last_seen_msecs));
+   put_varint(buffer, entry->metric);
+   put_varint(buffer, entry->n_hops);
+   for (uint32_t i = 0; i < entry->n_hops; i++) {
+      put_bytes(buffer, hops[i].mac_addr.octet, MU_MAC_ADDR_LEN);
+      put_varint(buffer, hops[i].metric);
+   }
+}
+
+static bool intern_table_ifs(      struct if_dictionary      *const ifs,
+                             const struct mu_badv_orig_table *const table)
+{
+   bool failed = false;
+
+   for (size_t i = 0; !failed && i < table->n_originators; i++) {
+      intern_if(ifs, table->originators[i].outgoing_if, &failed);
+   }
+   return !failed;
+}
+
+static void encode_keyframe(      struct mu_badv_history_writer *const writer,
+                            const struct mu_badv_orig_table     *const next,
+                            const uint64_t                             timestamp_ms)
+{
+   struct byte_buffer *payload = &writer->payload;
+   uint32_t            now     = quantize_time(timestamp_ms,
+                                               writer->config
+                                               .last_seen_quantum_ms);
+
+   put_u8(payload, next->metric_type);
+   put_varint(payload, writer->config.last_seen_quantum_ms);
+   put_varint(payload, writer->config.metric_quantum);
+   put_interfaces(payload, &writer->ifs, 0);
+   put_varint(payload, next->n_originators);
+   for (size_t i = 0; i < next->n_originators; i++) {
+      put_entry(payload, &writer->ifs, next, &next->originators[i], now);
+   }
+}
+
+/* Encodes the changes from the writer state to next. Returns the number of
+ * changed originators.
+ */
+static size_t encode_delta(      struct mu_badv_history_writer *const writer,
+                           const struct mu_badv_orig_table     *const next,
+                           const uint64_t                             timestamp_ms,
+                                 int                           *const error)
+{
+   const struct mu_badv_orig_table *prev     = writer->state;
+   struct byte_buffer              *payload  = &writer->payload;
+   size_t                          *removed  = NULL;
+   size_t                          *upserted = NULL;
+   size_t                           n_removed  = 0;
+   size_t                           n_upserted = 0;
+   size_t                           i = 0;
+   size_t                           j = 0;
+   int                              order;
+
+   removed  = mu_malloc((prev->n_originators + 1) * sizeof(size_t));
+   upserted = mu_malloc((next->n_originators + 1) * sizeof(size_t));
+   if (!removed || !upserted) {
+      MU_SET_ERROR(error, errno);
+      mu_free(removed);
+      mu_free(upserted);
+      payload->failed = true;
+      return 0;
+   }
+
+   while (i < prev->n_originators || j < next->n_originators) {
+      if (i == prev->n_originators) {
+         order = 1;
+      } else if (j == next->n_originators) {
+         order = -1;
+      } else {
+         order = compare_mac(&prev->originators[i].mac_addr,
+                             &next->originators[j].mac_addr);
+      }
+
+      if (order < 0) {
+         removed[n_removed++] = i++;
+      } else if (order > 0) {
+         upserted[n_upserted++] = j++;
+      } else {
+         if (!originators_equal(prev, &prev->originators[i],
+                                next, &next->originators[j])) {
+            upserted[n_upserted++] = j;
+         }
+         i++;
+         j++;
+      }
+   }
+
+   if (n_removed || n_upserted || prev->metric_type != next->metric_type) {
+      put_u8(payload, next->metric_type);
+      put_interfaces(payload, &writer->ifs, writer->n_ifs_recorded);
+      put_varint(payload, n_removed);
+      for (size_t k = 0; k < n_removed; k++) {
+         put_bytes(payload, prev->originators[removed[k]].mac_addr.octet,
+                   MU_MAC_ADDR_LEN);
+      }
+      put_varint(payload, n_upserted);
+      for (size_t k = 0; k < n_upserted; k++) {
+         put_entry(payload, &writer->ifs, next,
+                   &next->originators[upserted[k]],
+                   quantize_time(timestamp_ms,
+                                 writer->config.last_seen_quantum_ms));
+      }
+   }
+
+   mu_free(removed);
+   mu_free(upserted);
+   return n_removed + n_upserted + (prev->metric_type != next->metric_type);
+}
+
+/* Writes the pending records at the end of the log. A partially written
+ * chunk is cut off again so the log never ends in garbage followed by
+ * valid records.
+ */
+static bool write_pending(struct mu_badv_history_writer *const writer,
+                          int                           *const error)
+{
+   size_t  written = 0;
+   ssize_t n;
+
+   while (written < writer->pending.length) {
+      n = pwrite(writer->fd, writer->pending.data + written,
+                 writer->pending.length - written,
+                 writer->file_length + (off_t) written);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         MU_SET_ERROR(error, errno);
+         if (ftruncate(writer->fd, writer->file_length)) {
+            ; // The torn chunk is dropped when the log is opened again.
+         }
+         return false;
+      }
+      written += (size_t) n;
+   }
+
+   writer->file_length   += (off_t) written;
+   writer->pending.length = 0;
+   return true;
+}
+
+static bool emit_record(      struct mu_badv_history_writer *const writer,
+                        const unsigned char                        type,
+                        const uint64_t                             timestamp_ms,
+                              int                           *const error)
+{
+   struct byte_buffer *pending = &writer->pending;
+   size_t              start   = pending->length;
+
+   put_u8(pending, type);
+   put_varint(pending, writer->payload.length);
+   put_le(pending, timestamp_ms, 8);
+   put_bytes(pending, writer->payload.data, writer->payload.length);
+   if (!pending->failed) {
+      put_le(pending, crc32(pending->data + start, pending->length - start), 4);
+   }
+
+   if (pending->failed) {
+      MU_SET_ERROR(error, ENOMEM);
+      pending->failed = false;
+      pending->length = start;
+      return false;
+   }
+   return true;
+}
+
+/* Checks an existing log and returns the length of its valid part. */
+static bool valid_log_length(const int fd, off_t *const length, int *const error)
+{
+   struct stat    status;
+   unsigned char *data   = NULL;
+   struct record  record;
+   size_t         offset = HISTORY_HEADER_LEN;
+
+   if (fstat(fd, &status)) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+
+   if (!status.st_size) {
+      *length = 0;
+      return true;
+   }
+
+   data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (data == MAP_FAILED) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+
+   if (!valid_file_header(data, (size_t) status.st_size)) {
+      munmap(data, (size_t) status.st_size);
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   while (offset < (size_t) status.st_size
+          && parse_record(data + offset, (size_t) status.st_size - offset,
+                          &record)) {
+      offset += record.length;
+   }
+
+   munmap(data, (size_t) status.st_size);
+   *length = (off_t) offset;
+   return true;
+}
+
+static void free_replay(struct replay *const replay)
+{
+   mu_badv_orig_table_free(replay->state);
+   mu_free(replay->ifs.names);
+}
+
+static bool get_interfaces(struct cursor        *const cursor,
+                           struct if_dictionary *const ifs)
+{
+   uint64_t n_names = get_varint(cursor);
+   size_t   length;
+   char     name[MU_IF_NAME_LEN];
+   bool     failed = false;
+
+   for (uint64_t i = 0; i < n_names && !cursor->failed && !failed; i++) {
+      length = get_u8(cursor);
+      if (length >= MU_IF_NAME_LEN) {
+         cursor->failed = true;
+         break;
+      }
+      get_bytes(cursor, name, length);
+      name[length] = '\0';
+      if (intern_if(ifs, name, &failed) != ifs->n_names - 1) {
+         cursor->failed = true;   // Duplicate name.
+      }
+   }
+   return !cursor->failed && !failed;
+}
+
+/* Decodes count entries into a new table with real (not quantized) metrics
+ * and quantized seen-at times.
+ */
+static struct mu_badv_orig_table *get_entries(
+         struct cursor        *const cursor,
+   const struct replay        *const replay,
+   const uint64_t                    timestamp_ms,
+         int                  *const error)
+{
+   struct mu_badv_orig_table *table = NULL;
+   struct mu_badv_originator *entry = NULL;
+   struct mu_badv_hop        *hop   = NULL;
+   uint64_t                   n_entries = get_varint(cursor);
+   uint64_t                   index;
+   size_t                     max_hops  = (size_t) (cursor->end - cursor->pos)
+                                          / HOP_MIN_LEN;
+   uint32_t                   now;
+
+   if (cursor->failed || n_entries > (uint64_t) (cursor->end - cursor->pos)
+       || !replay->last_seen_quantum) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+   now = quantize_time(timestamp_ms, replay->last_seen_quantum);
+
+   table = mu_badv_orig_table_alloc((size_t) n_entries, max_hops, error);
+   if (!table) {
+      return NULL;
+   }
+
+   for (uint64_t i = 0; i < n_entries && !cursor->failed; i++) {
+      entry = &table->originators[table->n_originators++];
+      get_bytes(cursor, entry->mac_addr.octet, MU_MAC_ADDR_LEN);
+      if (get_u8(cursor) & ENTRY_NEXT_HOP_IS_SELF) {
+         entry->next_hop = entry->mac_addr;
+      } else {
+         get_bytes(cursor, entry->next_hop.octet, MU_MAC_ADDR_LEN);
+      }
+      index = get_varint(cursor);
+      if (index >= replay->ifs.n_names) {
+         cursor->failed = true;
+         break;
+      }
+      strcpy(entry->outgoing_if, replay->ifs.names[index]);
+      entry->last_seen_msecs = now - (uint32_t) get_varint(cursor);
+      entry->metric    = (uint32_t) get_varint(cursor) * replay->metric_quantum;
+      entry->n_hops    = (uint32_t) get_varint(cursor);
+      entry->first_hop = (uint32_t) table->n_hops;
+      if (entry->n_hops > max_hops - table->n_hops) {
+         cursor->failed = true;
+         break;
+      }
+      for (uint32_t j = 0; j < entry->n_hops; j++) {
+         hop = &table->hops[table->n_hops++];
+         get_bytes(cursor, hop->mac_addr.octet, MU_MAC_ADDR_LEN);
+         hop->metric = (uint32_t) get_varint(cursor) * replay->metric_quantum;
+      }
+   }
+
+   if (cursor->failed) {
+      MU_SET_ERROR(error, EINVAL);
+      mu_badv_orig_table_free(table);
+      return NULL;
+   }
+   return table;
+}
+
+static bool apply_keyframe(      struct replay *const replay,
+                           const struct record *const record,
+                                 int           *const error)
+{
+   struct cursor            cursor = { record->payload,
+                                       record->payload + record->payload_length,
+                                       false };
+   enum mu_badv_metric_type metric_type;
+
+   metric_type               = (enum mu_badv_metric_type) get_u8(&cursor);
+   replay->last_seen_quantum = (uint32_t) get_varint(&cursor);
+   replay->metric_quantum    = (uint32_t) get_varint(&cursor);
+   replay->ifs.n_names       = 0;
+
+   if (!get_interfaces(&cursor, &replay->ifs)) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   mu_badv_orig_table_free(replay->state);
+   replay->state = get_entries(&cursor, replay, record->timestamp_ms, error);
+   if (!replay->state) {
+      return false;
+   }
+   replay->state->metric_type = metric_type;
+   return true;
+}
+
+static bool apply_delta(      struct replay *const replay,
+                        const struct record *const record,
+                              int           *const error)
+{
+   struct cursor              cursor = { record->payload,
+                                         record->payload
+                                         + record->payload_length,
+                                         false };
+   struct mu_badv_orig_table *prev     = replay->state;
+   struct mu_badv_orig_table *upserted = NULL;
+   struct mu_badv_orig_table *next     = NULL;
+   const unsigned char       *removed  = NULL;
+   enum mu_badv_metric_type   metric_type;
+   uint64_t                   n_removed;
+   size_t                     i = 0;
+   size_t                     j = 0;
+   size_t                     k = 0;
+   int                        order;
+
+   metric_type = (enum mu_badv_metric_type) get_u8(&cursor);
+   if (!get_interfaces(&cursor, &replay->ifs)) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   n_removed = get_varint(&cursor);
+   removed   = cursor.pos;
+   if (cursor.failed || n_removed > (uint64_t) (cursor.end - cursor.pos)
+                                    / MU_MAC_ADDR_LEN) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+   cursor.pos += n_removed * MU_MAC_ADDR_LEN;
+
+   upserted = get_entries(&cursor, replay, record->timestamp_ms, error);
+   if (!upserted) {
+      return false;
+   }
+
+   next = mu_badv_orig_table_alloc(prev->n_originators
+                                   + upserted->n_originators,
+                                   prev->n_hops + upserted->n_hops, error);
+   if (!next) {
+      mu_badv_orig_table_free(upserted);
+      return false;
+   }
+   next->metric_type = metric_type;
+
+   while (i < prev->n_originators || j < upserted->n_originators) {
+      if (i == prev->n_originators) {
+         order = 1;
+      } else if (j == upserted->n_originators) {
+         order = -1;
+      } else {
+         order = compare_mac(&prev->originators[i].mac_addr,
+                             &upserted->originators[j].mac_addr);
+      }
+
+      if (order > 0) {
+         copy_originator(next, upserted, &upserted->originators[j++]);
+      } else if (order == 0) {
+         copy_originator(next, upserted, &upserted->originators[j++]);
+         i++;
+      } else {
+         while (k < n_removed
+                && memcmp(removed + k * MU_MAC_ADDR_LEN,
+                          prev->originators[i].mac_addr.octet,
+                          MU_MAC_ADDR_LEN) < 0) {
+            k++;
+         }
+         if (k == n_removed
+             || memcmp(removed + k * MU_MAC_ADDR_LEN,
+                       prev->originators[i].mac_addr.octet, MU_MAC_ADDR_LEN)) {
+            copy_originator(next, prev, &prev->originators[i]);
+         }
+         i++;
+      }
+   }
+
+   mu_badv_orig_table_free(upserted);
+   mu_badv_orig_table_free(prev);
+   replay->state = next;
+   return true;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_history_writer *mu_badv_history_writer_open(
+   const        char                   *const path,
+   const struct mu_badv_history_config *const config,
+                int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_history_writer *writer = NULL;
+   unsigned char header[HISTORY_HEADER_LEN] = { 0 };
+
+   if (!path) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   writer = mu_calloc(1, sizeof(struct mu_badv_history_writer));
+   if (!writer) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   if (config) {
+      writer->config = *config;
+   }
+   if (!writer->config.keyframe_interval) {
+      writer->config.keyframe_interval =
+         MU_BADV_HISTORY_DEFAULT_KEYFRAME_INTERVAL;
+   }
+   if (!writer->config.last_seen_quantum_ms) {
+      writer->config.last_seen_quantum_ms =
+         MU_BADV_HISTORY_DEFAULT_LAST_SEEN_QUANTUM_MS;
+   }
+   if (!writer->config.metric_quantum) {
+      writer->config.metric_quantum = MU_BADV_HISTORY_DEFAULT_METRIC_QUANTUM;
+   }
+   if (!writer->config.flush_bytes) {
+      writer->config.flush_bytes = MU_BADV_HISTORY_DEFAULT_FLUSH_BYTES;
+   }
+
+   writer->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (writer->fd < 0) {
+      MU_SET_ERROR(error, errno);
+      mu_free(writer);
+      return NULL;
+   }
+
+   if (!valid_log_length(writer->fd, &writer->file_length, error)) {
+      close(writer->fd);
+      mu_free(writer);
+      return NULL;
+   }
+
+   if (!writer->file_length) {
+      memcpy(header, HISTORY_MAGIC, strlen(HISTORY_MAGIC));
+      header[strlen(HISTORY_MAGIC)] = HISTORY_VERSION;
+      put_bytes(&writer->pending, header, sizeof(header));
+      if (writer->pending.failed) {
+         MU_SET_ERROR(error, ENOMEM);
+         close(writer->fd);
+         mu_free(writer);
+         return NULL;
+      }
+   } else if (ftruncate(writer->fd, writer->file_length)) {
+      MU_SET_ERROR(error, errno);
+      close(writer->fd);
+      mu_free(writer);
+      return NULL;
+   }
+
+   return writer;
+}
+
+/* Implementation notes:
+ * - The writer state is only replaced once the record is buffered, so a
+ *   failed append leaves the writer usable.
+ * - An unchanged table only moves last_timestamp_ms.
+ */
+bool mu_badv_history_append(
+         struct mu_badv_history_writer *const writer,
+   const struct mu_badv_orig_table     *const table,
+   const        uint64_t                      timestamp_ms,
+                int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *next     = NULL;
+   bool                       keyframe = false;
+   size_t                     n_changes;
+
+   if (!writer || !table
+       || (writer->state && timestamp_ms < writer->last_timestamp_ms)) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   next = normalize(table, &writer->config, timestamp_ms, error);
+   if (!next) {
+      return false;
+   }
+
+   keyframe   = !writer->state || writer->records_since_keyframe + 1
+                                  >= writer->config.keyframe_interval;
+   writer->payload.length = 0;
+   writer->payload.failed = false;
+
+   if (!keyframe) {
+      if (!intern_table_ifs(&writer->ifs, next)) {
+         MU_SET_ERROR(error, ENOMEM);
+         writer->ifs.n_names = writer->n_ifs_recorded;
+         mu_badv_orig_table_free(next);
+         return false;
+      }
+      n_changes = encode_delta(writer, next, timestamp_ms, error);
+      if (!n_changes && !writer->payload.failed) {
+         writer->ifs.n_names = writer->n_ifs_recorded;
+         mu_badv_orig_table_free(next);
+         writer->last_timestamp_ms = timestamp_ms;
+         return true;
+      }
+      if (writer->payload.length > writer->keyframe_length / 2) {
+         keyframe = true;
+      }
+   }
+
+   if (keyframe) {
+      writer->payload.length = 0;
+      writer->payload.failed = false;
+      writer->ifs.n_names    = 0;
+      if (!intern_table_ifs(&writer->ifs, next)) {
+         writer->payload.failed = true;
+      }
+      encode_keyframe(writer, next, timestamp_ms);
+   }
+
+   if (writer->payload.failed) {
+      MU_SET_ERROR(error, ENOMEM);
+   }
+   if (writer->payload.failed
+       || !emit_record(writer, keyframe ? RECORD_KEYFRAME : RECORD_DELTA,
+                       timestamp_ms, error)) {
+      if (keyframe) {
+         // The dictionary was rebuilt, the next record has to be a keyframe.
+         mu_badv_orig_table_free(writer->state);
+         writer->state = NULL;
+      } else {
+         writer->ifs.n_names = writer->n_ifs_recorded;
+      }
+      mu_badv_orig_table_free(next);
+      return false;
+   }
+
+   if (keyframe) {
+      writer->records_since_keyframe = 0;
+      writer->keyframe_length        = writer->payload.length;
+   } else {
+      writer->records_since_keyframe++;
+   }
+   writer->n_ifs_recorded    = writer->ifs.n_names;
+   writer->last_timestamp_ms = timestamp_ms;
+   mu_badv_orig_table_free(writer->state);
+   writer->state = next;
+
+   // A failed write keeps the records pending for the next attempt.
+   if (writer->pending.length >= writer->config.flush_bytes) {
+      return write_pending(writer, error);
+   }
+   return true;
+}
+
+bool mu_badv_history_record(
+         struct mu_badv_history_writer *const writer,
+   const        char                   *const interface_name,
+                int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *table = NULL;
+   struct timespec            now;
+   bool                       ok;
+
+   table = mu_badv_orig_table_load(interface_name, error);
+   if (!table) {
+      return false;
+   }
+
+   clock_gettime(CLOCK_REALTIME, &now);
+   ok = mu_badv_history_append(writer, table,
+                               (uint64_t) now.tv_sec * 1000
+                               + (uint64_t) now.tv_nsec / 1000000, error);
+   mu_badv_orig_table_free(table);
+   return ok;
+}
+
+bool mu_badv_history_flush(struct mu_badv_history_writer *const writer,
+                           int                           *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   if (!writer) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   if (!write_pending(writer, error)) {
+      return false;
+   }
+
+   if (fsync(writer->fd)) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+   return true;
+}
+
+void mu_badv_history_writer_close(struct mu_badv_history_writer *const writer)
+{
+   if (!writer) {
+      return;
+   }
+
+   mu_badv_history_flush(writer, NULL);
+   close(writer->fd);
+   mu_badv_orig_table_free(writer->state);
+   mu_free(writer->ifs.names);
+   mu_free(writer->pending.data);
+   mu_free(writer->payload.data);
+   mu_free(writer);
+}
+
+/* Implementation notes:
+ * - Indexing stops at the first torn or corrupt record.
+ */
+struct mu_badv_history_reader *mu_badv_history_reader_open(
+   const char *const path,
+         int  *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_history_reader *reader = NULL;
+   struct stat                    status;
+   struct record                  record;
+   size_t                         offset = HISTORY_HEADER_LEN;
+   size_t                         max_records;
+   int                            fd;
+
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   if (fstat(fd, &status)) {
+      MU_SET_ERROR(error, errno);
+      close(fd);
+      return NULL;
+   }
+
+   if ((size_t) status.st_size < HISTORY_HEADER_LEN) {
+      MU_SET_ERROR(error, EINVAL);
+      close(fd);
+      return NULL;
+   }
+
+   reader = mu_calloc(1, sizeof(struct mu_badv_history_reader));
+   if (!reader) {
+      MU_SET_ERROR(error, errno);
+      close(fd);
+      return NULL;
+   }
+
+   reader->length = (size_t) status.st_size;
+   reader->data   = mmap(NULL, reader->length, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (reader->data == MAP_FAILED) {
+      MU_SET_ERROR(error, errno);
+      mu_free(reader);
+      return NULL;
+   }
+
+   if (!valid_file_header(reader->data, reader->length)) {
+      MU_SET_ERROR(error, EINVAL);
+      mu_badv_history_reader_close(reader);
+      return NULL;
+   }
+
+   max_records     = (reader->length - HISTORY_HEADER_LEN) / RECORD_MIN_LEN;
+   reader->records = mu_malloc((max_records + 1) * sizeof(struct record_ref));
+   if (!reader->records) {
+      MU_SET_ERROR(error, errno);
+      mu_badv_history_reader_close(reader);
+      return NULL;
+   }
+
+   while (offset < reader->length
+          && parse_record(reader->data + offset, reader->length - offset,
+                          &record)) {
+      reader->records[reader->n_records].offset       = offset;
+      reader->records[reader->n_records].timestamp_ms = record.timestamp_ms;
+      reader->records[reader->n_records].keyframe     =
+         record.type == RECORD_KEYFRAME;
+      reader->n_records++;
+      offset += record.length;
+   }
+
+   return reader;
+}
+
+bool mu_badv_history_span(const struct mu_badv_history_reader *const reader,
+                                uint64_t                      *const first_ms,
+                                uint64_t                      *const last_ms)
+{
+   if (!reader || !reader->n_records) {
+      return false;
+   }
+
+   if (first_ms) {
+      *first_ms = reader->records[0].timestamp_ms;
+   }
+   if (last_ms) {
+      *last_ms = reader->records[reader->n_records - 1].timestamp_ms;
+   }
+   return true;
+}
+
+/* Implementation notes:
+ * - Binary search for the last record at or before the timestamp, then a
+ *   backwards walk to its keyframe, which is at most keyframe_interval
+ *   records away.
+ * - Interface IDs and aggregates are not logged but counted from the
+ *   replayed table, with metrics as quantized by the writer.
+ * - Last-seen times are those at the last record applied, an originator
+ *   unchanged since an earlier record has aged since.
+ */
+struct mu_badv_orig_table *mu_badv_history_table_at(
+   const struct mu_badv_history_reader *const reader,
+   const        uint64_t                      timestamp_ms,
+                uint64_t               *const recorded_at_ms,
+                int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct replay              replay;
+   struct record              record;
+   struct mu_badv_orig_table *table = NULL;
+   size_t                     low   = 0;
+   size_t                     high;
+   size_t                     last;
+   size_t                     first;
+   uint32_t                   now;
+   bool                       ok    = true;
+
+   if (!reader) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   // Find the first record after timestamp_ms.
+   high = reader->n_records;
+   while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (reader->records[middle].timestamp_ms <= timestamp_ms) {
+         low = middle + 1;
+      } else {
+         high = middle;
+      }
+   }
+
+   if (!low) {
+      MU_SET_ERROR(error, ENOENT);
+      return NULL;
+   }
+   last = low - 1;
+
+   for (first = last; first > 0 && !reader->records[first].keyframe; first--) {
+      ;
+   }
+   if (!reader->records[first].keyframe) {
+      MU_SET_ERROR(error, ENOENT);
+      return NULL;
+   }
+
+   memset(&replay, 0, sizeof(replay));
+   for (size_t i = first; ok && i <= last; i++) {
+      parse_record(reader->data + reader->records[i].offset,
+                   reader->length - reader->records[i].offset, &record);
+      if (record.type == RECORD_KEYFRAME) {
+         ok = apply_keyframe(&replay, &record, error);
+      } else {
+         ok = apply_delta(&replay, &record, error);
+      }
+   }
+
+   if (ok) {
+      table        = replay.state;
+      replay.state = NULL;
+      now = quantize_time(reader->records[last].timestamp_ms,
+                          replay.last_seen_quantum);
+      for (size_t i = 0; i < table->n_originators; i++) {
+         table->originators[i].last_seen_msecs =
+            (now - table->originators[i].last_seen_msecs)
+            * replay.last_seen_quantum;
+      }
+      mu_badv_orig_table_count_ifs(table);
+      if (recorded_at_ms) {
+         *recorded_at_ms = reader->records[last].timestamp_ms;
+      }
+   }
+   free_replay(&replay);
+   return table;
+}
+
+void mu_badv_history_reader_close(struct mu_badv_history_reader *const reader)
+{
+   if (!reader) {
+      return;
+   }
+
+   munmap(reader->data, reader->length);
+   mu_free(reader->records);
+   mu_free(reader);
+}
+
+#endif                          /* __linux */
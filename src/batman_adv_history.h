@@ -0,0 +1,241 @@
+/** @file batman_adv_history.h
+ * meshutil API for recording and replaying B.A.T.M.A.N. advanced topology
+ * history
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_history   Topology history
+ *
+ * A history log records originator tables over time in an append-only file
+ * and reconstructs the table at any past timestamp.
+ *
+ * The log is a sequence of records. A keyframe holds a complete table, a
+ * delta only the originators added, removed or changed since the previous
+ * record. Samples without changes are not recorded. An originator is recorded
+ * with the time it was last seen rather than its last-seen time, so one which
+ * is not heard from does not cause a delta while its last-seen time grows.
+ * Before comparing, those times and the metrics are quantized (see struct
+ * mu_badv_history_config), so small metric changes and an originator seen
+ * again within the same quantum do not cause a delta either. Reconstructed
+ * tables contain the quantized values, with last-seen times as of the last
+ * record applied.
+ *
+ * A keyframe is written at the latest every keyframe_interval records, which
+ * bounds the number of deltas a reader has to apply. Records are buffered and
+ * written in chunks of flush_bytes, so a flash device is written in large
+ * blocks and never rewritten. Each record carries a checksum; a record torn
+ * by a power loss is dropped when the log is opened again.
+ *
+ * Timestamps are milliseconds since the Epoch.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_HISTORY_H
+#define MESHUTIL_BATMAN_ADV_HISTORY_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batman_adv_originators.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+#define MU_BADV_HISTORY_DEFAULT_KEYFRAME_INTERVAL     64
+#define MU_BADV_HISTORY_DEFAULT_LAST_SEEN_QUANTUM_MS  1000
+#define MU_BADV_HISTORY_DEFAULT_METRIC_QUANTUM        8
+#define MU_BADV_HISTORY_DEFAULT_FLUSH_BYTES           4096
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** Settings of a history writer. Zero fields take the defaults.
+ */
+struct mu_badv_history_config {
+   uint32_t keyframe_interval;      ///< Maximum records per keyframe.
+   uint32_t last_seen_quantum_ms;   ///< Resolution of last-seen times.
+   uint32_t metric_quantum;         ///< Resolution of TQ and throughput.
+   uint32_t flush_bytes;            ///< Bytes buffered before writing.
+};
+
+/// Opaque handle of a history log opened for appending.
+struct mu_badv_history_writer;
+
+/// Opaque handle of a history log opened for reading.
+struct mu_badv_history_reader;
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Open a history log for appending, creating it if needed.
+ *
+ * A torn record at the end of an existing log is cut off. The first record
+ * appended is a keyframe.
+ *
+ * @param *path   [in]  Path of the log file.
+ * @param *config [in]  Settings, NULL for the defaults.
+ * @param *error  [out] For setting error codes on function failure.
+ *                      EINVAL if the file is not a history log.
+ *
+ * @return Pointer to the writer. Has to be released with
+ *         mu_badv_history_writer_close().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_history_writer
+*mu_badv_history_writer_open(const        char                   *const path,
+                             const struct mu_badv_history_config *const config,
+                                          int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Append a table to the log.
+ *
+ * Timestamps have to increase; a table older than the last one appended is
+ * rejected with EINVAL.
+ *
+ * @param *writer       [in]  The writer.
+ * @param *table        [in]  The originator table to record.
+ * @param  timestamp_ms [in]  When the table was read.
+ * @param *error        [out] For setting error codes on function failure.
+ *
+ * @retval true  The table was recorded (or did not change).
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_history_append(      struct mu_badv_history_writer *const writer,
+                       const struct mu_badv_orig_table     *const table,
+                       const        uint64_t                      timestamp_ms,
+                                    int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Read the originators table of a bat interface and append it.
+ *
+ * @param *writer         [in]  The writer.
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @retval true  The table was recorded.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_history_record(      struct mu_badv_history_writer *const writer,
+                       const        char                   *const interface_name,
+                                    int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Write buffered records to the log file and sync it.
+ *
+ * @retval true  All records are on disk.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_history_flush(struct mu_badv_history_writer *const writer,
+                      int                           *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Flush and close a history log.
+ */
+void
+mu_badv_history_writer_close(struct mu_badv_history_writer *const writer)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Open a history log for reading.
+ *
+ * Records appended after opening are not seen, open the log again to see them.
+ *
+ * @param *path  [in]  Path of the log file.
+ * @param *error [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the reader. Has to be released with
+ *         mu_badv_history_reader_close().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_history_reader
+*mu_badv_history_reader_open(const char *const path, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the time span covered by a log.
+ *
+ * @retval true  first_ms and last_ms were set.
+ * @retval false The log is empty.
+ */
+bool
+mu_badv_history_span(const struct mu_badv_history_reader *const reader,
+                           uint64_t                      *const first_ms,
+                           uint64_t                      *const last_ms)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Reconstruct the originator table at a point in time.
+ *
+ * @param *reader          [in]  The reader.
+ * @param  timestamp_ms    [in]  The point in time.
+ * @param *recorded_at_ms  [out] Timestamp of the last record applied. Can be
+ *                               NULL.
+ * @param *error           [out] For setting error codes on function failure.
+ *                               ENOENT if the log starts after timestamp_ms.
+ *
+ * @return Pointer to the table as recorded last at or before timestamp_ms.
+ *         Has to be released with mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_history_table_at(const struct mu_badv_history_reader *const reader,
+                          const        uint64_t                      timestamp_ms,
+                                       uint64_t               *const recorded_at_ms,
+                                       int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Close a history log opened for reading.
+ */
+void
+mu_badv_history_reader_close(struct mu_badv_history_reader *const reader)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_HISTORY_H */
@@ -0,0 +1,393 @@
+/** @file batman_adv_mac_filter.c
+ * meshutil API implementation for the B.A.T.M.A.N. advanced mesh membership
+ * filter
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_mac_filter_impl   Mesh membership filter implementation
+ *
+ * The filter is a split block Bloom filter. The high half of the hash of an
+ * address selects a block of eight 64 bit words; the low half, multiplied by
+ * a different odd constant for each word, selects one bit in every word. An
+ * address is added by setting its eight bits and is contained if all of them
+ * are set, which takes one cache line and no data dependent branches.
+ *
+ * Translation table lines look like
+ *
+ *      * 06:00:00:00:07:01  (  1) via 02:ba:00:00:00:07     (  1)   [.W]
+ *      * 06:00:00:00:00:01 [....W]
+ *
+ * in transtable_global and transtable_local, with '+' instead of '*' for
+ * further routes to a client in newer versions. Only the client address is
+ * used; header lines do not start with an address and are skipped.
+ *
+ * The number of lines bounds the number of addresses, which sizes the filter
+ * before any address is added.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "batman_adv_debugfs.h"
+#include "batman_adv_mac_filter.h"
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Name of the global translation table in the batman_adv debugfs directory.
+#define BATMAN_ADV_TRANSTABLE_GLOBAL "transtable_global"
+
+/// Name of the local translation table in the batman_adv debugfs directory.
+#define BATMAN_ADV_TRANSTABLE_LOCAL "transtable_local"
+
+/// Words per block, one bit is set in each.
+#define FILTER_BLOCK_WORDS 8
+
+/// Bytes per block, a cache line.
+#define FILTER_BLOCK_SIZE (FILTER_BLOCK_WORDS * sizeof(uint64_t))
+
+/// Most bits per address accepted.
+#define FILTER_MAX_BITS 64
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct mu_badv_mac_filter {
+   char      interface_name[MU_IF_NAME_LEN];
+   unsigned  bits_per_addr;
+   uint64_t *blocks;                   ///< Aligned to FILTER_BLOCK_SIZE.
+   void     *memory;                   ///< Allocation holding the blocks.
+   size_t    n_blocks;
+   size_t    max_blocks;
+   size_t    n_addrs;
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+/// Odd constants selecting the bit of an address in each word.
+static const uint32_t block_salts[FILTER_BLOCK_WORDS] = {
+   0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+   0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - The address is loaded as two words in host byte order; the hash only has
+ *   to be the same when adding and querying.
+ */
+static uint64_t mac_hash(const struct mu_mac_addr *const mac_addr)
+{
+   uint32_t low  = 0;
+   uint16_t high = 0;
+   uint64_t key  = 0;
+
+   memcpy(&low, mac_addr->octet, sizeof(low));
+   memcpy(&high, mac_addr->octet + sizeof(low), sizeof(high));
+   key  = (uint64_t) high << 32 | low;
+   key ^= key >> 33;
+   key *= 0xff51afd7ed558ccdULL;
+   key ^= key >> 33;
+   key *= 0xc4ceb9fe1a85ec53ULL;
+   key ^= key >> 33;
+   return key;
+}
+
+static uint64_t *hash_block(const struct mu_badv_mac_filter *const filter,
+                            const uint64_t                         hash)
+{
+   size_t block = (size_t) (((hash >> 32) * filter->n_blocks) >> 32);
+
+   return filter->blocks + block * FILTER_BLOCK_WORDS;
+}
+
+static void add_addr(      struct mu_badv_mac_filter *const filter,
+                     const struct mu_mac_addr        *const mac_addr)
+{
+   uint64_t  hash  = mac_hash(mac_addr);
+   uint64_t *block = hash_block(filter, hash);
+
+   for (int i = 0; i < FILTER_BLOCK_WORDS; i++) {
+      block[i] |= (uint64_t) 1 << (((uint32_t) hash * block_salts[i]) >> 26);
+   }
+   filter->n_addrs++;
+}
+
+static size_t count_lines(const char *const buffer)
+{
+   return mu_badv_count_delimiters(buffer, buffer + strlen(buffer), NULL) + 1;
+}
+
+/// A missing table is read as an empty one.
+static char *read_tt_table(const char *const interface_name,
+                           const char *const table,
+                                 int  *const error)
+{
+   char   *buffer   = NULL;
+   size_t  length   = 0;
+   int     tt_error = 0;
+
+   buffer = mu_badv_debugfs_read_table(interface_name, table, &length,
+                                       &tt_error);
+   if (!buffer && tt_error != ENOENT) {
+      MU_SET_ERROR(error, tt_error);
+   }
+   return buffer;
+}
+
+/// Returns the number of addresses added.
+static size_t add_tt_clients(      struct mu_badv_mac_filter *const filter,
+                             const char                      *const buffer)
+{
+   struct mu_mac_addr mac_addr;
+   const  char       *end     = buffer + strlen(buffer);
+   const  char       *field   = NULL;
+   size_t             n_addrs = filter->n_addrs;
+
+   for (const char *line = buffer; *line; line = mu_badv_next_line(line)) {
+      field = mu_badv_skip_blanks(line);
+      if (*field == '*' || *field == '+') {
+         field = mu_badv_skip_blanks(field + 1);
+      }
+      if (mu_badv_parse_mac(field, end, &mac_addr)) {
+         add_addr(filter, &mac_addr);
+      }
+   }
+   return filter->n_addrs - n_addrs;
+}
+
+/* Implementation notes:
+ * - The blocks only grow; memory is allocated with room to align them.
+ */
+static bool reserve(struct mu_badv_mac_filter *const filter,
+                    const size_t                     n_addrs,
+                    int                       *const error)
+{
+   size_t n_blocks = 0;
+   void  *memory   = NULL;
+
+   if (n_addrs > SIZE_MAX / filter->bits_per_addr) {
+      MU_SET_ERROR(error, ENOMEM);
+      return false;
+   }
+   n_blocks = (n_addrs * filter->bits_per_addr + FILTER_BLOCK_SIZE * 8 - 1)
+              / (FILTER_BLOCK_SIZE * 8);
+   if (!n_blocks) {
+      n_blocks = 1;
+   }
+
+   if (n_blocks > filter->max_blocks) {
+      memory = mu_malloc(n_blocks * FILTER_BLOCK_SIZE + FILTER_BLOCK_SIZE - 1);
+      if (!memory) {
+         MU_SET_ERROR(error, errno);
+         return false;
+      }
+      mu_free(filter->memory);
+      filter->memory     = memory;
+      filter->blocks     = (uint64_t *) (((uintptr_t) memory
+                                          + FILTER_BLOCK_SIZE - 1)
+                                         & ~(uintptr_t) (FILTER_BLOCK_SIZE
+                                                         - 1));
+      filter->max_blocks = n_blocks;
+   }
+
+   memset(filter->blocks, 0, n_blocks * FILTER_BLOCK_SIZE);
+   filter->n_blocks = n_blocks;
+   return true;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_mac_filter *mu_badv_mac_filter_new(
+   const char         *const interface_name,
+   const unsigned int        bits_per_addr,
+         int          *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const char *ifname = interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+   struct mu_badv_mac_filter *filter = NULL;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+   if (bits_per_addr > FILTER_MAX_BITS) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   filter = mu_calloc(1, sizeof(struct mu_badv_mac_filter));
+   if (!filter) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   strcpy(filter->interface_name, ifname);
+   filter->bits_per_addr = bits_per_addr ? bits_per_addr
+                                         : MU_BADV_MAC_FILTER_BITS;
+   return filter;
+}
+
+void mu_badv_mac_filter_free(struct mu_badv_mac_filter *const filter)
+{
+   if (!filter) {
+      return;
+   }
+   mu_free(filter->memory);
+   mu_free(filter);
+}
+
+/* Implementation notes:
+ * - All tables are read before the filter is cleared, so it is sized once
+ *   and a failed read leaves the previous contents. reserve() changes the
+ *   filter only once it cannot fail any more.
+ */
+bool mu_badv_mac_filter_refresh(struct mu_badv_mac_filter *const filter,
+                                int                       *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *table     = NULL;
+   char                      *tt_global = NULL;
+   char                      *tt_local  = NULL;
+   size_t                     n_addrs   = 0;
+   int                        tt_error  = 0;
+   bool                       ok        = false;
+
+   if (!filter) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_CALL_START(filter->interface_name);
+
+   table = mu_badv_orig_table_load(filter->interface_name, error);
+   if (!table) {
+      MU_TRACE_CALL_DONE(filter->interface_name, error);
+      return false;
+   }
+   tt_global = read_tt_table(filter->interface_name,
+                             BATMAN_ADV_TRANSTABLE_GLOBAL, &tt_error);
+   if (!tt_error) {
+      tt_local = read_tt_table(filter->interface_name,
+                               BATMAN_ADV_TRANSTABLE_LOCAL, &tt_error);
+   }
+   if (tt_error) {
+      MU_SET_ERROR(error, tt_error);
+      goto out;
+   }
+
+   n_addrs = table->n_originators;
+   if (tt_global) {
+      n_addrs += count_lines(tt_global);
+   }
+   if (tt_local) {
+      n_addrs += count_lines(tt_local);
+   }
+   MU_TRACE_INDEX_START("mac_filter", n_addrs);
+   if (!reserve(filter, n_addrs, error)) {
+      MU_TRACE_INDEX_DONE("mac_filter", 0, false);
+      goto out;
+   }
+   filter->n_addrs = 0;
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      add_addr(filter, &table->originators[i].mac_addr);
+   }
+   if (tt_global) {
+      MU_TRACE_PARSE_START(filter->interface_name,
+                           BATMAN_ADV_TRANSTABLE_GLOBAL, strlen(tt_global));
+      n_addrs = add_tt_clients(filter, tt_global);
+      MU_TRACE_PARSE_DONE(filter->interface_name,
+                          BATMAN_ADV_TRANSTABLE_GLOBAL, n_addrs);
+   }
+   if (tt_local) {
+      MU_TRACE_PARSE_START(filter->interface_name,
+                           BATMAN_ADV_TRANSTABLE_LOCAL, strlen(tt_local));
+      n_addrs = add_tt_clients(filter, tt_local);
+      MU_TRACE_PARSE_DONE(filter->interface_name,
+                          BATMAN_ADV_TRANSTABLE_LOCAL, n_addrs);
+   }
+   MU_TRACE_INDEX_DONE("mac_filter", filter->n_addrs, true);
+   ok = true;
+
+out:
+   MU_TRACE_CALL_DONE(filter->interface_name, error);
+   mu_badv_orig_table_free(table);
+   mu_free(tt_global);
+   mu_free(tt_local);
+   return ok;
+}
+
+/* Implementation notes:
+ * - The bits of all words are combined without branching.
+ */
+bool mu_badv_mac_filter_contains(const struct mu_badv_mac_filter *const filter,
+                                 const struct mu_mac_addr        *const mac_addr)
+{
+   const uint64_t *block = NULL;
+   uint64_t        hash  = 0;
+   uint64_t        match = 1;
+
+   if (!filter || !filter->n_blocks) {
+      return false;
+   }
+
+   hash  = mac_hash(mac_addr);
+   block = hash_block(filter, hash);
+#pragma GCC unroll 8
+   for (int i = 0; i < FILTER_BLOCK_WORDS; i++) {
+      match &= block[i] >> (((uint32_t) hash * block_salts[i]) >> 26);
+   }
+   return match & 1;
+}
+
+size_t mu_badv_mac_filter_size(const struct mu_badv_mac_filter *const filter)
+{
+   return filter ? filter->n_addrs : 0;
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,180 @@
+/** @file batman_adv_neighbors.c
+ * meshutil API implementation for the B.A.T.M.A.N. advanced neighbours table
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_neighbors_impl   Neighbours table implementation
+ *
+ * B.A.T.M.A.N. IV neighbour lines look like
+ *
+ *        eth0     02:ba:7a:df:04:01    0.180s
+ *
+ * and B.A.T.M.A.N. V neighbour lines like
+ *
+ *     02:ba:7a:df:04:01    0.400s (        1.0) [      eth0]
+ *
+ * The header lines do not match either syntax and are skipped.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batman_adv_debugfs.h"
+#include "batman_adv_neighbors.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static bool parse_neighbor_line(const char              *line,
+                                const char              *const end,
+                                struct mu_badv_neighbor *const neighbor)
+{
+   const char *field  = NULL;
+   size_t      length = 0;
+
+   memset(neighbor, 0, sizeof(*neighbor));
+   line = mu_badv_skip_blanks(line);
+
+   if ((field = mu_badv_parse_mac(line, end, &neighbor->mac_addr))) {
+      // B.A.T.M.A.N. V: address, last-seen, throughput, interface.
+      if (!(line = mu_badv_parse_last_seen(field,
+                                           &neighbor->last_seen_msecs))) {
+         return false;
+      }
+      if (!(line = mu_badv_parse_metric(line, &neighbor->metric_type,
+                                        &neighbor->metric))) {
+         return false;
+      }
+      return mu_badv_parse_ifname(line, neighbor->outgoing_if) != NULL;
+   }
+
+   // B.A.T.M.A.N. IV: interface, address, last-seen.
+   while (*line && *line != ' ' && *line != '\t' && *line != '\n') {
+      if (length < MU_IF_NAME_LEN - 1) {
+         neighbor->outgoing_if[length++] = *line;
+      }
+      line++;
+   }
+   neighbor->outgoing_if[length] = '\0';
+
+   line = mu_badv_skip_blanks(line);
+   if (!length
+       || !(line = mu_badv_parse_mac(line, end, &neighbor->mac_addr))) {
+      return false;
+   }
+   neighbor->metric_type = MU_BADV_METRIC_NONE;
+   return mu_badv_parse_last_seen(line, &neighbor->last_seen_msecs) != NULL;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Reads the neighbors table in one go, sizes the array by the number of
+ *   lines and trims it to the number of parsed entries.
+ */
+struct mu_badv_neighbor *mu_badv_neighbors(const char   *const interface_name,
+                                                 size_t *const n_neighbors,
+                                                 int    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   char                    *buffer    = NULL;
+   const char              *line      = NULL;
+   struct mu_badv_neighbor *neighbors = NULL;
+   struct mu_badv_neighbor *tmp       = NULL;
+   size_t                   length    = 0;
+   size_t                   n_lines   = 1;
+   size_t                   count     = 0;
+
+   if (n_neighbors) {
+      *n_neighbors = 0;
+   }
+
+   MU_TRACE_CALL_START(interface_name);
+   buffer = mu_badv_debugfs_read_table(interface_name,
+                                       BATMAN_ADV_NEIGHBORS_TABLE,
+                                       &length, error);
+   if (!buffer) {
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return NULL;
+   }
+   MU_TRACE_PARSE_START(interface_name, BATMAN_ADV_NEIGHBORS_TABLE, length);
+
+   for (line = buffer; *line; line++) {
+      if (*line == '\n') {
+         n_lines++;
+      }
+   }
+
+   neighbors = mu_malloc(n_lines * sizeof(struct mu_badv_neighbor));
+   if (!neighbors) {
+      MU_SET_ERROR(error, errno);
+      mu_free(buffer);
+      MU_TRACE_PARSE_DONE(interface_name, BATMAN_ADV_NEIGHBORS_TABLE, 0);
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return NULL;
+   }
+
+   for (line = buffer; *line; line = mu_badv_next_line(line)) {
+      if (parse_neighbor_line(line, buffer + length, &neighbors[count])) {
+         count++;
+      }
+   }
+   mu_free(buffer);
+   MU_TRACE_PARSE_DONE(interface_name, BATMAN_ADV_NEIGHBORS_TABLE, count);
+
+   if (!count) {
+      mu_free(neighbors);
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return NULL;
+   }
+
+   tmp = mu_realloc(neighbors, count * sizeof(struct mu_badv_neighbor));
+   if (tmp) {
+      neighbors = tmp;
+   }
+
+   if (n_neighbors) {
+      *n_neighbors = count;
+   }
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return neighbors;
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,97 @@
+/** @file batman_adv_neighbors.h
+ * meshutil API for the B.A.T.M.A.N. advanced neighbours table
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_neighbors   Neighbours table
+ *
+ * The neighbors table lists the nodes the own node hears directly, i.e. the
+ * one-hop neighbours, per hard interface. Reading it directly is cheaper and
+ * more accurate than deriving neighbours from the potential next hops of the
+ * originators table (see mu_badv_next_hop_addresses).
+ *
+ * B.A.T.M.A.N. IV neighbour lines carry no link metric, B.A.T.M.A.N. V lines
+ * carry the estimated throughput.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_NEIGHBORS_H
+#define MESHUTIL_BATMAN_ADV_NEIGHBORS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batman_adv.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** One entry of the neighbours table.
+ */
+struct mu_badv_neighbor {
+   struct mu_mac_addr          mac_addr;     ///< Address of the neighbour.
+   enum   mu_badv_metric_type  metric_type;  ///< Kind of metric.
+          uint32_t             metric;       ///< TQ or throughput in kbit/s.
+          uint32_t             last_seen_msecs;
+          char                 outgoing_if[MU_IF_NAME_LEN];
+};
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Get the one-hop neighbours of the own node.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *n_neighbors    [out] Number of entries in the returned array. Can be
+ *                              ignored by passing NULL.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to an array of neighbours. The array has to be
+ *         mu_free()'d by the caller.
+ *
+ * @retval NULL Returned on failure or when no neighbours available.
+ */
+struct mu_badv_neighbor
+*mu_badv_neighbors(const char   *const interface_name,
+                         size_t *const n_neighbors,
+                         int    *const error)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_NEIGHBORS_H */
@@ -0,0 +1,437 @@
+/** @file batman_adv_node_store.c
+ * meshutil API implementation for application state kept per node
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_node_store_impl   Node store implementation
+ *
+ * Nodes are entries of a header and the slot, allocated from blocks and never
+ * freed before the store. The hash table holds pointers to the entries with
+ * linear probing. Entries are never taken out of the table, removal only
+ * clears the present flag, so a probe sequence never breaks and a reader
+ * needs nothing but acquire loads:
+ *
+ * - the writer fills a table slot with a release store after initializing
+ *   the entry, so a reader seeing the pointer sees the address;
+ * - when the table fills up the writer copies it into one twice the size and
+ *   publishes that with a release store. Readers may still probe the old one,
+ *   so old tables are kept until the store is freed. They add up to less than
+ *   the size of the current table.
+ *
+ * Writers hold the store mutex. Tables are at most half full.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "batman_adv_node_store.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Smallest number of hash table slots allocated.
+#define NODE_STORE_MIN_SLOTS 64
+
+/// Number of entries allocated at once.
+#define NODE_STORE_BLOCK_ENTRIES 256
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Header of a node, followed by the slot at offset MU_BADV_NODE_SLOT_ALIGN.
+struct node_entry {
+   struct mu_mac_addr mac_addr;
+          uint32_t    present;         ///< Atomic, read without the mutex.
+          uint64_t    generation;      ///< Sync which last saw the node.
+};
+
+struct node_table {
+          size_t       mask;           ///< Number of slots - 1.
+   struct node_table  *retired;        ///< Previous, smaller table.
+   struct node_entry  *entries[];
+};
+
+struct entry_block {
+   struct entry_block *next;
+};
+
+struct mu_badv_node_store {
+   struct node_table  *table;          ///< Atomic, read without the mutex.
+          pthread_mutex_t mutex;
+          size_t       slot_size;
+          size_t       stride;         ///< Bytes per entry including slot.
+          size_t       n_entries;      ///< Including removed nodes.
+          size_t       n_present;      ///< Atomic, read without the mutex.
+          uint64_t     generation;
+   struct entry_block *blocks;
+          char        *next_entry;     ///< Unused part of the newest block.
+          size_t       n_free;         ///< Entries left in the newest block.
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static size_t mac_hash(const struct mu_mac_addr *const mac_addr,
+                       const size_t                    mask)
+{
+   uint64_t key = 0;
+
+   for (int i = 0; i < MU_MAC_ADDR_LEN; i++) {
+      key = key << 8 | mac_addr->octet[i];
+   }
+   key *= 0x9e3779b97f4a7c15ULL;
+   return (size_t) (key >> 32) & mask;
+}
+
+static void *entry_slot(struct node_entry *const entry)
+{
+   return (char *) entry + MU_BADV_NODE_SLOT_ALIGN;
+}
+
+static struct node_table *table_new(const size_t n_slots)
+{
+   struct node_table *table = mu_calloc(1, sizeof(struct node_table)
+                                        + n_slots * sizeof(struct node_entry *));
+
+   if (table) {
+      table->mask = n_slots - 1;
+   }
+   return table;
+}
+
+static struct node_entry *find_entry(const struct node_table  *const table,
+                                     const struct mu_mac_addr *const mac_addr)
+{
+   size_t             slot  = mac_hash(mac_addr, table->mask);
+   struct node_entry *entry = NULL;
+
+   while ((entry = __atomic_load_n(&table->entries[slot], __ATOMIC_ACQUIRE))) {
+      if (mu_mac_addr_equal(&entry->mac_addr, mac_addr)) {
+         return entry;
+      }
+      slot = (slot + 1) & table->mask;
+   }
+   return NULL;
+}
+
+static void insert_entry(struct node_table *const table,
+                         struct node_entry *const entry)
+{
+   size_t slot = mac_hash(&entry->mac_addr, table->mask);
+
+   while (table->entries[slot]) {
+      slot = (slot + 1) & table->mask;
+   }
+   __atomic_store_n(&table->entries[slot], entry, __ATOMIC_RELEASE);
+}
+
+/* Implementation notes:
+ * - Blocks are allocated with room to align the first entry to
+ *   MU_BADV_NODE_SLOT_ALIGN; the stride keeps the following ones aligned.
+ */
+static struct node_entry *alloc_entry(struct mu_badv_node_store *const store)
+{
+   struct entry_block *block = NULL;
+   struct node_entry  *entry = NULL;
+   uintptr_t           first;
+
+   if (!store->n_free) {
+      block = mu_calloc(1, sizeof(struct entry_block) + MU_BADV_NODE_SLOT_ALIGN
+                           + NODE_STORE_BLOCK_ENTRIES * store->stride);
+      if (!block) {
+         return NULL;
+      }
+      block->next   = store->blocks;
+      store->blocks = block;
+
+      first = ((uintptr_t) (block + 1) + MU_BADV_NODE_SLOT_ALIGN - 1)
+              & ~(uintptr_t) (MU_BADV_NODE_SLOT_ALIGN - 1);
+      store->next_entry = (char *) first;
+      store->n_free     = NODE_STORE_BLOCK_ENTRIES;
+   }
+
+   entry = (struct node_entry *) store->next_entry;
+   store->next_entry += store->stride;
+   store->n_free--;
+   return entry;
+}
+
+/// Called with the mutex held.
+static bool grow_table(struct mu_badv_node_store *const store)
+{
+   struct node_table *old_table = store->table;
+   struct node_table *new_table = NULL;
+
+   if ((store->n_entries + 1) * 2 <= old_table->mask + 1) {
+      return true;
+   }
+
+   new_table = table_new((old_table->mask + 1) * 2);
+   if (!new_table) {
+      return false;
+   }
+   for (size_t i = 0; i <= old_table->mask; i++) {
+      if (old_table->entries[i]) {
+         insert_entry(new_table, old_table->entries[i]);
+      }
+   }
+   new_table->retired = old_table;
+   __atomic_store_n(&store->table, new_table, __ATOMIC_RELEASE);
+   return true;
+}
+
+/// Called with the mutex held.
+static struct node_entry *add_node(struct mu_badv_node_store *const store,
+                                   const struct mu_mac_addr  *const mac_addr,
+                                         int                 *const error)
+{
+   struct node_entry *entry = find_entry(store->table, mac_addr);
+
+   if (!entry) {
+      if (!grow_table(store) || !(entry = alloc_entry(store))) {
+         MU_SET_ERROR(error, errno);
+         return NULL;
+      }
+      entry->mac_addr = *mac_addr;
+      insert_entry(store->table, entry);
+      store->n_entries++;
+   }
+
+   entry->generation = store->generation;
+   if (!entry->present) {
+      __atomic_store_n(&entry->present, 1, __ATOMIC_RELEASE);
+      __atomic_add_fetch(&store->n_present, 1, __ATOMIC_RELAXED);
+   }
+   return entry;
+}
+
+/// Called with the mutex held.
+static void remove_entry(struct mu_badv_node_store *const store,
+                         struct node_entry         *const entry)
+{
+   if (entry->present) {
+      __atomic_store_n(&entry->present, 0, __ATOMIC_RELEASE);
+      __atomic_sub_fetch(&store->n_present, 1, __ATOMIC_RELAXED);
+   }
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_node_store *mu_badv_node_store_new(const size_t        slot_size,
+                                                        int    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_node_store *store = NULL;
+
+   if (slot_size > SIZE_MAX / 2 / NODE_STORE_BLOCK_ENTRIES) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   store = mu_calloc(1, sizeof(struct mu_badv_node_store));
+   if (!store) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   store->slot_size = slot_size;
+   store->stride    = MU_BADV_NODE_SLOT_ALIGN
+                      + ((slot_size + MU_BADV_NODE_SLOT_ALIGN - 1)
+                         & ~(size_t) (MU_BADV_NODE_SLOT_ALIGN - 1));
+   store->table     = table_new(NODE_STORE_MIN_SLOTS);
+   if (!store->table) {
+      MU_SET_ERROR(error, errno);
+      mu_free(store);
+      return NULL;
+   }
+
+   pthread_mutex_init(&store->mutex, NULL);
+   return store;
+}
+
+void mu_badv_node_store_free(struct mu_badv_node_store *const store)
+{
+   struct node_table  *table = NULL;
+   struct entry_block *block = NULL;
+
+   if (!store) {
+      return;
+   }
+
+   while ((table = store->table)) {
+      store->table = table->retired;
+      mu_free(table);
+   }
+   while ((block = store->blocks)) {
+      store->blocks = block->next;
+      mu_free(block);
+   }
+   pthread_mutex_destroy(&store->mutex);
+   mu_free(store);
+}
+
+/* Implementation notes:
+ * - Every sync has a generation number; nodes not stamped with it while
+ *   adding the originators are removed.
+ */
+bool mu_badv_node_store_sync(      struct mu_badv_node_store *const store,
+                             const struct mu_badv_orig_table *const table,
+                                          int                *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct node_entry *entry = NULL;
+
+   if (!store || !table) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_INDEX_START("node_store", table->n_originators);
+   pthread_mutex_lock(&store->mutex);
+   store->generation++;
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      if (!add_node(store, &table->originators[i].mac_addr, error)) {
+         pthread_mutex_unlock(&store->mutex);
+         MU_TRACE_INDEX_DONE("node_store", table->n_originators, false);
+         return false;
+      }
+   }
+
+   for (size_t i = 0; i <= store->table->mask; i++) {
+      entry = store->table->entries[i];
+      if (entry && entry->generation != store->generation) {
+         remove_entry(store, entry);
+      }
+   }
+
+   pthread_mutex_unlock(&store->mutex);
+   MU_TRACE_INDEX_DONE("node_store", table->n_originators, true);
+   return true;
+}
+
+void *mu_badv_node_store_add(      struct mu_badv_node_store *const store,
+                             const struct mu_mac_addr        *const mac_addr,
+                                          int                *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct node_entry *entry = NULL;
+
+   if (!store || !mac_addr) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   pthread_mutex_lock(&store->mutex);
+   entry = add_node(store, mac_addr, error);
+   pthread_mutex_unlock(&store->mutex);
+
+   return entry ? entry_slot(entry) : NULL;
+}
+
+bool mu_badv_node_store_remove(      struct mu_badv_node_store *const store,
+                               const struct mu_mac_addr        *const mac_addr)
+{
+   struct node_entry *entry   = NULL;
+   bool               removed = false;
+
+   if (!store || !mac_addr) {
+      return false;
+   }
+
+   pthread_mutex_lock(&store->mutex);
+   entry = find_entry(store->table, mac_addr);
+   if (entry && entry->present) {
+      remove_entry(store, entry);
+      removed = true;
+   }
+   pthread_mutex_unlock(&store->mutex);
+
+   return removed;
+}
+
+void *mu_badv_node_store_slot(const struct mu_badv_node_store *const store,
+                              const struct mu_mac_addr        *const mac_addr)
+{
+   struct node_entry *entry = NULL;
+
+   if (!store || !mac_addr) {
+      return NULL;
+   }
+
+   entry = find_entry(__atomic_load_n(&store->table, __ATOMIC_ACQUIRE),
+                      mac_addr);
+   if (!entry || !__atomic_load_n(&entry->present, __ATOMIC_ACQUIRE)) {
+      return NULL;
+   }
+   return entry_slot(entry);
+}
+
+size_t mu_badv_node_store_size(const struct mu_badv_node_store *const store)
+{
+   return store ? __atomic_load_n(&store->n_present, __ATOMIC_RELAXED) : 0;
+}
+
+void mu_badv_node_store_foreach(const struct mu_badv_node_store *const store,
+                                       mu_badv_node_fn                fn,
+                                       void                          *ctx)
+{
+   const struct node_table *table = NULL;
+   struct node_entry       *entry = NULL;
+
+   if (!store || !fn) {
+      return;
+   }
+
+   table = __atomic_load_n(&store->table, __ATOMIC_ACQUIRE);
+   for (size_t i = 0; i <= table->mask; i++) {
+      entry = __atomic_load_n(&table->entries[i], __ATOMIC_ACQUIRE);
+      if (entry && __atomic_load_n(&entry->present, __ATOMIC_ACQUIRE)) {
+         fn(&entry->mac_addr, entry_slot(entry), ctx);
+      }
+   }
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,215 @@
+/** @file batman_adv_node_store.h
+ * meshutil API for application state kept per B.A.T.M.A.N. advanced node
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_node_store   Per-node state store
+ *
+ * A node store gives every mesh node an application defined slot of a fixed
+ * size, e.g. for alert status, counters or the time the node was last probed.
+ * Nodes are keyed by their binary MAC address.
+ *
+ * The set of nodes follows the originator table: mu_badv_node_store_sync()
+ * adds the originators of a table and removes the nodes no longer in it. A
+ * store set on a refresh handle with mu_badv_refresh_set_store() is synced by
+ * every refresh.
+ *
+ *     store = mu_badv_node_store_new(sizeof(struct my_state), &error);
+ *     mu_badv_refresh_set_store(refresh, store);
+ *     ...
+ *     struct my_state *state = mu_badv_node_store_slot(store, &mac_addr);
+ *     if (state) {
+ *        __atomic_add_fetch(&state->n_probes, 1, __ATOMIC_RELAXED);
+ *     }
+ *
+ * Lookups take no locks and can run on any number of threads while the store
+ * is synced. Changes to the set of nodes are serialized by a mutex.
+ *
+ * Slots are zeroed when a node is first added and start on a cache line of
+ * their own, so threads updating different nodes do not contend. The library
+ * never reads or writes a slot afterwards; concurrent updates of one slot are
+ * synchronized by the application, e.g. with atomic operations.
+ *
+ * A slot stays valid until the store is freed, also after its node was
+ * removed, so a pointer got from a lookup never dangles. A node which is
+ * added again gets its old slot back with the contents it had. The memory of
+ * a store therefore grows with the number of distinct nodes ever added.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_NODE_STORE_H
+#define MESHUTIL_BATMAN_ADV_NODE_STORE_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Alignment of the slots of a node store.
+#define MU_BADV_NODE_SLOT_ALIGN 64
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Opaque MAC address keyed store of per-node application state.
+struct mu_badv_node_store;
+
+/// Called by mu_badv_node_store_foreach() for every node in the store.
+typedef void (*mu_badv_node_fn)(const struct mu_mac_addr *mac_addr,
+                                void                     *slot,
+                                void                     *ctx);
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Create an empty node store.
+ *
+ * @param  slot_size [in]  Size of the application state of a node.
+ * @param *error     [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the store. Has to be released with
+ *         mu_badv_node_store_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_node_store
+*mu_badv_node_store_new(const size_t slot_size, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release a node store and all slots.
+ *
+ * No other thread may use the store or its slots any more.
+ */
+void
+mu_badv_node_store_free(struct mu_badv_node_store *const store)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Make the nodes of a store those of an originator table.
+ *
+ * Adds the originators of the table which are not in the store and removes
+ * the nodes which are not in the table.
+ *
+ * @param *store [in]  The node store.
+ * @param *table [in]  The originator table.
+ * @param *error [out] For setting error codes on function failure.
+ *
+ * @retval true  The store was synced.
+ * @retval false An error occurred. Nodes may have been added but none were
+ *               removed.
+ */
+bool
+mu_badv_node_store_sync(      struct mu_badv_node_store *const store,
+                        const struct mu_badv_orig_table *const table,
+                                     int                *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Add a node to a store.
+ *
+ * @param *store    [in]  The node store.
+ * @param *mac_addr [in]  Address of the node.
+ * @param *error    [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the slot of the node.
+ *
+ * @retval NULL Returned on failure.
+ */
+void
+*mu_badv_node_store_add(      struct mu_badv_node_store *const store,
+                        const struct mu_mac_addr        *const mac_addr,
+                                     int                *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Remove a node from a store.
+ *
+ * @retval true  The node was removed.
+ * @retval false The node was not in the store.
+ */
+bool
+mu_badv_node_store_remove(      struct mu_badv_node_store *const store,
+                          const struct mu_mac_addr        *const mac_addr)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Look up the slot of a node without taking a lock.
+ *
+ * @param *store    [in] The node store.
+ * @param *mac_addr [in] Address of the node.
+ *
+ * @return Pointer to the slot of the node, aligned to
+ *         MU_BADV_NODE_SLOT_ALIGN bytes.
+ *
+ * @retval NULL The node is not in the store.
+ */
+void
+*mu_badv_node_store_slot(const struct mu_badv_node_store *const store,
+                         const struct mu_mac_addr        *const mac_addr)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the number of nodes in a store.
+ */
+size_t
+mu_badv_node_store_size(const struct mu_badv_node_store *const store)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Call a function for every node in a store, without taking a lock.
+ *
+ * Nodes added or removed during the call may or may not be visited.
+ *
+ * @param *store [in] The node store.
+ * @param  fn    [in] Called with the address and slot of each node.
+ * @param *ctx   [in] Passed to fn as is.
+ */
+void
+mu_badv_node_store_foreach(const struct mu_badv_node_store *const store,
+                                  mu_badv_node_fn                fn,
+                                  void                          *ctx)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_NODE_STORE_H */
@@ -0,0 +1,435 @@
+/** @file batman_adv_orig_index.c
+ * meshutil API implementation for perfect hash indexes of B.A.T.M.A.N. advanced
+ * originator tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_orig_index_impl   Originator index implementation
+ *
+ * The index is a minimal perfect hash function built by hash and displace
+ * (CHD): the MAC addresses of n originators are hashed into about n / 2
+ * buckets and every bucket gets a pilot, chosen so that the slots
+ *
+ *     slot(key) = fastrange(mix(hash(key) ^ mix(pilot)), n)
+ *
+ * of its keys are free and distinct. Buckets are placed largest first, while
+ * most slots are still free. Buckets of a single key are placed last, by
+ * storing the slot itself with ORIG_INDEX_DIRECT set as the pilot, so filling
+ * the last free slots does not take a search.
+ *
+ * A slot holds the position of its originator in the table. A lookup hashes
+ * the address, reads the pilot of its bucket and the slot and compares the
+ * address of that one originator: two dependent loads and no collisions.
+ *
+ * Repeated addresses get no slot of their own; the first originator with an
+ * address is found, as by the linear search. Their slots stay empty.
+ *
+ * If a bucket finds no pilot within ORIG_INDEX_MAX_PILOT tries the index is
+ * built again with another seed.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Average number of keys per bucket.
+#define ORIG_INDEX_BUCKET_KEYS 2
+
+/// Pilot flag: the rest of the pilot is the slot of a single key bucket.
+#define ORIG_INDEX_DIRECT 0x80000000u
+
+/// Content of slots without an originator.
+#define ORIG_INDEX_EMPTY UINT32_MAX
+
+/// Pilots tried per bucket before starting over with another seed.
+#define ORIG_INDEX_MAX_PILOT (1u << 20)
+
+/// Seeds tried before giving up.
+#define ORIG_INDEX_MAX_SEEDS 8
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct mu_badv_orig_index {
+   uint64_t  seed;
+   uint32_t  n_buckets;
+   uint32_t  n_slots;
+   uint32_t *pilots;                   ///< Pilot of each bucket.
+   uint32_t *slots;                    ///< Originator of each slot.
+};
+
+/// Scratch space of a build.
+struct index_build {
+   uint64_t *hashes;                   ///< Hash of each originator.
+   uint32_t *keys;                     ///< Originators ordered by bucket.
+   uint32_t *bucket_start;             ///< First key of each bucket.
+   uint32_t *buckets;                  ///< Buckets ordered by size.
+   uint32_t *size_start;               ///< First bucket of each size.
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static uint64_t mix(uint64_t x)
+{
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdULL;
+   x ^= x >> 33;
+   x *= 0xc4ceb9fe1a85ec53ULL;
+   x ^= x >> 33;
+   return x;
+}
+
+static uint64_t mac_hash(const struct mu_mac_addr *const mac_addr,
+                         const uint64_t                  seed)
+{
+   uint64_t key = 0;
+
+   for (int i = 0; i < MU_MAC_ADDR_LEN; i++) {
+      key = key << 8 | mac_addr->octet[i];
+   }
+   return mix(key ^ seed);
+}
+
+static uint32_t fastrange(const uint64_t hash, const uint32_t range)
+{
+   return (uint32_t) (((hash >> 32) * range) >> 32);
+}
+
+static uint32_t pilot_slot(const uint64_t hash,
+                           const uint64_t pilot_hash,
+                           const uint32_t n_slots)
+{
+   return fastrange(mix(hash ^ pilot_hash), n_slots);
+}
+
+/* Implementation notes:
+ * - Keys are ordered by bucket and buckets by decreasing size with counting
+ *   sorts. Both sorts are stable, so the keys of a bucket are in table order
+ *   and a repeated address comes after the first one.
+ */
+static void sort_buckets(const struct mu_badv_orig_table *const table,
+                               struct mu_badv_orig_index *const index,
+                               struct index_build        *const build,
+                               uint32_t                  *const max_size)
+{
+   const uint32_t n_keys = (uint32_t) table->n_originators;
+   uint32_t       size   = 0;
+
+   memset(build->bucket_start, 0, (index->n_buckets + 1) * sizeof(uint32_t));
+   for (uint32_t i = 0; i < n_keys; i++) {
+      build->hashes[i] = mac_hash(&table->originators[i].mac_addr, index->seed);
+      build->bucket_start[fastrange(build->hashes[i], index->n_buckets) + 1]++;
+   }
+
+   *max_size = 0;
+   for (uint32_t b = 0; b < index->n_buckets; b++) {
+      size = build->bucket_start[b + 1];
+      if (size > *max_size) {
+         *max_size = size;
+      }
+      build->bucket_start[b + 1] += build->bucket_start[b];
+   }
+
+   // Filling in the keys moves every start to the end of its bucket.
+   for (uint32_t i = 0; i < n_keys; i++) {
+      uint32_t b = fastrange(build->hashes[i], index->n_buckets);
+
+      build->keys[build->bucket_start[b]++] = i;
+   }
+   memmove(build->bucket_start + 1, build->bucket_start,
+           index->n_buckets * sizeof(uint32_t));
+   build->bucket_start[0] = 0;
+
+   memset(build->size_start, 0, (*max_size + 2) * sizeof(uint32_t));
+   for (uint32_t b = 0; b < index->n_buckets; b++) {
+      size = build->bucket_start[b + 1] - build->bucket_start[b];
+      build->size_start[*max_size - size + 1]++;
+   }
+   for (uint32_t s = 0; s <= *max_size; s++) {
+      build->size_start[s + 1] += build->size_start[s];
+   }
+   for (uint32_t b = 0; b < index->n_buckets; b++) {
+      size = build->bucket_start[b + 1] - build->bucket_start[b];
+      build->buckets[build->size_start[*max_size - size]++] = b;
+   }
+}
+
+/* Implementation notes:
+ * - Drops keys repeating an address of the bucket, which would never get
+ *   distinct slots, and returns the number of keys left.
+ */
+static uint32_t unique_keys(const struct mu_badv_orig_table *const table,
+                                  uint32_t                  *const keys,
+                            const uint32_t                         n_keys)
+{
+   uint32_t n_unique = 0;
+
+   for (uint32_t k = 0; k < n_keys; k++) {
+      const struct mu_mac_addr *mac_addr = &table->originators[keys[k]].mac_addr;
+      bool                      repeated = false;
+
+      for (uint32_t u = 0; u < n_unique && !repeated; u++) {
+         repeated = mu_mac_addr_equal(&table->originators[keys[u]].mac_addr,
+                                      mac_addr);
+      }
+      if (!repeated) {
+         keys[n_unique++] = keys[k];
+      }
+   }
+   return n_unique;
+}
+
+static bool place_bucket(      struct mu_badv_orig_index *const index,
+                         const struct index_build        *const build,
+                         const uint32_t                   *const keys,
+                         const uint32_t                          n_keys,
+                         const uint32_t                          bucket,
+                               uint32_t                  *const taken)
+{
+   for (uint32_t pilot = 0; pilot < ORIG_INDEX_MAX_PILOT; pilot++) {
+      uint64_t pilot_hash = mix(pilot);
+      uint32_t k          = 0;
+
+      for (k = 0; k < n_keys; k++) {
+         taken[k] = pilot_slot(build->hashes[keys[k]], pilot_hash,
+                               index->n_slots);
+         if (index->slots[taken[k]] != ORIG_INDEX_EMPTY) {
+            break;
+         }
+         index->slots[taken[k]] = keys[k];
+      }
+      if (k == n_keys) {
+         index->pilots[bucket] = pilot;
+         return true;
+      }
+      while (k--) {
+         index->slots[taken[k]] = ORIG_INDEX_EMPTY;
+      }
+   }
+   return false;
+}
+
+static bool place_keys(const struct mu_badv_orig_table *const table,
+                             struct mu_badv_orig_index *const index,
+                             struct index_build        *const build)
+{
+   uint32_t max_size  = 0;
+   uint32_t free_slot = 0;
+   uint32_t taken[64];
+
+   sort_buckets(table, index, build, &max_size);
+   for (uint32_t s = 0; s < index->n_slots; s++) {
+      index->slots[s] = ORIG_INDEX_EMPTY;
+   }
+
+   for (uint32_t i = 0; i < index->n_buckets; i++) {
+      uint32_t  bucket = build->buckets[i];
+      uint32_t *keys   = &build->keys[build->bucket_start[bucket]];
+      uint32_t  n_keys = unique_keys(table, keys,
+                                     build->bucket_start[bucket + 1]
+                                     - build->bucket_start[bucket]);
+
+      if (n_keys > sizeof(taken) / sizeof(taken[0])) {
+         return false;
+      }
+      if (n_keys > 1) {
+         if (!place_bucket(index, build, keys, n_keys, bucket, taken)) {
+            return false;
+         }
+         continue;
+      }
+
+      index->pilots[bucket] = 0;
+      if (n_keys == 1) {
+         while (index->slots[free_slot] != ORIG_INDEX_EMPTY) {
+            free_slot++;
+         }
+         index->slots[free_slot] = keys[0];
+         index->pilots[bucket]   = ORIG_INDEX_DIRECT | free_slot;
+      }
+   }
+   return true;
+}
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DEFINITIONS                                           *
+*******************************************************************************/
+
+void mu_badv_orig_index_free(const struct mu_badv_orig_index *const index)
+{
+   mu_free((void *) index);
+}
+
+/* Implementation notes:
+ * - Pilots and slots follow the index in its block, so it is copied whole
+ *   and the pointers into it moved to the copy.
+ */
+const struct mu_badv_orig_index *mu_badv_orig_index_copy(
+   const struct mu_badv_orig_index *const index,
+         int                       *const error)
+{
+   struct mu_badv_orig_index *copy = NULL;
+   size_t                     size = sizeof(struct mu_badv_orig_index)
+                                     + ((size_t) index->n_buckets
+                                        + index->n_slots) * sizeof(uint32_t);
+
+   copy = mu_malloc(size);
+   if (!copy) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+   memcpy(copy, index, size);
+   copy->pilots = (uint32_t *) (copy + 1);
+   copy->slots  = copy->pilots + copy->n_buckets;
+   return copy;
+}
+
+/* Implementation notes:
+ * - The hash, the pilot and the slot of the address are computed exactly as
+ *   by the build; the address of the one originator found is compared, since
+ *   addresses not in the table map to some slot as well.
+ */
+const struct mu_badv_originator *mu_badv_orig_index_find(
+   const struct mu_badv_orig_table *const table,
+   const struct mu_mac_addr        *const mac_addr)
+{
+   const struct mu_badv_orig_index *index = table->index;
+   uint64_t                         hash  = 0;
+   uint32_t                         pilot = 0;
+   uint32_t                         slot  = 0;
+
+   if (!index->n_slots) {
+      return NULL;
+   }
+
+   hash  = mac_hash(mac_addr, index->seed);
+   pilot = index->pilots[fastrange(hash, index->n_buckets)];
+   slot  = pilot & ORIG_INDEX_DIRECT
+           ? pilot & ~ORIG_INDEX_DIRECT
+           : pilot_slot(hash, mix(pilot), index->n_slots);
+   slot  = index->slots[slot];
+
+   if (slot == ORIG_INDEX_EMPTY
+       || !mu_mac_addr_equal(&table->originators[slot].mac_addr, mac_addr)) {
+      return NULL;
+   }
+   return &table->originators[slot];
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Pilots and slots are allocated with the index; the scratch space of the
+ *   build is one more block, freed before returning.
+ */
+bool mu_badv_orig_table_index(struct mu_badv_orig_table *const table,
+                              int                       *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_index *index     = NULL;
+   struct index_build         build;
+   void                      *scratch   = NULL;
+   size_t                     n_keys    = 0;
+   size_t                     n_buckets = 0;
+
+   if (!table) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+   if (table->index) {
+      return true;
+   }
+
+   n_keys = table->n_originators;
+   if (n_keys >= ORIG_INDEX_DIRECT) {
+      MU_SET_ERROR(error, EOVERFLOW);
+      return false;
+   }
+   n_buckets = n_keys / ORIG_INDEX_BUCKET_KEYS + 1;
+
+   index = mu_malloc(sizeof(struct mu_badv_orig_index)
+                     + (n_buckets + n_keys) * sizeof(uint32_t));
+   scratch = mu_malloc(n_keys * sizeof(uint64_t)
+                       + (n_keys + 2 * n_buckets + 1) * sizeof(uint32_t)
+                       + (n_keys + 2) * sizeof(uint32_t));
+   if (!index || !scratch) {
+      MU_SET_ERROR(error, errno);
+      mu_free(index);
+      mu_free(scratch);
+      return false;
+   }
+
+   index->n_buckets = (uint32_t) n_buckets;
+   index->n_slots   = (uint32_t) n_keys;
+   index->pilots    = (uint32_t *) (index + 1);
+   index->slots     = index->pilots + n_buckets;
+
+   build.hashes       = scratch;
+   build.keys         = (uint32_t *) (build.hashes + n_keys);
+   build.bucket_start = build.keys + n_keys;
+   build.buckets      = build.bucket_start + n_buckets + 1;
+   build.size_start   = build.buckets + n_buckets;
+
+   MU_TRACE_INDEX_START("orig_index", n_keys);
+   for (unsigned int attempt = 0; attempt < ORIG_INDEX_MAX_SEEDS; attempt++) {
+      index->seed = mix(0x9e3779b97f4a7c15ULL * (attempt + 1));
+      if (place_keys(table, index, &build)) {
+         MU_TRACE_INDEX_DONE("orig_index", n_keys, true);
+         mu_free(scratch);
+         table->index = index;
+         return true;
+      }
+   }
+   MU_TRACE_INDEX_DONE("orig_index", n_keys, false);
+
+   MU_SET_ERROR(error, EAGAIN);
+   mu_free(index);
+   mu_free(scratch);
+   return false;
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,760 @@
+/** @file batman_adv_originators.c
+ * meshutil API implementation for parsed B.A.T.M.A.N. advanced originator
+ * tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_originators_impl   Originator table implementation
+ *
+ * Originator lines look like
+ *
+ *     02:ba:7a:df:04:03    0.560s   (200) 02:ba:7a:df:04:01 [      eth0]: 02:ba:7a:df:04:02 (180) 02:ba:7a:df:04:01 (200)
+ *
+ * i.e. originator, last-seen, metric and next hop, outgoing interface and the
+ * list of potential next hops with their metrics. Header lines and the "No
+ * batman nodes in range ..." line do not match and are skipped.
+ *
+ * Before parsing, the number of lines bounds the number of originators and
+ * the number of '(' characters bounds the number of potential next hops, so
+ * the table is allocated once. Both are counted in a single vectorized sweep
+ * of the buffer; lines are then parsed field by field with fixed-format
+ * parsers, and the search for the next line starts where the parse of the
+ * previous one stopped.
+ *
+ * Large tables are split into chunks of whole lines which are counted and
+ * parsed on several threads, see mu_badv_set_parallel_parse.
+ *
+ * Outgoing interfaces are numbered and summed up as each line is parsed. A
+ * table rarely has more than a few interfaces, so they are searched linearly
+ * by name. The interfaces of the chunks of a table are merged by name and the
+ * IDs of their originators mapped to those of the whole table.
+ *
+ * Indexes are allocated apart from their tables, see
+ * pg_batman_adv_orig_index_impl.
+ *
+ * mu_badv_orig_top_k() parses the same lines as they are read, each into an
+ * originator on the stack, with its potential next hops only counted. The
+ * caller's array is a heap with the originator ranking last at its root: a
+ * line ranking before the root replaces it, other lines cost one comparison.
+ * The heap is sorted in place at the end.
+ *
+ * A line longer than the buffer arrives in pieces, so each originator is only
+ * ranked once the next line starts. Potential next hops in the pieces after
+ * the first are counted by their metrics, one '(' each, as a hop can be cut
+ * anywhere.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batman_adv_cache.h"
+#include "batman_adv_debugfs.h"
+#include "batman_adv_originators.h"
+#include "batman_adv_shm.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Buffer mu_badv_orig_top_k() reads through.
+#define TOP_K_BUFFER_SIZE 4096
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Result of parsing one chunk of a table.
+struct orig_chunk {
+   struct mu_badv_orig_table *table;
+   int                        error;
+};
+
+struct orig_parse {
+   struct orig_chunk  *chunks;
+   const  char       **bounds;
+};
+
+/// State of mu_badv_orig_top_k() while streaming a table.
+struct orig_top {
+   enum   mu_badv_top_order   order;
+          bool                neighbors_only;
+   struct mu_badv_originator *heap;
+          size_t              k;
+          size_t              n;
+   struct mu_badv_originator  line;    ///< Originator of the line read.
+          bool                in_line;
+          size_t              n_opens; ///< '(' after the hops parsed.
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+/// Whether tables which answer several lookups are indexed.
+static bool orig_index_enabled = false;
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static size_t aligned_size(const size_t size)
+{
+   return (size + 7) & ~(size_t) 7;
+}
+
+static void init_if(struct mu_badv_if_stats *const stats,
+                    const char              *const name)
+{
+   memset(stats, 0, sizeof(struct mu_badv_if_stats));
+   strcpy(stats->name, name);
+   stats->metric_min = UINT32_MAX;
+}
+
+static size_t find_if(const struct mu_badv_orig_table *const table,
+                      const char                      *const name)
+{
+   size_t id = 0;
+
+   while (id < table->n_ifs && strcmp(table->ifs[id].name, name)) {
+      id++;
+   }
+   return id;
+}
+
+/// Numbers the outgoing interface of an originator and sums it up.
+static void count_if(struct mu_badv_orig_table *const table,
+                     struct mu_badv_originator *const originator)
+{
+   struct mu_badv_if_stats *stats = NULL;
+   size_t                   id    = find_if(table, originator->outgoing_if);
+
+   if (id == table->n_ifs) {
+      if (id == MU_BADV_MAX_IFS) {
+         originator->if_id = MU_BADV_IF_NONE;
+         return;
+      }
+      init_if(&table->ifs[table->n_ifs++], originator->outgoing_if);
+   }
+
+   stats = &table->ifs[id];
+   originator->if_id = (uint8_t) id;
+   stats->n_originators++;
+   if (mu_mac_addr_equal(&originator->next_hop, &originator->mac_addr)) {
+      stats->n_neighbors++;
+   }
+   if (originator->metric < stats->metric_min) {
+      stats->metric_min = originator->metric;
+   }
+   stats->metric_sum += originator->metric;
+}
+
+/// Adds the interfaces of a chunk to a table, mapping their IDs in ids.
+static void merge_ifs(      struct mu_badv_orig_table *const table,
+                      const struct mu_badv_orig_table *const part,
+                            uint8_t                   *const ids)
+{
+   const struct mu_badv_if_stats *from = NULL;
+   struct mu_badv_if_stats       *to   = NULL;
+   size_t                         id   = 0;
+
+   for (size_t i = 0; i < part->n_ifs; i++) {
+      from = &part->ifs[i];
+      id   = find_if(table, from->name);
+      if (id == MU_BADV_MAX_IFS) {
+         ids[i] = MU_BADV_IF_NONE;
+         continue;
+      }
+      to = &table->ifs[id];
+      if (id == table->n_ifs) {
+         init_if(to, from->name);
+         table->n_ifs++;
+      }
+      to->n_originators += from->n_originators;
+      to->n_neighbors   += from->n_neighbors;
+      to->metric_sum    += from->metric_sum;
+      if (from->metric_min < to->metric_min) {
+         to->metric_min = from->metric_min;
+      }
+      ids[i] = (uint8_t) id;
+   }
+}
+
+/// Parses a line up to the potential next hops, NULL if it did not match.
+static const char *parse_originator(const char                *line,
+                                    const char                *const end,
+                                    struct mu_badv_originator *const originator,
+                                    enum   mu_badv_metric_type *const type)
+{
+   line = mu_badv_skip_blanks(line);
+
+   if (!(line = mu_badv_parse_mac(line, end, &originator->mac_addr))) {
+      return NULL;
+   }
+   if (!(line = mu_badv_parse_last_seen(line, &originator->last_seen_msecs))) {
+      return NULL;
+   }
+   if (!(line = mu_badv_parse_metric(line, type, &originator->metric))) {
+      return NULL;
+   }
+   if (!(line = mu_badv_parse_mac(mu_badv_skip_blanks(line), end,
+                                  &originator->next_hop))) {
+      return NULL;
+   }
+   return mu_badv_parse_ifname(line, originator->outgoing_if);
+}
+
+/// Returns the end of the parsed part of the line, NULL if it did not match.
+static const char *parse_originator_line(const char                *line,
+                                         const char                *const end,
+                                         struct mu_badv_orig_table *const table,
+                                         const  size_t                    max_hops)
+{
+   struct mu_badv_originator *originator =
+      &table->originators[table->n_originators];
+   struct mu_badv_hop        *hop = NULL;
+   enum   mu_badv_metric_type type;
+   const  char               *field = NULL;
+
+   if (!(line = parse_originator(line, end, originator, &type))) {
+      return NULL;
+   }
+
+   table->metric_type    = type;
+   originator->first_hop = (uint32_t) table->n_hops;
+   originator->n_hops    = 0;
+
+   line = mu_badv_skip_blanks(line);
+   if (*line == ':') {
+      line++;
+      while (table->n_hops < max_hops) {
+         hop = &table->hops[table->n_hops];
+         if (!(field = mu_badv_parse_mac(mu_badv_skip_blanks(line), end,
+                                         &hop->mac_addr))) {
+            break;
+         }
+         if (!(field = mu_badv_parse_metric(field, &type, &hop->metric))) {
+            break;
+         }
+         line = field;
+         table->n_hops++;
+         originator->n_hops++;
+      }
+   }
+
+   count_if(table, originator);
+   table->n_originators++;
+   return line;
+}
+
+static struct mu_badv_orig_table *parse_lines(const char *const start,
+                                              const char *const end,
+                                                    int  *const error)
+{
+   struct mu_badv_orig_table *table    = NULL;
+   const  char               *line     = NULL;
+   const  char               *parsed   = NULL;
+   size_t                     n_lines  = 0;
+   size_t                     n_parens = 0;
+
+   n_lines = mu_badv_count_delimiters(start, end, &n_parens) + 1;
+
+   table = mu_badv_orig_table_alloc(n_lines, n_parens, error);
+   if (!table) {
+      return NULL;
+   }
+
+   for (line = start; line < end && *line; line = mu_badv_next_line(line)) {
+      parsed = parse_originator_line(line, end, table, n_parens);
+      if (parsed) {
+         line = parsed;
+      }
+   }
+
+   return table;
+}
+
+/// Whether a comes before b in an order, by address if they tie.
+static bool ranks_before(const struct mu_badv_originator *const a,
+                         const struct mu_badv_originator *const b,
+                         const enum   mu_badv_top_order         order)
+{
+   uint32_t x = 0;
+   uint32_t y = 0;
+
+   switch (order) {
+   case MU_BADV_TOP_STALEST:
+      x = a->last_seen_msecs;
+      y = b->last_seen_msecs;
+      break;
+   case MU_BADV_TOP_BEST_METRIC:
+      x = a->metric;
+      y = b->metric;
+      break;
+   case MU_BADV_TOP_WORST_METRIC:
+      x = b->metric;
+      y = a->metric;
+      break;
+   case MU_BADV_TOP_MOST_HOPS:
+      x = a->n_hops;
+      y = b->n_hops;
+      break;
+   }
+   if (x != y) {
+      return x > y;
+   }
+   return memcmp(a->mac_addr.octet, b->mac_addr.octet, MU_MAC_ADDR_LEN) < 0;
+}
+
+/// Moves entry i of a heap down below the entries ranking after it.
+static void sift_down(      struct mu_badv_originator *const heap,
+                      const size_t                           n,
+                            size_t                           i,
+                      const enum   mu_badv_top_order         order)
+{
+   struct mu_badv_originator entry = heap[i];
+   size_t                    child = 0;
+
+   while ((child = 2 * i + 1) < n) {
+      if (child + 1 < n && ranks_before(&heap[child], &heap[child + 1],
+                                        order)) {
+         child++;
+      }
+      if (!ranks_before(&entry, &heap[child], order)) {
+         break;
+      }
+      heap[i] = heap[child];
+      i       = child;
+   }
+   heap[i] = entry;
+}
+
+/// Moves entry i of a heap up above the entries ranking before it.
+static void sift_up(      struct mu_badv_originator *const heap,
+                          size_t                           i,
+                    const enum   mu_badv_top_order         order)
+{
+   struct mu_badv_originator entry  = heap[i];
+   size_t                    parent = 0;
+
+   while (i && ranks_before(&heap[parent = (i - 1) / 2], &entry, order)) {
+      heap[i] = heap[parent];
+      i       = parent;
+   }
+   heap[i] = entry;
+}
+
+/// Ranks the originator of the line read last.
+static void top_k_rank(struct orig_top *const top)
+{
+   if (!top->in_line) {
+      return;
+   }
+   top->in_line = false;
+
+   if (top->n < top->k) {
+      top->heap[top->n] = top->line;
+      sift_up(top->heap, top->n++, top->order);
+   } else if (ranks_before(&top->line, &top->heap[0], top->order)) {
+      top->heap[0] = top->line;
+      sift_down(top->heap, top->n, 0, top->order);
+   }
+}
+
+static void top_k_line(const char *const line, const bool continued,
+                       void *const ctx)
+{
+   struct orig_top           *top   = ctx;
+   struct mu_badv_originator *originator = &top->line;
+   struct mu_badv_hop         hop;
+   enum   mu_badv_metric_type type;
+   const  char               *end   = line + strlen(line);
+   const  char               *rest  = NULL;
+   const  char               *field = NULL;
+   size_t                     n_opens = 0;
+
+   if (continued) {
+      if (top->in_line) {
+         mu_badv_count_delimiters(line, end, &n_opens);
+         originator->n_hops += (uint32_t) (top->n_opens + n_opens);
+         top->n_opens        = 0;
+      }
+      return;
+   }
+   top_k_rank(top);
+
+   if (!(rest = parse_originator(line, end, originator, &type))) {
+      return;
+   }
+   if (top->neighbors_only
+       && !mu_mac_addr_equal(&originator->next_hop, &originator->mac_addr)) {
+      return;
+   }
+
+   originator->first_hop = 0;
+   originator->n_hops    = 0;
+   originator->if_id     = MU_BADV_IF_NONE;
+   rest = mu_badv_skip_blanks(rest);
+   if (*rest == ':') {
+      rest++;
+      while ((field = mu_badv_parse_mac(mu_badv_skip_blanks(rest), end,
+                                        &hop.mac_addr))
+             && (field = mu_badv_parse_metric(field, &type, &hop.metric))) {
+         rest = field;
+         originator->n_hops++;
+      }
+   }
+   mu_badv_count_delimiters(rest, end, &top->n_opens);
+   top->in_line = true;
+}
+
+static void parse_chunk(void *const ctx, const size_t chunk)
+{
+   struct orig_parse *parse = ctx;
+
+   parse->chunks[chunk].error = 0;
+   parse->chunks[chunk].table = parse_lines(parse->bounds[chunk],
+                                            parse->bounds[chunk + 1],
+                                            &parse->chunks[chunk].error);
+}
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DEFINITIONS                                           *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Header, originators and hops share one block so the table can be freed
+ *   with a single mu_free() and copied as a whole.
+ */
+struct mu_badv_orig_table *mu_badv_orig_table_alloc(
+   const size_t        max_originators,
+   const size_t        max_hops,
+         int    *const error)
+{
+   struct mu_badv_orig_table *table = NULL;
+   size_t header_size      = aligned_size(sizeof(struct mu_badv_orig_table));
+   size_t originators_size = aligned_size(max_originators
+                                          * sizeof(struct mu_badv_originator));
+
+   table = mu_malloc(header_size + originators_size
+                  + max_hops * sizeof(struct mu_badv_hop));
+   if (!table) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   table->metric_type   = MU_BADV_METRIC_NONE;
+   table->n_originators = 0;
+   table->n_hops        = 0;
+   table->originators   = (struct mu_badv_originator *)
+                          ((char *) table + header_size);
+   table->hops          = (struct mu_badv_hop *)
+                          ((char *) table + header_size + originators_size);
+   table->index         = NULL;
+   table->n_ifs         = 0;
+   return table;
+}
+
+/* Implementation notes:
+ * - Large tables are parsed in chunks, each into a table of its own, which
+ *   are then concatenated. Lines are parsed in the same order and the hop
+ *   limit of a chunk is never reached either, so the result is the same as
+ *   parsing the whole buffer at once.
+ */
+struct mu_badv_orig_table *mu_badv_orig_table_parse(
+   const char   *const buffer,
+   const size_t        length,
+         int    *const error)
+{
+   struct orig_chunk          chunks[MU_BADV_MAX_PARSE_CHUNKS];
+   const  char               *bounds[MU_BADV_MAX_PARSE_CHUNKS + 1];
+   struct orig_parse          parse     = { chunks, bounds };
+   struct mu_badv_orig_table *table     = NULL;
+   struct mu_badv_orig_table *part      = NULL;
+   struct mu_badv_originator *entry     = NULL;
+   uint8_t                    ids[MU_BADV_MAX_IFS];
+   size_t                     n_chunks  = mu_badv_parse_chunks(buffer, length,
+                                                               bounds);
+   size_t                     n_origs   = 0;
+   size_t                     n_hops    = 0;
+
+   if (n_chunks == 1) {
+      return parse_lines(buffer, buffer + length, error);
+   }
+
+   mu_badv_parse_parallel(n_chunks, parse_chunk, &parse);
+
+   for (size_t i = 0; i < n_chunks; i++) {
+      if (!chunks[i].table) {
+         MU_SET_ERROR(error, chunks[i].error);
+         goto out;
+      }
+      n_origs += chunks[i].table->n_originators;
+      n_hops  += chunks[i].table->n_hops;
+   }
+
+   table = mu_badv_orig_table_alloc(n_origs, n_hops, error);
+   if (!table) {
+      goto out;
+   }
+
+   for (size_t i = 0; i < n_chunks; i++) {
+      part = chunks[i].table;
+      merge_ifs(table, part, ids);
+      for (size_t o = 0; o < part->n_originators; o++) {
+         entry  = &table->originators[table->n_originators + o];
+         *entry = part->originators[o];
+         entry->first_hop += (uint32_t) table->n_hops;
+         if (entry->if_id != MU_BADV_IF_NONE) {
+            entry->if_id = ids[entry->if_id];
+         }
+      }
+      memcpy(&table->hops[table->n_hops], part->hops,
+             part->n_hops * sizeof(struct mu_badv_hop));
+      table->n_originators += part->n_originators;
+      table->n_hops        += part->n_hops;
+      if (part->n_originators) {
+         table->metric_type = part->metric_type;
+      }
+   }
+
+out:
+   for (size_t i = 0; i < n_chunks; i++) {
+      mu_free(chunks[i].table);
+   }
+   return table;
+}
+
+/* Implementation notes:
+ * - An attached shared memory snapshot takes precedence over debugfs.
+ */
+struct mu_badv_orig_table *mu_badv_orig_table_load(
+   const char *const interface_name,
+         int  *const error)
+{
+   struct mu_badv_orig_table *table  = NULL;
+   char                      *buffer = NULL;
+   size_t                     length = 0;
+
+   if (mu_badv_shm_snapshot(interface_name, &table, error)) {
+      return table;
+   }
+
+   buffer = mu_badv_debugfs_read_table(interface_name,
+                                       BATMAN_ADV_ORIGINATORS_TABLE,
+                                       &length, error);
+   if (!buffer) {
+      return NULL;
+   }
+
+   MU_TRACE_PARSE_START(interface_name, BATMAN_ADV_ORIGINATORS_TABLE, length);
+   table = mu_badv_orig_table_parse(buffer, length, error);
+   MU_TRACE_PARSE_DONE(interface_name, BATMAN_ADV_ORIGINATORS_TABLE,
+                       table ? table->n_originators : 0);
+   mu_free(buffer);
+   return table;
+}
+
+/* Implementation notes:
+ * - Failing to index a table is not an error; it is searched instead.
+ */
+void mu_badv_orig_table_index_reused(struct mu_badv_orig_table *const table)
+{
+   if (__atomic_load_n(&orig_index_enabled, __ATOMIC_RELAXED)) {
+      mu_badv_orig_table_index(table, NULL);
+   }
+}
+
+struct mu_badv_orig_table *mu_badv_orig_table_acquire(
+   const char *const interface_name,
+         int  *const error)
+{
+   return mu_badv_cache_acquire(interface_name, error);
+}
+
+void mu_badv_orig_table_release(struct mu_badv_orig_table *const table)
+{
+   if (!mu_badv_cache_release(table)) {
+      mu_badv_orig_table_free(table);
+   }
+}
+
+struct mu_badv_orig_table *mu_badv_orig_table_copy(
+   const struct mu_badv_orig_table *const table,
+         int                       *const error)
+{
+   struct mu_badv_orig_table *copy = NULL;
+
+   copy = mu_badv_orig_table_alloc(table->n_originators, table->n_hops, error);
+   if (!copy) {
+      return NULL;
+   }
+
+   copy->metric_type   = table->metric_type;
+   copy->n_originators = table->n_originators;
+   copy->n_hops        = table->n_hops;
+   copy->n_ifs         = table->n_ifs;
+   memcpy(copy->originators, table->originators,
+          table->n_originators * sizeof(struct mu_badv_originator));
+   memcpy(copy->hops, table->hops, table->n_hops * sizeof(struct mu_badv_hop));
+   memcpy(copy->ifs, table->ifs,
+          table->n_ifs * sizeof(struct mu_badv_if_stats));
+   if (table->index) {
+      copy->index = mu_badv_orig_index_copy(table->index, NULL);
+   }
+   return copy;
+}
+
+void mu_badv_orig_table_count_ifs(struct mu_badv_orig_table *const table)
+{
+   table->n_ifs = 0;
+   for (size_t i = 0; i < table->n_originators; i++) {
+      count_if(table, &table->originators[i]);
+   }
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_orig_table *mu_badv_orig_table_read(
+   const char *const interface_name,
+         int  *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *table = NULL;
+
+   MU_TRACE_CALL_START(interface_name);
+   table = mu_badv_orig_table_load(interface_name, error);
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return table;
+}
+
+void mu_badv_orig_table_free(struct mu_badv_orig_table *const table)
+{
+   if (table) {
+      mu_badv_orig_index_free(table->index);
+   }
+   mu_free(table);
+}
+
+void mu_badv_set_orig_index(const bool enabled)
+{
+   __atomic_store_n(&orig_index_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+const struct mu_badv_originator *mu_badv_orig_table_find(
+   const struct mu_badv_orig_table *const table,
+   const struct mu_mac_addr        *const mac_addr)
+{
+   if (!table || !mac_addr) {
+      return NULL;
+   }
+   if (table->index) {
+      return mu_badv_orig_index_find(table, mac_addr);
+   }
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      if (mu_mac_addr_equal(&table->originators[i].mac_addr, mac_addr)) {
+         return &table->originators[i];
+      }
+   }
+
+   return NULL;
+}
+
+int mu_badv_orig_table_if_id(const struct mu_badv_orig_table *const table,
+                             const char                      *const interface_name)
+{
+   size_t id = 0;
+
+   if (!table || !interface_name) {
+      return -1;
+   }
+   id = find_if(table, interface_name);
+   return id < table->n_ifs ? (int) id : -1;
+}
+
+/* Implementation notes:
+ * - Taking the root, which ranks last, to the end of the heap while shrinking
+ *   it leaves the array in order.
+ */
+size_t mu_badv_orig_top_k(const char                      *const interface_name,
+                          const enum   mu_badv_top_order         order,
+                          const bool                             neighbors_only,
+                                struct mu_badv_originator *const top,
+                          const size_t                           k,
+                                int                       *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct orig_top           state  = { .order          = order,
+                                          .neighbors_only = neighbors_only,
+                                          .heap           = top,
+                                          .k              = k };
+   struct mu_badv_originator last;
+   char                      buffer[TOP_K_BUFFER_SIZE];
+
+   if (!k) {
+      return 0;
+   }
+   if (!top) {
+      MU_SET_ERROR(error, EINVAL);
+      return 0;
+   }
+
+   MU_TRACE_CALL_START(interface_name);
+   if (!mu_badv_debugfs_stream_table(interface_name,
+                                     BATMAN_ADV_ORIGINATORS_TABLE, buffer,
+                                     sizeof(buffer), top_k_line, &state,
+                                     error)) {
+      MU_TRACE_CALL_DONE(interface_name, error);
+      return 0;
+   }
+   top_k_rank(&state);
+
+   for (size_t n = state.n; n > 1; n--) {
+      last       = top[0];
+      top[0]     = top[n - 1];
+      top[n - 1] = last;
+      sift_down(top, n - 1, 0, order);
+   }
+   MU_TRACE_CALL_DONE(interface_name, error);
+   return state.n;
+}
+
+#endif                          /* __linux */
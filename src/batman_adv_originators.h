@@ -0,0 +1,429 @@
+/** @file batman_adv_originators.h
+ * meshutil API for parsed B.A.T.M.A.N. advanced originator tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_originators   Originator tables
+ *
+ * An originator table is a parsed snapshot of the originators file of a bat
+ * interface. The mesh and node functions of the batman_adv API are answered
+ * from originator tables; callers doing many queries can read a table once
+ * and query it directly instead.
+ *
+ * The originators and their potential next hops are stored in two flat arrays
+ * without pointers between entries: originator i owns the n_hops entries of
+ * hops starting at first_hop. A table is allocated as a single block.
+ *
+ * mu_badv_orig_table_find() searches a table linearly. A table which serves
+ * many lookups can be indexed with mu_badv_orig_table_index(), which builds a
+ * minimal perfect hash function over its addresses, about 6 bytes per
+ * originator: a lookup then takes a single probe. Building takes about a
+ * quarter of the time parsing the table does. With mu_badv_set_orig_index()
+ * the tables the library keeps for several lookups are indexed: those of
+ * refresh handles and those cached with mu_badv_cache_set_ttl(). A table read
+ * for a single lookup is searched, indexing it would cost more than the
+ * search. An index is only valid as long as the table is not modified.
+ *
+ * The outgoing interfaces of a table are numbered in the order they first
+ * appear: if_id of an originator is the index of its interface in ifs, which
+ * also holds aggregates of the originators reached through each interface,
+ * computed while parsing. Grouping nodes by interface or checking the health
+ * of a radio thus needs no string comparisons:
+ *
+ *     id = mu_badv_orig_table_if_id(table, "wlan0");
+ *     for (size_t i = 0; id >= 0 && i < table->n_originators; i++) {
+ *        if (table->originators[i].if_id == id) {
+ *           ...
+ *        }
+ *     }
+ *     mean_tq = table->ifs[id].metric_sum / table->ifs[id].n_originators;
+ *
+ * IDs are only valid within their table; the same interface can have another
+ * ID in the next table read.
+ *
+ * Callers which only want the few extreme originators, e.g. the ten stalest
+ * nodes or the neighbours with the worst TQ, need no table at all:
+ *
+ *     struct mu_badv_originator stalest[10];
+ *
+ *     n = mu_badv_orig_top_k("bat0", MU_BADV_TOP_STALEST, false, stalest, 10,
+ *                            &error);
+ *
+ * mu_badv_orig_top_k() reads the originators file through a fixed buffer and
+ * keeps the best k originators seen so far in a heap in the caller's array,
+ * so it allocates nothing per originator and its memory does not grow with
+ * the mesh. Its result is that of sorting the table and keeping the first k,
+ * also for lines longer than the buffer. It always reads debugfs, also with a
+ * shared memory snapshot attached.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_ORIGINATORS_H
+#define MESHUTIL_BATMAN_ADV_ORIGINATORS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batman_adv.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Most outgoing interfaces told apart in a table.
+#define MU_BADV_MAX_IFS 32
+
+/// if_id of originators reached through further interfaces.
+#define MU_BADV_IF_NONE UINT8_MAX
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Orders of mu_badv_orig_top_k(), ties go to the lower address.
+enum mu_badv_top_order {
+   MU_BADV_TOP_STALEST,                ///< Longest since last seen first.
+   MU_BADV_TOP_BEST_METRIC,            ///< Highest metric first.
+   MU_BADV_TOP_WORST_METRIC,           ///< Lowest metric first.
+   MU_BADV_TOP_MOST_HOPS               ///< Most potential next hops first.
+};
+
+/** A potential next hop of an originator.
+ */
+struct mu_badv_hop {
+   struct mu_mac_addr mac_addr;
+          uint32_t    metric;          ///< TQ or throughput in kbit/s.
+};
+
+/** One line of the originators table.
+ */
+struct mu_badv_originator {
+   struct mu_mac_addr mac_addr;        ///< Address of the originator.
+   struct mu_mac_addr next_hop;        ///< Actual next hop towards it.
+          uint32_t    last_seen_msecs;
+          uint32_t    metric;          ///< TQ or throughput via next_hop.
+          uint32_t    first_hop;       ///< Index of first potential next hop.
+          uint32_t    n_hops;          ///< Number of potential next hops.
+          char        outgoing_if[MU_IF_NAME_LEN];
+          uint8_t     if_id;           ///< Index of outgoing_if in ifs.
+};
+
+/** Aggregates of the originators of a table reached through one outgoing
+ *  interface.
+ */
+struct mu_badv_if_stats {
+   char     name[MU_IF_NAME_LEN];
+   uint32_t n_originators;
+   uint32_t n_neighbors;               ///< Originators being their next hop.
+   uint32_t metric_min;                ///< Lowest metric via the next hops.
+   uint64_t metric_sum;                ///< Divided by n_originators the mean.
+};
+
+/// Opaque perfect hash index of an originator table.
+struct mu_badv_orig_index;
+
+/** Parsed originators table.
+ */
+struct mu_badv_orig_table {
+   enum   mu_badv_metric_type  metric_type;
+          size_t               n_originators;
+          size_t               n_hops;
+   struct mu_badv_originator  *originators;
+   struct mu_badv_hop         *hops;
+   const  struct mu_badv_orig_index *index; ///< NULL if not indexed.
+          size_t               n_ifs;
+   struct mu_badv_if_stats     ifs[MU_BADV_MAX_IFS];
+};
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Read and parse the originators table of a bat interface.
+ *
+ * If a shared memory snapshot of the interface is attached (see
+ * mu_badv_shm_attach) the table is copied from it instead of debugfs.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the table. Has to be released with
+ *         mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_orig_table_read(const char *const interface_name, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release an originator table.
+ */
+void
+mu_badv_orig_table_free(struct mu_badv_orig_table *const table)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Build a perfect hash index of a table for mu_badv_orig_table_find().
+ *
+ * The index is released with the table. Indexing an indexed table does
+ * nothing.
+ *
+ * @param *table [in]  The originator table, not modified afterwards.
+ * @param *error [out] For setting error codes on function failure.
+ *
+ * @retval true  The table is indexed.
+ * @retval false An error occurred. The table can still be searched.
+ */
+bool
+mu_badv_orig_table_index(struct mu_badv_orig_table *const table,
+                         int                       *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Index the originator tables the library reuses.
+ *
+ * Tables read afterwards by refresh handles, and those cached for the
+ * batman_adv API functions by mu_badv_cache_set_ttl(), are indexed with
+ * mu_badv_orig_table_index(). Tables returned by mu_badv_orig_table_read()
+ * and read for a single call are not. A table which cannot be indexed is
+ * used without an index. Off by default.
+ *
+ * @param enabled [in] Whether to index tables.
+ */
+void
+mu_badv_set_orig_index(const bool enabled)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Find an originator in a table.
+ *
+ * Takes a single probe if the table is indexed, otherwise searches it.
+ *
+ * @param *table    [in] The originator table.
+ * @param *mac_addr [in] Address of the originator.
+ *
+ * @return Pointer to the originator entry, owned by the table.
+ *
+ * @retval NULL The originator is not in the table.
+ */
+const struct mu_badv_originator
+*mu_badv_orig_table_find(const struct mu_badv_orig_table *const table,
+                         const struct mu_mac_addr        *const mac_addr)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the ID of an outgoing interface in a table.
+ *
+ * @param *table          [in] The originator table.
+ * @param *interface_name [in] Name of the outgoing interface.
+ *
+ * @return Index of the interface in the ifs of the table, the if_id of the
+ *         originators reached through it.
+ *
+ * @retval -1 No originator of the table is reached through the interface.
+ */
+int
+mu_badv_orig_table_if_id(const struct mu_badv_orig_table *const table,
+                         const char                      *const interface_name)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the first k originators of a bat interface in an order.
+ *
+ * Reads the originators file once without building a table. first_hop of the
+ * originators returned is 0 and if_id is MU_BADV_IF_NONE; n_hops is set.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param  order          [in]  Which originators come first.
+ * @param  neighbors_only [in]  Only originators which are their own next hop.
+ * @param *top            [out] Room for k originators, in order.
+ * @param  k              [in]  Most originators returned.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @return Number of originators stored in top, at most k.
+ *
+ * @retval 0 Returned on failure as well.
+ */
+size_t
+mu_badv_orig_top_k(const char                      *const interface_name,
+                   const enum   mu_badv_top_order         order,
+                   const bool                             neighbors_only,
+                         struct mu_badv_originator *const top,
+                   const size_t                           k,
+                         int                       *const error)
+__attribute__ ((visibility("default")));
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DECLARATIONS                                          *
+*******************************************************************************/
+
+/**
+ * @brief PRIVATE Parse an originators table held in memory.
+ *
+ * @param *buffer [in]  NUL terminated table contents.
+ * @param  length [in]  Length of the contents.
+ * @param *error  [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the table. Has to be released with
+ *         mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_orig_table_parse(const char   *const buffer,
+                          const size_t        length,
+                                int    *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Allocate an empty table with room for the given entries.
+ *
+ * @return Pointer to the table with n_originators and n_hops set to zero.
+ *
+ * @retval NULL Returned on failure, error is set from errno.
+ */
+struct mu_badv_orig_table
+*mu_badv_orig_table_alloc(const size_t        max_originators,
+                          const size_t        max_hops,
+                                int    *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Copy a table together with its index.
+ *
+ * Failing to copy the index is not an error; the copy is then not indexed.
+ *
+ * @return Pointer to the copy. Has to be released with
+ *         mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure, error is set from errno.
+ */
+struct mu_badv_orig_table
+*mu_badv_orig_table_copy(const struct mu_badv_orig_table *const table,
+                               int                       *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Number the outgoing interfaces of a table and sum them up.
+ *
+ * Sets if_id of every originator and the ifs of the table from outgoing_if,
+ * for tables not built by the parser.
+ */
+void
+mu_badv_orig_table_count_ifs(struct mu_badv_orig_table *const table)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Find an originator through the index of a table.
+ *
+ * @return Pointer to the originator entry, owned by the table.
+ *
+ * @retval NULL The originator is not in the table.
+ */
+const struct mu_badv_originator
+*mu_badv_orig_index_find(const struct mu_badv_orig_table *const table,
+                         const struct mu_mac_addr        *const mac_addr)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Copy the index of a table.
+ *
+ * @retval NULL Returned on failure, error is set from errno.
+ */
+const struct mu_badv_orig_index
+*mu_badv_orig_index_copy(const struct mu_badv_orig_index *const index,
+                               int                       *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Release the index of a table.
+ */
+void
+mu_badv_orig_index_free(const struct mu_badv_orig_index *const index)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Read the originator table of an interface.
+ *
+ * Copies an attached shared memory snapshot or parses the table in debugfs.
+ *
+ * @return Pointer to the table. Has to be released with
+ *         mu_badv_orig_table_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_orig_table_load(const char *const interface_name,
+                               int  *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Index a table which answers several lookups if
+ *        mu_badv_set_orig_index() is on.
+ */
+void
+mu_badv_orig_table_index_reused(struct mu_badv_orig_table *const table)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Get the originator table the API functions are answered from.
+ *
+ * The table comes from the cache if it is on for the interface, or from a
+ * read shared with concurrent callers (see pg_batman_adv_cache), so it must
+ * not be modified.
+ *
+ * @return Pointer to the table. Has to be handed back with
+ *         mu_badv_orig_table_release().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_orig_table
+*mu_badv_orig_table_acquire(const char *const interface_name,
+                                  int  *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Hand back a table got from mu_badv_orig_table_acquire().
+ */
+void
+mu_badv_orig_table_release(struct mu_badv_orig_table *const table)
+__attribute__ ((visibility("hidden")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_ORIGINATORS_H */
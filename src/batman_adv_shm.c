@@ -0,0 +1,885 @@
+/** @file batman_adv_shm.c
+ * meshutil API implementation for sharing B.A.T.M.A.N. advanced originator
+ * tables between processes
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_shm_impl   Shared memory snapshot implementation
+ *
+ * Segment layout:
+ *
+ *     +--------------------+ 0
+ *     | struct shm_header  |
+ *     +--------------------+ SHM_DATA_OFFSET
+ *     | interfaces         | MU_BADV_MAX_IFS * sizeof(struct mu_badv_if_stats)
+ *     +--------------------+ SHM_ENTRIES_OFFSET
+ *     | originators        | n_originators * sizeof(struct mu_badv_originator)
+ *     +--------------------+ aligned to 8 bytes
+ *     | hops               | n_hops * sizeof(struct mu_badv_hop)
+ *     +--------------------+
+ *
+ * The entries are stored exactly as in a struct mu_badv_orig_table, so
+ * publishing and copying a table are three memcpy() calls each. Lookups of a
+ * single originator scan the entries in place. The layout version changes
+ * whenever those structs change.
+ *
+ * The segment only grows. A reader maps the size it saw when attaching and
+ * maps the segment again when a snapshot does not fit, or when the segment
+ * was unlinked by a stopped publisher and a new one may have been created.
+ * Those are the only system calls on the read path.
+ *
+ * Mappings are reference counted. The attachments mutex is only held to take
+ * or drop a reference, readers follow the sequence lock without it. A mapping
+ * replaced while readers still use it is unmapped by the last of them.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batman_adv_debugfs.h"
+#include "batman_adv_originators.h"
+#include "batman_adv_shm.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Prefix of the shared memory segment names, followed by the interface name.
+#define SHM_NAME_PREFIX "/meshutil-badv-"
+
+#define SHM_MAGIC 0x4d554241u           // "MUBA"
+
+/// Increment whenever struct mu_badv_originator, mu_badv_hop or
+/// mu_badv_if_stats change.
+#define SHM_LAYOUT_VERSION 2
+
+#define SHM_DATA_OFFSET 64
+
+#define SHM_ENTRIES_OFFSET \
+   (SHM_DATA_OFFSET + ((MU_BADV_MAX_IFS * sizeof(struct mu_badv_if_stats) \
+                        + 7) & ~(size_t) 7))
+
+/// Initial size of a segment.
+#define SHM_MIN_SIZE 4096
+
+/// Time before giving up on a publisher stuck in a write.
+#define SHM_READ_TIMEOUT_MS 100
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/** Header at the start of a segment. seq is odd while a snapshot is being
+ *  written. generation is 0 until the first snapshot and after the publisher
+ *  has stopped.
+ */
+struct shm_header {
+   uint32_t magic;
+   uint32_t layout_version;
+   uint32_t seq;
+   uint32_t metric_type;
+   uint64_t generation;
+   uint64_t n_originators;
+   uint64_t n_hops;
+   uint64_t published_secs;             ///< CLOCK_REALTIME of the snapshot.
+   uint32_t n_ifs;
+};
+
+struct mu_badv_shm_publisher {
+   char              *name;
+   char               interface_name[MU_IF_NAME_LEN];
+   int                fd;
+   size_t             size;
+   struct shm_header *header;
+};
+
+/// A mapping of a segment, NULL header while the segment is empty.
+struct shm_mapping {
+          int                fd;
+          size_t             size;
+   const  struct shm_header *header;
+          unsigned int       users;    ///< The attachment and its readers.
+};
+
+/// An attached interface, kept in a list per process.
+struct shm_attachment {
+          char                   interface_name[MU_IF_NAME_LEN];
+   struct shm_mapping           *mapping;
+   struct shm_attachment        *next;
+};
+
+/// The entries of a snapshot as seen by a reader, inside the mapping.
+struct shm_view {
+          enum mu_badv_metric_type   metric_type;
+          size_t                     n_originators;
+          size_t                     n_hops;
+          size_t                     n_ifs;
+   const  struct mu_badv_originator *originators;
+   const  struct mu_badv_hop        *hops;
+   const  struct mu_badv_if_stats   *ifs;
+};
+
+/** Reads a view. Called again whenever the view turned out to be torn, so it
+ *  must not keep anything from an earlier call but allocations. Returns false
+ *  on an error, which ends the read.
+ */
+typedef bool (*shm_read_fn)(const struct shm_view *view, void *ctx);
+
+/// Context of copy_view().
+struct shm_copy {
+   struct mu_badv_orig_table *table;
+   int                       *error;
+};
+
+/// Context of find_view().
+struct shm_find {
+   const  struct mu_mac_addr        *mac_addr;
+   struct mu_badv_originator        *originator;
+          bool                       found;
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+static pthread_mutex_t        attachments_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct shm_attachment *attachments       = NULL;
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static size_t aligned_size(const size_t size)
+{
+   return (size + 7) & ~(size_t) 7;
+}
+
+static size_t data_size(const uint64_t n_originators, const uint64_t n_hops)
+{
+   return SHM_ENTRIES_OFFSET
+          + aligned_size(n_originators * sizeof(struct mu_badv_originator))
+          + n_hops * sizeof(struct mu_badv_hop);
+}
+
+static const char *default_if(const char *const interface_name)
+{
+   return interface_name ? interface_name : BATMAN_ADV_DEFAULT_IF;
+}
+
+static char *segment_name(const char *const interface_name, int *const error)
+{
+   const char *ifname = default_if(interface_name);
+   char       *name   = NULL;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+   if (strchr(ifname, '/')) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+
+   name = mu_calloc(strlen(SHM_NAME_PREFIX) + strlen(ifname) + 1, sizeof(char));
+   if (!name) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+   strcat(name, SHM_NAME_PREFIX);
+   strcat(name, ifname);
+   return name;
+}
+
+/* Grows the segment to hold at least size bytes and maps it again. The
+ * segment never shrinks, readers may still map the old size.
+ */
+static bool publisher_reserve(struct mu_badv_shm_publisher *const publisher,
+                              const size_t                        size,
+                                    int                    *const error)
+{
+   size_t  new_size = publisher->size ? publisher->size : SHM_MIN_SIZE;
+   void   *mapping  = NULL;
+
+   if (publisher->header && size <= publisher->size) {
+      return true;
+   }
+
+   while (new_size < size) {
+      new_size *= 2;
+   }
+
+   if (new_size > publisher->size
+       && ftruncate(publisher->fd, (off_t) new_size)) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+
+   mapping = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  publisher->fd, 0);
+   if (mapping == MAP_FAILED) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+
+   if (publisher->header) {
+      munmap(publisher->header, publisher->size);
+   }
+   publisher->header = mapping;
+   publisher->size   = new_size;
+   return true;
+}
+
+/* Writes a snapshot under the sequence lock. */
+static void publisher_write(      struct mu_badv_shm_publisher *const publisher,
+                            const struct mu_badv_orig_table    *const table)
+{
+   struct shm_header *header = publisher->header;
+   char              *data   = (char *) header + SHM_ENTRIES_OFFSET;
+   uint32_t           seq    = header->seq;
+   struct timespec    now;
+
+   clock_gettime(CLOCK_REALTIME, &now);
+
+   __atomic_store_n(&header->seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   header->metric_type    = (uint32_t) table->metric_type;
+   header->n_originators  = table->n_originators;
+   header->n_hops         = table->n_hops;
+   header->published_secs = (uint64_t) now.tv_sec;
+   header->n_ifs          = (uint32_t) table->n_ifs;
+   header->generation++;
+   memcpy((char *) header + SHM_DATA_OFFSET, table->ifs,
+          table->n_ifs * sizeof(struct mu_badv_if_stats));
+   memcpy(data, table->originators,
+          table->n_originators * sizeof(struct mu_badv_originator));
+   memcpy(data + aligned_size(table->n_originators
+                              * sizeof(struct mu_badv_originator)),
+          table->hops, table->n_hops * sizeof(struct mu_badv_hop));
+
+   __atomic_store_n(&header->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static uint64_t now_ms(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static void unmap(struct shm_mapping *const mapping)
+{
+   if (mapping->header) {
+      munmap((void *) mapping->header, mapping->size);
+   }
+   close(mapping->fd);
+   mu_free(mapping);
+}
+
+/* Opens a segment and maps all of it, unless it is still empty. */
+static struct shm_mapping *map(const char *const name, int *const error)
+{
+   struct shm_mapping *mapping = NULL;
+   struct stat         status;
+   void               *header  = NULL;
+
+   mapping = mu_calloc(1, sizeof(struct shm_mapping));
+   if (!mapping) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   mapping->fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+   if (mapping->fd < 0) {
+      MU_SET_ERROR(error, errno);
+      mu_free(mapping);
+      return NULL;
+   }
+
+   if (fstat(mapping->fd, &status)) {
+      MU_SET_ERROR(error, errno);
+      unmap(mapping);
+      return NULL;
+   }
+
+   if ((size_t) status.st_size >= SHM_DATA_OFFSET) {
+      header = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED,
+                    mapping->fd, 0);
+      if (header == MAP_FAILED) {
+         MU_SET_ERROR(error, errno);
+         unmap(mapping);
+         return NULL;
+      }
+      mapping->header = header;
+      mapping->size   = (size_t) status.st_size;
+   }
+
+   mapping->users = 1;
+   return mapping;
+}
+
+/// Called with the mutex held.
+static struct shm_attachment *find_attachment(const char *const interface_name)
+{
+   const char            *ifname     = default_if(interface_name);
+   struct shm_attachment *attachment = attachments;
+
+   while (attachment && strcmp(attachment->interface_name, ifname)) {
+      attachment = attachment->next;
+   }
+   return attachment;
+}
+
+/// Called with the mutex held.
+static void release_mapping(struct shm_mapping *const mapping)
+{
+   if (!--mapping->users) {
+      unmap(mapping);
+   }
+}
+
+static struct shm_mapping *acquire_mapping(const char *const interface_name)
+{
+   struct shm_attachment *attachment = NULL;
+   struct shm_mapping    *mapping    = NULL;
+
+   pthread_mutex_lock(&attachments_mutex);
+   attachment = find_attachment(interface_name);
+   if (attachment) {
+      mapping = attachment->mapping;
+      mapping->users++;
+   }
+   pthread_mutex_unlock(&attachments_mutex);
+   return mapping;
+}
+
+/* Implementation notes:
+ * - The segment is opened by name again, which also picks up a segment
+ *   created by a new publisher after the old one was unlinked.
+ * - If another reader replaced the mapping meanwhile, its mapping is used.
+ * - Returns NULL if the interface was detached or the segment is gone, old
+ *   is still held then.
+ */
+static struct shm_mapping *replace_mapping(
+   const char               *const interface_name,
+         struct shm_mapping *const old)
+{
+   struct shm_attachment *attachment = NULL;
+   struct shm_mapping    *mapping    = NULL;
+   char                  *name       = NULL;
+
+   name = segment_name(interface_name, NULL);
+   if (!name) {
+      return NULL;
+   }
+   mapping = map(name, NULL);
+   mu_free(name);
+   if (!mapping) {
+      return NULL;
+   }
+
+   pthread_mutex_lock(&attachments_mutex);
+   attachment = find_attachment(interface_name);
+   if (!attachment) {
+      release_mapping(mapping);
+      mapping = NULL;
+   } else if (attachment->mapping == old) {
+      attachment->mapping = mapping;
+      mapping->users++;
+      release_mapping(old);             // The reference of the attachment.
+      release_mapping(old);
+   } else {
+      release_mapping(mapping);
+      mapping = attachment->mapping;
+      mapping->users++;
+      release_mapping(old);
+   }
+   pthread_mutex_unlock(&attachments_mutex);
+   return mapping;
+}
+
+/* Whether the publisher of a mapping has unlinked its segment. */
+static bool unlinked(const struct shm_mapping *const mapping)
+{
+   struct stat status;
+
+   return !fstat(mapping->fd, &status) && !status.st_nlink;
+}
+
+/* Implementation notes:
+ * - Torn reads are detected by the sequence number and retried until
+ *   SHM_READ_TIMEOUT_MS have passed, so read may race with the publisher.
+ * - A stopped publisher leaves generation 0 behind. If its segment was
+ *   unlinked, a newly created one is mapped instead.
+ */
+static bool read_attached(const char  *const interface_name,
+                                shm_read_fn  read,
+                                void        *ctx)
+{
+   const struct shm_header *header   = NULL;
+   struct shm_mapping      *mapping  = NULL;
+   struct shm_mapping      *replaced = NULL;
+   struct shm_view          view;
+   uint64_t                 deadline = 0;
+   uint64_t                 n_originators;
+   uint64_t                 n_hops;
+   uint32_t                 n_ifs;
+   uint32_t                 seq;
+   bool                     answered = false;
+   bool                     remap    = false;
+
+   mapping = acquire_mapping(interface_name);
+   if (!mapping) {
+      return false;
+   }
+
+   for (unsigned int attempt = 0; ; attempt++) {
+      if (remap) {
+         remap    = false;
+         replaced = replace_mapping(interface_name, mapping);
+         if (!replaced) {
+            break;
+         }
+         mapping = replaced;
+      }
+      if (attempt) {
+         if (!deadline) {
+            deadline = now_ms() + SHM_READ_TIMEOUT_MS;
+         } else if (now_ms() >= deadline) {
+            break;
+         }
+         sched_yield();
+      }
+
+      header = mapping->header;
+      if (!header) {
+         if (attempt) {
+            break;                      // Still empty, nothing published.
+         }
+         remap = true;
+         continue;
+      }
+
+      seq = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+      if (seq & 1) {
+         continue;
+      }
+
+      if (header->magic != SHM_MAGIC
+          || header->layout_version != SHM_LAYOUT_VERSION) {
+         break;
+      }
+      if (!header->generation) {
+         if (__atomic_load_n(&header->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue;
+         }
+         if (attempt || !unlinked(mapping)) {
+            break;
+         }
+         remap = true;
+         continue;
+      }
+
+      n_originators = header->n_originators;
+      n_hops        = header->n_hops;
+      n_ifs         = header->n_ifs;
+      view.metric_type = (enum mu_badv_metric_type) header->metric_type;
+      if (n_ifs > MU_BADV_MAX_IFS
+          || data_size(n_originators, n_hops) > mapping->size) {
+         if (__atomic_load_n(&header->seq, __ATOMIC_ACQUIRE) == seq) {
+            remap = n_ifs <= MU_BADV_MAX_IFS;
+            if (!remap) {
+               break;
+            }
+         }
+         continue;
+      }
+
+      view.n_originators = (size_t) n_originators;
+      view.n_hops        = (size_t) n_hops;
+      view.n_ifs         = n_ifs;
+      view.ifs           = (const void *) ((const char *) header
+                                           + SHM_DATA_OFFSET);
+      view.originators   = (const void *) ((const char *) header
+                                           + SHM_ENTRIES_OFFSET);
+      view.hops          = (const void *) ((const char *) view.originators
+                                           + aligned_size(n_originators
+                                              * sizeof(struct
+                                                       mu_badv_originator)));
+      if (!read(&view, ctx)) {
+         answered = true;
+         break;
+      }
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&header->seq, __ATOMIC_RELAXED) == seq) {
+         answered = true;
+         break;
+      }
+   }
+
+   pthread_mutex_lock(&attachments_mutex);
+   release_mapping(mapping);
+   pthread_mutex_unlock(&attachments_mutex);
+   return answered;
+}
+
+/* Implementation notes:
+ * - The table is allocated for the counts seen in the first pass and only
+ *   reallocated when a later snapshot is larger.
+ */
+static bool copy_view(const struct shm_view *const view, void *ctx)
+{
+   struct shm_copy           *copy  = ctx;
+   struct mu_badv_orig_table *table = copy->table;
+
+   if (!table || view->n_originators > table->n_originators
+       || view->n_hops > table->n_hops) {
+      mu_badv_orig_table_free(table);
+      copy->table = table = mu_badv_orig_table_alloc(view->n_originators,
+                                                     view->n_hops,
+                                                     copy->error);
+      if (!table) {
+         return false;
+      }
+   }
+
+   memcpy(table->ifs, view->ifs, view->n_ifs * sizeof(struct mu_badv_if_stats));
+   memcpy(table->originators, view->originators,
+          view->n_originators * sizeof(struct mu_badv_originator));
+   memcpy(table->hops, view->hops, view->n_hops * sizeof(struct mu_badv_hop));
+
+   table->metric_type   = view->metric_type;
+   table->n_originators = view->n_originators;
+   table->n_hops        = view->n_hops;
+   table->n_ifs         = view->n_ifs;
+   return true;
+}
+
+static bool find_view(const struct shm_view *const view, void *ctx)
+{
+   struct shm_find *find = ctx;
+
+   find->found = false;
+   for (size_t i = 0; i < view->n_originators; i++) {
+      if (mu_mac_addr_equal(&view->originators[i].mac_addr, find->mac_addr)) {
+         *find->originator = view->originators[i];
+         find->found       = true;
+         break;
+      }
+   }
+   return true;
+}
+
+static bool count_view(const struct shm_view *const view, void *ctx)
+{
+   *(size_t *) ctx = view->n_originators;
+   return true;
+}
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DEFINITIONS                                           *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Checking the attachment list is the only cost when nothing is attached.
+ */
+bool mu_badv_shm_snapshot(const char                       *const interface_name,
+                                struct mu_badv_orig_table **const table,
+                                int                        *const error)
+{
+   struct shm_copy copy = {NULL, error};
+
+   if (!read_attached(interface_name, copy_view, &copy)) {
+      mu_badv_orig_table_free(copy.table);
+      return false;
+   }
+   *table = copy.table;
+   return true;
+}
+
+bool mu_badv_shm_find(const char                      *const interface_name,
+                      const struct mu_mac_addr        *const mac_addr,
+                            struct mu_badv_originator *const originator,
+                            bool                      *const found)
+{
+   struct shm_find find = {mac_addr, originator, false};
+
+   if (!read_attached(interface_name, find_view, &find)) {
+      return false;
+   }
+   *found = find.found;
+   return true;
+}
+
+bool mu_badv_shm_count(const char   *const interface_name,
+                             size_t *const n_originators)
+{
+   return read_attached(interface_name, count_view, n_originators);
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - A write lock on the segment keeps out other publishers. A segment left
+ *   behind by a crashed publisher is reused.
+ */
+struct mu_badv_shm_publisher *mu_badv_shm_publisher_new(
+   const char *const interface_name,
+         int  *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const  char                  *ifname    = default_if(interface_name);
+   struct mu_badv_shm_publisher *publisher = NULL;
+   struct flock                  lock;
+   struct stat                   status;
+
+   if (strlen(ifname) >= MU_IF_NAME_LEN) {
+      MU_SET_ERROR(error, ENAMETOOLONG);
+      return NULL;
+   }
+
+   publisher = mu_calloc(1, sizeof(struct mu_badv_shm_publisher));
+   if (!publisher) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+   publisher->fd = -1;
+   strcpy(publisher->interface_name, ifname);
+
+   publisher->name = segment_name(interface_name, error);
+   if (!publisher->name) {
+      mu_free(publisher);
+      return NULL;
+   }
+
+   publisher->fd = shm_open(publisher->name, O_RDWR | O_CREAT | O_CLOEXEC,
+                            0644);
+   if (publisher->fd < 0) {
+      MU_SET_ERROR(error, errno);
+      mu_free(publisher->name);
+      mu_free(publisher);
+      return NULL;
+   }
+
+   memset(&lock, 0, sizeof(lock));
+   lock.l_type   = F_WRLCK;
+   lock.l_whence = SEEK_SET;
+   if (fcntl(publisher->fd, F_SETLK, &lock)) {
+      MU_SET_ERROR(error, (errno == EAGAIN || errno == EACCES) ? EBUSY : errno);
+      close(publisher->fd);
+      mu_free(publisher->name);
+      mu_free(publisher);
+      return NULL;
+   }
+
+   if (fstat(publisher->fd, &status)) {
+      MU_SET_ERROR(error, errno);
+      status.st_size = -1;
+   }
+   publisher->size = (size_t) status.st_size;
+   if (status.st_size < 0 || !publisher_reserve(publisher, SHM_MIN_SIZE, error)) {
+      close(publisher->fd);
+      mu_free(publisher->name);
+      mu_free(publisher);
+      return NULL;
+   }
+
+   __atomic_store_n(&publisher->header->generation, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&publisher->header->seq,
+                    (publisher->header->seq + 1) & ~1u, __ATOMIC_RELAXED);
+   publisher->header->layout_version = SHM_LAYOUT_VERSION;
+   __atomic_store_n(&publisher->header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+   return publisher;
+}
+
+/* Implementation notes:
+ * - Reads debugfs directly, never an attached snapshot of the same process.
+ */
+bool mu_badv_shm_publish(struct mu_badv_shm_publisher *const publisher,
+                         int                          *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_orig_table *table  = NULL;
+   char                      *buffer = NULL;
+   size_t                     length = 0;
+   bool                       ok     = false;
+
+   if (!publisher) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_CALL_START(publisher->interface_name);
+   buffer = mu_badv_debugfs_read_table(publisher->interface_name,
+                                       BATMAN_ADV_ORIGINATORS_TABLE,
+                                       &length, error);
+   if (!buffer) {
+      MU_TRACE_CALL_DONE(publisher->interface_name, error);
+      return false;
+   }
+
+   table = mu_badv_orig_table_parse(buffer, length, error);
+   mu_free(buffer);
+   if (!table) {
+      MU_TRACE_CALL_DONE(publisher->interface_name, error);
+      return false;
+   }
+
+   if (publisher_reserve(publisher,
+                         data_size(table->n_originators, table->n_hops),
+                         error)) {
+      publisher_write(publisher, table);
+      ok = true;
+   }
+
+   mu_badv_orig_table_free(table);
+   MU_TRACE_CALL_DONE(publisher->interface_name, error);
+   return ok;
+}
+
+/* Implementation notes:
+ * - Readers that are still attached see generation 0 and use debugfs.
+ */
+void mu_badv_shm_publisher_free(struct mu_badv_shm_publisher *const publisher)
+{
+   uint32_t seq;
+
+   if (!publisher) {
+      return;
+   }
+
+   seq = publisher->header->seq;
+   __atomic_store_n(&publisher->header->seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   publisher->header->generation = 0;
+   __atomic_store_n(&publisher->header->seq, seq + 2, __ATOMIC_RELEASE);
+
+   munmap(publisher->header, publisher->size);
+   shm_unlink(publisher->name);
+   close(publisher->fd);
+   mu_free(publisher->name);
+   mu_free(publisher);
+}
+
+/* Implementation notes:
+ * - An empty segment is mapped by the first read after it was published.
+ */
+bool mu_badv_shm_attach(const char *const interface_name, int *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct shm_attachment *attachment = NULL;
+   struct shm_mapping    *mapping    = NULL;
+   char                  *name       = NULL;
+
+   pthread_mutex_lock(&attachments_mutex);
+   attachment = find_attachment(interface_name);
+   pthread_mutex_unlock(&attachments_mutex);
+   if (attachment) {
+      return true;
+   }
+
+   name = segment_name(interface_name, error);
+   if (!name) {
+      return false;
+   }
+
+   mapping = map(name, error);
+   mu_free(name);
+   if (!mapping) {
+      return false;
+   }
+
+   attachment = mu_calloc(1, sizeof(struct shm_attachment));
+   if (!attachment) {
+      MU_SET_ERROR(error, errno);
+      unmap(mapping);
+      return false;
+   }
+   strcpy(attachment->interface_name, default_if(interface_name));
+   attachment->mapping = mapping;
+
+   pthread_mutex_lock(&attachments_mutex);
+   if (find_attachment(interface_name)) {
+      release_mapping(mapping);
+      mu_free(attachment);
+   } else {
+      attachment->next = attachments;
+      attachments      = attachment;
+   }
+   pthread_mutex_unlock(&attachments_mutex);
+   return true;
+}
+
+/* Implementation notes:
+ * - Readers still using the mapping unmap it when they are done.
+ */
+void mu_badv_shm_detach(const char *const interface_name)
+{
+   struct shm_attachment **link       = &attachments;
+   struct shm_attachment  *attachment = NULL;
+   const  char            *ifname     = default_if(interface_name);
+
+   pthread_mutex_lock(&attachments_mutex);
+   while (*link) {
+      if (!strcmp((*link)->interface_name, ifname)) {
+         attachment = *link;
+         *link      = attachment->next;
+         release_mapping(attachment->mapping);
+         mu_free(attachment);
+         break;
+      }
+      link = &(*link)->next;
+   }
+   pthread_mutex_unlock(&attachments_mutex);
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,220 @@
+/** @file batman_adv_shm.h
+ * meshutil API for sharing B.A.T.M.A.N. advanced originator tables between
+ * processes
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_shm   Shared memory snapshots
+ *
+ * When several processes on a node query the same bat interface each of them
+ * reads and parses the originators file. Instead, one process can publish the
+ * parsed originator table in a POSIX shared memory segment
+ * (/dev/shm/meshutil-badv-<interface>) and the other processes attach to it.
+ *
+ * Publisher:
+ *
+ *     publisher = mu_badv_shm_publisher_new("bat0", &error);
+ *     while (running) {
+ *        mu_badv_shm_publish(publisher, &error);
+ *        sleep(1);
+ *     }
+ *     mu_badv_shm_publisher_free(publisher);
+ *
+ * Reader:
+ *
+ *     mu_badv_shm_attach("bat0", &error);
+ *     n_nodes = mu_badv_mesh_n_nodes("bat0", &error); // No debugfs access.
+ *
+ * After attaching, all originator based functions of the batman_adv API and
+ * mu_badv_orig_table_read answer from the latest published snapshot without
+ * system calls. Until the first snapshot is published they read debugfs.
+ *
+ * The segment holds a flat, pointer-free copy of the table guarded by a
+ * sequence lock: the publisher makes the sequence number odd while writing
+ * and even again when done, readers copy the snapshot and retry if the
+ * sequence number was odd or changed meanwhile. Queries about a single node
+ * and the node count are answered from the segment without copying the
+ * table. Readers map the segment read only and never block the publisher.
+ * Within a process a reader takes a mutex only to reference the mapping
+ * before the read and to drop it afterwards; no lock is held across the
+ * sequence lock read itself. Only one publisher per interface is allowed at
+ * a time.
+ *
+ * A reader gives up on a publisher stuck in a write after 100 ms and reads
+ * debugfs. When a publisher is stopped and another one started, attached
+ * readers switch to the new segment on their next query.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_SHM_H
+#define MESHUTIL_BATMAN_ADV_SHM_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+
+#include "batman_adv_originators.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Opaque handle of a snapshot publisher.
+struct mu_badv_shm_publisher;
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Create the shared memory segment of a bat interface for publishing.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *                              EBUSY if another process is publishing,
+ *                              ENAMETOOLONG for a name of MU_IF_NAME_LEN
+ *                              or more characters.
+ *
+ * @return Pointer to the publisher. Has to be released with
+ *         mu_badv_shm_publisher_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_shm_publisher
+*mu_badv_shm_publisher_new(const char *const interface_name, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Read the originators table from debugfs and publish it.
+ *
+ * @param *publisher [in]  The publisher.
+ * @param *error     [out] For setting error codes on function failure.
+ *
+ * @retval true  A new snapshot was published.
+ * @retval false An error occurred, the previous snapshot stays valid.
+ */
+bool
+mu_badv_shm_publish(struct mu_badv_shm_publisher *const publisher,
+                    int                          *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Stop publishing and remove the shared memory segment.
+ *
+ * Attached readers fall back to reading debugfs.
+ */
+void
+mu_badv_shm_publisher_free(struct mu_badv_shm_publisher *const publisher)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Answer queries on a bat interface from its shared memory segment.
+ *
+ * Attaching an already attached interface does nothing.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *error          [out] For setting error codes on function failure.
+ *                              ENOENT if nobody publishes the interface,
+ *                              ENAMETOOLONG for a name of MU_IF_NAME_LEN
+ *                              or more characters.
+ *
+ * @retval true  The interface is attached.
+ * @retval false An error occurred.
+ */
+bool
+mu_badv_shm_attach(const char *const interface_name, int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Detach a bat interface, queries read debugfs again.
+ */
+void
+mu_badv_shm_detach(const char *const interface_name)
+__attribute__ ((visibility("default")));
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DECLARATIONS                                          *
+*******************************************************************************/
+
+/**
+ * @brief PRIVATE Copy the latest snapshot of an attached interface.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param **table         [out] The copied table, NULL on error.
+ * @param *error          [out] For setting error codes on function failure.
+ *
+ * @retval true  The interface is attached and has a snapshot, table was set.
+ * @retval false No snapshot available, the caller has to read debugfs.
+ */
+bool
+mu_badv_shm_snapshot(const char                       *const interface_name,
+                           struct mu_badv_orig_table **const table,
+                           int                        *const error)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Look up one originator in the latest snapshot of an attached
+ *        interface.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *mac_addr       [in]  Address of the originator.
+ * @param *originator     [out] Copy of the originator if found.
+ * @param *found          [out] Whether the originator is in the snapshot.
+ *
+ * @retval true  The interface is attached and has a snapshot, found was set.
+ * @retval false No snapshot available, the caller has to read debugfs.
+ */
+bool
+mu_badv_shm_find(const char                      *const interface_name,
+                 const struct mu_mac_addr        *const mac_addr,
+                       struct mu_badv_originator *const originator,
+                       bool                      *const found)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Count the originators in the latest snapshot of an attached
+ *        interface.
+ *
+ * @param *interface_name [in]  Name of the bat interface.
+ * @param *n_originators  [out] Number of originators.
+ *
+ * @retval true  The interface is attached and has a snapshot.
+ * @retval false No snapshot available, the caller has to read debugfs.
+ */
+bool
+mu_badv_shm_count(const char   *const interface_name,
+                        size_t *const n_originators)
+__attribute__ ((visibility("hidden")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_SHM_H */
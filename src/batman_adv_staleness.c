@@ -0,0 +1,669 @@
+/** @file batman_adv_staleness.c
+ * meshutil API implementation for alerting on B.A.T.M.A.N. advanced nodes not
+ * seen for long
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_staleness_impl   Staleness watcher implementation
+ *
+ * Nodes are numbered in the order they are first seen and found by address
+ * through a hash table of node numbers with linear probing, at most half
+ * full, as in the topology.
+ *
+ * Deadlines are kept in a hierarchical timer wheel of WHEEL_LEVELS levels of
+ * WHEEL_BUCKETS buckets each, counting in ticks of the resolution. A node due
+ * in less than 64 ticks is in the bucket of level 0 for its tick, one due in
+ * less than 64 * 64 ticks in the bucket of level 1 for its block of 64 ticks,
+ * and so on. Whenever the wheel reaches the start of such a block, the nodes
+ * of the bucket of the next level up are moved down, which every node does at
+ * most WHEEL_LEVELS times. Deadlines beyond the last level wait in its
+ * furthest bucket and are placed again when they come down to level 0.
+ *
+ * Buckets are doubly linked lists of node numbers, so a node is moved in
+ * constant time when an update changes its deadline. A bit mask per level
+ * marks the buckets holding nodes, so advancing skips over empty ticks to the
+ * next occupied bucket or block start instead of visiting every tick.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "batman_adv_staleness.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Smallest number of hash table slots allocated.
+#define STALENESS_MIN_SLOTS 64
+
+/// Log2 of the number of buckets per level, one bit of the occupied masks each.
+#define WHEEL_BITS    6
+#define WHEEL_BUCKETS (1u << WHEEL_BITS)
+#define WHEEL_MASK    (WHEEL_BUCKETS - 1)
+#define WHEEL_LEVELS  4
+
+/// Ticks until the furthest deadline the wheel holds.
+#define WHEEL_SPAN    ((uint64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+/// No node.
+#define NODE_NONE   UINT32_MAX
+
+/// Not in any bucket.
+#define BUCKET_NONE UINT32_MAX
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct watch_node {
+   struct mu_mac_addr mac_addr;
+          uint32_t    level;
+          uint64_t    last_seen_ms;
+          uint64_t    expires;         ///< Tick of the next deadline.
+          uint32_t    bucket;          ///< Level * WHEEL_BUCKETS + bucket.
+          uint32_t    next;            ///< In the bucket.
+          uint32_t    prev;
+};
+
+struct mu_badv_staleness {
+          uint32_t         *thresholds_ms;
+          uint32_t          n_thresholds;
+          uint32_t          hysteresis_ms;
+          uint32_t          resolution_ms;
+          mu_badv_stale_fn  fn;
+          void             *ctx;
+   struct watch_node       *nodes;
+          uint32_t          n_nodes;
+          uint32_t          max_nodes;
+          uint32_t         *slots;     ///< Node number + 1, 0 if free.
+          size_t            slot_mask;
+          bool              started;
+          uint64_t          tick;      ///< Deadlines up to it are handled.
+          uint64_t          occupied[WHEEL_LEVELS];
+          uint32_t          buckets[WHEEL_LEVELS * WHEEL_BUCKETS];
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static size_t mac_hash(const struct mu_mac_addr *const mac_addr)
+{
+   uint32_t low  = 0;
+   uint16_t high = 0;
+   uint64_t key  = 0;
+
+   memcpy(&low, mac_addr->octet, sizeof(low));
+   memcpy(&high, mac_addr->octet + sizeof(low), sizeof(high));
+   key  = (uint64_t) high << 32 | low;
+   key ^= key >> 33;
+   key *= 0xff51afd7ed558ccdULL;
+   key ^= key >> 33;
+   return (size_t) key;
+}
+
+static uint32_t find_node(const struct mu_badv_staleness *const watcher,
+                          const struct mu_mac_addr       *const mac_addr)
+{
+   size_t   slot = mac_hash(mac_addr) & watcher->slot_mask;
+   uint32_t id   = 0;
+
+   while ((id = watcher->slots[slot])) {
+      if (mu_mac_addr_equal(&watcher->nodes[id - 1].mac_addr, mac_addr)) {
+         return id - 1;
+      }
+      slot = (slot + 1) & watcher->slot_mask;
+   }
+   return NODE_NONE;
+}
+
+/// Makes room for n nodes in the nodes and the hash table.
+static bool reserve_nodes(struct mu_badv_staleness *const watcher,
+                          const size_t                    n,
+                          int                      *const error)
+{
+   size_t             n_slots = watcher->slot_mask + 1;
+   size_t             max     = watcher->max_nodes ? watcher->max_nodes : 4;
+   uint32_t          *slots   = NULL;
+   struct watch_node *nodes   = NULL;
+   size_t             slot;
+
+   if (n >= NODE_NONE) {
+      MU_SET_ERROR(error, EOVERFLOW);
+      return false;
+   }
+
+   if (n > watcher->max_nodes) {
+      while (max < n) {
+         max *= 2;
+      }
+      if (max >= NODE_NONE) {
+         max = NODE_NONE - 1;
+      }
+      nodes = mu_realloc(watcher->nodes, max * sizeof(struct watch_node));
+      if (!nodes) {
+         MU_SET_ERROR(error, errno);
+         return false;
+      }
+      watcher->nodes     = nodes;
+      watcher->max_nodes = (uint32_t) max;
+   }
+
+   if (n * 2 <= n_slots) {
+      return true;
+   }
+   while (n * 2 > n_slots) {
+      n_slots *= 2;
+   }
+   slots = mu_calloc(n_slots, sizeof(uint32_t));
+   if (!slots) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+   for (uint32_t id = 0; id < watcher->n_nodes; id++) {
+      slot = mac_hash(&watcher->nodes[id].mac_addr) & (n_slots - 1);
+      while (slots[slot]) {
+         slot = (slot + 1) & (n_slots - 1);
+      }
+      slots[slot] = id + 1;
+   }
+   mu_free(watcher->slots);
+   watcher->slots     = slots;
+   watcher->slot_mask = n_slots - 1;
+   return true;
+}
+
+/// Called after reserve_nodes(), cannot fail.
+static uint32_t add_node(struct mu_badv_staleness *const watcher,
+                         const struct mu_mac_addr *const mac_addr)
+{
+   uint32_t           id   = watcher->n_nodes++;
+   struct watch_node *node = &watcher->nodes[id];
+   size_t             slot = mac_hash(mac_addr) & watcher->slot_mask;
+
+   memset(node, 0, sizeof(struct watch_node));
+   node->mac_addr = *mac_addr;
+   node->bucket   = BUCKET_NONE;
+
+   while (watcher->slots[slot]) {
+      slot = (slot + 1) & watcher->slot_mask;
+   }
+   watcher->slots[slot] = id + 1;
+   return id;
+}
+
+/// Finds the hash table slot of a node.
+static size_t find_slot(const struct mu_badv_staleness *const watcher,
+                        const uint32_t                        id)
+{
+   size_t slot = mac_hash(&watcher->nodes[id].mac_addr) & watcher->slot_mask;
+
+   while (watcher->slots[slot] != id + 1) {
+      slot = (slot + 1) & watcher->slot_mask;
+   }
+   return slot;
+}
+
+/// Empties a hash table slot, shifting back the entries probed past it.
+static void free_slot(struct mu_badv_staleness *const watcher,
+                            size_t                    slot)
+{
+   size_t   next = slot;
+   size_t   home = 0;
+   uint32_t id   = 0;
+
+   watcher->slots[slot] = 0;
+   for (;;) {
+      next = (next + 1) & watcher->slot_mask;
+      if (!(id = watcher->slots[next])) {
+         return;
+      }
+      home = mac_hash(&watcher->nodes[id - 1].mac_addr) & watcher->slot_mask;
+      if (((next - home) & watcher->slot_mask)
+          >= ((next - slot) & watcher->slot_mask)) {
+         watcher->slots[slot] = id;
+         watcher->slots[next] = 0;
+         slot                 = next;
+      }
+   }
+}
+
+static void unlink_node(struct mu_badv_staleness *const watcher,
+                        const uint32_t                  id)
+{
+   struct watch_node *node = &watcher->nodes[id];
+
+   if (node->bucket == BUCKET_NONE) {
+      return;
+   }
+   if (node->prev != NODE_NONE) {
+      watcher->nodes[node->prev].next = node->next;
+   } else {
+      watcher->buckets[node->bucket] = node->next;
+      if (node->next == NODE_NONE) {
+         watcher->occupied[node->bucket / WHEEL_BUCKETS] &=
+            ~((uint64_t) 1 << (node->bucket & WHEEL_MASK));
+      }
+   }
+   if (node->next != NODE_NONE) {
+      watcher->nodes[node->next].prev = node->prev;
+   }
+   node->bucket = BUCKET_NONE;
+}
+
+/// Puts a node into the bucket for its deadline, which is not before tick.
+static void place_node(struct mu_badv_staleness *const watcher,
+                       const uint32_t                  id)
+{
+   struct watch_node *node   = &watcher->nodes[id];
+   uint64_t           at     = node->expires;
+   unsigned int       level  = 0;
+   uint32_t           bucket = 0;
+
+   if (at - watcher->tick >= WHEEL_SPAN) {
+      at = watcher->tick + WHEEL_SPAN - 1;
+   }
+   while (level < WHEEL_LEVELS - 1
+          && at - watcher->tick >= (uint64_t) 1 << (WHEEL_BITS * (level + 1))) {
+      level++;
+   }
+   bucket = level * WHEEL_BUCKETS
+            + (uint32_t) ((at >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+   node->bucket = bucket;
+   node->prev   = NODE_NONE;
+   node->next   = watcher->buckets[bucket];
+   if (node->next != NODE_NONE) {
+      watcher->nodes[node->next].prev = id;
+   }
+   watcher->buckets[bucket]  = id;
+   watcher->occupied[level] |= (uint64_t) 1 << (bucket & WHEEL_MASK);
+}
+
+/// Schedules the deadline of the next level of a node, if it has one.
+static void schedule(struct mu_badv_staleness *const watcher,
+                     const uint32_t                  id)
+{
+   struct watch_node *node     = &watcher->nodes[id];
+   uint64_t           deadline = 0;
+   uint64_t           expires  = 0;
+
+   if (node->level >= watcher->n_thresholds) {
+      unlink_node(watcher, id);
+      return;
+   }
+
+   deadline = node->last_seen_ms + watcher->thresholds_ms[node->level];
+   expires  = (deadline + watcher->resolution_ms - 1) / watcher->resolution_ms;
+   if (expires <= watcher->tick) {
+      expires = watcher->tick + 1;
+   }
+   if (node->bucket != BUCKET_NONE && node->expires == expires) {
+      return;
+   }
+   unlink_node(watcher, id);
+   node->expires = expires;
+   place_node(watcher, id);
+}
+
+/// Level of a node of the given age which had the given level before.
+static uint32_t level_for(const struct mu_badv_staleness *const watcher,
+                          const uint64_t                        age_ms,
+                                uint32_t                        level)
+{
+   while (level < watcher->n_thresholds
+          && age_ms >= watcher->thresholds_ms[level]) {
+      level++;
+   }
+   while (level > 0
+          && age_ms + watcher->hysteresis_ms < watcher->thresholds_ms[level - 1]) {
+      level--;
+   }
+   return level;
+}
+
+/// Sets the level of a node and calls the level function if it changed.
+static bool set_level(struct mu_badv_staleness *const watcher,
+                      const uint32_t                  id,
+                      const uint64_t                  now_ms)
+{
+   struct watch_node *node      = &watcher->nodes[id];
+   uint32_t           old_level = node->level;
+   uint64_t           age_ms    = 0;
+
+   if (now_ms > node->last_seen_ms) {
+      age_ms = now_ms - node->last_seen_ms;
+   }
+   node->level = level_for(watcher, age_ms, old_level);
+   if (node->level == old_level) {
+      return false;
+   }
+   watcher->fn(&node->mac_addr, node->level, old_level, node->last_seen_ms,
+               watcher->ctx);
+   return true;
+}
+
+/// Takes all nodes out of a bucket and returns the first one.
+static uint32_t take_bucket(struct mu_badv_staleness *const watcher,
+                            const unsigned int              level,
+                            const uint32_t                  index)
+{
+   uint32_t bucket = level * WHEEL_BUCKETS + index;
+   uint32_t first  = watcher->buckets[bucket];
+
+   watcher->buckets[bucket]  = NODE_NONE;
+   watcher->occupied[level] &= ~((uint64_t) 1 << index);
+   return first;
+}
+
+/// Moves the nodes of the buckets of the upper levels reached by tick down.
+static void cascade(struct mu_badv_staleness *const watcher)
+{
+   uint32_t id    = 0;
+   uint32_t next  = 0;
+   uint32_t index = 0;
+
+   for (unsigned int level = 1; level < WHEEL_LEVELS; level++) {
+      index = (uint32_t) (watcher->tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+      for (id = take_bucket(watcher, level, index); id != NODE_NONE;
+           id = next) {
+         next = watcher->nodes[id].next;
+         place_node(watcher, id);
+      }
+      if (index) {
+         break;
+      }
+   }
+}
+
+/// Handles the nodes due at tick and returns the number of levels raised.
+static size_t expire(struct mu_badv_staleness *const watcher,
+                     const uint64_t                  now_ms)
+{
+   uint32_t id     = 0;
+   uint32_t next   = 0;
+   size_t   raised = 0;
+
+   for (id = take_bucket(watcher, 0, (uint32_t) watcher->tick & WHEEL_MASK);
+        id != NODE_NONE; id = next) {
+      next = watcher->nodes[id].next;
+      watcher->nodes[id].bucket = BUCKET_NONE;
+      if (watcher->nodes[id].expires > watcher->tick) {
+         place_node(watcher, id);
+         continue;
+      }
+      if (set_level(watcher, id, now_ms)) {
+         raised++;
+      }
+      schedule(watcher, id);
+   }
+   return raised;
+}
+
+static void start(struct mu_badv_staleness *const watcher,
+                  const uint64_t                  now_ms)
+{
+   if (!watcher->started) {
+      watcher->started = true;
+      watcher->tick    = now_ms / watcher->resolution_ms;
+   }
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_staleness
+*mu_badv_staleness_new(const uint32_t         *const thresholds_ms,
+                       const size_t                  n_thresholds,
+                       const uint32_t                hysteresis_ms,
+                       const uint32_t                resolution_ms,
+                             mu_badv_stale_fn        fn,
+                             void                   *ctx,
+                             int                    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_staleness *watcher = NULL;
+
+   if (!thresholds_ms || !n_thresholds || n_thresholds > UINT32_MAX || !fn) {
+      MU_SET_ERROR(error, EINVAL);
+      return NULL;
+   }
+   for (size_t i = 1; i < n_thresholds; i++) {
+      if (thresholds_ms[i] <= thresholds_ms[i - 1]) {
+         MU_SET_ERROR(error, EINVAL);
+         return NULL;
+      }
+   }
+
+   watcher = mu_calloc(1, sizeof(struct mu_badv_staleness));
+   if (!watcher) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+   watcher->thresholds_ms = mu_malloc(n_thresholds * sizeof(uint32_t));
+   watcher->slots         = mu_calloc(STALENESS_MIN_SLOTS, sizeof(uint32_t));
+   if (!watcher->thresholds_ms || !watcher->slots) {
+      MU_SET_ERROR(error, errno);
+      mu_badv_staleness_free(watcher);
+      return NULL;
+   }
+   memcpy(watcher->thresholds_ms, thresholds_ms,
+          n_thresholds * sizeof(uint32_t));
+   watcher->n_thresholds  = (uint32_t) n_thresholds;
+   watcher->hysteresis_ms = hysteresis_ms;
+   watcher->resolution_ms = resolution_ms ? resolution_ms
+                                          : MU_BADV_STALENESS_RESOLUTION_MS;
+   watcher->fn            = fn;
+   watcher->ctx           = ctx;
+   watcher->slot_mask     = STALENESS_MIN_SLOTS - 1;
+   for (size_t i = 0; i < WHEEL_LEVELS * WHEEL_BUCKETS; i++) {
+      watcher->buckets[i] = NODE_NONE;
+   }
+   return watcher;
+}
+
+void mu_badv_staleness_free(struct mu_badv_staleness *const watcher)
+{
+   if (!watcher) {
+      return;
+   }
+   mu_free(watcher->thresholds_ms);
+   mu_free(watcher->nodes);
+   mu_free(watcher->slots);
+   mu_free(watcher);
+}
+
+/* Implementation notes:
+ * - Room for every originator is reserved first, so the watcher is left
+ *   unchanged by a failure.
+ * - A last-seen time before the clock started counts as seen at time 0.
+ */
+bool mu_badv_staleness_update(      struct mu_badv_staleness  *const watcher,
+                              const struct mu_badv_orig_table *const table,
+                              const        uint64_t                  now_ms,
+                                           int                *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   const struct mu_badv_originator *originator = NULL;
+   uint32_t                         id         = 0;
+
+   if (!watcher || !table) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_INDEX_START("staleness", table->n_originators);
+   if (!reserve_nodes(watcher, (size_t) watcher->n_nodes
+                               + table->n_originators, error)) {
+      MU_TRACE_INDEX_DONE("staleness", table->n_originators, false);
+      return false;
+   }
+   start(watcher, now_ms);
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      originator = &table->originators[i];
+      id = find_node(watcher, &originator->mac_addr);
+      if (id == NODE_NONE) {
+         id = add_node(watcher, &originator->mac_addr);
+      }
+      watcher->nodes[id].last_seen_ms =
+         now_ms > originator->last_seen_msecs
+         ? now_ms - originator->last_seen_msecs : 0;
+      set_level(watcher, id, now_ms);
+      schedule(watcher, id);
+   }
+
+   MU_TRACE_INDEX_DONE("staleness", table->n_originators, true);
+   return true;
+}
+
+/* Implementation notes:
+ * - The last node takes the number of the removed one, so the nodes stay
+ *   dense. Its bucket neighbours and hash table slot are renumbered.
+ */
+bool mu_badv_staleness_remove(      struct mu_badv_staleness *const watcher,
+                              const struct mu_mac_addr       *const mac_addr)
+{
+   struct watch_node *node = NULL;
+   uint32_t           id   = NODE_NONE;
+   uint32_t           last = 0;
+
+   if (!watcher || !mac_addr) {
+      return false;
+   }
+   id = find_node(watcher, mac_addr);
+   if (id == NODE_NONE) {
+      return false;
+   }
+
+   unlink_node(watcher, id);
+   free_slot(watcher, find_slot(watcher, id));
+   last = --watcher->n_nodes;
+   if (id == last) {
+      return true;
+   }
+
+   node = &watcher->nodes[last];
+   if (node->bucket != BUCKET_NONE) {
+      if (node->prev != NODE_NONE) {
+         watcher->nodes[node->prev].next = id;
+      } else {
+         watcher->buckets[node->bucket] = id;
+      }
+      if (node->next != NODE_NONE) {
+         watcher->nodes[node->next].prev = id;
+      }
+   }
+   watcher->slots[find_slot(watcher, last)] = id + 1;
+   watcher->nodes[id] = *node;
+   return true;
+}
+
+/* Implementation notes:
+ * - Within a block of 64 ticks the next occupied bucket of level 0 is found
+ *   from the mask; without one the wheel jumps to the start of the next block,
+ *   where the upper levels are cascaded, or to the current tick.
+ */
+size_t mu_badv_staleness_advance(struct mu_badv_staleness *const watcher,
+                                 const uint64_t                  now_ms)
+{
+   uint64_t target  = 0;
+   uint64_t next    = 0;
+   uint64_t pending = 0;
+   uint32_t index   = 0;
+   size_t   raised  = 0;
+
+   if (!watcher) {
+      return 0;
+   }
+   if (!watcher->started) {
+      start(watcher, now_ms);
+      return 0;
+   }
+
+   target = now_ms / watcher->resolution_ms;
+   while (watcher->tick < target) {
+      index   = (uint32_t) watcher->tick & WHEEL_MASK;
+      pending = index == WHEEL_MASK
+                ? 0 : watcher->occupied[0] & (~(uint64_t) 0 << (index + 1));
+      if (pending) {
+         next = watcher->tick - index + (uint64_t) __builtin_ctzll(pending);
+      } else {
+         next = (watcher->tick | WHEEL_MASK) + 1;
+      }
+      if (next > target) {
+         watcher->tick = target;
+         break;
+      }
+
+      watcher->tick = next;
+      if (!(next & WHEEL_MASK)) {
+         cascade(watcher);
+      }
+      raised += expire(watcher, now_ms);
+   }
+   return raised;
+}
+
+int mu_badv_staleness_level(const struct mu_badv_staleness *const watcher,
+                            const struct mu_mac_addr       *const mac_addr,
+                                         uint64_t          *const last_seen_ms)
+{
+   uint32_t id = NODE_NONE;
+
+   if (!watcher || !mac_addr) {
+      return -1;
+   }
+   id = find_node(watcher, mac_addr);
+   if (id == NODE_NONE) {
+      return -1;
+   }
+   if (last_seen_ms) {
+      *last_seen_ms = watcher->nodes[id].last_seen_ms;
+   }
+   return (int) watcher->nodes[id].level;
+}
+
+size_t mu_badv_staleness_n_nodes(const struct mu_badv_staleness *const watcher)
+{
+   return watcher ? watcher->n_nodes : 0;
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,237 @@
+/** @file batman_adv_staleness.h
+ * meshutil API for alerting on B.A.T.M.A.N. advanced nodes not seen for long
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_staleness   Staleness watcher
+ *
+ * A staleness watcher calls a function when the time since a node was last
+ * seen crosses one of a list of ascending thresholds, e.g. to warn after 10
+ * seconds and alert after a minute:
+ *
+ *     static const uint32_t thresholds[] = {10000, 60000};
+ *
+ *     watcher = mu_badv_staleness_new(thresholds, 2, 2000, 0, on_level, ctx,
+ *                                     &error);
+ *     ...
+ *     // after every refresh of the originator table
+ *     mu_badv_staleness_update(watcher, table, now_ms, &error);
+ *     ...
+ *     // on every tick of the event loop
+ *     mu_badv_staleness_advance(watcher, now_ms);
+ *
+ * The level of a node is the number of thresholds its age reached. An update
+ * notes when each originator of the table was last seen and schedules the
+ * time its age reaches the next threshold in a timer wheel. Advancing the
+ * watcher raises the levels of the nodes whose time came, so a tick costs
+ * time in the number of nodes changing level, not in the size of the mesh.
+ * Nodes which dropped out of the table keep aging until the last threshold
+ * and stay watched, at their last level, until they are removed with
+ * mu_badv_staleness_remove(). A watcher of a mesh whose nodes come and go
+ * therefore grows without bound unless the caller removes nodes, e.g. once
+ * they reached the last level and were reported.
+ *
+ * Levels only drop in an update, when the node was seen again and its age is
+ * below the threshold of its level by more than the hysteresis. A node whose
+ * last-seen time jitters around a threshold therefore does not flap.
+ *
+ * Times are milliseconds on a monotonic clock of the caller's choice, e.g.
+ * CLOCK_MONOTONIC, and must not go back between calls. Deadlines are rounded
+ * up to the resolution of the wheel, so a level can be raised up to one
+ * resolution late but never early.
+ *
+ * A watcher is not thread-safe. The level function is called by update and
+ * advance on the calling thread and must not call them or remove itself.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_STALENESS_H
+#define MESHUTIL_BATMAN_ADV_STALENESS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Resolution of the timer wheel if none is given.
+#define MU_BADV_STALENESS_RESOLUTION_MS 100
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Opaque watcher of the ages of mesh nodes.
+struct mu_badv_staleness;
+
+/**
+ * Called when the level of a node changes.
+ *
+ * @param *mac_addr     Address of the node.
+ * @param  level        Number of thresholds the age of the node reached.
+ * @param  old_level    The level before.
+ * @param  last_seen_ms When the node was last seen.
+ * @param *ctx          As given to mu_badv_staleness_new().
+ */
+typedef void (*mu_badv_stale_fn)(const struct mu_mac_addr *mac_addr,
+                                 unsigned int              level,
+                                 unsigned int              old_level,
+                                 uint64_t                  last_seen_ms,
+                                 void                     *ctx);
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Create a staleness watcher.
+ *
+ * @param *thresholds_ms [in]  Ages raising the level, strictly ascending.
+ * @param  n_thresholds  [in]  Number of thresholds, at least one.
+ * @param  hysteresis_ms [in]  How far below the threshold of its level the
+ *                             age of a node has to be to lower the level.
+ * @param  resolution_ms [in]  Tick of the timer wheel, 0 for
+ *                             MU_BADV_STALENESS_RESOLUTION_MS.
+ * @param  fn            [in]  Called when the level of a node changes.
+ * @param *ctx           [in]  Passed to fn as is.
+ * @param *error         [out] For setting error codes on function failure.
+ *                             EINVAL if the thresholds are not ascending or
+ *                             fn is NULL.
+ *
+ * @return Pointer to the watcher. Has to be released with
+ *         mu_badv_staleness_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_staleness
+*mu_badv_staleness_new(const uint32_t         *const thresholds_ms,
+                       const size_t                  n_thresholds,
+                       const uint32_t                hysteresis_ms,
+                       const uint32_t                resolution_ms,
+                             mu_badv_stale_fn        fn,
+                             void                   *ctx,
+                             int                    *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release a staleness watcher.
+ */
+void
+mu_badv_staleness_free(struct mu_badv_staleness *const watcher)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Note the last-seen times of the originators of a table.
+ *
+ * Starts watching originators seen for the first time. Calls the level
+ * function for nodes whose level changed, then reschedules their deadlines.
+ *
+ * @param *watcher [in]  The staleness watcher.
+ * @param *table   [in]  The originator table.
+ * @param  now_ms  [in]  When the table was read.
+ * @param *error   [out] For setting error codes on function failure.
+ *
+ * @retval true  The watcher was updated.
+ * @retval false An error occurred. The watcher is unchanged.
+ */
+bool
+mu_badv_staleness_update(      struct mu_badv_staleness  *const watcher,
+                         const struct mu_badv_orig_table *const table,
+                         const        uint64_t                  now_ms,
+                                      int                *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Raise the levels of the nodes whose age reached a threshold.
+ *
+ * @param *watcher [in] The staleness watcher.
+ * @param  now_ms  [in] The current time.
+ *
+ * @return Number of nodes whose level was raised.
+ */
+size_t
+mu_badv_staleness_advance(struct mu_badv_staleness *const watcher,
+                          const uint64_t                  now_ms)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Stop watching a node.
+ *
+ * The node is forgotten; if it is in a later table it is watched again from
+ * level 0.
+ *
+ * @param *watcher  [in] The staleness watcher.
+ * @param *mac_addr [in] Address of the node.
+ *
+ * @retval true  The node was removed.
+ * @retval false The node was not watched.
+ */
+bool
+mu_badv_staleness_remove(      struct mu_badv_staleness *const watcher,
+                         const struct mu_mac_addr       *const mac_addr)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the level of a node.
+ *
+ * @param *watcher      [in]  The staleness watcher.
+ * @param *mac_addr     [in]  Address of the node.
+ * @param *last_seen_ms [out] When the node was last seen. Can be NULL.
+ *
+ * @return Number of thresholds the age of the node reached when it was last
+ *         updated or advanced.
+ *
+ * @retval -1 The node is not watched.
+ */
+int
+mu_badv_staleness_level(const struct mu_badv_staleness *const watcher,
+                        const struct mu_mac_addr       *const mac_addr,
+                                     uint64_t          *const last_seen_ms)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the number of nodes a watcher watches.
+ */
+size_t
+mu_badv_staleness_n_nodes(const struct mu_badv_staleness *const watcher)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_STALENESS_H */
@@ -0,0 +1,695 @@
+/** @file batman_adv_topology.c
+ * meshutil API implementation for merging B.A.T.M.A.N. advanced originator
+ * tables of many nodes into one mesh topology
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_topology_impl   Mesh topology implementation
+ *
+ * Nodes are numbered in the order they are first seen and found by address
+ * through a hash table of node numbers with linear probing, at most half
+ * full. Every node holds
+ *
+ * - the links it heard in its last report, sorted by neighbour,
+ * - the next hops of its last report, sorted by originator, and
+ * - the numbers of the nodes hearing it, unsorted.
+ *
+ * A merge collects the links and next hops of the report into scratch arrays
+ * kept by the topology, marking each neighbour with the number of the merge
+ * so a neighbour listed for several originators becomes one link. The new
+ * links are then compared with the old ones of the reporting node to update
+ * the hearers of only the neighbours which were gained or lost.
+ *
+ * All memory a merge needs is reserved before the reporting node is changed,
+ * so a failed merge leaves it as it was. Nodes first seen in a failed merge
+ * stay known, without links.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batman_adv_topology.h"
+#include "meshutil.h"
+#include "trace.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Smallest number of hash table slots allocated.
+#define TOPOLOGY_MIN_SLOTS 64
+
+/// No node.
+#define NODE_NONE UINT32_MAX
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct topo_link {
+   uint32_t node;                      ///< Neighbour, first for compare_ids().
+   uint32_t metric;
+   uint64_t seen_ms;
+};
+
+struct topo_route {
+   uint32_t destination;               ///< First for compare_ids().
+   uint32_t next_hop;
+   uint32_t metric;
+};
+
+struct topo_node {
+   struct mu_mac_addr  mac_addr;
+          bool         reported;       ///< routes are valid.
+          uint32_t     mark;           ///< Last merge listing it as neighbour.
+          uint32_t     link;           ///< Its link in that merge.
+          uint64_t     report_ms;
+   struct topo_link   *links;
+          uint32_t     n_links;
+          uint32_t     max_links;
+   struct topo_route  *routes;
+          uint32_t     n_routes;
+          uint32_t     max_routes;
+          uint32_t    *hearers;
+          uint32_t     n_hearers;
+          uint32_t     max_hearers;
+};
+
+struct mu_badv_topology {
+   struct topo_node  *nodes;
+          uint32_t    n_nodes;
+          uint32_t    max_nodes;
+          uint32_t   *slots;           ///< Node number + 1, 0 if free.
+          size_t      slot_mask;
+          size_t      n_links;
+          uint32_t    merge;           ///< Number of the current merge.
+   struct topo_link  *new_links;
+          size_t      max_new_links;
+   struct topo_route *new_routes;
+          size_t      max_new_routes;
+};
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static size_t mac_hash(const struct mu_mac_addr *const mac_addr)
+{
+   uint32_t low  = 0;
+   uint16_t high = 0;
+   uint64_t key  = 0;
+
+   memcpy(&low, mac_addr->octet, sizeof(low));
+   memcpy(&high, mac_addr->octet + sizeof(low), sizeof(high));
+   key  = (uint64_t) high << 32 | low;
+   key ^= key >> 33;
+   key *= 0xff51afd7ed558ccdULL;
+   key ^= key >> 33;
+   return (size_t) key;
+}
+
+static int compare_ids(const void *const a, const void *const b)
+{
+   uint32_t id_a = *(const uint32_t *) a;
+   uint32_t id_b = *(const uint32_t *) b;
+
+   return (id_a > id_b) - (id_a < id_b);
+}
+
+/// Grows an array to hold at least n elements; does nothing if it does.
+static bool reserve(void  **const array,
+                    size_t *const max,
+                    const size_t  n,
+                    const size_t  size,
+                    int    *const error)
+{
+   size_t  new_max = *max ? *max : 4;
+   void   *tmp     = NULL;
+
+   if (n <= *max) {
+      return true;
+   }
+   while (new_max < n) {
+      new_max *= 2;
+   }
+   tmp = mu_realloc(*array, new_max * size);
+   if (!tmp) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+   *array = tmp;
+   *max   = new_max;
+   return true;
+}
+
+/// reserve() for the 32 bit capacities of nodes.
+static bool reserve32(void     **const array,
+                      uint32_t  *const max,
+                      const size_t     n,
+                      const size_t     size,
+                      int       *const error)
+{
+   size_t max_size = *max;
+
+   if (n > UINT32_MAX) {
+      MU_SET_ERROR(error, EOVERFLOW);
+      return false;
+   }
+   if (!reserve(array, &max_size, n, size, error)) {
+      return false;
+   }
+   *max = max_size > UINT32_MAX ? UINT32_MAX : (uint32_t) max_size;
+   return true;
+}
+
+static uint32_t find_node(const struct mu_badv_topology *const topology,
+                          const struct mu_mac_addr      *const mac_addr)
+{
+   size_t   slot = mac_hash(mac_addr) & topology->slot_mask;
+   uint32_t id   = 0;
+
+   while ((id = topology->slots[slot])) {
+      if (mu_mac_addr_equal(&topology->nodes[id - 1].mac_addr, mac_addr)) {
+         return id - 1;
+      }
+      slot = (slot + 1) & topology->slot_mask;
+   }
+   return NODE_NONE;
+}
+
+static bool grow_slots(struct mu_badv_topology *const topology,
+                       int                     *const error)
+{
+   size_t    n_slots = (topology->slot_mask + 1) * 2;
+   uint32_t *slots   = mu_calloc(n_slots, sizeof(uint32_t));
+   size_t    slot;
+
+   if (!slots) {
+      MU_SET_ERROR(error, errno);
+      return false;
+   }
+   for (uint32_t id = 0; id < topology->n_nodes; id++) {
+      slot = mac_hash(&topology->nodes[id].mac_addr) & (n_slots - 1);
+      while (slots[slot]) {
+         slot = (slot + 1) & (n_slots - 1);
+      }
+      slots[slot] = id + 1;
+   }
+   mu_free(topology->slots);
+   topology->slots     = slots;
+   topology->slot_mask = n_slots - 1;
+   return true;
+}
+
+static uint32_t add_node(struct mu_badv_topology *const topology,
+                         const struct mu_mac_addr *const mac_addr,
+                         int                     *const error)
+{
+   uint32_t id   = find_node(topology, mac_addr);
+   size_t   slot = 0;
+
+   if (id != NODE_NONE) {
+      return id;
+   }
+   if (topology->n_nodes >= NODE_NONE - 1) {
+      MU_SET_ERROR(error, EOVERFLOW);
+      return NODE_NONE;
+   }
+   if (((size_t) topology->n_nodes + 1) * 2 > topology->slot_mask + 1
+       && !grow_slots(topology, error)) {
+      return NODE_NONE;
+   }
+   if (!reserve32((void **) &topology->nodes, &topology->max_nodes,
+                  (size_t) topology->n_nodes + 1, sizeof(struct topo_node),
+                  error)) {
+      return NODE_NONE;
+   }
+
+   id = topology->n_nodes++;
+   memset(&topology->nodes[id], 0, sizeof(struct topo_node));
+   topology->nodes[id].mac_addr = *mac_addr;
+
+   slot = mac_hash(mac_addr) & topology->slot_mask;
+   while (topology->slots[slot]) {
+      slot = (slot + 1) & topology->slot_mask;
+   }
+   topology->slots[slot] = id + 1;
+   return id;
+}
+
+/// Adds a link of the current merge or improves the one there is.
+static bool observe(      struct mu_badv_topology *const topology,
+                          size_t                  *const n_links,
+                    const struct mu_mac_addr      *const neighbour,
+                    const        uint32_t                metric,
+                    const        uint64_t                seen_ms,
+                                 int              *const error)
+{
+   uint32_t          id   = add_node(topology, neighbour, error);
+   struct topo_node *node = NULL;
+   struct topo_link *link = NULL;
+
+   if (id == NODE_NONE) {
+      return false;
+   }
+
+   node = &topology->nodes[id];
+   if (node->mark != topology->merge) {
+      node->mark = topology->merge;
+      node->link = (uint32_t) *n_links;
+      link       = &topology->new_links[(*n_links)++];
+      link->node    = id;
+      link->metric  = metric;
+      link->seen_ms = seen_ms;
+      return true;
+   }
+
+   link = &topology->new_links[node->link];
+   if (metric > link->metric) {
+      link->metric = metric;
+   }
+   if (seen_ms > link->seen_ms) {
+      link->seen_ms = seen_ms;
+   }
+   return true;
+}
+
+static void remove_hearer(struct topo_node *const node, const uint32_t hearer)
+{
+   for (uint32_t i = 0; i < node->n_hearers; i++) {
+      if (node->hearers[i] == hearer) {
+         node->hearers[i] = node->hearers[--node->n_hearers];
+         return;
+      }
+   }
+}
+
+static const struct topo_link *find_link(const struct topo_node *const node,
+                                         const uint32_t                neighbour)
+{
+   if (!node->n_links) {
+      return NULL;
+   }
+   return bsearch(&neighbour, node->links, node->n_links,
+                  sizeof(struct topo_link), compare_ids);
+}
+
+static void fill_link(const struct mu_badv_topology *const topology,
+                      const uint32_t                       from,
+                      const struct topo_link        *const link,
+                            struct mu_badv_link     *const out)
+{
+   out->from    = topology->nodes[from].mac_addr;
+   out->to      = topology->nodes[link->node].mac_addr;
+   out->metric  = link->metric;
+   out->seen_ms = link->seen_ms;
+}
+
+/* Implementation notes:
+ * - Collects the links and next hops of a table into the scratch arrays.
+ */
+static bool collect(      struct mu_badv_topology   *const topology,
+                    const struct mu_badv_orig_table *const table,
+                    const        uint64_t                  report_ms,
+                                 size_t             *const n_links,
+                                 int                *const error)
+{
+   const struct mu_badv_originator *originator = NULL;
+   const struct mu_badv_hop        *hop        = NULL;
+   struct topo_route               *route      = NULL;
+   uint64_t                         seen_ms    = 0;
+   uint32_t                         id         = 0;
+
+   if (!reserve((void **) &topology->new_links, &topology->max_new_links,
+                table->n_originators + table->n_hops,
+                sizeof(struct topo_link), error)
+       || !reserve((void **) &topology->new_routes,
+                   &topology->max_new_routes, table->n_originators,
+                   sizeof(struct topo_route), error)) {
+      return false;
+   }
+
+   if (!++topology->merge) {
+      for (uint32_t i = 0; i < topology->n_nodes; i++) {
+         topology->nodes[i].mark = 0;
+      }
+      topology->merge = 1;
+   }
+
+   *n_links = 0;
+   for (size_t i = 0; i < table->n_originators; i++) {
+      originator = &table->originators[i];
+      seen_ms    = report_ms > originator->last_seen_msecs
+                   ? report_ms - originator->last_seen_msecs : 0;
+
+      if (!observe(topology, n_links, &originator->next_hop,
+                   originator->metric, seen_ms, error)) {
+         return false;
+      }
+      for (uint32_t j = 0; j < originator->n_hops; j++) {
+         hop = &table->hops[originator->first_hop + j];
+         if (!observe(topology, n_links, &hop->mac_addr, hop->metric, seen_ms,
+                      error)) {
+            return false;
+         }
+      }
+
+      id = add_node(topology, &originator->mac_addr, error);
+      if (id == NODE_NONE) {
+         return false;
+      }
+      route              = &topology->new_routes[i];
+      route->destination = id;
+      route->next_hop    = find_node(topology, &originator->next_hop);
+      route->metric      = originator->metric;
+   }
+
+   qsort(topology->new_links, *n_links, sizeof(struct topo_link),
+         compare_ids);
+   qsort(topology->new_routes, table->n_originators, sizeof(struct topo_route),
+         compare_ids);
+   return true;
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+struct mu_badv_topology *mu_badv_topology_new(int *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct mu_badv_topology *topology = NULL;
+
+   topology = mu_calloc(1, sizeof(struct mu_badv_topology));
+   if (!topology) {
+      MU_SET_ERROR(error, errno);
+      return NULL;
+   }
+
+   topology->slots = mu_calloc(TOPOLOGY_MIN_SLOTS, sizeof(uint32_t));
+   if (!topology->slots) {
+      MU_SET_ERROR(error, errno);
+      mu_free(topology);
+      return NULL;
+   }
+   topology->slot_mask = TOPOLOGY_MIN_SLOTS - 1;
+   return topology;
+}
+
+void mu_badv_topology_free(struct mu_badv_topology *const topology)
+{
+   if (!topology) {
+      return;
+   }
+   for (uint32_t i = 0; i < topology->n_nodes; i++) {
+      mu_free(topology->nodes[i].links);
+      mu_free(topology->nodes[i].routes);
+      mu_free(topology->nodes[i].hearers);
+   }
+   mu_free(topology->nodes);
+   mu_free(topology->slots);
+   mu_free(topology->new_links);
+   mu_free(topology->new_routes);
+   mu_free(topology);
+}
+
+/* Implementation notes:
+ * - Old and new links are both sorted by neighbour and walked side by side:
+ *   neighbours only in the old links lose the reporter as hearer, those only
+ *   in the new ones gain it. The first walk only reserves memory.
+ * - A table listing an originator twice keeps one of its next hops.
+ */
+bool mu_badv_topology_merge(      struct mu_badv_topology   *const topology,
+                            const struct mu_mac_addr        *const reporter,
+                            const struct mu_badv_orig_table *const table,
+                            const        uint64_t                  report_ms,
+                                         int                *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   struct topo_node *node      = NULL;
+   struct topo_node *neighbour = NULL;
+   uint32_t          id        = 0;
+   size_t            n_links   = 0;
+   size_t            n_routes  = 0;
+   size_t            i         = 0;
+   size_t            j         = 0;
+
+   if (!topology || !reporter || !table) {
+      MU_SET_ERROR(error, EINVAL);
+      return false;
+   }
+
+   MU_TRACE_INDEX_START("topology", table->n_originators);
+   id = add_node(topology, reporter, error);
+   if (id == NODE_NONE || !collect(topology, table, report_ms, &n_links,
+                                   error)) {
+      MU_TRACE_INDEX_DONE("topology", table->n_originators, false);
+      return false;
+   }
+
+   for (size_t k = 0; k < table->n_originators; k++) {
+      if (!n_routes || topology->new_routes[k].destination
+                       != topology->new_routes[n_routes - 1].destination) {
+         topology->new_routes[n_routes++] = topology->new_routes[k];
+      }
+   }
+
+   node = &topology->nodes[id];
+   if (!reserve32((void **) &node->links, &node->max_links, n_links,
+                  sizeof(struct topo_link), error)
+       || !reserve32((void **) &node->routes, &node->max_routes, n_routes,
+                     sizeof(struct topo_route), error)) {
+      MU_TRACE_INDEX_DONE("topology", table->n_originators, false);
+      return false;
+   }
+   for (i = 0, j = 0; j < n_links; j++) {
+      while (i < node->n_links
+             && node->links[i].node < topology->new_links[j].node) {
+         i++;
+      }
+      if (i < node->n_links
+          && node->links[i].node == topology->new_links[j].node) {
+         continue;
+      }
+      neighbour = &topology->nodes[topology->new_links[j].node];
+      if (!reserve32((void **) &neighbour->hearers, &neighbour->max_hearers,
+                     (size_t) neighbour->n_hearers + 1, sizeof(uint32_t),
+                     error)) {
+         MU_TRACE_INDEX_DONE("topology", table->n_originators, false);
+         return false;
+      }
+   }
+
+   for (i = 0, j = 0; i < node->n_links || j < n_links;) {
+      if (j == n_links || (i < node->n_links
+                           && node->links[i].node
+                              < topology->new_links[j].node)) {
+         remove_hearer(&topology->nodes[node->links[i++].node], id);
+      } else if (i == node->n_links
+                 || topology->new_links[j].node < node->links[i].node) {
+         neighbour = &topology->nodes[topology->new_links[j++].node];
+         neighbour->hearers[neighbour->n_hearers++] = id;
+      } else {
+         i++;
+         j++;
+      }
+   }
+
+   topology->n_links += n_links;
+   topology->n_links -= node->n_links;
+   memcpy(node->links, topology->new_links, n_links * sizeof(struct topo_link));
+   memcpy(node->routes, topology->new_routes,
+          n_routes * sizeof(struct topo_route));
+   node->n_links   = (uint32_t) n_links;
+   node->n_routes  = (uint32_t) n_routes;
+   node->reported  = true;
+   node->report_ms = report_ms;
+
+   MU_TRACE_INDEX_DONE("topology", table->n_originators, true);
+   return true;
+}
+
+size_t mu_badv_topology_expire(struct mu_badv_topology *const topology,
+                               const uint64_t                 before_ms)
+{
+   struct topo_node *node      = NULL;
+   size_t            n_removed = 0;
+   uint32_t          n_kept    = 0;
+
+   if (!topology) {
+      return 0;
+   }
+
+   for (uint32_t id = 0; id < topology->n_nodes; id++) {
+      node   = &topology->nodes[id];
+      n_kept = 0;
+      for (uint32_t i = 0; i < node->n_links; i++) {
+         if (node->links[i].seen_ms < before_ms) {
+            remove_hearer(&topology->nodes[node->links[i].node], id);
+         } else {
+            node->links[n_kept++] = node->links[i];
+         }
+      }
+      n_removed     += node->n_links - n_kept;
+      node->n_links  = n_kept;
+
+      if (node->reported && node->report_ms < before_ms) {
+         node->reported = false;
+         node->n_routes = 0;
+      }
+   }
+
+   topology->n_links -= n_removed;
+   return n_removed;
+}
+
+size_t mu_badv_topology_n_nodes(const struct mu_badv_topology *const topology)
+{
+   return topology ? topology->n_nodes : 0;
+}
+
+size_t mu_badv_topology_n_links(const struct mu_badv_topology *const topology)
+{
+   return topology ? topology->n_links : 0;
+}
+
+size_t mu_badv_topology_links(const struct mu_badv_topology *const topology,
+                              const struct mu_mac_addr      *const node,
+                                    struct mu_badv_link     *const links,
+                              const        size_t                  max_links)
+{
+   const struct topo_node *from = NULL;
+   uint32_t                id   = 0;
+
+   if (!topology || !node) {
+      return 0;
+   }
+   id = find_node(topology, node);
+   if (id == NODE_NONE) {
+      return 0;
+   }
+
+   from = &topology->nodes[id];
+   for (uint32_t i = 0; i < from->n_links && i < max_links; i++) {
+      fill_link(topology, id, &from->links[i], &links[i]);
+   }
+   return from->n_links;
+}
+
+size_t mu_badv_topology_hearers(const struct mu_badv_topology *const topology,
+                                const struct mu_mac_addr      *const node,
+                                      struct mu_badv_link     *const links,
+                                const        size_t                  max_links)
+{
+   const struct topo_node *to     = NULL;
+   const struct topo_link *link   = NULL;
+   uint32_t                id     = 0;
+   uint32_t                hearer = 0;
+
+   if (!topology || !node) {
+      return 0;
+   }
+   id = find_node(topology, node);
+   if (id == NODE_NONE) {
+      return 0;
+   }
+
+   to = &topology->nodes[id];
+   for (uint32_t i = 0; i < to->n_hearers && i < max_links; i++) {
+      hearer = to->hearers[i];
+      link   = find_link(&topology->nodes[hearer], id);
+      fill_link(topology, hearer, link, &links[i]);
+   }
+   return to->n_hearers;
+}
+
+bool mu_badv_topology_next_hop(const struct mu_badv_topology *const topology,
+                               const struct mu_mac_addr      *const reporter,
+                               const struct mu_mac_addr      *const destination,
+                                     struct mu_mac_addr      *const next_hop,
+                                     uint32_t                *const metric)
+{
+   const struct topo_node  *node  = NULL;
+   const struct topo_route *route = NULL;
+   uint32_t                 from  = 0;
+   uint32_t                 to    = 0;
+
+   if (!topology || !reporter || !destination || !next_hop) {
+      return false;
+   }
+   from = find_node(topology, reporter);
+   to   = find_node(topology, destination);
+   if (from == NODE_NONE || to == NODE_NONE) {
+      return false;
+   }
+
+   node = &topology->nodes[from];
+   if (!node->n_routes) {
+      return false;
+   }
+   route = bsearch(&to, node->routes, node->n_routes,
+                   sizeof(struct topo_route), compare_ids);
+   if (!route) {
+      return false;
+   }
+
+   *next_hop = topology->nodes[route->next_hop].mac_addr;
+   if (metric) {
+      *metric = route->metric;
+   }
+   return true;
+}
+
+void mu_badv_topology_foreach_link(
+   const struct mu_badv_topology *const topology,
+          mu_badv_link_fn              fn,
+          void                        *ctx)
+{
+   struct mu_badv_link link;
+
+   if (!topology || !fn) {
+      return;
+   }
+   for (uint32_t id = 0; id < topology->n_nodes; id++) {
+      for (uint32_t i = 0; i < topology->nodes[id].n_links; i++) {
+         fill_link(topology, id, &topology->nodes[id].links[i], &link);
+         fn(&link, ctx);
+      }
+   }
+}
+
+#endif                          /* __linux */
@@ -0,0 +1,248 @@
+/** @file batman_adv_topology.h
+ * meshutil API for merging B.A.T.M.A.N. advanced originator tables of many
+ * nodes into one mesh topology
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_batman_adv_topology   Mesh topology
+ *
+ * A topology merges the originator tables reported by many nodes of a mesh,
+ * e.g. to a central collector, into one graph of who hears whom:
+ *
+ *     topology = mu_badv_topology_new(&error);
+ *     ...
+ *     // for every report, keyed by the hardware address of the bat
+ *     // interface of the reporting node, see mu_badv_if_hwaddr()
+ *     mu_str_to_mac_addr(hwaddr, &reporter);
+ *     mu_badv_topology_merge(topology, &reporter, table, now_ms, &error);
+ *     ...
+ *     n_links = mu_badv_topology_links(topology, &node, links, MAX_LINKS);
+ *
+ * A node hears every node listed as next hop or potential next hop in its
+ * table. The metric of the link is the best metric through that neighbour
+ * and the link was last seen when the freshest originator entry through it
+ * was. For every reporting node the topology also keeps the next hop it
+ * chose towards each originator.
+ *
+ * A report replaces the links and next hops of the reporting node only, so
+ * merging it takes time in the size of the report, not of the mesh. Links of
+ * a node which stops reporting are kept until they are older than the
+ * cut-off given to mu_badv_topology_expire().
+ *
+ * Times are milliseconds on a clock of the caller's choice; the topology only
+ * compares them.
+ *
+ * A topology is not thread-safe. Merges and expiry must not overlap other
+ * calls on the same topology.
+ */
+
+#ifndef MESHUTIL_BATMAN_ADV_TOPOLOGY_H
+#define MESHUTIL_BATMAN_ADV_TOPOLOGY_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Opaque graph of the links of a mesh.
+struct mu_badv_topology;
+
+/** A link of a topology, heard by node from.
+ */
+struct mu_badv_link {
+   struct mu_mac_addr from;            ///< Node reporting the link.
+   struct mu_mac_addr to;              ///< Neighbour heard by it.
+          uint32_t    metric;          ///< TQ or throughput in kbit/s.
+          uint64_t    seen_ms;         ///< When the link was last seen.
+};
+
+/// Called by mu_badv_topology_foreach_link() for every link.
+typedef void (*mu_badv_link_fn)(const struct mu_badv_link *link, void *ctx);
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Create an empty topology.
+ *
+ * @param *error [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the topology. Has to be released with
+ *         mu_badv_topology_free().
+ *
+ * @retval NULL Returned on failure.
+ */
+struct mu_badv_topology
+*mu_badv_topology_new(int *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release a topology.
+ */
+void
+mu_badv_topology_free(struct mu_badv_topology *const topology)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Merge the originator table reported by a node into a topology.
+ *
+ * Replaces the links and next hops of the reporting node.
+ *
+ * @param *topology  [in]  The topology.
+ * @param *reporter  [in]  Address of the reporting node.
+ * @param *table     [in]  Its originator table.
+ * @param  report_ms [in]  When the table was read.
+ * @param *error     [out] For setting error codes on function failure.
+ *
+ * @retval true  The table was merged.
+ * @retval false An error occurred. The links and next hops are unchanged.
+ */
+bool
+mu_badv_topology_merge(      struct mu_badv_topology   *const topology,
+                       const struct mu_mac_addr        *const reporter,
+                       const struct mu_badv_orig_table *const table,
+                       const        uint64_t                  report_ms,
+                                    int                *const error)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Remove the links last seen before a cut-off.
+ *
+ * The next hops of nodes whose last report is older are removed as well.
+ *
+ * @param *topology  [in] The topology.
+ * @param  before_ms [in] The cut-off.
+ *
+ * @return Number of links removed.
+ */
+size_t
+mu_badv_topology_expire(struct mu_badv_topology *const topology,
+                        const uint64_t                 before_ms)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the number of nodes a topology knows of.
+ *
+ * Nodes are never removed, also when all their links expired.
+ */
+size_t
+mu_badv_topology_n_nodes(const struct mu_badv_topology *const topology)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the number of links of a topology.
+ */
+size_t
+mu_badv_topology_n_links(const struct mu_badv_topology *const topology)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the links heard by a node, ordered by nothing in particular.
+ *
+ * @param *topology  [in]  The topology.
+ * @param *node      [in]  Address of the node.
+ * @param *links     [out] Room for max_links links.
+ * @param  max_links [in]  Most links stored.
+ *
+ * @return Number of links of the node, which can be more than max_links.
+ */
+size_t
+mu_badv_topology_links(const struct mu_badv_topology *const topology,
+                       const struct mu_mac_addr      *const node,
+                             struct mu_badv_link     *const links,
+                       const        size_t                  max_links)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the links of the nodes hearing a node.
+ *
+ * @param *topology  [in]  The topology.
+ * @param *node      [in]  Address of the node.
+ * @param *links     [out] Room for max_links links, to is node in all.
+ * @param  max_links [in]  Most links stored.
+ *
+ * @return Number of nodes hearing the node, which can be more than
+ *         max_links.
+ */
+size_t
+mu_badv_topology_hearers(const struct mu_badv_topology *const topology,
+                         const struct mu_mac_addr      *const node,
+                               struct mu_badv_link     *const links,
+                         const        size_t                  max_links)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Get the next hop a node chose towards an originator.
+ *
+ * @param *topology    [in]  The topology.
+ * @param *reporter    [in]  Address of the reporting node.
+ * @param *destination [in]  Address of the originator.
+ * @param *next_hop    [out] Address of the next hop.
+ * @param *metric      [out] Metric via the next hop. Can be NULL.
+ *
+ * @retval true  next_hop was set.
+ * @retval false The node did not report a route to the originator.
+ */
+bool
+mu_badv_topology_next_hop(const struct mu_badv_topology *const topology,
+                          const struct mu_mac_addr      *const reporter,
+                          const struct mu_mac_addr      *const destination,
+                                struct mu_mac_addr      *const next_hop,
+                                uint32_t                *const metric)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Call a function for every link of a topology.
+ *
+ * @param *topology [in] The topology.
+ * @param  fn       [in] Called with each link.
+ * @param *ctx      [in] Passed to fn as is.
+ */
+void
+mu_badv_topology_foreach_link(const struct mu_badv_topology *const topology,
+                                     mu_badv_link_fn              fn,
+                                     void                        *ctx)
+__attribute__ ((visibility("default")));
+
+#endif                          /* __linux */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* MESHUTIL_BATMAN_ADV_TOPOLOGY_H */
@@ -34,12 +34,14 @@
 *******************************************************************************/
 
 #include <errno.h>
-#include <stdio.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "linux.h"
 #include "meshutil.h"
+#include "trace.h"
 
 /*******************************************************************************
 *   CONSTANT DEFINITIONS                                                       *
@@ -47,6 +49,63 @@
 
 #define PROC_MOUNTS_PATH "/proc/mounts"
 
+/// Environment variable replacing the debugfs mount point (e.g. fixtures).
+#define DEBUGFS_ROOT_ENV "MESHUTIL_DEBUGFS_ROOT"
+
+/// Initial buffer size for reading virtual files.
+#define READ_FILE_INITIAL_SIZE 4096
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+/* Finds the first line of the /proc/mounts contents with the mount type
+ * debugfs. Returns its mount point field, terminated in place, or NULL.
+ */
+static char *find_debugfs_mount_point(char *const mounts)
+{
+   char *line  = mounts;
+   char *next  = NULL;
+   char *mount_point;
+   char *type;
+
+   while (line && *line) {
+      next = strchr(line, '\n');
+      if (next) {
+         *next++ = '\0';
+      }
+
+      // Fields: device mount_point type options dump pass
+      mount_point = strchr(line, ' ');
+      type        = mount_point ? strchr(mount_point + 1, ' ') : NULL;
+      if (type) {
+         *type++ = '\0';
+         if (!strncmp(type, "debugfs ", strlen("debugfs "))) {
+            return mount_point + 1;
+         }
+      }
+
+      line = next;
+   }
+
+   return NULL;
+}
+
+/* Returns the debugfs root set in the environment or NULL. Ignored in
+ * set-user-ID and set-group-ID programs.
+ */
+static const char *debugfs_root_override(void)
+{
+   const char *root = NULL;
+
+   if (getuid() != geteuid() || getgid() != getegid()) {
+      return NULL;
+   }
+
+   root = getenv(DEBUGFS_ROOT_ENV);
+   return root && *root ? root : NULL;
+}
+
 /*******************************************************************************
 *   PRIVATE API FUNCTION DEFINITIONS                                           *
 *******************************************************************************/
@@ -58,32 +117,21 @@ bool mu_linux_debugfs_mounted(int *const error)
 {
    MU_SET_ERROR(error, 0);
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
-
-   fp = fopen (PROC_MOUNTS_PATH, "r");
+   char *mounts = NULL;
+   bool  mounted;
 
-   if (!fp) {
-      MU_SET_ERROR(error, errno);
-      return false;
+   if (debugfs_root_override()) {
+      return true;
    }
 
-   while ((read = getline(&line, &len, fp)) != -1) {
-      // Terminate *line after mount type field.
-      *strchr (strchr (strchr (line, ' ') + 1, ' ') + 1, ' ') = '\0';
-      // Test for debugfs only in the mount type field.
-      if (strstr(strchr (strchr (line, ' ') + 1, ' '), "debugfs")) {
-         free (line);
-         fclose (fp);
-         return true;
-      }
+   mounts = mu_linux_read_file(PROC_MOUNTS_PATH, NULL, error);
+   if (!mounts) {
+      return false;
    }
 
-   free(line);
-   fclose (fp);
-   return false;
+   mounted = find_debugfs_mount_point(mounts) != NULL;
+   mu_free(mounts);
+   return mounted;
 }
 
 /* Implementation notes:
@@ -94,53 +142,113 @@ char
 {
    MU_SET_ERROR(error, 0);
 
-   FILE *fp;
-   char *line = NULL;
-   size_t len = 0;
-   ssize_t read;
+   char       *mounts      = NULL;
+   char       *tmp_line    = NULL;
+   char       *mount_point = NULL;
+   const char *root        = debugfs_root_override();
+
+   if (root) {
+      mount_point = mu_calloc(strlen(root) + 1, sizeof(char));
+      if (!mount_point) {
+         MU_SET_ERROR(error, errno);
+      } else {
+         strcpy(mount_point, root);
+      }
+      return mount_point;
+   }
+
+   mounts = mu_linux_read_file(PROC_MOUNTS_PATH, NULL, error);
+   if (!mounts) {
+      return NULL;
+   }
 
-   char *mount_point = NULL;
-   char *tmp_line = NULL;
+   tmp_line = find_debugfs_mount_point(mounts);
+   if (tmp_line) {
+      #pragma message "May return string with escaped unicode sequences."
+      /// TODO: Unescape unicode sequences in mount point (e.g. whitespace)
+      mount_point = mu_calloc(strlen(tmp_line) + 1, sizeof(char));
+      if (!mount_point) {
+         MU_SET_ERROR(error, errno);
+      } else {
+         strcpy(mount_point, tmp_line);
+      }
+   }
 
-   fp = fopen (PROC_MOUNTS_PATH, "r");
+   mu_free(mounts);
+   return mount_point;
+}
 
-   if (!fp) {
+/* Implementation notes:
+ * - Doubles the buffer whenever it fills up; virtual files have no usable
+ *   st_size.
+ */
+char *mu_linux_read_file(const char *const path,
+                               size_t *const length,
+                               int    *const error)
+{
+   MU_SET_ERROR(error, 0);
+
+   int     fd;
+   char   *buffer   = NULL;
+   char   *tmp      = NULL;
+   size_t  capacity = READ_FILE_INITIAL_SIZE;
+   size_t  used     = 0;
+   ssize_t n;
+
+   MU_TRACE_READ_START(path);
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+
+   if (fd < 0) {
       MU_SET_ERROR(error, errno);
+      MU_TRACE_READ_DONE(path, 0, error);
       return NULL;
    }
 
-   while ((read = getline(&line, &len, fp)) != -1) {
-      // Terminate *line after mount type field.
-      *strchr (strchr (strchr (line, ' ') + 1, ' ') + 1, ' ') = '\0';
-      // Test for debugfs only in the mount type field.
-      if (strstr(strchr (strchr (line, ' ') + 1, ' '), "debugfs")) {
-         tmp_line = strchr(line, ' ');
+   buffer = mu_malloc(capacity);
+   if (!buffer) {
+      MU_SET_ERROR(error, errno);
+      close(fd);
+      MU_TRACE_READ_DONE(path, 0, error);
+      return NULL;
+   }
 
-         if(!tmp_line) {
+   for (;;) {
+      if (used + 1 >= capacity) {
+         tmp = mu_realloc(buffer, capacity * 2);
+         if (!tmp) {
             MU_SET_ERROR(error, errno);
-            free (line);
-            fclose (fp);
+            mu_free(buffer);
+            close(fd);
+            MU_TRACE_READ_DONE(path, 0, error);
             return NULL;
          }
+         buffer = tmp;
+         capacity *= 2;
+      }
 
-         tmp_line = tmp_line + 1;
-
-         *strchr(tmp_line, ' ') = '\0'; // End the string. Next whitespace from
-                                        // mount path.
-
-         #pragma message "May return string with escaped unicode sequences."
-         /// TODO: Unescape unicode sequences in mount point (e.g. whitespace)
-         mount_point = calloc (strlen (tmp_line) + 1, sizeof (char));
-         strncpy (mount_point, tmp_line, strlen (tmp_line));
-         free (line);
-         fclose (fp);
-         return mount_point;
+      n = read(fd, buffer + used, capacity - used - 1);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         MU_SET_ERROR(error, errno);
+         mu_free(buffer);
+         close(fd);
+         MU_TRACE_READ_DONE(path, 0, error);
+         return NULL;
+      } else if (n == 0) {
+         break;
       }
+      used += (size_t) n;
    }
 
-   free (line);
-   fclose (fp);
-   return NULL;
+   close(fd);
+   buffer[used] = '\0';
+   if (length) {
+      *length = used;
+   }
+   MU_TRACE_READ_DONE(path, used, error);
+   return buffer;
 }
 
 #endif                          /* __linux */
@@ -31,6 +31,7 @@
 *******************************************************************************/
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /*******************************************************************************
 *   PRIVATE API FUNCTION DECLARATIONS                                          *
@@ -39,6 +40,9 @@
 /**
  * @brief PRIVATE Test whether the Linux debug filesystem is mounted.
  *
+ * Always true if MESHUTIL_DEBUGFS_ROOT is set, see
+ * mu_linux_debugfs_mount_point.
+ *
  * @param *error [out] For setting error codes on function failure.
  *
  * @retval true  debugfs is mounted
@@ -53,6 +57,10 @@ __attribute__ ((visibility("hidden")));
  *
  * If debugfs is mounted at multiple mount points, returns the first one.
  *
+ * The environment variable MESHUTIL_DEBUGFS_ROOT replaces the mount point,
+ * e.g. to run against fixture tables. It is ignored in set-user-ID and
+ * set-group-ID programs.
+ *
  * @param *error [out] For setting error codes on function failure.
  *
  * @return Pointer to string containing the mount path.
@@ -62,5 +70,26 @@ char
 *mu_linux_debugfs_mount_point(int *const error)
 __attribute__ ((visibility("hidden")));
 
+/**
+ * @brief PRIVATE Read the whole contents of a file into memory.
+ *
+ * Meant for virtual files (debugfs, sysfs) which report a size of zero, so the
+ * buffer is grown while reading. The contents are NUL terminated.
+ *
+ * @param *path   [in]  Path of the file to read.
+ * @param *length [out] Number of bytes read, excluding the terminating NUL.
+ *                      Can be ignored by passing NULL.
+ * @param *error  [out] For setting error codes on function failure.
+ *
+ * @return Pointer to the file contents. Has to be mu_free()'d by the caller.
+ *
+ * @retval NULL The file could not be read.
+ */
+char
+*mu_linux_read_file(const char *const path,
+                          size_t *const length,
+                          int    *const error)
+__attribute__ ((visibility("hidden")));
+
 #endif                          /* __linux */
 #endif                          /* MESHUTIL_BATMAN_ADV_H */
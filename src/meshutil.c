@@ -0,0 +1,205 @@
+/** @file meshutil.c
+ * Common, routing protocol independent helpers
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meshutil.h"
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+static void *default_alloc(size_t size, void *ctx);
+static void *default_realloc(void *ptr, size_t size, void *ctx);
+static void  default_free(void *ptr, void *ctx);
+
+static struct {
+   mu_alloc_fn    alloc;
+   mu_realloc_fn  realloc;
+   mu_free_fn     free;
+   void          *ctx;
+} allocator = { default_alloc, default_realloc, default_free, NULL };
+
+/*******************************************************************************
+*   STATIC HELPER FUNCTION DEFINITIONS                                         *
+*******************************************************************************/
+
+static void *default_alloc(size_t size, void *ctx)
+{
+   (void) ctx;
+   return malloc(size);
+}
+
+static void *default_realloc(void *ptr, size_t size, void *ctx)
+{
+   (void) ctx;
+   return realloc(ptr, size);
+}
+
+static void default_free(void *ptr, void *ctx)
+{
+   (void) ctx;
+   free(ptr);
+}
+
+static int hex_digit_value(const char c)
+{
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   } else if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   } else if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+   } else {
+      return -1;
+   }
+}
+
+/*******************************************************************************
+*   PUBLIC API FUNCTION DEFINITIONS                                            *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Accepts upper and lower case hex digits, requires ':' separators.
+ */
+bool mu_str_to_mac_addr(const char *const str, struct mu_mac_addr *const addr)
+{
+   int high, low;
+
+   if (!str || !addr) {
+      return false;
+   }
+
+   for (int i = 0; i < MU_MAC_ADDR_LEN; i++) {
+      high = hex_digit_value(str[i * 3]);
+      if (high < 0) {
+         return false;
+      }
+      low = hex_digit_value(str[i * 3 + 1]);
+      if (low < 0) {
+         return false;
+      }
+      if (i < MU_MAC_ADDR_LEN - 1 && str[i * 3 + 2] != ':') {
+         return false;
+      }
+      addr->octet[i] = (unsigned char) (high << 4 | low);
+   }
+
+   return true;
+}
+
+/* Implementation notes:
+ * - Writes lower case hex digits like the Linux kernel %pM format.
+ */
+void mu_mac_addr_to_str(const struct mu_mac_addr *const addr, char *const str)
+{
+   static const char digits[] = "0123456789abcdef";
+
+   for (int i = 0; i < MU_MAC_ADDR_LEN; i++) {
+      str[i * 3]     = digits[addr->octet[i] >> 4];
+      str[i * 3 + 1] = digits[addr->octet[i] & 0x0f];
+      str[i * 3 + 2] = ':';
+   }
+   str[MU_MAC_ADDR_STR_LEN] = '\0';
+}
+
+bool mu_mac_addr_equal(const struct mu_mac_addr *const a,
+                       const struct mu_mac_addr *const b)
+{
+   return !memcmp(a->octet, b->octet, MU_MAC_ADDR_LEN);
+}
+
+void mu_set_allocator(mu_alloc_fn    alloc,
+                      mu_realloc_fn  realloc,
+                      mu_free_fn     free,
+                      void          *ctx)
+{
+   if (!alloc || !realloc || !free) {
+      allocator.alloc   = default_alloc;
+      allocator.realloc = default_realloc;
+      allocator.free    = default_free;
+      allocator.ctx     = NULL;
+   } else {
+      allocator.alloc   = alloc;
+      allocator.realloc = realloc;
+      allocator.free    = free;
+      allocator.ctx     = ctx;
+   }
+}
+
+void mu_free(void *ptr)
+{
+   if (ptr) {
+      allocator.free(ptr, allocator.ctx);
+   }
+}
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DEFINITIONS                                           *
+*******************************************************************************/
+
+/* Implementation notes:
+ * - Custom allocators need not set errno, so it is set here.
+ */
+void *mu_malloc(size_t size)
+{
+   void *ptr = allocator.alloc(size ? size : 1, allocator.ctx);
+
+   if (!ptr) {
+      errno = ENOMEM;
+   }
+   return ptr;
+}
+
+void *mu_calloc(size_t n_members, size_t size)
+{
+   void *ptr = NULL;
+
+   if (size && n_members > SIZE_MAX / size) {
+      errno = ENOMEM;
+      return NULL;
+   }
+
+   ptr = mu_malloc(n_members * size);
+   if (ptr) {
+      memset(ptr, 0, n_members * size);
+   }
+   return ptr;
+}
+
+void *mu_realloc(void *ptr, size_t size)
+{
+   void *new_ptr = allocator.realloc(ptr, size ? size : 1, allocator.ctx);
+
+   if (!new_ptr) {
+      errno = ENOMEM;
+   }
+   return new_ptr;
+}
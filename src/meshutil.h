@@ -37,9 +37,83 @@
  * was returned legitimately or due to an error.
  */
 
+/** @page pg_allocator memory allocation
+ *
+ * All memory the library allocates, including the memory returned to the
+ * caller, goes through the allocator set with mu_set_allocator. By default it
+ * is the C library allocator, so returned memory can also be released with
+ * free(). With a custom allocator returned memory has to be released with
+ * mu_free() (or directly by the custom allocator).
+ *
+ * A custom allocator can e.g. take memory from a fixed pool, count the
+ * allocations or put all results of a tick into an arena which is then freed
+ * at once.
+ *
+ * The allocator is called from threads of the library as well as from the
+ * caller's: from the workers of a parallel parse (mu_badv_set_parallel_parse),
+ * from the worker of every refresh handle (mu_badv_refresh_new) and from any
+ * thread the caller hands library calls to. It therefore has to be
+ * thread-safe; an arena bound to the calling thread is not. The coroutine
+ * awaitables of meshutil_coro.hpp allocate with the C++ allocator and run
+ * library calls on threads they start themselves (see pg_cpp_coro).
+ *
+ * Some memory outlives any single call and belongs to the process rather
+ * than to a tick: the tables cached with mu_badv_cache_set_ttl and their
+ * per-interface entries, the records of table loads in flight that concurrent
+ * callers wait for, and the shared memory attachments of mu_badv_shm_attach.
+ * The cached tables are released by setting the time to live to 0 and the
+ * attachments by mu_badv_shm_detach; the small per-interface cache entries
+ * stay until the process exits. An arena freed at the end of a tick must not
+ * back this memory. The capability cache of mu_badv_caps_get is kept in
+ * static storage and allocates nothing that outlives a call.
+ */
+
 #ifndef MESHUTIL_H
 #define MESHUTIL_H 1
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Number of octets in a MAC address.
+#define MU_MAC_ADDR_LEN 6
+
+/// Length of the "xx:xx:xx:xx:xx:xx" representation of a MAC address.
+#define MU_MAC_ADDR_STR_LEN 17
+
+/// Maximum length of a network interface name including the terminating NUL.
+#define MU_IF_NAME_LEN 16
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+/// Allocate size bytes, like malloc().
+typedef void *(*mu_alloc_fn)(size_t size, void *ctx);
+
+/// Resize an allocation, like realloc(). ptr can be NULL.
+typedef void *(*mu_realloc_fn)(void *ptr, size_t size, void *ctx);
+
+/// Release an allocation, like free(). ptr can be NULL.
+typedef void (*mu_free_fn)(void *ptr, void *ctx);
+
+/** Binary representation of a MAC address.
+ */
+struct mu_mac_addr {
+   unsigned char octet[MU_MAC_ADDR_LEN];
+};
+
 /*******************************************************************************
 *   FUNCTION MACROS                                                            *
 *******************************************************************************/
@@ -57,4 +131,115 @@
  */
 #define MU_SET_ERROR(eptr, eval) if ( eptr ) { *eptr = eval; }
 
+/*******************************************************************************
+*   PUBLIC API FUNCTION DECLARATIONS                                           *
+*******************************************************************************/
+
+/**
+ * @brief Convert a "xx:xx:xx:xx:xx:xx" string to a binary MAC address.
+ *
+ * Only the first MU_MAC_ADDR_STR_LEN characters of str are examined, so the
+ * string may continue after the address (e.g. a line of a batman_adv table).
+ *
+ * @param *str  [in]  String starting with a MAC address.
+ * @param *addr [out] The parsed MAC address.
+ *
+ * @retval true  The address was parsed.
+ * @retval false str does not start with a MAC address.
+ */
+bool
+mu_str_to_mac_addr(const char *const str, struct mu_mac_addr *const addr)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Convert a binary MAC address to the "xx:xx:xx:xx:xx:xx" string.
+ *
+ * @param *addr [in]  The MAC address.
+ * @param *str  [out] Buffer of at least MU_MAC_ADDR_STR_LEN + 1 characters.
+ */
+void
+mu_mac_addr_to_str(const struct mu_mac_addr *const addr, char *const str)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Compare two binary MAC addresses.
+ *
+ * @retval true  The addresses are equal.
+ * @retval false The addresses differ.
+ */
+bool
+mu_mac_addr_equal(const struct mu_mac_addr *const a,
+                  const struct mu_mac_addr *const b)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Set the allocator used for all memory allocated by the library.
+ *
+ * Has to be called before any other meshutil function allocates memory, or
+ * once all memory allocated by the library has been released, and not
+ * concurrently with other meshutil functions.
+ *
+ * The functions are called from several threads at once, library worker
+ * threads included, and have to be thread-safe. Memory of the caches and
+ * shared memory attachments is kept across calls, see @ref pg_allocator.
+ *
+ * Passing NULL for any of the functions restores the C library allocator.
+ *
+ * @param  alloc   [in] Allocation function.
+ * @param  realloc [in] Reallocation function.
+ * @param  free    [in] Release function.
+ * @param *ctx     [in] Passed to the functions as is.
+ */
+void
+mu_set_allocator(mu_alloc_fn   alloc,
+                 mu_realloc_fn realloc,
+                 mu_free_fn    free,
+                 void         *ctx)
+__attribute__ ((visibility("default")));
+
+/**
+ * @brief Release memory returned by a meshutil function.
+ *
+ * @param *ptr [in] The memory to release. Can be NULL.
+ */
+void
+mu_free(void *ptr)
+__attribute__ ((visibility("default")));
+
+/*******************************************************************************
+*   PRIVATE API FUNCTION DECLARATIONS                                          *
+*******************************************************************************/
+
+/**
+ * @brief PRIVATE Allocate memory with the configured allocator.
+ *
+ * @retval NULL Returned on failure, errno is set to ENOMEM.
+ */
+void
+*mu_malloc(size_t size)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Allocate zeroed memory with the configured allocator.
+ *
+ * @retval NULL Returned on failure, errno is set to ENOMEM.
+ */
+void
+*mu_calloc(size_t n_members, size_t size)
+__attribute__ ((visibility("hidden")));
+
+/**
+ * @brief PRIVATE Resize memory with the configured allocator.
+ *
+ * @retval NULL Returned on failure, errno is set to ENOMEM and ptr is still
+ *              valid.
+ */
+void
+*mu_realloc(void *ptr, size_t size)
+__attribute__ ((visibility("hidden")));
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif                          /* MESHUTIL_H */
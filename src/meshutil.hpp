@@ -0,0 +1,1357 @@
+/** @file meshutil.hpp
+ * Header-only C++ interface for meshutil
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_cpp C++ interface
+ *
+ * meshutil.hpp wraps the C API for C++17 and later. It needs no extra
+ * library, link with libmeshutil as usual.
+ *
+ * - Everything returned by the library is owned by a move-only object which
+ *   mu_free()s it, handles (DAT index, gateway selector, ...) are closed by
+ *   their destructor.
+ * - Errors are thrown as std::system_error carrying the errno value of the
+ *   error argument of the C function.
+ * - Tables are not copied: originators(), hops() and entries() are spans into
+ *   the parsed table and outgoing_if() is a string_view into its entry. The
+ *   views are valid as long as the owning object.
+ * - The owning objects are ranges (begin()/end() with standard iterators), so
+ *   they work with range-for, <algorithm> and, in C++20, std::ranges.
+ * - MAC address literals are checked at compile time in C++20. In C++17 only
+ *   literals in constant expressions are, others throw on a bad address.
+ *
+ * Example:
+ *
+ *     using namespace meshutil::literals;
+ *
+ *     auto table = meshutil::badv::orig_table::read("bat0");
+ *     for (const auto &originator : table) {
+ *        std::cout << meshutil::mac_addr(originator.mac_addr) << " via "
+ *                  << meshutil::badv::outgoing_if(originator) << '\n';
+ *     }
+ *     if (auto *gw = table.find("02:ba:7a:df:04:01"_mac)) { ... }
+ *
+ * With C++20 meshutil::span is std::span, before it is a minimal replacement
+ * with the same members used here.
+ */
+
+#ifndef MESHUTIL_HPP
+#define MESHUTIL_HPP 1
+
+#if __cplusplus < 201703L
+#error "meshutil.hpp requires C++17 or later"
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <array>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<span>)
+#include <span>
+#endif
+
+#include "meshutil.h"
+#include "batman_adv.h"
+#include "batman_adv_async.h"
+#include "batman_adv_cache.h"
+#include "batman_adv_caps.h"
+#include "batman_adv_dat.h"
+#include "batman_adv_gateways.h"
+#include "batman_adv_history.h"
+#include "batman_adv_mac_filter.h"
+#include "batman_adv_neighbors.h"
+#include "batman_adv_node_store.h"
+#include "batman_adv_originators.h"
+#include "batman_adv_shm.h"
+#include "batman_adv_staleness.h"
+#include "batman_adv_topology.h"
+
+namespace meshutil {
+
+/*******************************************************************************
+*   SPAN                                                                       *
+*******************************************************************************/
+
+#if defined(__cpp_lib_span) && __cpp_lib_span >= 202002L
+
+template <class T>
+using span = std::span<T>;
+
+#else
+
+/** Contiguous view, subset of std::span for C++17.
+ */
+template <class T>
+class span {
+public:
+   using element_type    = T;
+   using value_type      = std::remove_cv_t<T>;
+   using size_type       = std::size_t;
+   using difference_type = std::ptrdiff_t;
+   using pointer         = T *;
+   using reference       = T &;
+   using iterator        = T *;
+
+   constexpr span() noexcept = default;
+   constexpr span(T *data, std::size_t size) noexcept
+      : data_(data), size_(size) {}
+
+   constexpr T           *data()  const noexcept { return data_; }
+   constexpr std::size_t  size()  const noexcept { return size_; }
+   constexpr bool         empty() const noexcept { return size_ == 0; }
+   constexpr T           *begin() const noexcept { return data_; }
+   constexpr T           *end()   const noexcept { return data_ + size_; }
+   constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+
+private:
+   T           *data_ = nullptr;
+   std::size_t  size_ = 0;
+};
+
+#endif
+
+/*******************************************************************************
+*   DETAIL                                                                     *
+*******************************************************************************/
+
+namespace detail {
+
+/// Throw the errno value of a C error argument, if any.
+inline void check(const int error)
+{
+   if (error) {
+      throw std::system_error(error, std::generic_category());
+   }
+}
+
+/// Releases memory returned by the library.
+struct free_deleter {
+   void operator()(void *const ptr) const noexcept { mu_free(ptr); }
+};
+
+constexpr int hex_value(const char c) noexcept
+{
+   return c >= '0' && c <= '9' ? c - '0'
+        : c >= 'a' && c <= 'f' ? c - 'a' + 10
+        : c >= 'A' && c <= 'F' ? c - 'A' + 10
+        : -1;
+}
+
+/// View of a NUL padded fixed size character field.
+template <std::size_t N>
+std::string_view fixed_string(const char (&field)[N]) noexcept
+{
+   return std::string_view(field, ::strnlen(field, N));
+}
+
+} // namespace detail
+
+/*******************************************************************************
+*   MAC ADDRESSES                                                              *
+*******************************************************************************/
+
+/** Binary MAC address usable in constant expressions.
+ */
+class mac_addr {
+public:
+   using octets_type = std::array<unsigned char, MU_MAC_ADDR_LEN>;
+
+   constexpr mac_addr() noexcept : octets_{} {}
+
+   constexpr explicit mac_addr(const octets_type &octets) noexcept
+      : octets_(octets) {}
+
+   mac_addr(const struct mu_mac_addr &addr) noexcept : octets_{}
+   {
+      std::memcpy(octets_.data(), addr.octet, MU_MAC_ADDR_LEN);
+   }
+
+   /**
+    * @brief Parse a "xx:xx:xx:xx:xx:xx" string.
+    *
+    * Throws std::invalid_argument if str is not exactly a MAC address, which
+    * makes a bad literal a compile error in constant expressions.
+    */
+   static constexpr mac_addr parse(const std::string_view str)
+   {
+      octets_type octets{};
+
+      if (str.size() != MU_MAC_ADDR_STR_LEN) {
+         throw std::invalid_argument("meshutil::mac_addr: bad length");
+      }
+      for (std::size_t i = 0; i < MU_MAC_ADDR_LEN; i++) {
+         const int high = detail::hex_value(str[3 * i]);
+         const int low  = detail::hex_value(str[3 * i + 1]);
+
+         if (high < 0 || low < 0 || (i < MU_MAC_ADDR_LEN - 1
+                                     && str[3 * i + 2] != ':')) {
+            throw std::invalid_argument("meshutil::mac_addr: bad address");
+         }
+         octets[i] = static_cast<unsigned char>(high << 4 | low);
+      }
+      return mac_addr(octets);
+   }
+
+   constexpr const octets_type &octets() const noexcept { return octets_; }
+
+   /// The address as used by the C API.
+   struct mu_mac_addr c_addr() const noexcept
+   {
+      struct mu_mac_addr addr;
+
+      std::memcpy(addr.octet, octets_.data(), MU_MAC_ADDR_LEN);
+      return addr;
+   }
+
+   std::string to_string() const
+   {
+      char str[MU_MAC_ADDR_STR_LEN + 1];
+      const struct mu_mac_addr addr = c_addr();
+
+      mu_mac_addr_to_str(&addr, str);
+      return std::string(str, MU_MAC_ADDR_STR_LEN);
+   }
+
+   friend constexpr bool operator==(const mac_addr &a,
+                                    const mac_addr &b) noexcept
+   {
+      for (std::size_t i = 0; i < MU_MAC_ADDR_LEN; i++) {
+         if (a.octets_[i] != b.octets_[i]) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   friend constexpr bool operator!=(const mac_addr &a,
+                                    const mac_addr &b) noexcept
+   {
+      return !(a == b);
+   }
+
+   friend constexpr bool operator<(const mac_addr &a,
+                                   const mac_addr &b) noexcept
+   {
+      for (std::size_t i = 0; i < MU_MAC_ADDR_LEN; i++) {
+         if (a.octets_[i] != b.octets_[i]) {
+            return a.octets_[i] < b.octets_[i];
+         }
+      }
+      return false;
+   }
+
+   friend std::ostream &operator<<(std::ostream &os, const mac_addr &addr)
+   {
+      return os << addr.to_string();
+   }
+
+private:
+   octets_type octets_;
+};
+
+namespace literals {
+
+/// "02:ba:7a:df:04:01"_mac, a bad address does not compile in C++20.
+#if defined(__cpp_consteval) && __cpp_consteval >= 201811L
+consteval
+#else
+constexpr
+#endif
+mac_addr operator""_mac(const char *const str, const std::size_t len)
+{
+   return mac_addr::parse(std::string_view(str, len));
+}
+
+} // namespace literals
+
+/*******************************************************************************
+*   OWNING RESULTS                                                             *
+*******************************************************************************/
+
+/** String returned by the library.
+ */
+class c_string {
+public:
+   c_string() noexcept = default;
+   explicit c_string(char *const str) noexcept : str_(str) {}
+
+   std::string_view view() const noexcept
+   {
+      return str_ ? std::string_view(str_.get()) : std::string_view();
+   }
+
+   const char *c_str() const noexcept { return str_ ? str_.get() : ""; }
+   bool        empty() const noexcept { return view().empty(); }
+   std::string str()   const           { return std::string(view()); }
+
+   operator std::string_view() const noexcept { return view(); }
+
+private:
+   std::unique_ptr<char, detail::free_deleter> str_;
+};
+
+/** Array returned by the library (neighbours, gateways).
+ */
+template <class T>
+class c_array {
+public:
+   using value_type     = T;
+   using const_iterator = const T *;
+   using iterator       = const_iterator;
+
+   c_array() noexcept = default;
+   c_array(T *const data, const std::size_t size) noexcept
+      : data_(data), size_(data ? size : 0) {}
+
+   span<const T>  view()  const noexcept { return {data_.get(), size_}; }
+   const T       *data()  const noexcept { return data_.get(); }
+   std::size_t    size()  const noexcept { return size_; }
+   bool           empty() const noexcept { return size_ == 0; }
+   const T       *begin() const noexcept { return data_.get(); }
+   const T       *end()   const noexcept { return data_.get() + size_; }
+   const T &operator[](std::size_t i) const noexcept { return data_[i]; }
+
+private:
+   std::unique_ptr<T[], detail::free_deleter> data_;
+   std::size_t                                size_ = 0;
+};
+
+/*******************************************************************************
+*   BATMAN_ADV                                                                 *
+*******************************************************************************/
+
+namespace badv {
+
+/// Name of the interface an originator, neighbour or gateway is seen on.
+template <class Entry>
+std::string_view outgoing_if(const Entry &entry) noexcept
+{
+   return detail::fixed_string(entry.outgoing_if);
+}
+
+/// Address string of a node list entry.
+inline std::string_view address(const struct mu_bat_mesh_node &node) noexcept
+{
+   return detail::fixed_string(node.mac_addr);
+}
+
+/** Linked list of node addresses returned by the library.
+ */
+class node_list {
+public:
+   class iterator {
+   public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type        = struct mu_bat_mesh_node;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const struct mu_bat_mesh_node *;
+      using reference         = const struct mu_bat_mesh_node &;
+
+      iterator() noexcept = default;
+      explicit iterator(pointer node) noexcept : node_(node) {}
+
+      reference operator*()  const noexcept { return *node_; }
+      pointer   operator->() const noexcept { return node_; }
+
+      iterator &operator++() noexcept { node_ = node_->next; return *this; }
+      iterator  operator++(int) noexcept
+      {
+         iterator previous = *this;
+         node_ = node_->next;
+         return previous;
+      }
+
+      friend bool operator==(const iterator &a, const iterator &b) noexcept
+      {
+         return a.node_ == b.node_;
+      }
+      friend bool operator!=(const iterator &a, const iterator &b) noexcept
+      {
+         return a.node_ != b.node_;
+      }
+
+   private:
+      pointer node_ = nullptr;
+   };
+
+   using const_iterator = iterator;
+
+   node_list() noexcept = default;
+   node_list(struct mu_bat_mesh_node *const head, const int size) noexcept
+      : head_(head), size_(head && size > 0 ? std::size_t(size) : 0) {}
+
+   iterator    begin() const noexcept { return iterator(head_.get()); }
+   iterator    end()   const noexcept { return iterator(); }
+   std::size_t size()  const noexcept { return size_; }
+   bool        empty() const noexcept { return !head_; }
+
+private:
+   struct deleter {
+      void operator()(struct mu_bat_mesh_node *node) const noexcept
+      {
+         while (node) {
+            struct mu_bat_mesh_node *const next = node->next;
+            mu_free(node);
+            node = next;
+         }
+      }
+   };
+
+   std::unique_ptr<struct mu_bat_mesh_node, deleter> head_;
+   std::size_t                                       size_ = 0;
+};
+
+/** Parsed originators table.
+ */
+class orig_table {
+public:
+   using value_type     = struct mu_badv_originator;
+   using const_iterator = const struct mu_badv_originator *;
+   using iterator       = const_iterator;
+
+   orig_table() noexcept = default;
+   explicit orig_table(struct mu_badv_orig_table *const table) noexcept
+      : table_(table) {}
+
+   /// Read the table of a bat interface, NULL for the default interface.
+   static orig_table read(const char *const interface_name = nullptr)
+   {
+      int error = 0;
+      struct mu_badv_orig_table *const table =
+         mu_badv_orig_table_read(interface_name, &error);
+
+      detail::check(error);
+      return orig_table(table);
+   }
+
+   enum mu_badv_metric_type metric_type() const noexcept
+   {
+      return table_ ? table_->metric_type : MU_BADV_METRIC_NONE;
+   }
+
+   span<const struct mu_badv_originator> originators() const noexcept
+   {
+      if (!table_) {
+         return {};
+      }
+      return {table_->originators, table_->n_originators};
+   }
+
+   /// Potential next hops of an originator of this table.
+   span<const struct mu_badv_hop>
+   hops(const struct mu_badv_originator &originator) const noexcept
+   {
+      if (!table_) {
+         return {};
+      }
+      return {table_->hops + originator.first_hop, originator.n_hops};
+   }
+
+   /// Outgoing interfaces with their aggregates, indexed by if_id.
+   span<const struct mu_badv_if_stats> interfaces() const noexcept
+   {
+      if (!table_) {
+         return {};
+      }
+      return {table_->ifs, table_->n_ifs};
+   }
+
+   /// if_id of the originators reached through an interface.
+   std::optional<std::uint8_t> if_id(const char *const interface_name)
+      const noexcept
+   {
+      const int id = mu_badv_orig_table_if_id(table_.get(), interface_name);
+
+      if (id < 0) {
+         return std::nullopt;
+      }
+      return static_cast<std::uint8_t>(id);
+   }
+
+   /// Build a perfect hash index for find(), see mu_badv_orig_table_index().
+   void index()
+   {
+      int error = 0;
+
+      mu_badv_orig_table_index(table_.get(), &error);
+      detail::check(error);
+   }
+
+   /// The originator with the address, nullptr if not in the table.
+   const struct mu_badv_originator *find(const mac_addr &addr) const noexcept
+   {
+      const struct mu_mac_addr c_addr = addr.c_addr();
+
+      return mu_badv_orig_table_find(table_.get(), &c_addr);
+   }
+
+   const_iterator begin() const noexcept { return originators().data(); }
+   const_iterator end()   const noexcept
+   {
+      return originators().data() + originators().size();
+   }
+   std::size_t    size()  const noexcept { return originators().size(); }
+   bool           empty() const noexcept { return size() == 0; }
+
+   /// The C table, still owned by this object.
+   const struct mu_badv_orig_table *get() const noexcept
+   {
+      return table_.get();
+   }
+
+   /// Give up ownership, the table has to be mu_badv_orig_table_free()'d.
+   struct mu_badv_orig_table *release() noexcept { return table_.release(); }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_orig_table *const table) const noexcept
+      {
+         mu_badv_orig_table_free(table);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_orig_table, deleter> table_;
+};
+
+inline bool kmod_available()
+{
+   int        error     = 0;
+   const bool available = mu_badv_kmod_available(&error);
+
+   detail::check(error);
+   return available;
+}
+
+inline bool kmod_loaded()
+{
+   int        error  = 0;
+   const bool loaded = mu_badv_kmod_loaded(&error);
+
+   detail::check(error);
+   return loaded;
+}
+
+inline c_string kmod_version()
+{
+   int      error = 0;
+   c_string version(mu_badv_kmod_version(&error));
+
+   detail::check(error);
+   return version;
+}
+
+inline bool if_up(const char *const interface_name = nullptr)
+{
+   int        error = 0;
+   const bool up    = mu_badv_if_up(interface_name, &error);
+
+   detail::check(error);
+   return up;
+}
+
+inline c_string if_hwaddr(const char *const interface_name = nullptr)
+{
+   int      error = 0;
+   c_string hwaddr(mu_badv_if_hwaddr(interface_name, &error));
+
+   detail::check(error);
+   return hwaddr;
+}
+
+inline unsigned int mesh_n_nodes(const char *const interface_name = nullptr)
+{
+   int                error   = 0;
+   const unsigned int n_nodes = mu_badv_mesh_n_nodes(interface_name, &error);
+
+   detail::check(error);
+   return n_nodes;
+}
+
+inline node_list mesh_node_addresses(const char *const interface_name = nullptr)
+{
+   int                            error   = 0;
+   int                            n_nodes = 0;
+   struct mu_bat_mesh_node *const head    =
+      mu_badv_mesh_node_addresses(interface_name, &n_nodes, &error);
+   node_list                      nodes(head, n_nodes);
+
+   detail::check(error);
+   return nodes;
+}
+
+inline node_list next_hop_addresses(const bool        potential,
+                                    const char *const interface_name = nullptr)
+{
+   int                            error   = 0;
+   int                            n_nodes = 0;
+   struct mu_bat_mesh_node *const head    =
+      mu_badv_next_hop_addresses(interface_name, potential, &n_nodes, &error);
+   node_list                      nodes(head, n_nodes);
+
+   detail::check(error);
+   return nodes;
+}
+
+inline c_array<struct mu_badv_neighbor>
+neighbors(const char *const interface_name = nullptr)
+{
+   int                            error = 0;
+   std::size_t                    n     = 0;
+   struct mu_badv_neighbor *const data  =
+      mu_badv_neighbors(interface_name, &n, &error);
+   c_array<struct mu_badv_neighbor> result(data, n);
+
+   detail::check(error);
+   return result;
+}
+
+inline c_array<struct mu_badv_gateway>
+gateways(const char *const interface_name = nullptr)
+{
+   int                           error = 0;
+   std::size_t                   n     = 0;
+   struct mu_badv_gateway *const data  =
+      mu_badv_gateways(interface_name, &n, &error);
+   c_array<struct mu_badv_gateway> result(data, n);
+
+   detail::check(error);
+   return result;
+}
+
+inline struct mu_badv_caps caps()
+{
+   int                 error = 0;
+   struct mu_badv_caps result;
+
+   mu_badv_caps_get(&result, &error);
+   detail::check(error);
+   return result;
+}
+
+/// Set the time to live of the cached originator table, 0 turns it off.
+inline void set_cache_ttl(const std::chrono::milliseconds ttl,
+                          const char *const interface_name = nullptr)
+{
+   int error = 0;
+
+   mu_badv_cache_set_ttl(interface_name,
+                         static_cast<unsigned int>(ttl.count()), &error);
+   detail::check(error);
+}
+
+/// Cache counters, all zero if no time to live was ever set.
+inline struct mu_badv_cache_stats
+cache_stats(const char *const interface_name = nullptr) noexcept
+{
+   struct mu_badv_cache_stats stats = {};
+
+   mu_badv_cache_stats(interface_name, &stats);
+   return stats;
+}
+
+/// The first top.size() originators in an order, stored at the front of top.
+inline span<struct mu_badv_originator>
+orig_top_k(const span<struct mu_badv_originator> top,
+           const enum mu_badv_top_order          order,
+           const bool                            neighbors_only = false,
+           const char *const                     interface_name = nullptr)
+{
+   int               error = 0;
+   const std::size_t n     = mu_badv_orig_top_k(interface_name, order,
+                                                neighbors_only, top.data(),
+                                                top.size(), &error);
+
+   detail::check(error);
+   return span<struct mu_badv_originator>(top.data(), n);
+}
+
+/** Distributed ARP Table index.
+ */
+class dat_index {
+public:
+   explicit dat_index(const char *const interface_name = nullptr)
+   {
+      int error = 0;
+
+      index_.reset(mu_badv_dat_index_new(interface_name, &error));
+      detail::check(error);
+   }
+
+   void refresh()
+   {
+      int error = 0;
+
+      mu_badv_dat_index_refresh(index_.get(), &error);
+      detail::check(error);
+   }
+
+   std::optional<struct mu_badv_dat_entry>
+   lookup(const std::uint32_t ipv4,
+          const int           vid = MU_BADV_DAT_VID_ANY) const noexcept
+   {
+      struct mu_badv_dat_entry entry;
+
+      if (!mu_badv_dat_lookup(index_.get(), ipv4, vid, &entry)) {
+         return std::nullopt;
+      }
+      return entry;
+   }
+
+   /// All entries, valid until the next refresh().
+   span<const struct mu_badv_dat_entry> entries() const noexcept
+   {
+      std::size_t                           n       = 0;
+      const struct mu_badv_dat_entry *const entries =
+         mu_badv_dat_index_entries(index_.get(), &n);
+
+      return {entries, entries ? n : 0};
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_dat_index *const index) const noexcept
+      {
+         mu_badv_dat_index_free(index);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_dat_index, deleter> index_;
+};
+
+/** Mesh membership filter, see pg_batman_adv_mac_filter.
+ */
+class mac_filter {
+public:
+   explicit mac_filter(const char   *const interface_name = nullptr,
+                       const unsigned int  bits_per_addr  = 0)
+   {
+      int error = 0;
+
+      filter_.reset(mu_badv_mac_filter_new(interface_name, bits_per_addr,
+                                           &error));
+      detail::check(error);
+   }
+
+   void refresh()
+   {
+      int error = 0;
+
+      mu_badv_mac_filter_refresh(filter_.get(), &error);
+      detail::check(error);
+   }
+
+   /// False if the address is certainly not in the mesh.
+   bool contains(const mac_addr &addr) const noexcept
+   {
+      const struct mu_mac_addr c_addr = addr.c_addr();
+
+      return mu_badv_mac_filter_contains(filter_.get(), &c_addr);
+   }
+
+   std::size_t size() const noexcept
+   {
+      return mu_badv_mac_filter_size(filter_.get());
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_mac_filter *const filter) const noexcept
+      {
+         mu_badv_mac_filter_free(filter);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_mac_filter, deleter> filter_;
+};
+
+/** Cached best gateway selector.
+ */
+class gw_selector {
+public:
+   explicit gw_selector(const char   *const interface_name = nullptr,
+                        const unsigned int  refresh_interval_ms = 0)
+   {
+      int error = 0;
+
+      selector_.reset(mu_badv_gw_selector_new(interface_name,
+                                              refresh_interval_ms, &error));
+      detail::check(error);
+   }
+
+   std::optional<struct mu_badv_gateway> best()
+   {
+      int                    error = 0;
+      struct mu_badv_gateway gateway;
+      const bool found = mu_badv_gw_selector_best(selector_.get(), &gateway,
+                                                  &error);
+
+      detail::check(error);
+      if (!found) {
+         return std::nullopt;
+      }
+      return gateway;
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_gw_selector *const selector) const noexcept
+      {
+         mu_badv_gw_selector_free(selector);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_gw_selector, deleter> selector_;
+};
+
+/** Per-node application state of type T, see pg_batman_adv_node_store.
+ *
+ * T is stored in zeroed memory and never constructed or destroyed, so it has
+ * to be trivial, e.g. a struct of std::atomic counters is not but one of
+ * integers updated with std::atomic_ref is.
+ */
+template <class T>
+class node_store {
+   static_assert(std::is_trivial_v<T>, "node state must be a trivial type");
+   static_assert(alignof(T) <= MU_BADV_NODE_SLOT_ALIGN,
+                 "node state alignment too large");
+
+public:
+   node_store()
+   {
+      int error = 0;
+
+      store_.reset(mu_badv_node_store_new(sizeof(T), &error));
+      detail::check(error);
+   }
+
+   /// The C handle, still owned by this object.
+   struct mu_badv_node_store *get() const noexcept { return store_.get(); }
+
+   void sync(const orig_table &table)
+   {
+      int error = 0;
+
+      mu_badv_node_store_sync(store_.get(), table.get(), &error);
+      detail::check(error);
+   }
+
+   T &add(const mac_addr &addr)
+   {
+      const struct mu_mac_addr c_addr = addr.c_addr();
+      int                      error  = 0;
+      void *const              slot   = mu_badv_node_store_add(store_.get(),
+                                                               &c_addr,
+                                                               &error);
+
+      detail::check(error);
+      return *static_cast<T *>(slot);
+   }
+
+   bool remove(const mac_addr &addr) noexcept
+   {
+      const struct mu_mac_addr c_addr = addr.c_addr();
+
+      return mu_badv_node_store_remove(store_.get(), &c_addr);
+   }
+
+   /// State of a node, nullptr if the node is not in the store. Lock-free.
+   T *find(const mac_addr &addr) const noexcept
+   {
+      const struct mu_mac_addr c_addr = addr.c_addr();
+
+      return static_cast<T *>(mu_badv_node_store_slot(store_.get(), &c_addr));
+   }
+
+   std::size_t size() const noexcept
+   {
+      return mu_badv_node_store_size(store_.get());
+   }
+
+   /// Calls f(mac_addr, T &) for every node. Lock-free.
+   template <class F>
+   void for_each(F &&f) const
+   {
+      auto call = [](const struct mu_mac_addr *const addr, void *const slot,
+                     void *const ctx) {
+         (*static_cast<std::remove_reference_t<F> *>(ctx))(
+            mac_addr(*addr), *static_cast<T *>(slot));
+      };
+
+      mu_badv_node_store_foreach(store_.get(), call, std::addressof(f));
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_node_store *const store) const noexcept
+      {
+         mu_badv_node_store_free(store);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_node_store, deleter> store_;
+};
+
+/** Asynchronous originator table refresh.
+ */
+class refresh {
+public:
+   explicit refresh(const char *const interface_name = nullptr)
+   {
+      int error = 0;
+
+      refresh_.reset(mu_badv_refresh_new(interface_name, &error));
+      detail::check(error);
+   }
+
+   /// Descriptor to poll for completion, owned by this object.
+   int fd() const noexcept { return mu_badv_refresh_fd(refresh_.get()); }
+
+   /// The C handle, still owned by this object.
+   struct mu_badv_refresh *get() const noexcept { return refresh_.get(); }
+
+   /// Sync a node store with every refreshed table; it has to outlive this.
+   template <class T>
+   void set_store(node_store<T> &store) noexcept
+   {
+      mu_badv_refresh_set_store(refresh_.get(), store.get());
+   }
+
+   void start()
+   {
+      int error = 0;
+
+      mu_badv_refresh_start(refresh_.get(), &error);
+      detail::check(error);
+   }
+
+   /// The refreshed table, nullopt if no refresh has completed.
+   std::optional<orig_table> collect()
+   {
+      int        error = 0;
+      orig_table table(mu_badv_refresh_collect(refresh_.get(), &error));
+
+      if (error == EAGAIN) {
+         return std::nullopt;
+      }
+      detail::check(error);
+      return table;
+   }
+
+   /// The refreshed table by deadline, and whether it is the last good one.
+   std::pair<orig_table, bool>
+   query(const std::chrono::steady_clock::time_point deadline)
+   {
+      using std::chrono::duration_cast;
+      using std::chrono::milliseconds;
+
+      const auto since_boot = deadline.time_since_epoch();
+      int        error      = 0;
+      bool       stale      = false;
+      orig_table table(mu_badv_refresh_query(
+         refresh_.get(),
+         since_boot.count() > 0
+            ? static_cast<std::uint64_t>(
+                 duration_cast<milliseconds>(since_boot).count())
+            : 0,
+         &stale, &error));
+
+      detail::check(error);
+      return {std::move(table), stale};
+   }
+
+   /// Give up on the refresh in progress, from any thread.
+   void cancel() noexcept { mu_badv_refresh_cancel(refresh_.get()); }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_refresh *const refresh) const noexcept
+      {
+         mu_badv_refresh_free(refresh);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_refresh, deleter> refresh_;
+};
+
+/** Shared memory snapshot publisher.
+ */
+class shm_publisher {
+public:
+   explicit shm_publisher(const char *const interface_name = nullptr)
+   {
+      int error = 0;
+
+      publisher_.reset(mu_badv_shm_publisher_new(interface_name, &error));
+      detail::check(error);
+   }
+
+   void publish()
+   {
+      int error = 0;
+
+      mu_badv_shm_publish(publisher_.get(), &error);
+      detail::check(error);
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_shm_publisher *const publisher)
+         const noexcept
+      {
+         mu_badv_shm_publisher_free(publisher);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_shm_publisher, deleter> publisher_;
+};
+
+/** Attachment to a shared memory snapshot, detached by the destructor.
+ */
+class shm_attachment {
+public:
+   explicit shm_attachment(const char *const interface_name = nullptr)
+      : interface_name_(interface_name ? interface_name : "")
+   {
+      int error = 0;
+
+      mu_badv_shm_attach(interface_name, &error);
+      detail::check(error);
+      attached_ = true;
+   }
+
+   shm_attachment(shm_attachment &&other) noexcept
+      : interface_name_(std::move(other.interface_name_)),
+        attached_(std::exchange(other.attached_, false)) {}
+
+   shm_attachment &operator=(shm_attachment &&other) noexcept
+   {
+      if (this != &other) {
+         detach();
+         interface_name_ = std::move(other.interface_name_);
+         attached_       = std::exchange(other.attached_, false);
+      }
+      return *this;
+   }
+
+   shm_attachment(const shm_attachment &)            = delete;
+   shm_attachment &operator=(const shm_attachment &) = delete;
+
+   ~shm_attachment() { detach(); }
+
+   void detach() noexcept
+   {
+      if (attached_) {
+         mu_badv_shm_detach(interface_name_.empty() ? nullptr
+                                                    : interface_name_.c_str());
+         attached_ = false;
+      }
+   }
+
+private:
+   std::string interface_name_;
+   bool        attached_ = false;
+};
+
+/** History log opened for appending.
+ */
+class history_writer {
+public:
+   explicit history_writer(
+      const        char                   *const path,
+      const struct mu_badv_history_config *const config = nullptr)
+   {
+      int error = 0;
+
+      writer_.reset(mu_badv_history_writer_open(path, config, &error));
+      detail::check(error);
+   }
+
+   void append(const orig_table &table, const std::uint64_t timestamp_ms)
+   {
+      int error = 0;
+
+      mu_badv_history_append(writer_.get(), table.get(), timestamp_ms, &error);
+      detail::check(error);
+   }
+
+   void record(const char *const interface_name = nullptr)
+   {
+      int error = 0;
+
+      mu_badv_history_record(writer_.get(), interface_name, &error);
+      detail::check(error);
+   }
+
+   void flush()
+   {
+      int error = 0;
+
+      mu_badv_history_flush(writer_.get(), &error);
+      detail::check(error);
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_history_writer *const writer)
+         const noexcept
+      {
+         mu_badv_history_writer_close(writer);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_history_writer, deleter> writer_;
+};
+
+/** History log opened for reading.
+ */
+class history_reader {
+public:
+   explicit history_reader(const char *const path)
+   {
+      int error = 0;
+
+      reader_.reset(mu_badv_history_reader_open(path, &error));
+      detail::check(error);
+   }
+
+   /// First and last timestamp of the log, nullopt if it is empty.
+   std::optional<std::pair<std::uint64_t, std::uint64_t>>
+   time_span() const noexcept
+   {
+      std::uint64_t first_ms = 0;
+      std::uint64_t last_ms  = 0;
+
+      if (!mu_badv_history_span(reader_.get(), &first_ms, &last_ms)) {
+         return std::nullopt;
+      }
+      return std::make_pair(first_ms, last_ms);
+   }
+
+   orig_table table_at(const std::uint64_t        timestamp_ms,
+                             std::uint64_t *const recorded_at_ms = nullptr)
+      const
+   {
+      int        error = 0;
+      orig_table table(mu_badv_history_table_at(reader_.get(), timestamp_ms,
+                                                recorded_at_ms, &error));
+
+      detail::check(error);
+      return table;
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_history_reader *const reader)
+         const noexcept
+      {
+         mu_badv_history_reader_close(reader);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_history_reader, deleter> reader_;
+};
+
+/** Links of a mesh merged from the originator tables of its nodes.
+ */
+class topology {
+public:
+   topology()
+   {
+      int error = 0;
+
+      topology_.reset(mu_badv_topology_new(&error));
+      detail::check(error);
+   }
+
+   void merge(const mac_addr      &reporter,
+              const orig_table    &table,
+              const std::uint64_t  report_ms)
+   {
+      int                      error  = 0;
+      const struct mu_mac_addr c_addr = reporter.c_addr();
+
+      mu_badv_topology_merge(topology_.get(), &c_addr, table.get(), report_ms,
+                             &error);
+      detail::check(error);
+   }
+
+   std::size_t expire(const std::uint64_t before_ms) noexcept
+   {
+      return mu_badv_topology_expire(topology_.get(), before_ms);
+   }
+
+   std::size_t n_nodes() const noexcept
+   {
+      return mu_badv_topology_n_nodes(topology_.get());
+   }
+
+   std::size_t n_links() const noexcept
+   {
+      return mu_badv_topology_n_links(topology_.get());
+   }
+
+   /// Next hop the reporter chose towards the destination.
+   std::optional<mac_addr> next_hop(const mac_addr &reporter,
+                                    const mac_addr &destination) const noexcept
+   {
+      const struct mu_mac_addr c_reporter    = reporter.c_addr();
+      const struct mu_mac_addr c_destination = destination.c_addr();
+      struct mu_mac_addr       next_hop;
+
+      if (!mu_badv_topology_next_hop(topology_.get(), &c_reporter,
+                                     &c_destination, &next_hop, nullptr)) {
+         return std::nullopt;
+      }
+      return mac_addr(next_hop);
+   }
+
+   /// Call f with every link of the topology.
+   template <class F>
+   void for_each_link(F &&f) const
+   {
+      auto call = [](const struct mu_badv_link *const link, void *const ctx) {
+         (*static_cast<std::remove_reference_t<F> *>(ctx))(*link);
+      };
+
+      mu_badv_topology_foreach_link(topology_.get(), call, std::addressof(f));
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_topology *const topology) const noexcept
+      {
+         mu_badv_topology_free(topology);
+      }
+   };
+
+   std::unique_ptr<struct mu_badv_topology, deleter> topology_;
+};
+
+/** Calls a function when nodes were not seen for longer than thresholds.
+ */
+class staleness {
+public:
+   using level_fn = std::function<void(const mac_addr &node,
+                                       unsigned int    level,
+                                       unsigned int    old_level,
+                                       std::uint64_t   last_seen_ms)>;
+
+   staleness(span<const std::uint32_t> thresholds_ms,
+             const std::uint32_t       hysteresis_ms,
+             level_fn                  fn,
+             const std::uint32_t       resolution_ms = 0)
+      : fn_(std::make_unique<level_fn>(std::move(fn)))
+   {
+      int  error = 0;
+      auto call  = [](const struct mu_mac_addr *const addr,
+                      const unsigned int level, const unsigned int old_level,
+                      const std::uint64_t last_seen_ms, void *const ctx) {
+         (*static_cast<level_fn *>(ctx))(mac_addr(*addr), level, old_level,
+                                          last_seen_ms);
+      };
+
+      watcher_.reset(mu_badv_staleness_new(thresholds_ms.data(),
+                                           thresholds_ms.size(), hysteresis_ms,
+                                           resolution_ms, call, fn_.get(),
+                                           &error));
+      detail::check(error);
+   }
+
+   void update(const orig_table &table, const std::uint64_t now_ms)
+   {
+      int error = 0;
+
+      mu_badv_staleness_update(watcher_.get(), table.get(), now_ms, &error);
+      detail::check(error);
+   }
+
+   /// Number of nodes whose level was raised.
+   std::size_t advance(const std::uint64_t now_ms)
+   {
+      return mu_badv_staleness_advance(watcher_.get(), now_ms);
+   }
+
+   /// Level of a node, nullopt if it is not watched.
+   std::optional<unsigned int> level(const mac_addr &node) const noexcept
+   {
+      const struct mu_mac_addr c_addr = node.c_addr();
+      const int level = mu_badv_staleness_level(watcher_.get(), &c_addr,
+                                                nullptr);
+
+      if (level < 0) {
+         return std::nullopt;
+      }
+      return static_cast<unsigned int>(level);
+   }
+
+   /// Stops watching a node, false if it was not watched.
+   bool remove(const mac_addr &node) noexcept
+   {
+      const struct mu_mac_addr c_addr = node.c_addr();
+
+      return mu_badv_staleness_remove(watcher_.get(), &c_addr);
+   }
+
+   std::size_t size() const noexcept
+   {
+      return mu_badv_staleness_n_nodes(watcher_.get());
+   }
+
+private:
+   struct deleter {
+      void operator()(struct mu_badv_staleness *const watcher) const noexcept
+      {
+         mu_badv_staleness_free(watcher);
+      }
+   };
+
+   std::unique_ptr<level_fn>                          fn_;
+   std::unique_ptr<struct mu_badv_staleness, deleter> watcher_;
+};
+
+} // namespace badv
+
+} // namespace meshutil
+
+#endif                          /* __linux */
+
+#endif                          /* MESHUTIL_HPP */
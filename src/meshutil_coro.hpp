@@ -0,0 +1,365 @@
+/** @file meshutil_coro.hpp
+ * C++20 coroutine interface for meshutil
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_cpp_coro C++20 coroutines
+ *
+ * meshutil_coro.hpp makes the blocking queries co_await-able. Awaiting
+ * suspends the coroutine, the query runs on another thread and the coroutine
+ * is resumed through an executor: any copyable callable taking a
+ * std::coroutine_handle<>, which typically posts the handle to the event loop
+ * of the calling coroutine:
+ *
+ *     auto on_loop = [&loop](std::coroutine_handle<> h) { loop.post(h); };
+ *
+ *     task<void> watch(const std::vector<std::string> &names)
+ *     {
+ *        auto table = co_await meshutil::coro::async_refresh(on_loop, "bat0");
+ *        bool up    = co_await meshutil::coro::async_if_up(on_loop, "bat0");
+ *        auto all   = co_await meshutil::coro::refresh_all(on_loop, names);
+ *     }
+ *
+ * inline_executor resumes on the thread which completed the query instead.
+ *
+ * The originator table refresh uses an asynchronous refresh handle (see
+ * pg_batman_adv_async), either a temporary one or one passed by the caller
+ * to avoid creating a worker thread per refresh. The other queries run on a
+ * short-lived thread each.
+ *
+ * when_all starts a vector of awaitables at once and resumes when the last one
+ * completed, so e.g. the tables of several interfaces are read in parallel.
+ * Errors are thrown from co_await as std::system_error.
+ *
+ * The library does not provide a coroutine (task) type; the awaitables work
+ * with any.
+ */
+
+#ifndef MESHUTIL_CORO_HPP
+#define MESHUTIL_CORO_HPP 1
+
+#if __cplusplus < 202002L || !__has_include(<coroutine>)
+#error "meshutil_coro.hpp requires C++20 coroutines"
+#endif
+
+#ifdef __linux
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "meshutil.hpp"
+
+namespace meshutil::coro {
+
+/*******************************************************************************
+*   EXECUTORS                                                                  *
+*******************************************************************************/
+
+/// Something that resumes a suspended coroutine, e.g. on an event loop.
+template <class E>
+concept executor = std::copy_constructible<E>
+                   && std::invocable<E &, std::coroutine_handle<>>;
+
+/// Resumes the coroutine on the thread which completed the query.
+struct inline_executor {
+   void operator()(const std::coroutine_handle<> handle) const
+   {
+      handle.resume();
+   }
+};
+
+/*******************************************************************************
+*   OPERATIONS                                                                 *
+*******************************************************************************/
+
+namespace detail {
+
+/* An operation is started once with a completion function, which it calls
+ * exactly once from any thread, and then asked for its result. The completion
+ * function is never stored in the operation while it is called, so it may
+ * destroy the operation.
+ */
+
+/// Reads an originator table through an asynchronous refresh handle.
+class refresh_op {
+public:
+   explicit refresh_op(const char *const interface_name)
+      : owned_(std::in_place, interface_name), handle_(owned_->get()) {}
+
+   explicit refresh_op(badv::refresh &refresh) noexcept
+      : handle_(refresh.get()) {}
+
+   void start(std::function<void()> done) noexcept
+   {
+      done_ = std::move(done);
+      mu_badv_refresh_set_notify(handle_, &refresh_op::notify, this);
+      mu_badv_refresh_start(handle_, nullptr);
+   }
+
+   badv::orig_table result()
+   {
+      int              error = 0;
+      badv::orig_table table(mu_badv_refresh_collect(handle_, &error));
+
+      meshutil::detail::check(error);
+      return table;
+   }
+
+private:
+   static void notify(void *const ctx)
+   {
+      refresh_op *const     self = static_cast<refresh_op *>(ctx);
+      std::function<void()> done = std::move(self->done_);
+
+      mu_badv_refresh_set_notify(self->handle_, nullptr, nullptr);
+      done();
+   }
+
+   std::optional<badv::refresh>  owned_;
+   struct mu_badv_refresh       *handle_ = nullptr;
+   std::function<void()>         done_;
+};
+
+/// Runs a blocking query on a thread of its own.
+template <class F>
+class offload_op {
+public:
+   using result_type = std::invoke_result_t<F &>;
+
+   explicit offload_op(F function) : function_(std::move(function)) {}
+
+   void start(const std::function<void()> &done) noexcept
+   {
+      try {
+         std::thread([this, done] {
+            try {
+               value_.emplace(function_());
+            } catch (...) {
+               error_ = std::current_exception();
+            }
+            done();
+         }).detach();
+      } catch (...) {
+         error_ = std::current_exception();
+         done();
+      }
+   }
+
+   result_type result()
+   {
+      if (error_) {
+         std::rethrow_exception(error_);
+      }
+      return std::move(*value_);
+   }
+
+private:
+   F                          function_;
+   std::optional<result_type> value_;
+   std::exception_ptr         error_;
+};
+
+/// Keeps an interface name for another thread, empty for the default.
+inline std::string copy_name(const char *const interface_name)
+{
+   return interface_name ? interface_name : "";
+}
+
+inline const char *name_arg(const std::string &name) noexcept
+{
+   return name.empty() ? nullptr : name.c_str();
+}
+
+} // namespace detail
+
+/*******************************************************************************
+*   AWAITABLES                                                                 *
+*******************************************************************************/
+
+template <class Op, executor E>
+class when_all_awaitable;
+
+/** co_await-able query, resumed through the executor.
+ */
+template <class Op, executor E>
+class [[nodiscard]] awaitable {
+public:
+   awaitable(E ex, Op op) : op_(std::move(op)), ex_(std::move(ex)) {}
+
+   bool await_ready() const noexcept { return false; }
+
+   void await_suspend(const std::coroutine_handle<> handle) noexcept
+   {
+      op_.start([ex = ex_, handle]() mutable { ex(handle); });
+   }
+
+   decltype(auto) await_resume() { return op_.result(); }
+
+private:
+   friend class when_all_awaitable<Op, E>;
+
+   Op op_;
+   E  ex_;
+};
+
+/** Awaits several queries started at once, see when_all().
+ */
+template <class Op, executor E>
+class [[nodiscard]] when_all_awaitable {
+public:
+   using result_type = std::decay_t<decltype(std::declval<Op &>().result())>;
+
+   explicit when_all_awaitable(std::vector<awaitable<Op, E>> awaitables)
+      : awaitables_(std::move(awaitables)) {}
+
+   bool await_ready() const noexcept { return awaitables_.empty(); }
+
+   /* One extra count keeps the last completion from resuming the coroutine
+    * while operations are still being started here.
+    */
+   bool await_suspend(const std::coroutine_handle<> handle) noexcept
+   {
+      const E ex = awaitables_.front().ex_;
+
+      pending_.store(awaitables_.size() + 1, std::memory_order_relaxed);
+      for (auto &awaitable : awaitables_) {
+         awaitable.op_.start([this, ex, handle]() mutable {
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+               ex(handle);
+            }
+         });
+      }
+      return pending_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+   }
+
+   /// Results in the order of the awaitables, the first error is thrown.
+   std::vector<result_type> await_resume()
+   {
+      std::vector<result_type> results;
+
+      results.reserve(awaitables_.size());
+      for (auto &awaitable : awaitables_) {
+         results.push_back(awaitable.op_.result());
+      }
+      return results;
+   }
+
+private:
+   std::vector<awaitable<Op, E>> awaitables_;
+   std::atomic<std::size_t>      pending_{0};
+};
+
+/*******************************************************************************
+*   QUERIES                                                                    *
+*******************************************************************************/
+
+/// Read the originator table of an interface on a temporary refresh handle.
+template <executor E>
+awaitable<detail::refresh_op, E>
+async_refresh(E ex, const char *const interface_name = nullptr)
+{
+   return {std::move(ex), detail::refresh_op(interface_name)};
+}
+
+/// Read the originator table through a refresh handle of the caller.
+template <executor E>
+awaitable<detail::refresh_op, E> async_refresh(E ex, badv::refresh &refresh)
+{
+   return {std::move(ex), detail::refresh_op(refresh)};
+}
+
+template <executor E>
+auto async_if_up(E ex, const char *const interface_name = nullptr)
+{
+   auto query = [name = detail::copy_name(interface_name)] {
+      return badv::if_up(detail::name_arg(name));
+   };
+
+   return awaitable<detail::offload_op<decltype(query)>, E>(
+      std::move(ex), detail::offload_op<decltype(query)>(std::move(query)));
+}
+
+template <executor E>
+auto async_mesh_node_addresses(E ex, const char *const interface_name = nullptr)
+{
+   auto query = [name = detail::copy_name(interface_name)] {
+      return badv::mesh_node_addresses(detail::name_arg(name));
+   };
+
+   return awaitable<detail::offload_op<decltype(query)>, E>(
+      std::move(ex), detail::offload_op<decltype(query)>(std::move(query)));
+}
+
+template <executor E>
+auto async_next_hop_addresses(E ex, const bool potential,
+                              const char *const interface_name = nullptr)
+{
+   auto query = [potential, name = detail::copy_name(interface_name)] {
+      return badv::next_hop_addresses(potential, detail::name_arg(name));
+   };
+
+   return awaitable<detail::offload_op<decltype(query)>, E>(
+      std::move(ex), detail::offload_op<decltype(query)>(std::move(query)));
+}
+
+/*******************************************************************************
+*   COMBINATORS                                                                *
+*******************************************************************************/
+
+/// Start all awaitables at once, resume when all of them completed.
+template <class Op, executor E>
+when_all_awaitable<Op, E> when_all(std::vector<awaitable<Op, E>> awaitables)
+{
+   return when_all_awaitable<Op, E>(std::move(awaitables));
+}
+
+/// Read the originator tables of several interfaces in parallel.
+template <executor E>
+when_all_awaitable<detail::refresh_op, E>
+refresh_all(E ex, const std::vector<std::string> &interface_names)
+{
+   std::vector<awaitable<detail::refresh_op, E>> awaitables;
+
+   awaitables.reserve(interface_names.size());
+   for (const auto &name : interface_names) {
+      awaitables.push_back(async_refresh(ex, name.c_str()));
+   }
+   return when_all(std::move(awaitables));
+}
+
+} // namespace meshutil::coro
+
+#endif                          /* __linux */
+
+#endif                          /* MESHUTIL_CORO_HPP */
@@ -0,0 +1,120 @@
+/** @file trace.h
+ * Internal static tracepoints of the meshutil library
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_trace   Static tracepoints
+ *
+ * Configured with -DMESHUTIL_USDT=ON the library carries USDT probes of the
+ * provider meshutil, which perf, bpftrace or SystemTap attach to in a running
+ * process. A probe nobody attached to is a single nop. Building with them
+ * needs sys/sdt.h, e.g. from the systemtap-sdt-dev package.
+ *
+ *     probe         arguments
+ *     read_start    path
+ *     read_done     path, bytes read, error code
+ *     parse_start   interface name, table name, bytes
+ *     parse_done    interface name, table name, entries parsed
+ *     index_start   index name, entries
+ *     index_done    index name, entries, 1 if built
+ *     call_start    function name, interface name
+ *     call_done     function name, interface name, error code
+ *
+ * Every start probe is followed by the done probe of the same name on the
+ * same thread. Calls are public functions reading a table or sysfs, e.g.
+ * mu_badv_mesh_n_nodes(), mu_badv_if_up() or mu_badv_shm_publish(); the
+ * interface name is empty for calls without one, such as the mu_badv_kmod_
+ * functions and mu_badv_caps_get(). Lookups in tables already read, such as
+ * mu_badv_mac_filter_contains(), have no probes. For example
+ *
+ *     bpftrace -e 'usdt:/usr/lib/libmeshutil.so:meshutil:call_start
+ *                  { @start[tid] = nsecs; }
+ *                  usdt:/usr/lib/libmeshutil.so:meshutil:call_done
+ *                  /@start[tid]/
+ *                  { @us[str(arg0)] = hist((nsecs - @start[tid]) / 1000);
+ *                    delete(@start[tid]); }'
+ *
+ * shows the latency of each call.
+ */
+
+#ifndef MESHUTIL_TRACE_H
+#define MESHUTIL_TRACE_H 1
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#ifdef MESHUTIL_USDT
+#include <sys/sdt.h>
+#endif
+
+/*******************************************************************************
+*   FUNCTION MACROS                                                            *
+*******************************************************************************/
+
+#ifdef MESHUTIL_USDT
+
+/// Interface name of a call, resolving NULL like the batman_adv functions.
+#define MU_TRACE_IF(interface_name) \
+   ((interface_name) ? (interface_name) : BATMAN_ADV_DEFAULT_IF)
+
+/// Error code behind an error pointer which can be NULL.
+#define MU_TRACE_ERROR(error) ((error) ? *(error) : 0)
+
+#define MU_TRACE_READ_START(path) \
+   DTRACE_PROBE1(meshutil, read_start, path)
+#define MU_TRACE_READ_DONE(path, bytes, error) \
+   DTRACE_PROBE3(meshutil, read_done, path, (size_t) (bytes), \
+                 MU_TRACE_ERROR(error))
+
+#define MU_TRACE_PARSE_START(interface_name, table, bytes) \
+   DTRACE_PROBE3(meshutil, parse_start, MU_TRACE_IF(interface_name), table, \
+                 (size_t) (bytes))
+#define MU_TRACE_PARSE_DONE(interface_name, table, n_entries) \
+   DTRACE_PROBE3(meshutil, parse_done, MU_TRACE_IF(interface_name), table, \
+                 (size_t) (n_entries))
+
+#define MU_TRACE_INDEX_START(index, n_entries) \
+   DTRACE_PROBE2(meshutil, index_start, index, (size_t) (n_entries))
+#define MU_TRACE_INDEX_DONE(index, n_entries, built) \
+   DTRACE_PROBE3(meshutil, index_done, index, (size_t) (n_entries), \
+                 (int) (built))
+
+#define MU_TRACE_CALL_START(interface_name) \
+   DTRACE_PROBE2(meshutil, call_start, __func__, MU_TRACE_IF(interface_name))
+#define MU_TRACE_CALL_DONE(interface_name, error) \
+   DTRACE_PROBE3(meshutil, call_done, __func__, MU_TRACE_IF(interface_name), \
+                 MU_TRACE_ERROR(error))
+
+#else                           /* MESHUTIL_USDT */
+
+#define MU_TRACE_READ_START(path)                             do { } while (0)
+#define MU_TRACE_READ_DONE(path, bytes, error)                do { } while (0)
+#define MU_TRACE_PARSE_START(interface_name, table, bytes)    do { } while (0)
+#define MU_TRACE_PARSE_DONE(interface_name, table, n_entries) do { } while (0)
+#define MU_TRACE_INDEX_START(index, n_entries)                do { } while (0)
+#define MU_TRACE_INDEX_DONE(index, n_entries, built)          do { } while (0)
+#define MU_TRACE_CALL_START(interface_name)                   do { } while (0)
+#define MU_TRACE_CALL_DONE(interface_name, error)             do { } while (0)
+
+#endif                          /* MESHUTIL_USDT */
+
+#endif                          /* MESHUTIL_TRACE_H */
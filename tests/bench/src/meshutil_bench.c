@@ -0,0 +1,1508 @@
+/** @file meshutil_bench.c
+ * Benchmarks of the meshutil API against generated batman_adv tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_bench Benchmarks
+ *
+ *     meshutil_bench [-s sizes] [-f fan-outs] [-i iterations] [-t threads]
+ *                    [-b filter] [-o output.json]
+ *
+ * For every combination of originator count (-s, default 10,1000,10000,100000)
+ * and potential next hops per originator (-f, default 1,4,16) a fixture
+ * debugfs tree is written to a temporary directory and the library is pointed
+ * at it with MESHUTIL_DEBUGFS_ROOT. Every benchmarked function is then called
+ * -i times (default: scaled down with the table size) by each of -t threads
+ * (default 1). With more than one thread all threads call the same function at
+ * the same time, which measures contention; functions meant for a single
+ * writer (history writing, shared memory publishing and the topology only the
+ * first thread keeps) are skipped then. -b only runs
+ * functions whose name contains the filter string.
+ *
+ * The results are written as JSON: per function and fixture the latency
+ * percentiles in nanoseconds, and per call the number and bytes of
+ * allocations (counted through mu_set_allocator) and the bytes read from
+ * files (from /proc/self/io, including reads of worker threads).
+ *
+ * Functions probing the system rather than debugfs (kernel module and
+ * interface state) run against the real system and are reported once with
+ * "nodes": 0. Calls which fail are counted as errors.
+ *
+ * Functions which only return a field or release an object (the *_free,
+ * *_close and *_size functions, mu_badv_topology_n_links() and the like) and
+ * the process-wide switches (mu_badv_set_orig_index(),
+ * mu_badv_set_parallel_parse()) are not timed on their own; closing and
+ * freeing is timed together with opening where that is the common pattern.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batman_adv.h"
+#include "batman_adv_async.h"
+#include "batman_adv_cache.h"
+#include "batman_adv_caps.h"
+#include "batman_adv_dat.h"
+#include "batman_adv_gateways.h"
+#include "batman_adv_history.h"
+#include "batman_adv_mac_filter.h"
+#include "batman_adv_neighbors.h"
+#include "batman_adv_node_store.h"
+#include "batman_adv_originators.h"
+#include "batman_adv_shm.h"
+#include "batman_adv_staleness.h"
+#include "batman_adv_topology.h"
+#include "linux.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+#define BENCH_IF "bat0"
+
+/// Originators asked for in the top-k case.
+#define BENCH_TOP_K 10
+
+/// Links asked for in the topology lookup cases.
+#define BENCH_MAX_LINKS 16
+
+/// Tables in the log the history reader cases read, one per second.
+#define HISTORY_READ_TABLES 32
+
+#define DEFAULT_SIZES   "10,1000,10000,100000"
+#define DEFAULT_FANOUTS "1,4,16"
+
+#define MAX_LIST        16
+#define MAX_THREADS     256
+
+/// Calls per function and thread are about this divided by the table size.
+#define ITERATION_BUDGET 2000000
+#define MIN_ITERATIONS   5
+#define MAX_ITERATIONS   2000
+
+/// Time to live of the table cache in the [cache] cases, longer than a case.
+#define CACHE_TTL_MS 3600000
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct fixture {
+   size_t       n_nodes;
+   unsigned int fanout;
+   char         root[64];
+};
+
+/// Per thread state the benchmarked calls work on.
+struct bench_state {
+   const struct fixture          *fixture;
+   struct mu_bat_mesh_node        node;
+   struct mu_mac_addr             mac_addr;
+   uint32_t                       dat_ipv4;
+   struct mu_badv_orig_table     *table;
+   struct mu_badv_orig_table     *indexed_table;
+   struct mu_badv_dat_index      *dat_index;
+   struct mu_badv_mac_filter     *mac_filter;
+   struct mu_badv_gw_selector    *gw_selector;
+   struct mu_badv_refresh        *refresh;
+   struct mu_badv_refresh        *notified_refresh;
+   sem_t                          notified;
+   bool                           has_notified;
+   struct mu_badv_history_writer *history;
+   char                           history_path[80];
+   uint64_t                       history_ms;
+   struct mu_badv_history_reader *history_reader;
+   char                           history_read_path[96];
+   struct mu_badv_staleness      *staleness;
+   uint64_t                       staleness_ms;
+   struct mu_badv_shm_publisher  *publisher;
+   struct mu_badv_topology       *topology;
+   uint64_t                       topology_ms;
+};
+
+struct bench_case {
+   const char *name;
+   bool        system;        ///< Does not read debugfs.
+   bool        single_writer; ///< Not run with several threads.
+   bool      (*run)(struct bench_state *const state, int *const error);
+};
+
+struct thread_job {
+   const struct bench_case *bench;
+   struct bench_state       state;
+   size_t                   iterations;
+   uint64_t                *latencies_ns;
+   size_t                   errors;
+   pthread_barrier_t       *barrier;
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+static uint64_t n_allocations;
+static uint64_t allocated_bytes;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+/// Staleness levels of the staleness cases.
+static const uint32_t stale_thresholds[] = {10000, 60000, 600000};
+
+/// Node store shared by all threads, synced with the fixture.
+static struct mu_badv_node_store *node_store;
+
+/*******************************************************************************
+*   COUNTING ALLOCATOR                                                         *
+*******************************************************************************/
+
+static void *counting_alloc(size_t size, void *ctx)
+{
+   (void) ctx;
+   __atomic_add_fetch(&n_allocations, 1, __ATOMIC_RELAXED);
+   __atomic_add_fetch(&allocated_bytes, size, __ATOMIC_RELAXED);
+   return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *ctx)
+{
+   (void) ctx;
+   __atomic_add_fetch(&n_allocations, 1, __ATOMIC_RELAXED);
+   __atomic_add_fetch(&allocated_bytes, size, __ATOMIC_RELAXED);
+   return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *ctx)
+{
+   (void) ctx;
+   free(ptr);
+}
+
+/*******************************************************************************
+*   MEASUREMENT HELPERS                                                        *
+*******************************************************************************/
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/// Bytes read by the process so far ("rchar" of /proc/self/io).
+static uint64_t bytes_read(void)
+{
+   char                buffer[512];
+   unsigned long long  rchar = 0;
+   FILE               *io    = fopen("/proc/self/io", "r");
+
+   if (!io) {
+      return 0;
+   }
+   while (fgets(buffer, sizeof(buffer), io)) {
+      if (sscanf(buffer, "rchar: %llu", &rchar) == 1) {
+         break;
+      }
+   }
+   fclose(io);
+   return rchar;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+   const uint64_t x = *(const uint64_t *) a;
+   const uint64_t y = *(const uint64_t *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const uint64_t *const sorted,
+                           const size_t          n,
+                           const double          p)
+{
+   size_t index = (size_t) (p * (double) (n - 1) + 0.5);
+
+   return sorted[index < n ? index : n - 1];
+}
+
+static uint32_t random_u32(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 7;
+   rng_state ^= rng_state << 17;
+   return (uint32_t) (rng_state >> 32);
+}
+
+static size_t parse_list(const char *str, size_t *const values)
+{
+   size_t n = 0;
+   char  *end;
+
+   while (*str && n < MAX_LIST) {
+      values[n++] = strtoul(str, &end, 10);
+      str = *end == ',' ? end + 1 : end;
+      if (end == str && *str) {
+         break;
+      }
+   }
+   return n;
+}
+
+/*******************************************************************************
+*   FIXTURES                                                                   *
+*******************************************************************************/
+
+static void node_mac(const size_t index, char *const str)
+{
+   sprintf(str, "02:%02x:%02x:%02x:%02x:%02x",
+           (unsigned int) (index >> 24) & 0xff, (unsigned int) (index >> 16) & 0xff,
+           (unsigned int) (index >> 8) & 0xff, (unsigned int) index & 0xff, 1u);
+}
+
+static const char *node_if(const size_t index)
+{
+   return index % 2 ? "wlan0" : "eth0";
+}
+
+static FILE *open_table(const struct fixture *const fixture,
+                        const char           *const table)
+{
+   char path[128];
+
+   snprintf(path, sizeof(path), "%s/batman_adv/" BENCH_IF "/%s",
+            fixture->root, table);
+   return fopen(path, "w");
+}
+
+/* Neighbours are the first fanout nodes; every originator lists all of them as
+ * potential next hops and uses one as the actual next hop.
+ */
+static bool write_originators(const struct fixture *const fixture)
+{
+   FILE  *file = open_table(fixture, "originators");
+   char   mac[MU_MAC_ADDR_STR_LEN + 1];
+   char   hop[MU_MAC_ADDR_STR_LEN + 1];
+   size_t n_neighbors = fixture->fanout < fixture->n_nodes
+                        ? fixture->fanout : fixture->n_nodes;
+
+   if (!file) {
+      return false;
+   }
+
+   fprintf(file, "[B.A.T.M.A.N. adv 2011.4.0, MainIF/MAC: "
+                 "eth0/02:ba:7a:df:04:00 (" BENCH_IF ")]\n"
+                 "  Originator      last-seen (#/255)           "
+                 "Nexthop [outgoingIF]:   Potential nexthops ...\n");
+
+   for (size_t i = 0; i < fixture->n_nodes; i++) {
+      size_t   next_hop = i % n_neighbors;
+      uint32_t seen_ms  = random_u32() % 200000;
+
+      node_mac(i, mac);
+      node_mac(next_hop, hop);
+      fprintf(file, "%s %4u.%03us   (%3u) %s [%10s]:", mac,
+              seen_ms / 1000, seen_ms % 1000, 255 - (unsigned int) (i % 200),
+              hop, node_if(next_hop));
+      for (size_t h = 0; h < n_neighbors; h++) {
+         node_mac(h, hop);
+         fprintf(file, " %s (%3u)", hop, random_u32() % 256);
+      }
+      fputc('\n', file);
+   }
+
+   return fclose(file) == 0;
+}
+
+static bool write_neighbors(const struct fixture *const fixture)
+{
+   FILE  *file = open_table(fixture, "neighbors");
+   char   mac[MU_MAC_ADDR_STR_LEN + 1];
+   size_t n_neighbors = fixture->fanout < fixture->n_nodes
+                        ? fixture->fanout : fixture->n_nodes;
+
+   if (!file) {
+      return false;
+   }
+
+   fprintf(file, "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: "
+                 "eth0/02:ba:7a:df:04:00 (" BENCH_IF
+                 "/02:ba:7a:df:04:00 BATMAN_IV)]\n"
+                 "IF             Neighbor              last-seen\n");
+   for (size_t i = 0; i < n_neighbors; i++) {
+      node_mac(i, mac);
+      fprintf(file, "%12s     %s %4u.%03us\n", node_if(i), mac,
+              (unsigned int) i % 10, (unsigned int) (i * 37) % 1000);
+   }
+
+   return fclose(file) == 0;
+}
+
+/// One gateway per 50 originators, the first one selected.
+static bool write_gateways(const struct fixture *const fixture)
+{
+   FILE *file = open_table(fixture, "gateways");
+   char  mac[MU_MAC_ADDR_STR_LEN + 1];
+   char  hop[MU_MAC_ADDR_STR_LEN + 1];
+
+   if (!file) {
+      return false;
+   }
+
+   fprintf(file, "[B.A.T.M.A.N. adv 2011.4.0, MainIF/MAC: "
+                 "eth0/02:ba:7a:df:04:00 (" BENCH_IF ")]\n"
+                 "      Gateway      (#/255)           "
+                 "Nexthop [outgoingIF]: gw_class ...\n");
+   for (size_t i = 0; i < fixture->n_nodes; i += 50) {
+      node_mac(i, mac);
+      node_mac(i % fixture->fanout, hop);
+      fprintf(file, "%s %s (%3u) %s [%10s]: %u.0/%u.0 MBit\n",
+              i ? "  " : "=>", mac, 100 + (unsigned int) (i % 150), hop,
+              node_if(i % fixture->fanout), 1 + (unsigned int) (i % 100),
+              1 + (unsigned int) (i % 20));
+   }
+
+   return fclose(file) == 0;
+}
+
+static bool write_dat_cache(const struct fixture *const fixture)
+{
+   FILE *file = open_table(fixture, "dat_cache");
+   char  mac[MU_MAC_ADDR_STR_LEN + 1];
+
+   if (!file) {
+      return false;
+   }
+
+   fprintf(file, "Distributed ARP Table (" BENCH_IF "):\n"
+                 "          IPv4             MAC        VID   last-seen\n");
+   for (size_t i = 0; i < fixture->n_nodes; i++) {
+      node_mac(i, mac);
+      fprintf(file, " * %15u.%u.%u.%u %s %4d %6u:%02u\n",
+              10u, (unsigned int) (i >> 16) & 0xff,
+              (unsigned int) (i >> 8) & 0xff, (unsigned int) i & 0xff, mac,
+              -1, (unsigned int) (i % 5), (unsigned int) (i % 60));
+   }
+
+   return fclose(file) == 0;
+}
+
+/// Two clients per originator, announced through it.
+static bool write_transtable_global(const struct fixture *const fixture)
+{
+   FILE *file = open_table(fixture, "transtable_global");
+   char  mac[MU_MAC_ADDR_STR_LEN + 1];
+
+   if (!file) {
+      return false;
+   }
+
+   fprintf(file, "Globally announced TT entries received via the mesh "
+                 BENCH_IF "\n"
+                 "       Client        (TTVN)       Originator      "
+                 "(Curr TTVN)\n");
+   for (size_t i = 0; i < fixture->n_nodes; i++) {
+      node_mac(i, mac);
+      for (unsigned int c = 0; c < 2; c++) {
+         fprintf(file, " * 06:%02x:%02x:%02x:%02x:%02x  (%3u) via %s     "
+                       "(%3u)   [..]\n",
+                 (unsigned int) (i >> 24) & 0xff,
+                 (unsigned int) (i >> 16) & 0xff,
+                 (unsigned int) (i >> 8) & 0xff, (unsigned int) i & 0xff, c,
+                 1u, mac, 1u);
+      }
+   }
+
+   return fclose(file) == 0;
+}
+
+static bool create_fixture(struct fixture *const fixture)
+{
+   const char *tmpdir = getenv("TMPDIR");
+   char        path[128];
+
+   snprintf(fixture->root, sizeof(fixture->root), "%s/meshutil_bench.XXXXXX",
+            tmpdir && *tmpdir ? tmpdir : "/tmp");
+   if (!mkdtemp(fixture->root)) {
+      return false;
+   }
+
+   snprintf(path, sizeof(path), "%s/batman_adv", fixture->root);
+   mkdir(path, 0755);
+   snprintf(path, sizeof(path), "%s/batman_adv/" BENCH_IF, fixture->root);
+   if (mkdir(path, 0755)) {
+      return false;
+   }
+
+   rng_state = 0x9e3779b97f4a7c15ULL ^ fixture->n_nodes ^
+               ((uint64_t) fixture->fanout << 40);
+   return write_originators(fixture) && write_neighbors(fixture)
+          && write_gateways(fixture) && write_dat_cache(fixture)
+          && write_transtable_global(fixture);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+                        struct FTW *ftw)
+{
+   (void) st;
+   (void) flag;
+   (void) ftw;
+   return remove(path);
+}
+
+static void remove_fixture(const struct fixture *const fixture)
+{
+   nftw(fixture->root, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+/*******************************************************************************
+*   BENCHMARKED CALLS                                                          *
+*******************************************************************************/
+
+static bool run_kmod_available(struct bench_state *const state,
+                               int                *const error)
+{
+   (void) state;
+   mu_badv_kmod_available(error);
+   return true;
+}
+
+static bool run_kmod_loaded(struct bench_state *const state,
+                            int                *const error)
+{
+   (void) state;
+   mu_badv_kmod_loaded(error);
+   return true;
+}
+
+static bool run_kmod_version(struct bench_state *const state,
+                             int                *const error)
+{
+   (void) state;
+   char *version = mu_badv_kmod_version(error);
+
+   mu_free(version);
+   return version != NULL;
+}
+
+static bool run_if_available(struct bench_state *const state,
+                             int                *const error)
+{
+   (void) state;
+   mu_badv_if_available(BENCH_IF, error);
+   return true;
+}
+
+static bool run_if_up(struct bench_state *const state, int *const error)
+{
+   (void) state;
+   mu_badv_if_up(BENCH_IF, error);
+   return true;
+}
+
+static bool run_if_hwaddr(struct bench_state *const state, int *const error)
+{
+   (void) state;
+   char *hwaddr = mu_badv_if_hwaddr(BENCH_IF, error);
+
+   mu_free(hwaddr);
+   return hwaddr != NULL;
+}
+
+static bool run_debugfs_mount_point(struct bench_state *const state,
+                                    int                *const error)
+{
+   (void) state;
+   char *mount_point = mu_linux_debugfs_mount_point(error);
+
+   mu_free(mount_point);
+   return mount_point != NULL;
+}
+
+static bool run_mesh_n_nodes(struct bench_state *const state,
+                             int                *const error)
+{
+   (void) state;
+   return mu_badv_mesh_n_nodes(BENCH_IF, error) > 0;
+}
+
+static void free_node_list(struct mu_bat_mesh_node *node)
+{
+   struct mu_bat_mesh_node *next;
+
+   while (node) {
+      next = node->next;
+      mu_free(node);
+      node = next;
+   }
+}
+
+static bool run_mesh_node_addresses(struct bench_state *const state,
+                                    int                *const error)
+{
+   (void) state;
+   struct mu_bat_mesh_node *nodes =
+      mu_badv_mesh_node_addresses(BENCH_IF, NULL, error);
+
+   free_node_list(nodes);
+   return nodes != NULL;
+}
+
+static bool run_next_hop_addresses(struct bench_state *const state,
+                                   int                *const error)
+{
+   (void) state;
+   struct mu_bat_mesh_node *nodes =
+      mu_badv_next_hop_addresses(BENCH_IF, false, NULL, error);
+
+   free_node_list(nodes);
+   return nodes != NULL;
+}
+
+static bool run_potential_next_hop_addresses(struct bench_state *const state,
+                                             int                *const error)
+{
+   (void) state;
+   struct mu_bat_mesh_node *nodes =
+      mu_badv_next_hop_addresses(BENCH_IF, true, NULL, error);
+
+   free_node_list(nodes);
+   return nodes != NULL;
+}
+
+static bool run_node_is_next_hop(struct bench_state *const state,
+                                 int                *const error)
+{
+   mu_badv_node_is_next_hop(BENCH_IF, &state->node, true, error);
+   return true;
+}
+
+static bool run_node_accessible_via_if(struct bench_state *const state,
+                                       int                *const error)
+{
+   char *ifname = mu_badv_node_accessible_via_if(BENCH_IF, &state->node,
+                                                 error);
+
+   mu_free(ifname);
+   return ifname != NULL;
+}
+
+static bool run_node_last_seen(struct bench_state *const state,
+                               int                *const error)
+{
+   mu_badv_node_last_seen(BENCH_IF, &state->node, error);
+   return true;
+}
+
+static bool run_node_next_hop(struct bench_state *const state,
+                              int                *const error)
+{
+   struct mu_bat_mesh_node *next_hop =
+      mu_badv_node_next_hop(BENCH_IF, &state->node, error);
+
+   if (next_hop != &state->node) {
+      mu_free(next_hop);
+   }
+   return next_hop != NULL;
+}
+
+static bool run_orig_table_read(struct bench_state *const state,
+                                int                *const error)
+{
+   (void) state;
+   struct mu_badv_orig_table *table = mu_badv_orig_table_read(BENCH_IF, error);
+
+   mu_badv_orig_table_free(table);
+   return table != NULL;
+}
+
+static bool run_orig_table_find(struct bench_state *const state,
+                                int                *const error)
+{
+   (void) error;
+   return mu_badv_orig_table_find(state->table, &state->mac_addr) != NULL;
+}
+
+static bool run_orig_index_find(struct bench_state *const state,
+                                int                *const error)
+{
+   (void) error;
+   return mu_badv_orig_table_find(state->indexed_table,
+                                  &state->mac_addr) != NULL;
+}
+
+static bool run_orig_top_k(struct bench_state *const state,
+                           int                *const error)
+{
+   (void) state;
+   struct mu_badv_originator top[BENCH_TOP_K];
+
+   mu_badv_orig_top_k(BENCH_IF, MU_BADV_TOP_STALEST, false, top, BENCH_TOP_K,
+                      error);
+   return !*error;
+}
+
+static bool run_neighbors(struct bench_state *const state, int *const error)
+{
+   (void) state;
+   struct mu_badv_neighbor *neighbors = mu_badv_neighbors(BENCH_IF, NULL,
+                                                          error);
+
+   mu_free(neighbors);
+   return neighbors != NULL;
+}
+
+static bool run_gateways(struct bench_state *const state, int *const error)
+{
+   (void) state;
+   struct mu_badv_gateway *gateways = mu_badv_gateways(BENCH_IF, NULL, error);
+
+   mu_free(gateways);
+   return gateways != NULL;
+}
+
+static bool run_gw_selector_best(struct bench_state *const state,
+                                 int                *const error)
+{
+   struct mu_badv_gateway gateway;
+
+   return mu_badv_gw_selector_best(state->gw_selector, &gateway, error);
+}
+
+static bool run_dat_index_refresh(struct bench_state *const state,
+                                  int                *const error)
+{
+   return mu_badv_dat_index_refresh(state->dat_index, error);
+}
+
+static bool run_dat_lookup(struct bench_state *const state, int *const error)
+{
+   (void) error;
+   return mu_badv_dat_lookup(state->dat_index, state->dat_ipv4,
+                             MU_BADV_DAT_VID_ANY, NULL);
+}
+
+static bool run_dat_index_entries(struct bench_state *const state,
+                                  int                *const error)
+{
+   const struct mu_badv_dat_entry *entries   = NULL;
+   size_t                          n_entries = 0;
+   uint32_t                        sum       = 0;
+
+   (void) error;
+   entries = mu_badv_dat_index_entries(state->dat_index, &n_entries);
+   for (size_t i = 0; i < n_entries; i++) {
+      sum += entries[i].last_seen_secs;
+   }
+   return entries != NULL && sum != UINT32_MAX;
+}
+
+static bool run_caps_get(struct bench_state *const state, int *const error)
+{
+   (void) state;
+   struct mu_badv_caps caps;
+
+   return mu_badv_caps_get(&caps, error);
+}
+
+static bool run_caps_probe(struct bench_state *const state, int *const error)
+{
+   (void) state;
+   struct mu_badv_caps caps;
+
+   mu_badv_caps_invalidate();
+   return mu_badv_caps_get(&caps, error);
+}
+
+static bool run_refresh(struct bench_state *const state, int *const error)
+{
+   struct mu_badv_orig_table *table = NULL;
+   fd_set                     fds;
+
+   if (!mu_badv_refresh_start(state->refresh, error)) {
+      return false;
+   }
+   FD_ZERO(&fds);
+   FD_SET(mu_badv_refresh_fd(state->refresh), &fds);
+   select(mu_badv_refresh_fd(state->refresh) + 1, &fds, NULL, NULL, NULL);
+
+   table = mu_badv_refresh_collect(state->refresh, error);
+   mu_badv_orig_table_free(table);
+   return table != NULL;
+}
+
+static bool run_refresh_notify(struct bench_state *const state,
+                               int                *const error)
+{
+   if (!mu_badv_refresh_start(state->notified_refresh, error)) {
+      return false;
+   }
+   while (sem_wait(&state->notified) && errno == EINTR) {
+      ;
+   }
+   return true;
+}
+
+static bool run_refresh_query(struct bench_state *const state,
+                              int                *const error)
+{
+   struct mu_badv_orig_table *table = NULL;
+   bool                       stale = false;
+
+   table = mu_badv_refresh_query(state->refresh, now_ns() / 1000000 + 60000,
+                                 &stale, error);
+   mu_badv_orig_table_free(table);
+   return table != NULL && !stale;
+}
+
+static bool run_refresh_cancel(struct bench_state *const state,
+                               int                *const error)
+{
+   if (!mu_badv_refresh_start(state->refresh, error)) {
+      return false;
+   }
+   mu_badv_refresh_cancel(state->refresh);
+   return true;
+}
+
+static bool run_history_append(struct bench_state *const state,
+                               int                *const error)
+{
+   state->history_ms += 1000;
+   return mu_badv_history_append(state->history, state->table,
+                                 state->history_ms, error);
+}
+
+static bool run_history_flush(struct bench_state *const state,
+                              int                *const error)
+{
+   return run_history_append(state, error)
+          && mu_badv_history_flush(state->history, error);
+}
+
+/// Stamped with the wall clock, so it runs after the appends.
+static bool run_history_record(struct bench_state *const state,
+                               int                *const error)
+{
+   return mu_badv_history_record(state->history, BENCH_IF, error);
+}
+
+static bool run_history_reader_open(struct bench_state *const state,
+                                    int                *const error)
+{
+   struct mu_badv_history_reader *reader = NULL;
+
+   reader = mu_badv_history_reader_open(state->history_read_path, error);
+   mu_badv_history_reader_close(reader);
+   return reader != NULL;
+}
+
+static bool run_history_span(struct bench_state *const state,
+                             int                *const error)
+{
+   uint64_t first_ms;
+   uint64_t last_ms;
+
+   (void) error;
+   return mu_badv_history_span(state->history_reader, &first_ms, &last_ms);
+}
+
+static bool run_history_table_at(struct bench_state *const state,
+                                 int                *const error)
+{
+   struct mu_badv_orig_table *table = NULL;
+
+   table = mu_badv_history_table_at(state->history_reader,
+                                    random_u32() % (HISTORY_READ_TABLES * 1000),
+                                    NULL, error);
+   mu_badv_orig_table_free(table);
+   return table != NULL;
+}
+
+static bool run_staleness_update(struct bench_state *const state,
+                                 int                *const error)
+{
+   state->staleness_ms += 1000;
+   return mu_badv_staleness_update(state->staleness, state->table,
+                                   state->staleness_ms, error);
+}
+
+static bool run_staleness_advance(struct bench_state *const state,
+                                  int                *const error)
+{
+   (void) error;
+   state->staleness_ms += 1000;
+   mu_badv_staleness_advance(state->staleness, state->staleness_ms);
+   return true;
+}
+
+static bool run_staleness_level(struct bench_state *const state,
+                                int                *const error)
+{
+   (void) error;
+   return mu_badv_staleness_level(state->staleness, &state->mac_addr,
+                                  NULL) >= 0;
+}
+
+static bool run_shm_publish(struct bench_state *const state,
+                            int                *const error)
+{
+   return mu_badv_shm_publish(state->publisher, error);
+}
+
+static bool run_mac_filter_refresh(struct bench_state *const state,
+                                   int                *const error)
+{
+   return mu_badv_mac_filter_refresh(state->mac_filter, error);
+}
+
+static bool run_mac_filter_contains(struct bench_state *const state,
+                                    int                *const error)
+{
+   (void) error;
+   return mu_badv_mac_filter_contains(state->mac_filter, &state->mac_addr);
+}
+
+static bool run_node_store_sync(struct bench_state *const state,
+                                int                *const error)
+{
+   return mu_badv_node_store_sync(node_store, state->table, error);
+}
+
+static bool run_node_store_slot(struct bench_state *const state,
+                                int                *const error)
+{
+   uint64_t *probes = mu_badv_node_store_slot(node_store, &state->mac_addr);
+
+   (void) error;
+   if (probes) {
+      __atomic_add_fetch(probes, 1, __ATOMIC_RELAXED);
+   }
+   return probes != NULL;
+}
+
+static bool run_topology_merge(struct bench_state *const state,
+                               int                *const error)
+{
+   return mu_badv_topology_merge(state->topology, &state->mac_addr,
+                                 state->table, ++state->topology_ms, error);
+}
+
+static bool run_topology_links(struct bench_state *const state,
+                               int                *const error)
+{
+   struct mu_badv_link links[BENCH_MAX_LINKS];
+
+   (void) error;
+   return mu_badv_topology_links(state->topology, &state->mac_addr, links,
+                                 BENCH_MAX_LINKS) > 0;
+}
+
+static bool run_topology_hearers(struct bench_state *const state,
+                                 int                *const error)
+{
+   struct mu_badv_link links[BENCH_MAX_LINKS];
+
+   (void) error;
+   return mu_badv_topology_hearers(state->topology,
+                                   &state->table->originators[0].mac_addr,
+                                   links, BENCH_MAX_LINKS) > 0;
+}
+
+static bool run_topology_next_hop(struct bench_state *const state,
+                                  int                *const error)
+{
+   struct mu_mac_addr next_hop;
+   uint32_t           metric;
+
+   (void) error;
+   return mu_badv_topology_next_hop(state->topology, &state->mac_addr,
+                                    &state->table->originators[0].mac_addr,
+                                    &next_hop, &metric);
+}
+
+static void count_link(const struct mu_badv_link *const link, void *const ctx)
+{
+   (void) link;
+   ++*(size_t *) ctx;
+}
+
+static bool run_topology_foreach_link(struct bench_state *const state,
+                                      int                *const error)
+{
+   size_t n_links = 0;
+
+   (void) error;
+   mu_badv_topology_foreach_link(state->topology, count_link, &n_links);
+   return n_links > 0;
+}
+
+/// Expires nothing, all links were seen at the last merge: a full scan.
+static bool run_topology_expire(struct bench_state *const state,
+                                int                *const error)
+{
+   (void) error;
+   mu_badv_topology_expire(state->topology, state->topology_ms);
+   return true;
+}
+
+static bool run_shm_orig_table_read(struct bench_state *const state,
+                                    int                *const error)
+{
+   return run_orig_table_read(state, error);
+}
+
+static const struct bench_case bench_cases[] = {
+   {"mu_badv_kmod_available",            true,  false, run_kmod_available},
+   {"mu_badv_kmod_loaded",               true,  false, run_kmod_loaded},
+   {"mu_badv_kmod_version",              true,  false, run_kmod_version},
+   {"mu_badv_if_available",              true,  false, run_if_available},
+   {"mu_badv_if_up",                     true,  false, run_if_up},
+   {"mu_badv_if_hwaddr",                 true,  false, run_if_hwaddr},
+   {"mu_linux_debugfs_mount_point",      false, false, run_debugfs_mount_point},
+   {"mu_badv_mesh_n_nodes",              false, false, run_mesh_n_nodes},
+   {"mu_badv_mesh_n_nodes[cache]",       false, false, run_mesh_n_nodes},
+   {"mu_badv_mesh_node_addresses",       false, false, run_mesh_node_addresses},
+   {"mu_badv_next_hop_addresses",        false, false, run_next_hop_addresses},
+   {"mu_badv_next_hop_addresses[potential]", false, false,
+                                         run_potential_next_hop_addresses},
+   {"mu_badv_node_is_next_hop",          false, false, run_node_is_next_hop},
+   {"mu_badv_node_accessible_via_if",    false, false,
+                                         run_node_accessible_via_if},
+   {"mu_badv_node_last_seen",            false, false, run_node_last_seen},
+   {"mu_badv_node_last_seen[cache]",     false, false, run_node_last_seen},
+   {"mu_badv_node_next_hop",             false, false, run_node_next_hop},
+   {"mu_badv_orig_table_read",           false, false, run_orig_table_read},
+   {"mu_badv_orig_table_find",           false, false, run_orig_table_find},
+   {"mu_badv_orig_table_find[index]",    false, false, run_orig_index_find},
+   {"mu_badv_orig_top_k",                false, false, run_orig_top_k},
+   {"mu_badv_neighbors",                 false, false, run_neighbors},
+   {"mu_badv_gateways",                  false, false, run_gateways},
+   {"mu_badv_gw_selector_best",          false, false, run_gw_selector_best},
+   {"mu_badv_dat_index_refresh",         false, false, run_dat_index_refresh},
+   {"mu_badv_dat_lookup",                false, false, run_dat_lookup},
+   {"mu_badv_dat_index_entries",         false, false, run_dat_index_entries},
+   {"mu_badv_caps_get",                  false, false, run_caps_get},
+   {"mu_badv_caps_get[probe]",           false, false, run_caps_probe},
+   {"mu_badv_refresh_start+collect",     false, false, run_refresh},
+   {"mu_badv_refresh_start[notify]",     false, false, run_refresh_notify},
+   {"mu_badv_refresh_query",             false, false, run_refresh_query},
+   {"mu_badv_refresh_start+cancel",      false, false, run_refresh_cancel},
+   {"mu_badv_history_append",            false, true,  run_history_append},
+   {"mu_badv_history_append+flush",      false, true,  run_history_flush},
+   {"mu_badv_history_record",            false, true,  run_history_record},
+   {"mu_badv_history_reader_open+close", false, false,
+                                         run_history_reader_open},
+   {"mu_badv_history_span",              false, false, run_history_span},
+   {"mu_badv_history_table_at",          false, false, run_history_table_at},
+   {"mu_badv_staleness_update",          false, false, run_staleness_update},
+   {"mu_badv_staleness_advance",         false, false, run_staleness_advance},
+   {"mu_badv_staleness_level",           false, false, run_staleness_level},
+   {"mu_badv_shm_publish",               false, true,  run_shm_publish},
+   {"mu_badv_orig_table_read[shm]",      false, false, run_shm_orig_table_read},
+   {"mu_badv_mac_filter_refresh",        false, false, run_mac_filter_refresh},
+   {"mu_badv_mac_filter_contains",       false, false, run_mac_filter_contains},
+   {"mu_badv_node_store_sync",           false, false, run_node_store_sync},
+   {"mu_badv_node_store_slot",           false, false, run_node_store_slot},
+   {"mu_badv_topology_merge",            false, true,  run_topology_merge},
+   {"mu_badv_topology_links",            false, true,  run_topology_links},
+   {"mu_badv_topology_hearers",          false, true,  run_topology_hearers},
+   {"mu_badv_topology_next_hop",         false, true,  run_topology_next_hop},
+   {"mu_badv_topology_foreach_link",     false, true,
+                                         run_topology_foreach_link},
+   {"mu_badv_topology_expire",           false, true,  run_topology_expire},
+};
+
+#define N_BENCH_CASES (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+/*******************************************************************************
+*   RUNNER                                                                     *
+*******************************************************************************/
+
+/// Collects the result of a refresh on the worker thread and wakes the caller.
+static void refresh_notified(void *const ctx)
+{
+   struct bench_state *state = ctx;
+
+   mu_badv_orig_table_free(mu_badv_refresh_collect(state->notified_refresh,
+                                                   NULL));
+   sem_post(&state->notified);
+}
+
+static void stale_level(const struct mu_mac_addr *const mac_addr,
+                        const unsigned int              level,
+                        const unsigned int              old_level,
+                        const uint64_t                  last_seen_ms,
+                        void                     *const ctx)
+{
+   (void) mac_addr;
+   (void) level;
+   (void) old_level;
+   (void) last_seen_ms;
+   (void) ctx;
+}
+
+/// Writes the log the history reader cases read, the table once a second.
+static bool write_history_log(const char                *const path,
+                              const struct mu_badv_orig_table *const table)
+{
+   struct mu_badv_history_writer *writer = NULL;
+   bool                           ok     = true;
+   int                            error  = 0;
+
+   writer = mu_badv_history_writer_open(path, NULL, &error);
+   if (!writer) {
+      return false;
+   }
+   for (uint64_t i = 0; i < HISTORY_READ_TABLES && ok; i++) {
+      ok = mu_badv_history_append(writer, table, i * 1000, &error);
+   }
+   mu_badv_history_writer_close(writer);
+   return ok;
+}
+
+static bool state_init(struct bench_state   *const state,
+                       const struct fixture *const fixture,
+                       const unsigned int          thread)
+{
+   int                              error = 0;
+   const struct mu_badv_originator *last  = NULL;
+
+   memset(state, 0, sizeof(*state));
+   state->fixture = fixture;
+   if (!fixture->n_nodes) {
+      return true;
+   }
+
+   state->table = mu_badv_orig_table_read(BENCH_IF, &error);
+   if (!state->table || !state->table->n_originators) {
+      return false;
+   }
+
+   // The last originator is the worst case for the linear lookups.
+   last = &state->table->originators[state->table->n_originators - 1];
+   state->mac_addr = last->mac_addr;
+   mu_mac_addr_to_str(&last->mac_addr, state->node.mac_addr);
+   state->dat_ipv4 = htonl(10u << 24 | (uint32_t) (fixture->n_nodes - 1));
+
+   state->indexed_table = mu_badv_orig_table_read(BENCH_IF, &error);
+   if (!state->indexed_table
+       || !mu_badv_orig_table_index(state->indexed_table, &error)) {
+      return false;
+   }
+
+   state->dat_index   = mu_badv_dat_index_new(BENCH_IF, &error);
+   state->gw_selector = mu_badv_gw_selector_new(BENCH_IF, 0, &error);
+   state->refresh     = mu_badv_refresh_new(BENCH_IF, &error);
+   if (!state->dat_index || !state->gw_selector || !state->refresh) {
+      return false;
+   }
+   mu_badv_dat_index_refresh(state->dat_index, &error);
+
+   if (sem_init(&state->notified, 0, 0)) {
+      return false;
+   }
+   state->has_notified     = true;
+   state->notified_refresh = mu_badv_refresh_new(BENCH_IF, &error);
+   if (!state->notified_refresh) {
+      return false;
+   }
+   mu_badv_refresh_set_notify(state->notified_refresh, refresh_notified,
+                              state);
+
+   state->staleness = mu_badv_staleness_new(stale_thresholds,
+                                            sizeof(stale_thresholds)
+                                            / sizeof(stale_thresholds[0]),
+                                            0, 0, stale_level, NULL, &error);
+   if (!state->staleness
+       || !mu_badv_staleness_update(state->staleness, state->table, 0,
+                                    &error)) {
+      return false;
+   }
+
+   state->mac_filter = mu_badv_mac_filter_new(BENCH_IF, 0, &error);
+   if (!state->mac_filter
+       || !mu_badv_mac_filter_refresh(state->mac_filter, &error)) {
+      return false;
+   }
+
+   // The first thread writes the log, the others only read it.
+   snprintf(state->history_read_path, sizeof(state->history_read_path),
+            "%s/history_read.log", fixture->root);
+   if (thread == 0 && !write_history_log(state->history_read_path,
+                                         state->table)) {
+      return false;
+   }
+   state->history_reader = mu_badv_history_reader_open(state->history_read_path,
+                                                       &error);
+   if (!state->history_reader) {
+      return false;
+   }
+
+   if (thread == 0) {
+      snprintf(state->history_path, sizeof(state->history_path),
+               "%s/history.log", fixture->root);
+      state->history   = mu_badv_history_writer_open(state->history_path,
+                                                     NULL, &error);
+      state->publisher = mu_badv_shm_publisher_new(BENCH_IF, &error);
+      state->topology  = mu_badv_topology_new(&error);
+      if (!state->topology
+          || !mu_badv_topology_merge(state->topology, &state->mac_addr,
+                                     state->table, ++state->topology_ms,
+                                     &error)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static void state_free(struct bench_state *const state)
+{
+   mu_badv_topology_free(state->topology);
+   mu_badv_shm_publisher_free(state->publisher);
+   mu_badv_history_writer_close(state->history);
+   mu_badv_history_reader_close(state->history_reader);
+   mu_badv_staleness_free(state->staleness);
+   mu_badv_refresh_free(state->notified_refresh);
+   if (state->has_notified) {
+      sem_destroy(&state->notified);
+   }
+   mu_badv_refresh_free(state->refresh);
+   mu_badv_gw_selector_free(state->gw_selector);
+   mu_badv_dat_index_free(state->dat_index);
+   mu_badv_mac_filter_free(state->mac_filter);
+   mu_badv_orig_table_free(state->indexed_table);
+   mu_badv_orig_table_free(state->table);
+}
+
+static void *run_thread(void *const arg)
+{
+   struct thread_job *job = arg;
+   int                error;
+   uint64_t           start;
+
+   pthread_barrier_wait(job->barrier);
+   for (size_t i = 0; i < job->iterations; i++) {
+      error = 0;
+      start = now_ns();
+      if (!job->bench->run(&job->state, &error) || error) {
+         job->errors++;
+      }
+      job->latencies_ns[i] = now_ns() - start;
+   }
+   return NULL;
+}
+
+static bool run_case(const struct bench_case *const bench,
+                     struct thread_job       *const jobs,
+                     const unsigned int             n_threads,
+                     const size_t                   iterations,
+                     const bool                     first,
+                     FILE                    *const out)
+{
+   pthread_t          threads[MAX_THREADS];
+   pthread_barrier_t  barrier;
+   uint64_t          *all     = NULL;
+   size_t             n_calls = (size_t) n_threads * iterations;
+   size_t             errors  = 0;
+   uint64_t           sum     = 0;
+   uint64_t           allocs_before, bytes_before, read_before, read_cost;
+   uint64_t           allocs, bytes, read;
+   int                error;
+
+   all = malloc(n_calls * sizeof(uint64_t));
+   if (!all) {
+      return false;
+   }
+
+   // Warm up caches and lazily created state.
+   for (unsigned int t = 0; t < n_threads; t++) {
+      error = 0;
+      bench->run(&jobs[t].state, &error);
+   }
+
+   pthread_barrier_init(&barrier, NULL, n_threads);
+   for (unsigned int t = 0; t < n_threads; t++) {
+      jobs[t].bench        = bench;
+      jobs[t].iterations   = iterations;
+      jobs[t].latencies_ns = all + (size_t) t * iterations;
+      jobs[t].errors       = 0;
+      jobs[t].barrier      = &barrier;
+   }
+
+   read_cost     = bytes_read();
+   read_cost     = bytes_read() - read_cost;
+   allocs_before = __atomic_load_n(&n_allocations, __ATOMIC_RELAXED);
+   bytes_before  = __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+   read_before   = bytes_read();
+
+   for (unsigned int t = 1; t < n_threads; t++) {
+      pthread_create(&threads[t], NULL, run_thread, &jobs[t]);
+   }
+   run_thread(&jobs[0]);
+   for (unsigned int t = 1; t < n_threads; t++) {
+      pthread_join(threads[t], NULL);
+   }
+
+   read   = bytes_read() - read_before - read_cost;
+   allocs = __atomic_load_n(&n_allocations, __ATOMIC_RELAXED) - allocs_before;
+   bytes  = __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED) - bytes_before;
+   pthread_barrier_destroy(&barrier);
+
+   for (unsigned int t = 0; t < n_threads; t++) {
+      errors += jobs[t].errors;
+   }
+   for (size_t i = 0; i < n_calls; i++) {
+      sum += all[i];
+   }
+   qsort(all, n_calls, sizeof(uint64_t), compare_u64);
+
+   fprintf(out, "%s\n    {\"function\": \"%s\", \"nodes\": %zu, "
+                "\"fanout\": %u, \"threads\": %u, \"iterations\": %zu, "
+                "\"errors\": %zu,\n     \"latency_ns\": {\"min\": %llu, "
+                "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+                "\"max\": %llu, \"mean\": %llu},\n"
+                "     \"allocations_per_call\": %.2f, "
+                "\"allocated_bytes_per_call\": %.1f, "
+                "\"bytes_read_per_call\": %.1f}",
+           first ? "" : ",", bench->name,
+           bench->system ? 0 : jobs[0].state.fixture->n_nodes,
+           bench->system ? 0 : jobs[0].state.fixture->fanout,
+           n_threads, iterations, errors,
+           (unsigned long long) all[0],
+           (unsigned long long) percentile(all, n_calls, 0.50),
+           (unsigned long long) percentile(all, n_calls, 0.90),
+           (unsigned long long) percentile(all, n_calls, 0.99),
+           (unsigned long long) all[n_calls - 1],
+           (unsigned long long) (sum / n_calls),
+           (double) allocs / (double) n_calls,
+           (double) bytes / (double) n_calls,
+           (double) read / (double) n_calls);
+
+   free(all);
+   return true;
+}
+
+static bool matches(const struct bench_case *const bench,
+                    const char              *const filter)
+{
+   return !filter || strstr(bench->name, filter);
+}
+
+/* Runs all cases matching the filter against one fixture; system cases run
+ * only with the first fixture.
+ */
+static bool run_fixture(const struct fixture *const fixture,
+                        const bool                  system_cases,
+                        const unsigned int          n_threads,
+                        const size_t                iterations_arg,
+                        const char           *const filter,
+                        bool                 *const first,
+                        FILE                 *const out)
+{
+   struct thread_job *jobs       = calloc(n_threads, sizeof(*jobs));
+   size_t             iterations = iterations_arg;
+   bool               ok         = true;
+   int                error      = 0;
+
+   if (!jobs) {
+      return false;
+   }
+
+   if (!iterations) {
+      iterations = ITERATION_BUDGET / (fixture->n_nodes * fixture->fanout + 10);
+      iterations = iterations < MIN_ITERATIONS ? MIN_ITERATIONS
+                 : iterations > MAX_ITERATIONS ? MAX_ITERATIONS : iterations;
+   }
+
+   setenv("MESHUTIL_DEBUGFS_ROOT", fixture->root, 1);
+   mu_badv_caps_invalidate();
+
+   for (unsigned int t = 0; t < n_threads && ok; t++) {
+      ok = state_init(&jobs[t].state, fixture, t);
+   }
+   if (ok) {
+      node_store = mu_badv_node_store_new(sizeof(uint64_t), &error);
+      ok = node_store
+           && (!jobs[0].state.table
+               || mu_badv_node_store_sync(node_store, jobs[0].state.table,
+                                          &error));
+   }
+   if (!ok) {
+      fprintf(stderr, "Cannot set up fixture %s\n", fixture->root);
+   }
+
+   for (size_t c = 0; c < N_BENCH_CASES && ok; c++) {
+      const struct bench_case *bench = &bench_cases[c];
+      bool                     shm   = strstr(bench->name, "[shm]") != NULL;
+      bool                     cache = strstr(bench->name, "[cache]") != NULL;
+
+      if (bench->system != system_cases || !matches(bench, filter)
+          || (bench->single_writer && n_threads > 1)) {
+         continue;
+      }
+      if ((bench->run == run_shm_publish && !jobs[0].state.publisher)
+          || (bench->run == run_history_record && !jobs[0].state.history)) {
+         continue;
+      }
+      if (shm) {
+         if (!jobs[0].state.publisher
+             || !mu_badv_shm_publish(jobs[0].state.publisher, &error)
+             || !mu_badv_shm_attach(BENCH_IF, &error)) {
+            continue;
+         }
+      }
+
+      if (cache && !mu_badv_cache_set_ttl(BENCH_IF, CACHE_TTL_MS, &error)) {
+         continue;
+      }
+
+      fprintf(stderr, "%-40s nodes %7zu fanout %2u threads %u\n",
+              bench->name, fixture->n_nodes, fixture->fanout, n_threads);
+      ok = run_case(bench, jobs, n_threads, iterations, *first, out);
+      *first = false;
+
+      if (shm) {
+         mu_badv_shm_detach(BENCH_IF);
+      }
+      if (cache) {
+         mu_badv_cache_set_ttl(BENCH_IF, 0, NULL);
+      }
+   }
+
+   for (unsigned int t = 0; t < n_threads; t++) {
+      state_free(&jobs[t].state);
+   }
+   if (node_store) {
+      mu_badv_node_store_free(node_store);
+      node_store = NULL;
+   }
+   free(jobs);
+   return ok;
+}
+
+static void usage(const char *const program)
+{
+   fprintf(stderr, "Usage: %s [-s sizes] [-f fan-outs] [-i iterations] "
+                   "[-t threads] [-b filter] [-o output.json]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+   size_t          sizes[MAX_LIST];
+   size_t          fanouts[MAX_LIST];
+   size_t          n_sizes    = parse_list(DEFAULT_SIZES, sizes);
+   size_t          n_fanouts  = parse_list(DEFAULT_FANOUTS, fanouts);
+   size_t          iterations = 0;
+   unsigned int    n_threads  = 1;
+   const char     *filter     = NULL;
+   FILE           *out        = stdout;
+   bool            first      = true;
+   bool            ok         = true;
+   struct fixture  fixture;
+   struct fixture  system_fixture = {0, 1, ""};
+   int             option;
+
+   while ((option = getopt(argc, argv, "s:f:i:t:b:o:h")) != -1) {
+      switch (option) {
+      case 's': n_sizes    = parse_list(optarg, sizes);           break;
+      case 'f': n_fanouts  = parse_list(optarg, fanouts);         break;
+      case 'i': iterations = strtoul(optarg, NULL, 10);           break;
+      case 't': n_threads  = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+      case 'b': filter     = optarg;                              break;
+      case 'o':
+         out = fopen(optarg, "w");
+         if (!out) {
+            perror(optarg);
+            return EXIT_FAILURE;
+         }
+         break;
+      default:
+         usage(argv[0]);
+         return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+   if (n_threads < 1 || n_threads > MAX_THREADS) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   mu_set_allocator(counting_alloc, counting_realloc, counting_free, NULL);
+
+   fprintf(out, "{\"benchmark\": \"meshutil\", \"threads\": %u, "
+                "\"results\": [", n_threads);
+
+   ok = run_fixture(&system_fixture, true, n_threads, iterations, filter,
+                    &first, out);
+
+   for (size_t s = 0; s < n_sizes && ok; s++) {
+      for (size_t f = 0; f < n_fanouts && ok; f++) {
+         if (!sizes[s] || !fanouts[f]) {
+            continue;
+         }
+         memset(&fixture, 0, sizeof(fixture));
+         fixture.n_nodes = sizes[s];
+         fixture.fanout  = (unsigned int) fanouts[f];
+
+         if (!create_fixture(&fixture)) {
+            fprintf(stderr, "Cannot write fixture: %s\n", strerror(errno));
+            ok = false;
+         } else {
+            ok = run_fixture(&fixture, false, n_threads, iterations, filter,
+                             &first, out);
+         }
+         remove_fixture(&fixture);
+      }
+   }
+
+   fprintf(out, "\n]}\n");
+   if (out != stdout) {
+      fclose(out);
+   }
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif                          /* __linux */
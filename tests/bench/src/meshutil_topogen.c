@@ -0,0 +1,811 @@
+/** @file meshutil_topogen.c
+ * Generator of synthetic batman_adv debugfs tables
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_topogen Topology generator
+ *
+ *     meshutil_topogen -o directory [-n nodes] [-d degree] [-c clients]
+ *                      [-i interfaces] [-p hop penalty] [-T steps]
+ *                      [-I interval] [-j join rate] [-l leave rate]
+ *                      [-F flap rate] [-s seed]
+ *
+ * Builds a random geometric graph: -n nodes (default 1000) are placed
+ * uniformly in a unit square and two nodes are linked if they are closer than
+ * a radio range chosen to give a mean of -d links per node (default 8). The
+ * link TQ is 255 * (1 - (d / r)^4) for distance d and range r.
+ *
+ * The tables are those node 0 would show. Like B.A.T.M.A.N. IV, the TQ of a
+ * route is the product of its link TQs, reduced by the hop penalty (-p,
+ * default 10) at every forwarding node. For every originator each neighbour
+ * of node 0 with a route to it is a potential next hop and the best one is
+ * the next hop. Originators whose TQ rounds to 0 are not in the table, as in
+ * batman_adv; a higher degree or -p 0 keeps more of a large mesh reachable.
+ * Every node announces -c clients (default 2) and uses -i interfaces
+ * (default 1).
+ *
+ * With -T steps (default 1) a time sequence is written, -I seconds apart
+ * (default 10). Before each step after the first, every node except node 0
+ * leaves with the probability -l, -j times the current node count new nodes
+ * join at random positions, and every link is down for the step with the
+ * probability -F. Nodes which left or became unreachable stay in the
+ * originators table with a growing last-seen time until they are purged
+ * after 200 seconds, as in batman_adv.
+ *
+ * The same -s seed (default 1) gives the same tables. Step k is written to
+ *
+ *     directory/tNNNN/batman_adv/bat0/{originators,neighbors,
+ *                                      transtable_global,transtable_local}
+ *
+ * so a step can be read by pointing MESHUTIL_DEBUGFS_ROOT at directory/tNNNN.
+ * All tables use the batman_adv 2016.1 layout with B.A.T.M.A.N. IV, the first
+ * release with a neighbours table: translation table entries carry a VLAN id
+ * (untagged, -1) and a CRC, local entries also a last-seen time.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+#define TOPOGEN_IF "bat0"
+
+#define TQ_MAX            255
+/// Route TQs are kept in 1/256 steps so rounding does not cut long routes.
+#define ROUTE_TQ_MAX      (TQ_MAX << 8)
+#define PURGE_TIMEOUT_MS  200000
+#define MAX_INTERFACES    4
+#define MAX_CLIENTS       255
+#define NO_NODE           UINT32_MAX
+
+static const char *const interface_names[MAX_INTERFACES] = {
+   "wlan0", "eth0", "wlan1", "eth1"
+};
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+struct options {
+   const char   *directory;
+   uint32_t      n_nodes;
+   double        degree;
+   unsigned int  n_clients;
+   unsigned int  n_interfaces;
+   unsigned int  hop_penalty;
+   unsigned int  n_steps;
+   unsigned int  interval_s;
+   double        join_rate;
+   double        leave_rate;
+   double        flap_rate;
+   uint64_t      seed;
+};
+
+struct node {
+   double   x;
+   double   y;
+   bool     present;
+   uint32_t ttvn;             ///< Translation table version.
+   /// What node 0 knew when it last heard of the node.
+   uint64_t last_seen_ms;     ///< 0 if never heard of.
+   uint32_t last_next_hop;
+   uint8_t  last_tq;
+};
+
+/// Links of present nodes in compressed sparse row form.
+struct graph {
+   uint32_t *first;           ///< Index of first link of each node, n + 1.
+   uint32_t *peer;
+   uint8_t  *tq;
+   size_t    capacity;
+};
+
+/// Per step TQs of the routes from one neighbour of node 0.
+struct routes {
+   uint16_t  *tq;             ///< Per originator in 1/256, 0 if unreachable.
+   uint32_t **buckets;        ///< ROUTE_TQ_MAX + 1 each.
+   size_t    *bucket_len;
+   size_t    *bucket_cap;
+};
+
+struct topology {
+   struct options  options;
+   struct node    *nodes;
+   uint32_t        n_nodes;   ///< Including nodes which left.
+   uint32_t        capacity;
+   double          range;
+   uint64_t        rng;
+   struct graph    graph;
+};
+
+/*******************************************************************************
+*   RANDOM NUMBERS                                                             *
+*******************************************************************************/
+
+static uint64_t splitmix64(uint64_t x)
+{
+   x += 0x9e3779b97f4a7c15ULL;
+   x  = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   x  = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+   return x ^ (x >> 31);
+}
+
+static double random_unit(struct topology *const topology)
+{
+   topology->rng = splitmix64(topology->rng);
+   return (double) (topology->rng >> 11) / 9007199254740992.0;
+}
+
+/// Deterministic value in [0, 1) for a link in a step.
+static double link_unit(const struct topology *const topology,
+                        uint32_t u, uint32_t v, const unsigned int step)
+{
+   if (u > v) {
+      uint32_t swap = u;
+      u = v;
+      v = swap;
+   }
+   return (double) (splitmix64(topology->options.seed
+                               ^ splitmix64(((uint64_t) u << 32 | v)
+                                            ^ ((uint64_t) step << 48))) >> 11)
+          / 9007199254740992.0;
+}
+
+/*******************************************************************************
+*   TOPOLOGY                                                                   *
+*******************************************************************************/
+
+static bool add_node(struct topology *const topology)
+{
+   struct node *node;
+
+   if (topology->n_nodes == topology->capacity) {
+      uint32_t     capacity = topology->capacity ? topology->capacity * 2 : 64;
+      struct node *nodes    = realloc(topology->nodes,
+                                      capacity * sizeof(struct node));
+
+      if (!nodes) {
+         return false;
+      }
+      topology->nodes    = nodes;
+      topology->capacity = capacity;
+   }
+
+   node = &topology->nodes[topology->n_nodes++];
+   memset(node, 0, sizeof(*node));
+   node->x             = random_unit(topology);
+   node->y             = random_unit(topology);
+   node->present       = true;
+   node->ttvn          = 1;
+   node->last_next_hop = NO_NODE;
+   return true;
+}
+
+static uint8_t link_tq(const struct topology *const topology,
+                       const uint32_t u, const uint32_t v)
+{
+   double dx = topology->nodes[u].x - topology->nodes[v].x;
+   double dy = topology->nodes[u].y - topology->nodes[v].y;
+   double q  = (dx * dx + dy * dy) / (topology->range * topology->range);
+
+   return q >= 1.0 ? 0 : (uint8_t) (TQ_MAX * (1.0 - q * q));
+}
+
+static const char *link_interface(const struct topology *const topology,
+                                  const uint32_t u, const uint32_t v)
+{
+   return interface_names[(u + v) % topology->options.n_interfaces];
+}
+
+/* Implementation notes:
+ * - Nodes are sorted into grid cells of the radio range, so only the 3x3
+ *   cells around a node are searched for peers. Two passes over the cells
+ *   count and then fill the links.
+ */
+static bool build_graph(struct topology *const topology,
+                        const unsigned int     step)
+{
+   struct graph *graph    = &topology->graph;
+   uint32_t      n        = topology->n_nodes;
+   uint32_t      side     = (uint32_t) (1.0 / topology->range) + 1;
+   uint32_t     *cell_of  = malloc(n * sizeof(uint32_t));
+   uint32_t     *cell_first = calloc((size_t) side * side + 1, sizeof(uint32_t));
+   uint32_t     *cell_nodes = malloc(n * sizeof(uint32_t));
+   uint32_t     *fill     = NULL;
+   bool          ok       = false;
+
+   free(graph->first);
+   graph->first = calloc((size_t) n + 1, sizeof(uint32_t));
+   if (!cell_of || !cell_first || !cell_nodes || !graph->first) {
+      goto out;
+   }
+
+   for (uint32_t i = 0; i < n; i++) {
+      uint32_t cx = (uint32_t) (topology->nodes[i].x * side);
+      uint32_t cy = (uint32_t) (topology->nodes[i].y * side);
+
+      cell_of[i] = (cy < side ? cy : side - 1) * side + (cx < side ? cx : side - 1);
+      if (topology->nodes[i].present) {
+         cell_first[cell_of[i] + 1]++;
+      }
+   }
+   for (uint32_t c = 0; c < side * side; c++) {
+      cell_first[c + 1] += cell_first[c];
+   }
+   fill = calloc((size_t) side * side, sizeof(uint32_t));
+   if (!fill) {
+      goto out;
+   }
+   for (uint32_t i = 0; i < n; i++) {
+      if (topology->nodes[i].present) {
+         uint32_t c = cell_of[i];
+         cell_nodes[cell_first[c] + fill[c]++] = i;
+      }
+   }
+
+   for (int pass = 0; pass < 2; pass++) {
+      for (uint32_t i = 0; i < n; i++) {
+         uint32_t cx, cy;
+
+         if (!topology->nodes[i].present) {
+            continue;
+         }
+         cx = cell_of[i] % side;
+         cy = cell_of[i] / side;
+         for (uint32_t y = cy ? cy - 1 : 0; y <= cy + 1 && y < side; y++) {
+            for (uint32_t x = cx ? cx - 1 : 0; x <= cx + 1 && x < side; x++) {
+               uint32_t c = y * side + x;
+
+               for (uint32_t k = cell_first[c]; k < cell_first[c + 1]; k++) {
+                  uint32_t j  = cell_nodes[k];
+                  uint8_t  tq = j == i ? 0 : link_tq(topology, i, j);
+
+                  if (!tq || link_unit(topology, i, j, step)
+                             < topology->options.flap_rate) {
+                     continue;
+                  }
+                  if (pass == 0) {
+                     graph->first[i + 1]++;
+                  } else {
+                     uint32_t l = graph->first[i] + fill[i]++;
+                     graph->peer[l] = j;
+                     graph->tq[l]   = tq;
+                  }
+               }
+            }
+         }
+      }
+
+      if (pass == 0) {
+         for (uint32_t i = 0; i < n; i++) {
+            graph->first[i + 1] += graph->first[i];
+         }
+         if (graph->first[n] > graph->capacity) {
+            free(graph->peer);
+            free(graph->tq);
+            graph->capacity = graph->first[n];
+            graph->peer = malloc(graph->capacity * sizeof(uint32_t));
+            graph->tq   = malloc(graph->capacity);
+            if (!graph->peer || !graph->tq) {
+               goto out;
+            }
+         }
+         free(fill);
+         fill = calloc(n, sizeof(uint32_t));
+         if (!fill) {
+            goto out;
+         }
+      }
+   }
+   ok = true;
+
+out:
+   free(fill);
+   free(cell_nodes);
+   free(cell_first);
+   free(cell_of);
+   return ok;
+}
+
+static bool bucket_push(struct routes *const routes, const uint16_t tq,
+                        const uint32_t node)
+{
+   if (routes->bucket_len[tq] == routes->bucket_cap[tq]) {
+      size_t    capacity = routes->bucket_cap[tq] ? routes->bucket_cap[tq] * 2
+                                                  : 64;
+      uint32_t *bucket   = realloc(routes->buckets[tq],
+                                   capacity * sizeof(uint32_t));
+
+      if (!bucket) {
+         return false;
+      }
+      routes->buckets[tq]    = bucket;
+      routes->bucket_cap[tq] = capacity;
+   }
+   routes->buckets[tq][routes->bucket_len[tq]++] = node;
+   return true;
+}
+
+/* Implementation notes:
+ * - Route TQs only decrease along a route and are integers, so the best
+ *   routes from the source are found by taking nodes from one bucket per TQ
+ *   value in decreasing TQ order (Dijkstra with a bucket queue). Node 0 is
+ *   excluded; the routes are those via source as seen by node 0.
+ */
+static bool compute_routes(const struct topology *const topology,
+                           struct routes         *const routes,
+                           const uint32_t               source)
+{
+   const struct graph *graph   = &topology->graph;
+   unsigned int        penalty = TQ_MAX - topology->options.hop_penalty;
+
+   memset(routes->tq, 0, topology->n_nodes * sizeof(uint16_t));
+   routes->tq[source] = ROUTE_TQ_MAX;
+   if (!bucket_push(routes, ROUTE_TQ_MAX, source)) {
+      return false;
+   }
+
+   for (int tq = ROUTE_TQ_MAX; tq > 0; tq--) {
+      while (routes->bucket_len[tq]) {
+         uint32_t u = routes->buckets[tq][--routes->bucket_len[tq]];
+
+         if (routes->tq[u] != tq) {
+            continue;
+         }
+         for (uint32_t l = graph->first[u]; l < graph->first[u + 1]; l++) {
+            uint32_t v    = graph->peer[l];
+            uint32_t next = (uint32_t) tq * graph->tq[l] / TQ_MAX
+                            * penalty / TQ_MAX;
+
+            if (v != 0 && next > routes->tq[v]) {
+               routes->tq[v] = (uint16_t) next;
+               if (!bucket_push(routes, (uint16_t) next, v)) {
+                  return false;
+               }
+            }
+         }
+      }
+   }
+   return true;
+}
+
+/* Before every step after the first some nodes leave and join.
+ */
+static bool churn(struct topology *const topology)
+{
+   const struct options *options = &topology->options;
+   uint32_t              present = 0;
+   double                joins;
+
+   for (uint32_t i = 1; i < topology->n_nodes; i++) {
+      struct node *node = &topology->nodes[i];
+
+      if (node->present && random_unit(topology) < options->leave_rate) {
+         node->present = false;
+      }
+   }
+   for (uint32_t i = 0; i < topology->n_nodes; i++) {
+      present += topology->nodes[i].present;
+   }
+
+   joins = options->join_rate * present;
+   joins = floor(joins) + (random_unit(topology) < joins - floor(joins));
+   for (uint32_t k = 0; k < (uint32_t) joins; k++) {
+      if (!add_node(topology)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/*******************************************************************************
+*   TABLE OUTPUT                                                               *
+*******************************************************************************/
+
+static void print_mac(FILE *const file, const uint32_t node)
+{
+   fprintf(file, "02:ba:%02x:%02x:%02x:%02x", node >> 24 & 0xff,
+           node >> 16 & 0xff, node >> 8 & 0xff, node & 0xff);
+}
+
+static void print_client(FILE *const file, const uint32_t node,
+                         const unsigned int client)
+{
+   fprintf(file, "06:%02x:%02x:%02x:%02x:%02x", node >> 24 & 0xff,
+           node >> 16 & 0xff, node >> 8 & 0xff, node & 0xff, client);
+}
+
+/// First line of the originators and neighbours tables.
+static void print_header(FILE *const file)
+{
+   fprintf(file, "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: %s/",
+           interface_names[0]);
+   print_mac(file, 0);
+   fprintf(file, " (" TOPOGEN_IF "/");
+   print_mac(file, 0);
+   fprintf(file, " BATMAN_IV)]\n");
+}
+
+/// Stand-in for the CRC over the translation table of a node.
+static unsigned int tt_crc(const uint32_t node)
+{
+   return (node + 1) * 0x9e3779b1u;
+}
+
+static FILE *open_table(const char *const step_dir, const char *const table)
+{
+   char path[PATH_MAX];
+
+   if (snprintf(path, sizeof(path), "%s/batman_adv/" TOPOGEN_IF "/%s",
+                step_dir, table) >= (int) sizeof(path)) {
+      errno = ENAMETOOLONG;
+      return NULL;
+   }
+   return fopen(path, "w");
+}
+
+static bool make_dirs(const char *const step_dir)
+{
+   static const char *const subdirs[] = {
+      "", "/batman_adv", "/batman_adv/" TOPOGEN_IF
+   };
+   char path[PATH_MAX];
+
+   for (size_t i = 0; i < sizeof(subdirs) / sizeof(subdirs[0]); i++) {
+      if (snprintf(path, sizeof(path), "%s%s", step_dir, subdirs[i])
+          >= (int) sizeof(path)) {
+         errno = ENAMETOOLONG;
+         return false;
+      }
+      if (mkdir(path, 0755) && errno != EEXIST) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static void print_last_seen(FILE *const file, const uint64_t ms)
+{
+   fprintf(file, "%4u.%03us", (unsigned int) (ms / 1000),
+           (unsigned int) (ms % 1000));
+}
+
+/* Implementation notes:
+ * - The routes via every neighbour of node 0 are computed first; tq[k][o] is
+ *   then the TQ of originator o via neighbour k as seen by node 0.
+ */
+static bool write_step(struct topology *const topology,
+                       const unsigned int     step,
+                       const char     *const  step_dir)
+{
+   const struct options *options   = &topology->options;
+   const struct graph   *graph     = &topology->graph;
+   uint32_t              n_hops    = graph->first[1] - graph->first[0];
+   uint64_t              now_ms    = ((uint64_t) step * options->interval_s + 1)
+                                     * 1000;
+   uint8_t             **hop_tq    = calloc(n_hops ? n_hops : 1,
+                                            sizeof(uint8_t *));
+   struct routes         routes;
+   FILE                 *file      = NULL;
+   bool                  ok        = false;
+
+   routes.tq         = malloc(topology->n_nodes * sizeof(uint16_t));
+   routes.buckets    = calloc(ROUTE_TQ_MAX + 1, sizeof(uint32_t *));
+   routes.bucket_len = calloc(ROUTE_TQ_MAX + 1, sizeof(size_t));
+   routes.bucket_cap = calloc(ROUTE_TQ_MAX + 1, sizeof(size_t));
+   if (!hop_tq || !routes.tq || !routes.buckets || !routes.bucket_len
+       || !routes.bucket_cap || !make_dirs(step_dir)) {
+      goto out;
+   }
+
+   for (uint32_t k = 0; k < n_hops; k++) {
+      uint32_t neighbor = graph->peer[graph->first[0] + k];
+      uint8_t  tq_link  = graph->tq[graph->first[0] + k];
+
+      hop_tq[k] = malloc(topology->n_nodes);
+      if (!hop_tq[k] || !compute_routes(topology, &routes, neighbor)) {
+         goto out;
+      }
+      for (uint32_t o = 0; o < topology->n_nodes; o++) {
+         hop_tq[k][o] = (uint8_t) (((uint32_t) routes.tq[o] * tq_link / TQ_MAX
+                                    + 128) >> 8);
+      }
+   }
+
+   // originators
+   file = open_table(step_dir, "originators");
+   if (!file) {
+      goto out;
+   }
+   print_header(file);
+   fprintf(file, "  Originator      last-seen (#/255)           "
+                 "Nexthop [outgoingIF]:   Potential nexthops ...\n");
+
+   for (uint32_t o = 1; o < topology->n_nodes; o++) {
+      struct node *node = &topology->nodes[o];
+      uint32_t     best = NO_NODE;
+      uint8_t      tq   = 0;
+
+      for (uint32_t k = 0; k < n_hops; k++) {
+         if (hop_tq[k][o] > tq) {
+            tq   = hop_tq[k][o];
+            best = k;
+         }
+      }
+
+      if (best != NO_NODE) {
+         node->last_seen_ms  = now_ms - (uint64_t) (random_unit(topology) * 1000);
+         node->last_next_hop = graph->peer[graph->first[0] + best];
+         node->last_tq       = tq;
+      } else if (!node->last_seen_ms
+                 || now_ms - node->last_seen_ms > PURGE_TIMEOUT_MS) {
+         continue;
+      }
+
+      print_mac(file, o);
+      fputc(' ', file);
+      print_last_seen(file, now_ms - node->last_seen_ms);
+      fprintf(file, "   (%3u) ", node->last_tq);
+      print_mac(file, node->last_next_hop);
+      fprintf(file, " [%10s]:", link_interface(topology, 0,
+                                               node->last_next_hop));
+      if (best == NO_NODE) {
+         fputc(' ', file);
+         print_mac(file, node->last_next_hop);
+         fprintf(file, " (%3u)", node->last_tq);
+      }
+      for (uint32_t k = 0; k < n_hops; k++) {
+         if (hop_tq[k][o]) {
+            fputc(' ', file);
+            print_mac(file, graph->peer[graph->first[0] + k]);
+            fprintf(file, " (%3u)", hop_tq[k][o]);
+         }
+      }
+      fputc('\n', file);
+   }
+   if (fclose(file)) {
+      file = NULL;
+      goto out;
+   }
+
+   // neighbors
+   file = open_table(step_dir, "neighbors");
+   if (!file) {
+      goto out;
+   }
+   print_header(file);
+   fprintf(file, "IF             Neighbor              last-seen\n");
+   for (uint32_t k = 0; k < n_hops; k++) {
+      uint32_t neighbor = graph->peer[graph->first[0] + k];
+
+      fprintf(file, "%12s     ", link_interface(topology, 0, neighbor));
+      print_mac(file, neighbor);
+      fputs("    ", file);
+      print_last_seen(file, (uint64_t) (random_unit(topology) * 1000));
+      fputc('\n', file);
+   }
+   if (fclose(file)) {
+      file = NULL;
+      goto out;
+   }
+
+   // transtable_local
+   file = open_table(step_dir, "transtable_local");
+   if (!file) {
+      goto out;
+   }
+   fprintf(file, "Locally retrieved addresses (from " TOPOGEN_IF
+                 ") announced via TT (TTVN: %u):\n"
+                 "       Client         VID Flags    Last seen (CRC       )\n",
+           topology->nodes[0].ttvn);
+   for (unsigned int c = 0; c < options->n_clients; c++) {
+      fputs(" * ", file);
+      print_client(file, 0, c);
+      fprintf(file, " %4i [.%c..%c.] %3u.%03u   (%#.8x)\n", -1,
+              c ? '.' : 'P', c % 2 ? 'W' : '.', c ? c % 60 : 0,
+              c ? c * 37 % 1000 : 0, tt_crc(0));
+   }
+   if (fclose(file)) {
+      file = NULL;
+      goto out;
+   }
+
+   // transtable_global: the clients of every originator in the table
+   file = open_table(step_dir, "transtable_global");
+   if (!file) {
+      goto out;
+   }
+   fprintf(file, "Globally announced TT entries received via the mesh "
+                 TOPOGEN_IF "\n"
+                 "       Client        VID  (TTVN)       Originator      "
+                 "(Curr TTVN) (CRC       ) Flags\n");
+   for (uint32_t o = 1; o < topology->n_nodes; o++) {
+      const struct node *node = &topology->nodes[o];
+
+      if (!node->last_seen_ms
+          || now_ms - node->last_seen_ms > PURGE_TIMEOUT_MS) {
+         continue;
+      }
+      for (unsigned int c = 0; c < options->n_clients; c++) {
+         fputs(" * ", file);
+         print_client(file, o, c);
+         fprintf(file, " %4i   (%3u) via ", -1, node->ttvn);
+         print_mac(file, o);
+         fprintf(file, "     (%3u)   (%#.8x) [.%c..]\n", node->ttvn, tt_crc(o),
+                 c % 2 ? 'W' : '.');
+      }
+   }
+   ok = fclose(file) == 0;
+   file = NULL;
+
+out:
+   if (file) {
+      fclose(file);
+   }
+   for (uint32_t k = 0; hop_tq && k < n_hops; k++) {
+      free(hop_tq[k]);
+   }
+   for (int tq = 0; routes.buckets && tq <= ROUTE_TQ_MAX; tq++) {
+      free(routes.buckets[tq]);
+   }
+   free(routes.bucket_cap);
+   free(routes.bucket_len);
+   free(routes.buckets);
+   free(routes.tq);
+   free(hop_tq);
+   return ok;
+}
+
+/*******************************************************************************
+*   MAIN                                                                       *
+*******************************************************************************/
+
+static void usage(const char *const program)
+{
+   fprintf(stderr, "Usage: %s -o directory [-n nodes] [-d degree] "
+                   "[-c clients] [-i interfaces]\n"
+                   "       [-p hop penalty] [-T steps] [-I interval] "
+                   "[-j join rate] [-l leave rate]\n"
+                   "       [-F flap rate] [-s seed]\n", program);
+}
+
+static bool parse_options(int argc, char **argv, struct options *const options)
+{
+   int option;
+
+   options->directory    = NULL;
+   options->n_nodes      = 1000;
+   options->degree       = 8.0;
+   options->n_clients    = 2;
+   options->n_interfaces = 1;
+   options->hop_penalty  = 10;
+   options->n_steps      = 1;
+   options->interval_s   = 10;
+   options->join_rate    = 0.0;
+   options->leave_rate   = 0.0;
+   options->flap_rate    = 0.0;
+   options->seed         = 1;
+
+   while ((option = getopt(argc, argv, "o:n:d:c:i:p:T:I:j:l:F:s:h")) != -1) {
+      switch (option) {
+      case 'o': options->directory    = optarg;                         break;
+      case 'n': options->n_nodes      = strtoul(optarg, NULL, 10);      break;
+      case 'd': options->degree       = strtod(optarg, NULL);           break;
+      case 'c': options->n_clients    = strtoul(optarg, NULL, 10);      break;
+      case 'i': options->n_interfaces = strtoul(optarg, NULL, 10);      break;
+      case 'p': options->hop_penalty  = strtoul(optarg, NULL, 10);      break;
+      case 'T': options->n_steps      = strtoul(optarg, NULL, 10);      break;
+      case 'I': options->interval_s   = strtoul(optarg, NULL, 10);      break;
+      case 'j': options->join_rate    = strtod(optarg, NULL);           break;
+      case 'l': options->leave_rate   = strtod(optarg, NULL);           break;
+      case 'F': options->flap_rate    = strtod(optarg, NULL);           break;
+      case 's': options->seed         = strtoull(optarg, NULL, 10);     break;
+      default:
+         return false;
+      }
+   }
+
+   return options->directory && options->n_nodes >= 1
+          && options->n_nodes < NO_NODE && options->degree > 0.0
+          && options->n_clients <= MAX_CLIENTS
+          && options->n_interfaces >= 1
+          && options->n_interfaces <= MAX_INTERFACES
+          && options->hop_penalty < TQ_MAX && options->n_steps >= 1
+          && options->join_rate >= 0.0 && options->leave_rate >= 0.0
+          && options->leave_rate <= 1.0 && options->flap_rate >= 0.0
+          && options->flap_rate <= 1.0;
+}
+
+int main(int argc, char **argv)
+{
+   struct topology topology;
+   char            step_dir[PATH_MAX];
+   bool            ok = true;
+
+   memset(&topology, 0, sizeof(topology));
+   if (!parse_options(argc, argv, &topology.options)) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (mkdir(topology.options.directory, 0755) && errno != EEXIST) {
+      perror(topology.options.directory);
+      return EXIT_FAILURE;
+   }
+
+   topology.rng   = splitmix64(topology.options.seed);
+   topology.range = sqrt(topology.options.degree
+                         / (M_PI * topology.options.n_nodes));
+   if (topology.range > 1.0) {
+      topology.range = 1.0;
+   }
+
+   for (uint32_t i = 0; i < topology.options.n_nodes && ok; i++) {
+      ok = add_node(&topology);
+   }
+
+   for (unsigned int step = 0; step < topology.options.n_steps && ok; step++) {
+      if (step) {
+         ok = churn(&topology);
+      }
+      snprintf(step_dir, sizeof(step_dir), "%s/t%04u",
+               topology.options.directory, step);
+      ok = ok && build_graph(&topology, step)
+              && write_step(&topology, step, step_dir);
+      if (ok) {
+         fprintf(stderr, "%s: %u nodes ever, %u links, %u neighbours\n", step_dir,
+                 topology.n_nodes, topology.graph.first[topology.n_nodes] / 2,
+                 topology.graph.first[1]);
+      }
+   }
+   if (!ok) {
+      fprintf(stderr, "Cannot write tables: %s\n", strerror(errno));
+   }
+
+   free(topology.graph.first);
+   free(topology.graph.peer);
+   free(topology.graph.tq);
+   free(topology.nodes);
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif                          /* __linux */
@@ -2,16 +2,55 @@
 
 #define _XOPEN_SOURCE 700
 
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
 
 #include "batman_adv.h"
+#include "batman_adv_async.h"
+#include "batman_adv_cache.h"
+#include "batman_adv_dat.h"
+#include "batman_adv_gateways.h"
+#include "batman_adv_history.h"
+#include "batman_adv_mac_filter.h"
+#include "batman_adv_neighbors.h"
+#include "batman_adv_originators.h"
+#include "batman_adv_shm.h"
+#include "batman_adv_staleness.h"
+#include "batman_adv_topology.h"
+#include "meshutil.h"
 
 #define UNIMPLMENTED "Test not implemented"
 
+/// Interface of the fixture tables.
+#define TEST_IF "bat0"
+
+/// Root of the fixture tables, MESHUTIL_DEBUGFS_ROOT of the fixture suite.
+static char fixture_root[64];
+
+/// Chunk borders of parallel parses which fell on a line start, and not.
+static unsigned int n_aligned_borders;
+static unsigned int n_unaligned_borders;
+
+/* C++ interface tests, in meshutil_hpp_tests.cpp. */
+void check_node_store_for_each (void);
+
+/* C++20 coroutine tests, in meshutil_coro_tests.cpp. */
+void check_coro_awaitables (void);
+
 void check_module_version (void)
 {
    char *version = mu_badv_kmod_version(NULL);
@@ -25,6 +64,1606 @@ void check_module_version (void)
 
 }
 
+void check_mac_addr_conversion (void)
+{
+   struct mu_mac_addr addr;
+   char               str[MU_MAC_ADDR_STR_LEN + 1];
+
+   CU_ASSERT_TRUE(mu_str_to_mac_addr("02:BA:7a:df:04:01 trailing", &addr));
+   CU_ASSERT_EQUAL(addr.octet[0], 0x02);
+   CU_ASSERT_EQUAL(addr.octet[1], 0xba);
+   CU_ASSERT_EQUAL(addr.octet[5], 0x01);
+
+   mu_mac_addr_to_str(&addr, str);
+   CU_ASSERT_STRING_EQUAL(str, "02:ba:7a:df:04:01");
+
+   CU_ASSERT_FALSE(mu_str_to_mac_addr("02:ba:7a:df:04", &addr));
+   CU_ASSERT_FALSE(mu_str_to_mac_addr("02-ba-7a-df-04-01", &addr));
+}
+
+static unsigned int n_allocations;
+static unsigned int n_releases;
+
+static void *counting_alloc(size_t size, void *ctx)
+{
+   (void) ctx;
+   n_allocations++;
+   return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *ctx)
+{
+   (void) ctx;
+   if (!ptr) {
+      n_allocations++;
+   }
+   return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *ctx)
+{
+   (void) ctx;
+   n_releases++;
+   free(ptr);
+}
+
+void check_allocator_hooks (void)
+{
+   char *version = NULL;
+
+   n_allocations = 0;
+   n_releases    = 0;
+   mu_set_allocator(counting_alloc, counting_realloc, counting_free, NULL);
+
+   mu_badv_if_available(NULL, NULL);
+   version = mu_badv_kmod_version(NULL);
+   mu_free(version);
+
+   mu_set_allocator(NULL, NULL, NULL, NULL);
+
+   CU_ASSERT_TRUE(n_allocations > 0);
+   CU_ASSERT_EQUAL(n_allocations, n_releases);
+}
+
+void check_long_interface_name (void)
+{
+   char name[MU_IF_NAME_LEN * 4];
+   int  error = 0;
+
+   memset(name, 'x', sizeof(name) - 1);
+   name[sizeof(name) - 1] = '\0';
+
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(name, &error), 0);
+   CU_ASSERT_EQUAL(error, ENAMETOOLONG);
+}
+
+#define STALE_NODES 256
+#define STALE_STEPS 20000
+
+static const uint32_t stale_thresholds[] = {100, 3000, 50000, 2000000};
+
+/// Brute-force model of a staleness watcher.
+struct stale_model {
+   bool     watched[STALE_NODES];
+   uint32_t level[STALE_NODES];
+   uint64_t last_seen_ms[STALE_NODES];
+   size_t   n_calls;
+};
+
+static uint32_t stale_random (void)
+{
+   static uint32_t state = 2463534242u;
+
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+   return state;
+}
+
+static void stale_mac (size_t index, struct mu_mac_addr *mac_addr)
+{
+   memset(mac_addr, 0, sizeof(struct mu_mac_addr));
+   mac_addr->octet[0] = 0x02;
+   mac_addr->octet[4] = (uint8_t) (index >> 8);
+   mac_addr->octet[5] = (uint8_t) index;
+}
+
+static void count_stale_call (const struct mu_mac_addr *mac_addr,
+                              unsigned int level, unsigned int old_level,
+                              uint64_t last_seen_ms, void *ctx)
+{
+   (void) mac_addr;
+   (void) last_seen_ms;
+   CU_ASSERT_NOT_EQUAL(level, old_level);
+   ((struct stale_model *) ctx)->n_calls++;
+}
+
+/// Level of a node of the given age, as in the header.
+static uint32_t stale_level (uint64_t age_ms, uint32_t level,
+                             uint32_t hysteresis_ms)
+{
+   while (level < 4 && age_ms >= stale_thresholds[level]) {
+      level++;
+   }
+   while (level > 0 && age_ms + hysteresis_ms < stale_thresholds[level - 1]) {
+      level--;
+   }
+   return level;
+}
+
+/* Random updates, advances and removals, compared after every step with a
+ * scan of all nodes. Times and thresholds are multiples of the resolution,
+ * so the wheel raises levels exactly on time.
+ */
+void check_staleness_model (void)
+{
+   struct stale_model        model;
+   struct mu_badv_staleness *watcher = NULL;
+   struct mu_badv_orig_table table;
+   struct mu_badv_originator originators[64];
+   struct mu_mac_addr        mac_addr;
+   uint64_t                  now_ms  = 1000000;
+   uint64_t                  seen_ms = 0;
+   uint32_t                  age_ms  = 0;
+   uint32_t                  level   = 0;
+   size_t                    index   = 0;
+   size_t                    n_calls = 0;
+   size_t                    raised  = 0;
+   size_t                    n_nodes = 0;
+   int                       error   = 0;
+
+   memset(&model, 0, sizeof(model));
+   memset(&table, 0, sizeof(table));
+   memset(originators, 0, sizeof(originators));
+   table.originators = originators;
+
+   watcher = mu_badv_staleness_new(stale_thresholds, 4, 500, 10,
+                                   count_stale_call, &model, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(watcher);
+
+   for (size_t step = 0; step < STALE_STEPS; step++) {
+      n_calls = model.n_calls;
+
+      switch (stale_random() % 10) {
+      case 0: case 1: case 2: case 3:
+         table.n_originators = stale_random() % 64;
+         for (size_t i = 0; i < table.n_originators; i++) {
+            index = stale_random() % STALE_NODES;
+            age_ms = 10 * (stale_random() % 4 ? stale_random() % 600
+                                              : stale_random() % 210000);
+            stale_mac(index, &originators[i].mac_addr);
+            originators[i].last_seen_msecs = age_ms;
+
+            seen_ms = now_ms > age_ms ? now_ms - age_ms : 0;
+            level   = model.watched[index] ? model.level[index] : 0;
+            model.watched[index]      = true;
+            model.last_seen_ms[index] = seen_ms;
+            model.level[index]        = stale_level(now_ms - seen_ms, level,
+                                                    500);
+            n_calls += model.level[index] != level;
+         }
+         CU_ASSERT_TRUE(mu_badv_staleness_update(watcher, &table, now_ms,
+                                                 &error));
+         break;
+      case 8:
+         index = stale_random() % STALE_NODES;
+         stale_mac(index, &mac_addr);
+         CU_ASSERT_EQUAL(mu_badv_staleness_remove(watcher, &mac_addr),
+                         model.watched[index]);
+         model.watched[index] = false;
+         break;
+      default:
+         now_ms += 10 * (stale_random() % 4 ? stale_random() % 100
+                                            : stale_random() % 300000);
+         raised = 0;
+         for (index = 0; index < STALE_NODES; index++) {
+            if (!model.watched[index]) {
+               continue;
+            }
+            level = model.level[index];
+            while (model.level[index] < 4
+                   && now_ms - model.last_seen_ms[index]
+                      >= stale_thresholds[model.level[index]]) {
+               model.level[index]++;
+            }
+            raised += model.level[index] != level;
+         }
+         n_calls += raised;
+         CU_ASSERT_EQUAL(mu_badv_staleness_advance(watcher, now_ms), raised);
+         break;
+      }
+
+      CU_ASSERT_EQUAL(model.n_calls, n_calls);
+      n_nodes = 0;
+      for (index = 0; index < STALE_NODES; index++) {
+         stale_mac(index, &mac_addr);
+         level = (uint32_t) mu_badv_staleness_level(watcher, &mac_addr,
+                                                    &seen_ms);
+         if (!model.watched[index]) {
+            CU_ASSERT_EQUAL(level, (uint32_t) -1);
+            continue;
+         }
+         n_nodes++;
+         CU_ASSERT_EQUAL(level, model.level[index]);
+         CU_ASSERT_EQUAL(seen_ms, model.last_seen_ms[index]);
+      }
+      CU_ASSERT_EQUAL(mu_badv_staleness_n_nodes(watcher), n_nodes);
+   }
+
+   mu_badv_staleness_free(watcher);
+}
+
+/*******************************************************************************
+*   FIXTURE SUITE                                                              *
+*******************************************************************************/
+
+static int init_fixture_suite (void)
+{
+   char path[128];
+
+   snprintf(fixture_root, sizeof(fixture_root), "/tmp/meshutil_cunit.XXXXXX");
+   if (!mkdtemp(fixture_root)) {
+      return -1;
+   }
+   snprintf(path, sizeof(path), "%s/batman_adv", fixture_root);
+   mkdir(path, 0755);
+   snprintf(path, sizeof(path), "%s/batman_adv/" TEST_IF, fixture_root);
+   if (mkdir(path, 0755)) {
+      return -1;
+   }
+   return setenv("MESHUTIL_DEBUGFS_ROOT", fixture_root, 1);
+}
+
+static int remove_entry (const char *path, const struct stat *st, int flag,
+                         struct FTW *ftw)
+{
+   (void) st;
+   (void) flag;
+   (void) ftw;
+   return remove(path);
+}
+
+static int clean_fixture_suite (void)
+{
+   unsetenv("MESHUTIL_DEBUGFS_ROOT");
+   return nftw(fixture_root, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+static FILE *open_table (const char *table)
+{
+   char path[128];
+
+   snprintf(path, sizeof(path), "%s/batman_adv/" TEST_IF "/%s", fixture_root,
+            table);
+   return fopen(path, "w");
+}
+
+static void remove_table (const char *table)
+{
+   char path[128];
+
+   snprintf(path, sizeof(path), "%s/batman_adv/" TEST_IF "/%s", fixture_root,
+            table);
+   unlink(path);
+}
+
+static bool write_table (const char *table, const char *contents)
+{
+   FILE *file = open_table(table);
+
+   if (!file) {
+      return false;
+   }
+   fputs(contents, file);
+   return fclose(file) == 0;
+}
+
+static void node_mac (size_t index, char *str)
+{
+   sprintf(str, "02:ba:%02x:%02x:%02x:01", (unsigned int) (index >> 16) & 0xff,
+           (unsigned int) (index >> 8) & 0xff, (unsigned int) index & 0xff);
+}
+
+/* Originator i is reached through neighbour i % n_hops and lists all
+ * neighbours as potential next hops. All lines have the same length and the
+ * header is padded to a multiple of it, so the offset of every line is known.
+ */
+static bool write_originators (size_t n_nodes, size_t n_hops)
+{
+   FILE   *file = open_table("originators");
+   char    mac[MU_MAC_ADDR_STR_LEN + 1];
+   char    hop[MU_MAC_ADDR_STR_LEN + 1];
+   size_t  line_length = 0;
+   int     header_length = 0;
+
+   if (!file) {
+      return false;
+   }
+
+   node_mac(0, mac);
+   line_length = (size_t) snprintf(NULL, 0, "%s %4u.%03us   (%3u) %s [%10s]:\n",
+                                   mac, 0u, 0u, 0u, mac, "eth0")
+                 + n_hops * (size_t) snprintf(NULL, 0, " %s (%3u)", mac, 0u);
+
+   header_length = fprintf(file, "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: "
+                                 "eth0/02:ba:7a:df:04:00 (" TEST_IF
+                                 "/02:ba:7a:df:04:00 BATMAN_IV)]\n"
+                                 "   Originator        last-seen (#/255) "
+                                 "Nexthop           [outgoingIF]: "
+                                 "Potential nexthops ...");
+   while ((size_t) header_length % line_length != line_length - 1) {
+      header_length += fputc(' ', file) != EOF;
+   }
+   fputc('\n', file);
+
+   for (size_t i = 0; i < n_nodes; i++) {
+      node_mac(i, mac);
+      node_mac(i % n_hops, hop);
+      fprintf(file, "%s %4u.%03us   (%3u) %s [%10s]:", mac,
+              (unsigned int) (i % 200), (unsigned int) (i * 7 % 1000),
+              255 - (unsigned int) (i % 200), hop, i % 2 ? "wlan0" : "eth0");
+      for (size_t h = 0; h < n_hops; h++) {
+         node_mac(h, hop);
+         fprintf(file, " %s (%3u)", hop, (unsigned int) ((i + h) % 256));
+      }
+      fputc('\n', file);
+   }
+
+   return fclose(file) == 0;
+}
+
+/// Reads a fixture table back, NULL on error. Released with free().
+static char *read_table (const char *root, const char *table, size_t *length)
+{
+   FILE *file   = NULL;
+   char *buffer = NULL;
+   char  path[128];
+   long  size;
+
+   snprintf(path, sizeof(path), "%s/batman_adv/" TEST_IF "/%s", root, table);
+   file = fopen(path, "r");
+   if (!file) {
+      return NULL;
+   }
+   if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0
+       || fseek(file, 0, SEEK_SET)) {
+      fclose(file);
+      return NULL;
+   }
+   buffer = malloc((size_t) size + 1);
+   if (buffer) {
+      *length = fread(buffer, 1, (size_t) size, file);
+      buffer[*length] = '\0';
+   }
+   fclose(file);
+   return buffer;
+}
+
+/// Whether two tables hold the same entries in the same order.
+static bool same_tables (const struct mu_badv_orig_table *a,
+                         const struct mu_badv_orig_table *b)
+{
+   if (a->metric_type != b->metric_type
+       || a->n_originators != b->n_originators || a->n_hops != b->n_hops
+       || a->n_ifs != b->n_ifs) {
+      return false;
+   }
+
+   for (size_t i = 0; i < a->n_ifs; i++) {
+      if (strcmp(a->ifs[i].name, b->ifs[i].name)
+          || a->ifs[i].n_originators != b->ifs[i].n_originators
+          || a->ifs[i].n_neighbors != b->ifs[i].n_neighbors
+          || a->ifs[i].metric_min != b->ifs[i].metric_min
+          || a->ifs[i].metric_sum != b->ifs[i].metric_sum) {
+         return false;
+      }
+   }
+
+   for (size_t i = 0; i < a->n_originators; i++) {
+      const struct mu_badv_originator *x = &a->originators[i];
+      const struct mu_badv_originator *y = &b->originators[i];
+
+      if (!mu_mac_addr_equal(&x->mac_addr, &y->mac_addr)
+          || !mu_mac_addr_equal(&x->next_hop, &y->next_hop)
+          || x->last_seen_msecs != y->last_seen_msecs
+          || x->metric != y->metric || x->first_hop != y->first_hop
+          || x->n_hops != y->n_hops || x->if_id != y->if_id
+          || strcmp(x->outgoing_if, y->outgoing_if)) {
+         return false;
+      }
+   }
+
+   for (size_t i = 0; i < a->n_hops; i++) {
+      if (!mu_mac_addr_equal(&a->hops[i].mac_addr, &b->hops[i].mac_addr)
+          || a->hops[i].metric != b->hops[i].metric) {
+         return false;
+      }
+   }
+   return true;
+}
+
+void check_orig_index (void)
+{
+   struct mu_badv_orig_table *table = NULL;
+   struct mu_mac_addr         addr;
+   char                       mac[MU_MAC_ADDR_STR_LEN + 1];
+   int                        error = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_originators(5000, 3));
+
+   mu_badv_set_orig_index(true);
+   table = mu_badv_orig_table_read(TEST_IF, &error);
+   mu_badv_set_orig_index(false);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+   CU_ASSERT_EQUAL(table->n_originators, 5000);
+   CU_ASSERT_PTR_NULL(table->index);  // Read for the caller, not reused.
+
+   CU_ASSERT_TRUE(mu_badv_orig_table_index(table, &error));
+   CU_ASSERT_PTR_NOT_NULL(table->index);
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      addr = table->originators[i].mac_addr;
+      CU_ASSERT_PTR_EQUAL(mu_badv_orig_table_find(table, &addr),
+                          &table->originators[i]);
+   }
+   for (size_t i = 5000; i < 15000; i++) {
+      node_mac(i, mac);
+      mu_str_to_mac_addr(mac, &addr);
+      CU_ASSERT_PTR_NULL(mu_badv_orig_table_find(table, &addr));
+   }
+
+   mu_badv_orig_table_free(table);
+}
+
+/* Parses the originators table under root on the calling thread and on 2 to 8
+ * threads and compares the results entry by entry.
+ */
+static void check_parallel_parse_under (const char *root)
+{
+   struct mu_badv_orig_table *serial   = NULL;
+   struct mu_badv_orig_table *parallel = NULL;
+   char                      *buffer   = NULL;
+   size_t                     length   = 0;
+   size_t                     border;
+   int                        error    = 0;
+
+   buffer = read_table(root, "originators", &length);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(buffer);
+   setenv("MESHUTIL_DEBUGFS_ROOT", root, 1);
+
+   mu_badv_set_parallel_parse(1, 0);
+   serial = mu_badv_orig_table_read(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL(serial);
+
+   for (unsigned int n_threads = 2; serial && n_threads <= 8; n_threads++) {
+      mu_badv_set_parallel_parse(n_threads, 1);
+      parallel = mu_badv_orig_table_read(TEST_IF, &error);
+      CU_ASSERT_PTR_NOT_NULL(parallel);
+      if (parallel) {
+         CU_ASSERT_TRUE(same_tables(serial, parallel));
+      }
+      mu_badv_orig_table_free(parallel);
+
+      for (unsigned int i = 1; i < n_threads; i++) {
+         border = length / n_threads * i;
+         if (buffer[border - 1] == '\n') {
+            n_aligned_borders++;
+         } else {
+            n_unaligned_borders++;
+         }
+      }
+   }
+
+   mu_badv_set_parallel_parse(0, 0);
+   setenv("MESHUTIL_DEBUGFS_ROOT", fixture_root, 1);
+   mu_badv_orig_table_free(serial);
+   free(buffer);
+}
+
+void check_parallel_parse (void)
+{
+   char command[256];
+   char root[128];
+
+   n_aligned_borders   = 0;
+   n_unaligned_borders = 0;
+
+   /* With 6 hops the header is padded to one line, 12600 lines of equal
+    * length then put every chunk border on a line start.
+    */
+   CU_ASSERT_TRUE_FATAL(write_originators(12599, 6));
+   check_parallel_parse_under(fixture_root);
+
+   /* Lines of varying length, borders fall into lines. */
+   snprintf(command, sizeof(command),
+            MESHUTIL_TOPOGEN " -o %s/topogen -n 60000 -i 2 -p 0 >/dev/null",
+            fixture_root);
+   CU_ASSERT_EQUAL_FATAL(system(command), 0);
+   snprintf(root, sizeof(root), "%s/topogen/t0000", fixture_root);
+   check_parallel_parse_under(root);
+
+   CU_ASSERT_TRUE(n_aligned_borders > 0);
+   CU_ASSERT_TRUE(n_unaligned_borders > 0);
+}
+
+/* Nodes with ties in every order, some neighbours, some lines longer than
+ * the buffer of mu_badv_orig_top_k() and a few malformed lines.
+ */
+static bool write_top_k_originators (size_t n_nodes)
+{
+   FILE   *file = open_table("originators");
+   char    mac[MU_MAC_ADDR_STR_LEN + 1];
+   char    hop[MU_MAC_ADDR_STR_LEN + 1];
+   size_t  n_hops = 0;
+
+   if (!file) {
+      return false;
+   }
+
+   fprintf(file, "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: eth0/02:ba:7a:df:04:00"
+                 " (" TEST_IF "/02:ba:7a:df:04:00 BATMAN_IV)]\n"
+                 "   Originator        last-seen (#/255) Nexthop           "
+                 "[outgoingIF]: Potential nexthops ...\n");
+   for (size_t i = 0; i < n_nodes; i++) {
+      node_mac(i, mac);
+      node_mac(i % 3 ? i / 3 : i, hop);
+      n_hops = i % 10 == 3 ? 200 + i : 1 + i % 5;
+      if (i % 17 == 5) {
+         fprintf(file, "%s garbage\n", mac);
+         continue;
+      }
+      fprintf(file, "%s %4u.%03us   (%3u) %s [%10s]:", mac,
+              (unsigned int) (i % 7), (unsigned int) (i % 4 * 250),
+              (unsigned int) (i * 53 % 40), hop, "wlan0");
+      for (size_t h = 0; h < n_hops; h++) {
+         node_mac(h, hop);
+         fprintf(file, " %s (%3u)", hop, (unsigned int) (h % 256));
+      }
+      fputc('\n', file);
+   }
+
+   return fclose(file) == 0;
+}
+
+static enum mu_badv_top_order top_k_order;
+
+/// Ranking of mu_badv_orig_top_k() for qsort().
+static int compare_top_k (const void *x, const void *y)
+{
+   const struct mu_badv_originator *a = x;
+   const struct mu_badv_originator *b = y;
+   uint32_t                         u = 0;
+   uint32_t                         v = 0;
+
+   switch (top_k_order) {
+   case MU_BADV_TOP_STALEST:
+      u = a->last_seen_msecs;
+      v = b->last_seen_msecs;
+      break;
+   case MU_BADV_TOP_BEST_METRIC:
+      u = a->metric;
+      v = b->metric;
+      break;
+   case MU_BADV_TOP_WORST_METRIC:
+      u = b->metric;
+      v = a->metric;
+      break;
+   case MU_BADV_TOP_MOST_HOPS:
+      u = a->n_hops;
+      v = b->n_hops;
+      break;
+   }
+   if (u != v) {
+      return u > v ? -1 : 1;
+   }
+   return memcmp(a->mac_addr.octet, b->mac_addr.octet, MU_MAC_ADDR_LEN);
+}
+
+void check_orig_top_k (void)
+{
+   const  size_t              n_nodes = 60;
+   const  size_t              ks[]    = {1, 5, n_nodes, n_nodes + 3};
+   struct mu_badv_orig_table *table   = NULL;
+   struct mu_badv_originator  sorted[60];
+   struct mu_badv_originator  top[63];
+   size_t                     n_sorted = 0;
+   size_t                     n_top    = 0;
+   size_t                     n_long   = 0;
+   int                        error    = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_top_k_originators(n_nodes));
+   table = mu_badv_orig_table_read(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+   CU_ASSERT_EQUAL(table->n_originators, n_nodes - 4);
+   for (size_t i = 0; i < table->n_originators; i++) {
+      n_long += table->originators[i].n_hops >= 200;
+   }
+   CU_ASSERT_EQUAL(n_long, 6);
+
+   for (int order = MU_BADV_TOP_STALEST; order <= MU_BADV_TOP_MOST_HOPS;
+        order++) {
+      for (int neighbors_only = 0; neighbors_only < 2; neighbors_only++) {
+         n_sorted = 0;
+         for (size_t i = 0; i < table->n_originators; i++) {
+            if (!neighbors_only
+                || mu_mac_addr_equal(&table->originators[i].next_hop,
+                                     &table->originators[i].mac_addr)) {
+               sorted[n_sorted++] = table->originators[i];
+            }
+         }
+         top_k_order = (enum mu_badv_top_order) order;
+         qsort(sorted, n_sorted, sizeof(*sorted), compare_top_k);
+
+         for (size_t j = 0; j < sizeof(ks) / sizeof(*ks); j++) {
+            n_top = mu_badv_orig_top_k(TEST_IF, top_k_order,
+                                       neighbors_only, top, ks[j], &error);
+            CU_ASSERT_EQUAL(error, 0);
+            CU_ASSERT_EQUAL_FATAL(n_top,
+                                  ks[j] < n_sorted ? ks[j] : n_sorted);
+            for (size_t i = 0; i < n_top; i++) {
+               CU_ASSERT_TRUE(mu_mac_addr_equal(&top[i].mac_addr,
+                                                &sorted[i].mac_addr));
+               CU_ASSERT_EQUAL(top[i].last_seen_msecs,
+                               sorted[i].last_seen_msecs);
+               CU_ASSERT_EQUAL(top[i].metric, sorted[i].metric);
+               CU_ASSERT_EQUAL(top[i].n_hops, sorted[i].n_hops);
+            }
+         }
+      }
+   }
+
+   mu_badv_orig_table_free(table);
+}
+
+static bool same_mac (const struct mu_mac_addr *addr, const char *str)
+{
+   struct mu_mac_addr expected;
+
+   return mu_str_to_mac_addr(str, &expected)
+          && mu_mac_addr_equal(addr, &expected);
+}
+
+void check_neighbors_table (void)
+{
+   struct mu_badv_neighbor *neighbors   = NULL;
+   size_t                   n_neighbors = 0;
+   int                      error       = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_table("neighbors",
+      "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: eth0/02:ba:7a:df:04:00 "
+      "(" TEST_IF "/02:ba:7a:df:04:00 BATMAN_IV)]\n"
+      "IF             Neighbor              last-seen\n"
+      "        eth0     02:ba:00:00:01:01    0.180s\n"
+      "       wlan0     02:ba:00:00:02:01   12.5s\n"
+      "        eth0     02:ba:00:00:03    0.100s\n"
+      "        eth0     02:ba:00:00:04:01\n"
+      "        eth0     02:ba:00:00:05:01    1,000s\n"
+      "garbage\n"
+      "        eth0     02:ba:00:00:06:01    1.000s"));
+   neighbors = mu_badv_neighbors(TEST_IF, &n_neighbors, &error);
+   CU_ASSERT_EQUAL(error, 0);
+   CU_ASSERT_EQUAL_FATAL(n_neighbors, 3);
+   CU_ASSERT_TRUE(same_mac(&neighbors[0].mac_addr, "02:ba:00:00:01:01"));
+   CU_ASSERT_STRING_EQUAL(neighbors[0].outgoing_if, "eth0");
+   CU_ASSERT_EQUAL(neighbors[0].last_seen_msecs, 180);
+   CU_ASSERT_EQUAL(neighbors[0].metric_type, MU_BADV_METRIC_NONE);
+   CU_ASSERT_TRUE(same_mac(&neighbors[1].mac_addr, "02:ba:00:00:02:01"));
+   CU_ASSERT_STRING_EQUAL(neighbors[1].outgoing_if, "wlan0");
+   CU_ASSERT_EQUAL(neighbors[1].last_seen_msecs, 12500);
+   CU_ASSERT_TRUE(same_mac(&neighbors[2].mac_addr, "02:ba:00:00:06:01"));
+   CU_ASSERT_EQUAL(neighbors[2].last_seen_msecs, 1000);
+   mu_free(neighbors);
+
+   CU_ASSERT_TRUE_FATAL(write_table("neighbors",
+      "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: eth0/02:ba:7a:df:04:00 "
+      "(" TEST_IF "/02:ba:7a:df:04:00 BATMAN_V)]\n"
+      "  Neighbor        last-seen ( throughput) [        IF]\n"
+      "02:ba:00:00:01:01    0.400s (        1.0) [      eth0]\n"
+      "02:ba:00:00:02:01    1.020s (       54.3) [     wlan0]\n"
+      "02:ba:00:00:03:01    0.400s (        1.0 [      eth0]\n"
+      "02:ba:00:00:04:01    0.400s (        1.0) [          ]\n"
+      "02:ba:00:00:05:01    0.400s\n"));
+   neighbors = mu_badv_neighbors(TEST_IF, &n_neighbors, &error);
+   CU_ASSERT_EQUAL(error, 0);
+   CU_ASSERT_EQUAL_FATAL(n_neighbors, 2);
+   CU_ASSERT_EQUAL(neighbors[0].metric_type, MU_BADV_METRIC_THROUGHPUT);
+   CU_ASSERT_EQUAL(neighbors[0].metric, 1000);
+   CU_ASSERT_EQUAL(neighbors[0].last_seen_msecs, 400);
+   CU_ASSERT_STRING_EQUAL(neighbors[0].outgoing_if, "eth0");
+   CU_ASSERT_TRUE(same_mac(&neighbors[1].mac_addr, "02:ba:00:00:02:01"));
+   CU_ASSERT_EQUAL(neighbors[1].metric, 54300);
+   CU_ASSERT_STRING_EQUAL(neighbors[1].outgoing_if, "wlan0");
+   mu_free(neighbors);
+
+   CU_ASSERT_TRUE_FATAL(write_table("neighbors", "garbage\n"));
+   CU_ASSERT_PTR_NULL(mu_badv_neighbors(TEST_IF, &n_neighbors, &error));
+   CU_ASSERT_EQUAL(n_neighbors, 0);
+   CU_ASSERT_EQUAL(error, 0);
+}
+
+/// Lines of both formats, the first selected, and malformed lines.
+static const char gateways_table[] =
+   "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: eth0/02:ba:7a:df:04:00 "
+   "(" TEST_IF "/02:ba:7a:df:04:00 BATMAN_IV)]\n"
+   "      Router            ( TQ) Next Hop          [outgoingIf]  Bandwidth\n"
+   "=> 02:ba:00:00:01:01 (200) 02:ba:00:00:01:01 [      eth0]: 10.0/2.0 MBit\n"
+   "   02:ba:00:00:02:01 (230) 02:ba:00:00:09:01 [ wlan0]: 160 - 5MBit/1MBit\n"
+   "   02:ba:00:00:03:01 (2x0) 02:ba:00:00:09:01 [     wlan0]: 1.0/1.0 MBit\n"
+   "   02:ba:00:00:04:01 (100) 02:ba:00:00:09    [     wlan0]: 1.0/1.0 MBit\n"
+   "   02:ba:00:00:05:01 (100) 02:ba:00:00:09:01 [     wlan0: 1.0/1.0 MBit\n"
+   "   02:ba:00:00:06:01 (220) 02:ba:00:00:09:01 [      eth0]\n";
+
+void check_gateways_table (void)
+{
+   struct mu_badv_gateway *gateways   = NULL;
+   size_t                  n_gateways = 0;
+   int                     error      = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_table("gateways", gateways_table));
+   gateways = mu_badv_gateways(TEST_IF, &n_gateways, &error);
+   CU_ASSERT_EQUAL(error, 0);
+   CU_ASSERT_EQUAL_FATAL(n_gateways, 3);
+
+   CU_ASSERT_TRUE(gateways[0].selected);
+   CU_ASSERT_TRUE(same_mac(&gateways[0].mac_addr, "02:ba:00:00:01:01"));
+   CU_ASSERT_TRUE(same_mac(&gateways[0].next_hop, "02:ba:00:00:01:01"));
+   CU_ASSERT_EQUAL(gateways[0].metric_type, MU_BADV_METRIC_TQ);
+   CU_ASSERT_EQUAL(gateways[0].metric, 200);
+   CU_ASSERT_STRING_EQUAL(gateways[0].outgoing_if, "eth0");
+   CU_ASSERT_EQUAL(gateways[0].bandwidth_down_kbit, 10000);
+   CU_ASSERT_EQUAL(gateways[0].bandwidth_up_kbit, 2000);
+
+   CU_ASSERT_FALSE(gateways[1].selected);
+   CU_ASSERT_TRUE(same_mac(&gateways[1].next_hop, "02:ba:00:00:09:01"));
+   CU_ASSERT_EQUAL(gateways[1].metric, 230);
+   CU_ASSERT_STRING_EQUAL(gateways[1].outgoing_if, "wlan0");
+   CU_ASSERT_EQUAL(gateways[1].bandwidth_down_kbit, 5000);
+   CU_ASSERT_EQUAL(gateways[1].bandwidth_up_kbit, 1000);
+
+   CU_ASSERT_TRUE(same_mac(&gateways[2].mac_addr, "02:ba:00:00:06:01"));
+   CU_ASSERT_EQUAL(gateways[2].metric, 220);
+   CU_ASSERT_EQUAL(gateways[2].bandwidth_down_kbit, 0);
+   CU_ASSERT_EQUAL(gateways[2].bandwidth_up_kbit, 0);
+   mu_free(gateways);
+}
+
+/// Size of the allocation failed by failing_alloc().
+static size_t       fail_size;
+static unsigned int n_failed;
+
+static void *failing_alloc(size_t size, void *ctx)
+{
+   (void) ctx;
+   if (size == fail_size) {
+      n_failed++;
+      errno = ENOMEM;
+      return NULL;
+   }
+   return malloc(size);
+}
+
+static void *failing_realloc(void *ptr, size_t size, void *ctx)
+{
+   (void) ctx;
+   return realloc(ptr, size);
+}
+
+static void failing_free(void *ptr, void *ctx)
+{
+   (void) ctx;
+   free(ptr);
+}
+
+void check_gw_selector (void)
+{
+   struct mu_badv_gw_selector *selector = NULL;
+   struct mu_badv_gateway      best;
+   size_t                      n_lines  = 1;
+   int                         error    = 0;
+
+   memset(&best, 0, sizeof(best));
+   CU_ASSERT_TRUE_FATAL(write_table("gateways", gateways_table));
+   selector = mu_badv_gw_selector_new(TEST_IF, 60000, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(selector);
+
+   // Fail the allocation of the parsed gateways; the failure is not kept.
+   for (const char *c = gateways_table; *c; c++) {
+      n_lines += *c == '\n';
+   }
+   fail_size = n_lines * sizeof(struct mu_badv_gateway);
+   n_failed  = 0;
+   mu_set_allocator(failing_alloc, failing_realloc, failing_free, NULL);
+   CU_ASSERT_FALSE(mu_badv_gw_selector_best(selector, &best, &error));
+   mu_set_allocator(NULL, NULL, NULL, NULL);
+   CU_ASSERT_EQUAL(n_failed, 1);
+   CU_ASSERT_EQUAL(error, ENOMEM);
+
+   CU_ASSERT_TRUE(mu_badv_gw_selector_best(selector, &best, &error));
+   CU_ASSERT_EQUAL(error, 0);
+   CU_ASSERT_TRUE(best.selected);
+   CU_ASSERT_TRUE(same_mac(&best.mac_addr, "02:ba:00:00:01:01"));
+
+   // Within the refresh interval a changed table is not read.
+   CU_ASSERT_TRUE_FATAL(write_table("gateways", gateways_table + 1));
+   CU_ASSERT_TRUE(mu_badv_gw_selector_best(selector, &best, &error));
+   CU_ASSERT_TRUE(same_mac(&best.mac_addr, "02:ba:00:00:01:01"));
+   mu_badv_gw_selector_free(selector);
+
+   // Without a selected gateway the one with the best metric is used.
+   CU_ASSERT_TRUE_FATAL(write_table("gateways", strchr(gateways_table, '=')
+                                                + 2));
+   selector = mu_badv_gw_selector_new(TEST_IF, 0, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(selector);
+   CU_ASSERT_TRUE(mu_badv_gw_selector_best(selector, &best, &error));
+   CU_ASSERT_FALSE(best.selected);
+   CU_ASSERT_TRUE(same_mac(&best.mac_addr, "02:ba:00:00:02:01"));
+   mu_badv_gw_selector_free(selector);
+}
+
+void check_dat_table (void)
+{
+   struct mu_badv_dat_index       *index     = NULL;
+   const struct mu_badv_dat_entry *entries   = NULL;
+   struct mu_badv_dat_entry        entry;
+   size_t                          n_entries = 0;
+   int                             error     = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_table("dat_cache",
+      "Distributed ARP Table (" TEST_IF ", vid 0):\n"
+      "          IPv4             MAC        VID   last-seen\n"
+      " *        10.0.0.1 02:ba:00:00:01:01   -1      0:05\n"
+      " *        10.0.0.2 02:ba:00:00:02:01    7      1:30\n"
+      " *        10.0.0.3 02:ba:00:00:03:01      2:00\n"
+      " *      10.0.0.256 02:ba:00:00:04:01   -1      0:05\n"
+      " *          10.0.0 02:ba:00:00:05:01   -1      0:05\n"
+      " *        10.0.0.6 02:ba:00:00:06:01   -1      0-05\n"
+      " *        10.0.0.7 02:ba:00:00:07      -1      0:05\n"
+      "          10.0.0.8 02:ba:00:00:08:01   -1      0:05\n"
+      " *        10.0.0.2 02:ba:00:00:09:01   -1      0:10"));
+   index = mu_badv_dat_index_new(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(index);
+   CU_ASSERT_TRUE(mu_badv_dat_index_refresh(index, &error));
+   CU_ASSERT_EQUAL(error, 0);
+
+   entries = mu_badv_dat_index_entries(index, &n_entries);
+   CU_ASSERT_EQUAL_FATAL(n_entries, 4);
+   CU_ASSERT_EQUAL(entries[0].ipv4, inet_addr("10.0.0.1"));
+   CU_ASSERT_TRUE(same_mac(&entries[0].mac_addr, "02:ba:00:00:01:01"));
+   CU_ASSERT_EQUAL(entries[0].vid, MU_BADV_DAT_VID_UNTAGGED);
+   CU_ASSERT_EQUAL(entries[0].last_seen_secs, 5);
+   CU_ASSERT_EQUAL(entries[1].vid, 7);
+   CU_ASSERT_EQUAL(entries[1].last_seen_secs, 90);
+   // Tables of old versions have no VID column.
+   CU_ASSERT_EQUAL(entries[2].ipv4, inet_addr("10.0.0.3"));
+   CU_ASSERT_EQUAL(entries[2].vid, MU_BADV_DAT_VID_UNTAGGED);
+   CU_ASSERT_EQUAL(entries[2].last_seen_secs, 120);
+
+   CU_ASSERT_TRUE(mu_badv_dat_lookup(index, inet_addr("10.0.0.2"), 7,
+                                     &entry));
+   CU_ASSERT_TRUE(same_mac(&entry.mac_addr, "02:ba:00:00:02:01"));
+   CU_ASSERT_TRUE(mu_badv_dat_lookup(index, inet_addr("10.0.0.2"),
+                                     MU_BADV_DAT_VID_UNTAGGED, &entry));
+   CU_ASSERT_TRUE(same_mac(&entry.mac_addr, "02:ba:00:00:09:01"));
+   CU_ASSERT_TRUE(mu_badv_dat_lookup(index, inet_addr("10.0.0.3"),
+                                     MU_BADV_DAT_VID_ANY, NULL));
+   CU_ASSERT_FALSE(mu_badv_dat_lookup(index, inet_addr("10.0.0.3"), 7, NULL));
+   CU_ASSERT_FALSE(mu_badv_dat_lookup(index, inet_addr("10.0.0.4"),
+                                      MU_BADV_DAT_VID_ANY, NULL));
+   CU_ASSERT_FALSE(mu_badv_dat_lookup(index, inet_addr("10.0.0.8"),
+                                      MU_BADV_DAT_VID_ANY, NULL));
+
+   // A table without entries empties the index.
+   CU_ASSERT_TRUE_FATAL(write_table("dat_cache", "garbage\n"));
+   CU_ASSERT_TRUE(mu_badv_dat_index_refresh(index, &error));
+   mu_badv_dat_index_entries(index, &n_entries);
+   CU_ASSERT_EQUAL(n_entries, 0);
+   CU_ASSERT_FALSE(mu_badv_dat_lookup(index, inet_addr("10.0.0.1"),
+                                      MU_BADV_DAT_VID_ANY, NULL));
+   mu_badv_dat_index_free(index);
+}
+
+#define FILTER_NODES   2000
+#define FILTER_CLIENTS 4000
+#define FILTER_PROBES  100000
+
+/// Translation table of n clients, starting at client first.
+static bool write_clients (const char *table, size_t first, size_t n)
+{
+   FILE *file = open_table(table);
+   char  mac[MU_MAC_ADDR_STR_LEN + 1];
+
+   if (!file) {
+      return false;
+   }
+   fprintf(file, "Globally announced TT entries received via the mesh "
+                 TEST_IF "\n"
+                 "       Client         (TTVN)       Originator      (Curr "
+                 "TTVN) Flags\n");
+   for (size_t i = first; i < first + n; i++) {
+      node_mac(i, mac);
+      mac[1] = '6';
+      fprintf(file, " * %s  (%3u) via 02:ba:00:00:00:07     (%3u)   [.W]\n",
+              mac, 1u, 1u);
+   }
+   return fclose(file) == 0;
+}
+
+void check_mac_filter (void)
+{
+   static const unsigned int bits[] = {8, 16};
+   static const double       max_rates[] = {0.04, 0.002};
+
+   struct mu_badv_mac_filter *filter = NULL;
+   struct mu_mac_addr         mac_addr;
+   char                       mac[MU_MAC_ADDR_STR_LEN + 1];
+   size_t                     n_false = 0;
+   int                        error   = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_originators(FILTER_NODES, 1));
+   CU_ASSERT_TRUE_FATAL(write_clients("transtable_global", 0,
+                                      FILTER_CLIENTS / 2));
+   CU_ASSERT_TRUE_FATAL(write_clients("transtable_local", FILTER_CLIENTS / 2,
+                                      FILTER_CLIENTS / 2));
+
+   for (size_t b = 0; b < sizeof(bits) / sizeof(bits[0]); b++) {
+      filter = mu_badv_mac_filter_new(TEST_IF, bits[b], &error);
+      CU_ASSERT_PTR_NOT_NULL_FATAL(filter);
+      CU_ASSERT_TRUE_FATAL(mu_badv_mac_filter_refresh(filter, &error));
+      CU_ASSERT_EQUAL(mu_badv_mac_filter_size(filter),
+                      FILTER_NODES + FILTER_CLIENTS);
+
+      // No false negatives.
+      for (size_t i = 0; i < FILTER_NODES + FILTER_CLIENTS; i++) {
+         node_mac(i, mac);
+         if (i >= FILTER_NODES) {
+            node_mac(i - FILTER_NODES, mac);
+            mac[1] = '6';
+         }
+         mu_str_to_mac_addr(mac, &mac_addr);
+         CU_ASSERT_TRUE(mu_badv_mac_filter_contains(filter, &mac_addr));
+      }
+
+      // False positives at the load the filter was sized for.
+      n_false = 0;
+      for (size_t i = 0; i < FILTER_PROBES; i++) {
+         node_mac(i, mac);
+         mac[1] = 'a';
+         mu_str_to_mac_addr(mac, &mac_addr);
+         n_false += mu_badv_mac_filter_contains(filter, &mac_addr);
+      }
+      CU_ASSERT_TRUE((double) n_false / FILTER_PROBES < max_rates[b]);
+
+      mu_badv_mac_filter_free(filter);
+   }
+
+   // A failed refresh keeps the previous contents: no false negatives.
+   filter = mu_badv_mac_filter_new(TEST_IF, 0, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(filter);
+   CU_ASSERT_TRUE_FATAL(mu_badv_mac_filter_refresh(filter, &error));
+   remove_table("originators");
+   CU_ASSERT_FALSE(mu_badv_mac_filter_refresh(filter, &error));
+   CU_ASSERT_EQUAL(error, ENOENT);
+   CU_ASSERT_EQUAL(mu_badv_mac_filter_size(filter),
+                   FILTER_NODES + FILTER_CLIENTS);
+   for (size_t i = 0; i < FILTER_NODES; i++) {
+      node_mac(i, mac);
+      mu_str_to_mac_addr(mac, &mac_addr);
+      CU_ASSERT_TRUE(mu_badv_mac_filter_contains(filter, &mac_addr));
+   }
+   mu_badv_mac_filter_free(filter);
+
+   remove_table("transtable_global");
+   remove_table("transtable_local");
+}
+
+/// Reads the originators table of a mesh generated with the given seed.
+static struct mu_badv_orig_table *generate_mesh (unsigned int seed)
+{
+   struct mu_badv_orig_table *table = NULL;
+   char                       command[256];
+   char                       root[128];
+   int                        error = 0;
+
+   snprintf(command, sizeof(command),
+            MESHUTIL_TOPOGEN " -o %s/mesh%u -n 400 -s %u >/dev/null 2>&1",
+            fixture_root, seed, seed);
+   if (system(command)) {
+      return NULL;
+   }
+   snprintf(root, sizeof(root), "%s/mesh%u/t0000", fixture_root, seed);
+   setenv("MESHUTIL_DEBUGFS_ROOT", root, 1);
+   table = mu_badv_orig_table_read(TEST_IF, &error);
+   setenv("MESHUTIL_DEBUGFS_ROOT", fixture_root, 1);
+   return table;
+}
+
+/// Links of a reporter by the documented rules, returns their number.
+static size_t expected_links (const struct mu_badv_orig_table *table,
+                              uint64_t report_ms, struct mu_badv_link *links)
+{
+   const struct mu_badv_originator *originator = NULL;
+   const struct mu_mac_addr        *to         = NULL;
+   uint32_t                         metric     = 0;
+   uint64_t                         seen_ms    = 0;
+   size_t                           n_links    = 0;
+   size_t                           k          = 0;
+
+   for (size_t i = 0; i < table->n_originators; i++) {
+      originator = &table->originators[i];
+      seen_ms    = report_ms - originator->last_seen_msecs;
+      for (uint32_t j = 0; j <= originator->n_hops; j++) {
+         to     = j ? &table->hops[originator->first_hop + j - 1].mac_addr
+                    : &originator->next_hop;
+         metric = j ? table->hops[originator->first_hop + j - 1].metric
+                    : originator->metric;
+         for (k = 0; k < n_links && !mu_mac_addr_equal(&links[k].to, to); k++) {
+         }
+         if (k == n_links) {
+            memset(&links[k], 0, sizeof(struct mu_badv_link));
+            links[k].to = *to;
+            n_links++;
+         }
+         if (metric > links[k].metric) {
+            links[k].metric = metric;
+         }
+         if (seen_ms > links[k].seen_ms) {
+            links[k].seen_ms = seen_ms;
+         }
+      }
+   }
+   return n_links;
+}
+
+/// Checks the links of a reporter against the expected ones.
+static void check_links (const struct mu_badv_topology *topology,
+                         const struct mu_mac_addr      *reporter,
+                         const struct mu_badv_link     *expected,
+                               size_t                   n_expected)
+{
+   struct mu_badv_link links[64];
+   size_t              n_links = 0;
+   size_t              k       = 0;
+
+   n_links = mu_badv_topology_links(topology, reporter, links, 64);
+   CU_ASSERT_EQUAL_FATAL(n_links, n_expected);
+   for (size_t i = 0; i < n_links; i++) {
+      CU_ASSERT_TRUE(mu_mac_addr_equal(&links[i].from, reporter));
+      for (k = 0; k < n_expected
+                  && !mu_mac_addr_equal(&expected[k].to, &links[i].to); k++) {
+      }
+      CU_ASSERT_FATAL(k < n_expected);
+      CU_ASSERT_EQUAL(links[i].metric, expected[k].metric);
+      CU_ASSERT_EQUAL(links[i].seen_ms, expected[k].seen_ms);
+   }
+}
+
+void check_topology_merge (void)
+{
+   struct mu_badv_orig_table *tables[2]     = { NULL, NULL };
+   struct mu_badv_topology   *topology      = NULL;
+   struct mu_badv_link        expected[2][64];
+   size_t                     n_expected[2] = { 0, 0 };
+   struct mu_mac_addr         reporters[2];
+   struct mu_mac_addr         next_hop;
+   uint64_t                   report_ms[2]  = { 100000, 200000 };
+   uint64_t                   cut_ms        = 0;
+   size_t                     n_expired     = 0;
+   int                        error         = 0;
+
+   mu_str_to_mac_addr("02:ba:7a:df:04:00", &reporters[0]);
+   mu_str_to_mac_addr("02:ba:7a:df:05:00", &reporters[1]);
+   topology = mu_badv_topology_new(&error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(topology);
+
+   for (unsigned int r = 0; r < 2; r++) {
+      tables[r] = generate_mesh(r + 1);
+      CU_ASSERT_PTR_NOT_NULL_FATAL(tables[r]);
+      n_expected[r] = expected_links(tables[r], report_ms[r], expected[r]);
+      CU_ASSERT_TRUE_FATAL(n_expected[r] > 0 && n_expected[r] <= 64);
+      CU_ASSERT_TRUE(mu_badv_topology_merge(topology, &reporters[r],
+                                            tables[r], report_ms[r], &error));
+   }
+
+   CU_ASSERT_EQUAL(mu_badv_topology_n_links(topology),
+                   n_expected[0] + n_expected[1]);
+   for (unsigned int r = 0; r < 2; r++) {
+      check_links(topology, &reporters[r], expected[r], n_expected[r]);
+      for (size_t i = 0; i < tables[r]->n_originators; i++) {
+         CU_ASSERT_TRUE(mu_badv_topology_next_hop(topology, &reporters[r],
+                           &tables[r]->originators[i].mac_addr, &next_hop,
+                           NULL));
+         CU_ASSERT_TRUE(mu_mac_addr_equal(&next_hop,
+                                          &tables[r]->originators[i].next_hop));
+      }
+   }
+
+   // Expiry between the reports removes the links of the older one.
+   cut_ms = (report_ms[0] + report_ms[1]) / 2;
+   for (unsigned int r = 0; r < 2; r++) {
+      for (size_t k = 0; k < n_expected[r]; k++) {
+         n_expired += expected[r][k].seen_ms < cut_ms;
+      }
+   }
+   CU_ASSERT_EQUAL(n_expired, n_expected[0]);
+   CU_ASSERT_EQUAL(mu_badv_topology_expire(topology, cut_ms), n_expired);
+   CU_ASSERT_EQUAL(mu_badv_topology_n_links(topology), n_expected[1]);
+   CU_ASSERT_EQUAL(mu_badv_topology_links(topology, &reporters[0], NULL, 0),
+                   0);
+
+   // A new report of the first node replaces its links only.
+   CU_ASSERT_TRUE(mu_badv_topology_merge(topology, &reporters[0], tables[1],
+                                         report_ms[1], &error));
+   CU_ASSERT_EQUAL(mu_badv_topology_n_links(topology), 2 * n_expected[1]);
+   check_links(topology, &reporters[0], expected[1], n_expected[1]);
+   check_links(topology, &reporters[1], expected[1], n_expected[1]);
+
+   mu_badv_topology_free(topology);
+   mu_badv_orig_table_free(tables[0]);
+   mu_badv_orig_table_free(tables[1]);
+}
+
+static void sleep_ms (long ms)
+{
+   struct timespec duration = { ms / 1000, ms % 1000 * 1000000 };
+
+   while (nanosleep(&duration, &duration) && errno == EINTR) {
+   }
+}
+
+void check_cache_ttl (void)
+{
+   struct mu_badv_cache_stats before;
+   struct mu_badv_cache_stats after;
+   int                        error = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_originators(10, 1));
+   CU_ASSERT_TRUE_FATAL(mu_badv_cache_set_ttl(TEST_IF, 60000, &error));
+   mu_badv_cache_invalidate(TEST_IF);
+   CU_ASSERT_TRUE_FATAL(mu_badv_cache_stats(TEST_IF, &before));
+
+   // Within the time to live the table read first is used.
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), 11);
+   CU_ASSERT_TRUE_FATAL(write_originators(20, 1));
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), 11);
+   CU_ASSERT_TRUE(mu_badv_cache_stats(TEST_IF, &after));
+   CU_ASSERT_EQUAL(after.misses - before.misses, 1);
+   CU_ASSERT_EQUAL(after.hits - before.hits, 1);
+
+   // Once it expired the table is read again.
+   CU_ASSERT_TRUE(mu_badv_cache_set_ttl(TEST_IF, 50, &error));
+   sleep_ms(100);
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), 21);
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), 21);
+   CU_ASSERT_TRUE(mu_badv_cache_stats(TEST_IF, &after));
+   CU_ASSERT_EQUAL(after.misses - before.misses, 2);
+   CU_ASSERT_EQUAL(after.hits - before.hits, 2);
+
+   CU_ASSERT_TRUE(mu_badv_cache_set_ttl(TEST_IF, 0, &error));
+}
+
+#define CACHE_THREADS 8
+
+static unsigned int cache_results[CACHE_THREADS];
+static unsigned int cache_n_done;
+
+static void *acquire_n_nodes (void *arg)
+{
+   int error = 0;
+
+   cache_results[(size_t) arg] = mu_badv_mesh_n_nodes(TEST_IF, &error);
+   __atomic_add_fetch(&cache_n_done, 1, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+/* The originators table is a FIFO, so every read of it has to be fed by the
+ * test and is counted. Threads still waiting a second after the first read
+ * are taken as blocked in a read of their own and fed an empty table.
+ */
+void check_cache_single_load (void)
+{
+   struct mu_badv_cache_stats before;
+   struct mu_badv_cache_stats after;
+   pthread_t                  threads[CACHE_THREADS];
+   char                       path[128];
+   unsigned int               n_loads = 0;
+   unsigned int               waited  = 0;
+   int                        error   = 0;
+   int                        fd      = -1;
+
+   snprintf(path, sizeof(path), "%s/batman_adv/" TEST_IF "/originators",
+            fixture_root);
+   unlink(path);
+   CU_ASSERT_EQUAL_FATAL(mkfifo(path, 0600), 0);
+   CU_ASSERT_TRUE_FATAL(mu_badv_cache_set_ttl(TEST_IF, 60000, &error));
+   mu_badv_cache_invalidate(TEST_IF);
+   CU_ASSERT_TRUE_FATAL(mu_badv_cache_stats(TEST_IF, &before));
+
+   cache_n_done = 0;
+   for (size_t i = 0; i < CACHE_THREADS; i++) {
+      CU_ASSERT_EQUAL_FATAL(pthread_create(&threads[i], NULL,
+                                           acquire_n_nodes, (void *) i), 0);
+   }
+
+   // The first reader blocks in open until the table is written; give the
+   // other threads time to join its read.
+   sleep_ms(100);
+   CU_ASSERT_TRUE(write_originators(30, 1));
+   n_loads++;
+   while (__atomic_load_n(&cache_n_done, __ATOMIC_ACQUIRE) < CACHE_THREADS) {
+      fd = ++waited > 1000 ? open(path, O_WRONLY | O_NONBLOCK) : -1;
+      if (fd >= 0) {
+         n_loads++;
+         close(fd);
+      }
+      sleep_ms(1);
+   }
+   for (size_t i = 0; i < CACHE_THREADS; i++) {
+      pthread_join(threads[i], NULL);
+      CU_ASSERT_EQUAL(cache_results[i], 31);
+   }
+
+   CU_ASSERT_EQUAL(n_loads, 1);
+   CU_ASSERT_TRUE(mu_badv_cache_stats(TEST_IF, &after));
+   CU_ASSERT_EQUAL(after.misses - before.misses, 1);
+   CU_ASSERT_EQUAL(after.hits - before.hits + after.joined - before.joined,
+                   CACHE_THREADS - 1);
+
+   CU_ASSERT_TRUE(mu_badv_cache_set_ttl(TEST_IF, 0, &error));
+   unlink(path);
+}
+
+static uint64_t monotonic_ms (void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static void *cancel_refresh (void *refresh)
+{
+   sleep_ms(50);
+   mu_badv_refresh_cancel(refresh);
+   return NULL;
+}
+
+/* The originators table is a FIFO whenever a read has to block until the
+ * test writes the table.
+ */
+void check_refresh_query (void)
+{
+   struct mu_badv_refresh    *refresh = NULL;
+   struct mu_badv_orig_table *table   = NULL;
+   pthread_t                  thread;
+   char                       path[128];
+   uint64_t                   start   = 0;
+   bool                       stale   = false;
+   int                        error   = 0;
+
+   snprintf(path, sizeof(path), "%s/batman_adv/" TEST_IF "/originators",
+            fixture_root);
+   unlink(path);
+   CU_ASSERT_EQUAL_FATAL(mkfifo(path, 0600), 0);
+   refresh = mu_badv_refresh_new(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(refresh);
+
+   // Without a table read before, a deadline passing is an error.
+   CU_ASSERT_PTR_NULL(mu_badv_refresh_query(refresh, monotonic_ms() - 1,
+                                            &stale, &error));
+   CU_ASSERT_EQUAL(error, ETIMEDOUT);
+   start = monotonic_ms();
+   CU_ASSERT_PTR_NULL(mu_badv_refresh_query(refresh, start + 50, &stale,
+                                            &error));
+   CU_ASSERT_EQUAL(error, ETIMEDOUT);
+   CU_ASSERT_TRUE(monotonic_ms() - start >= 50);
+
+   // So is cancelling the read, which ends the wait at once.
+   CU_ASSERT_EQUAL_FATAL(pthread_create(&thread, NULL, cancel_refresh,
+                                        refresh), 0);
+   start = monotonic_ms();
+   CU_ASSERT_PTR_NULL(mu_badv_refresh_query(refresh, start + 10000, &stale,
+                                            &error));
+   CU_ASSERT_EQUAL(error, ECANCELED);
+   CU_ASSERT_TRUE(monotonic_ms() - start < 5000);
+   pthread_join(thread, NULL);
+
+   // Let the cancelled read return, then read a table.
+   CU_ASSERT_TRUE(write_originators(5, 1));
+   unlink(path);
+   CU_ASSERT_TRUE_FATAL(write_originators(5, 1));
+   table = mu_badv_refresh_query(refresh, monotonic_ms() + 5000, &stale,
+                                 &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+   CU_ASSERT_FALSE(stale);
+   CU_ASSERT_EQUAL(table->n_originators, 5);
+   mu_badv_orig_table_free(table);
+
+   // From then on timeouts and cancels give the last table, marked stale.
+   unlink(path);
+   CU_ASSERT_EQUAL_FATAL(mkfifo(path, 0600), 0);
+   table = mu_badv_refresh_query(refresh, monotonic_ms() + 50, &stale,
+                                 &error);
+   CU_ASSERT_PTR_NOT_NULL(table);
+   CU_ASSERT_TRUE(stale);
+   CU_ASSERT_EQUAL(error, 0);
+   mu_badv_orig_table_free(table);
+
+   CU_ASSERT_EQUAL_FATAL(pthread_create(&thread, NULL, cancel_refresh,
+                                        refresh), 0);
+   table = mu_badv_refresh_query(refresh, monotonic_ms() + 10000, &stale,
+                                 &error);
+   CU_ASSERT_PTR_NOT_NULL(table);
+   CU_ASSERT_TRUE(stale);
+   CU_ASSERT_EQUAL(error, 0);
+   mu_badv_orig_table_free(table);
+   pthread_join(thread, NULL);
+
+   CU_ASSERT_TRUE(write_originators(7, 1));
+   mu_badv_refresh_free(refresh);
+   unlink(path);
+}
+
+/// Last-seen time at now_ms of a node seen at seen_ms, in whole seconds.
+static uint32_t history_last_seen (uint64_t now_ms, uint64_t seen_ms)
+{
+   return (uint32_t) ((now_ms + 500) / 1000 - (seen_ms + 500) / 1000) * 1000;
+}
+
+void check_history_round_trip (void)
+{
+   const struct mu_badv_history_config config = { 3, 1000, 1, 1 };
+   const uint64_t                      t0     = 1700000000000ULL;
+   struct mu_badv_history_writer *writer   = NULL;
+   struct mu_badv_history_reader *reader   = NULL;
+   struct mu_badv_orig_table     *table    = NULL;
+   struct mu_badv_orig_table     *past     = NULL;
+   uint64_t                       seen_at[50];
+   uint64_t                       first_ms = 0;
+   uint64_t                       last_ms  = 0;
+   uint64_t                       recorded = 0;
+   char                           path[128];
+   struct stat                    status;
+   int                            error    = 0;
+
+   CU_ASSERT_TRUE_FATAL(write_originators(50, 2));
+   table = mu_badv_orig_table_read(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+   for (size_t i = 0; i < 50; i++) {
+      seen_at[i] = t0 - table->originators[i].last_seen_msecs;
+   }
+
+   snprintf(path, sizeof(path), "%s/history", fixture_root);
+   writer = mu_badv_history_writer_open(path, &config, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(writer);
+
+   // Keyframe.
+   CU_ASSERT_TRUE(mu_badv_history_append(writer, table, t0, &error));
+
+   // Nobody seen again, the ages grow: no record.
+   for (size_t i = 0; i < 50; i++) {
+      table->originators[i].last_seen_msecs += 5000;
+   }
+   CU_ASSERT_TRUE(mu_badv_history_append(writer, table, t0 + 5000, &error));
+
+   // Node 3 seen again with a new metric, then node 49 gone: two deltas.
+   for (size_t i = 0; i < 50; i++) {
+      table->originators[i].last_seen_msecs += 5000;
+   }
+   table->originators[3].last_seen_msecs = 0;
+   table->originators[3].metric          = 17;
+   seen_at[3] = t0 + 10000;
+   CU_ASSERT_TRUE(mu_badv_history_append(writer, table, t0 + 10000, &error));
+   for (size_t i = 0; i < 49; i++) {
+      table->originators[i].last_seen_msecs += 10000;
+   }
+   table->n_originators = 49;
+   CU_ASSERT_TRUE(mu_badv_history_append(writer, table, t0 + 20000, &error));
+
+   // Third record since the keyframe: another keyframe.
+   table->originators[0].metric = 1;
+   CU_ASSERT_TRUE(mu_badv_history_append(writer, table, t0 + 30000, &error));
+   mu_badv_history_writer_close(writer);
+
+   reader = mu_badv_history_reader_open(path, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+   CU_ASSERT_TRUE(mu_badv_history_span(reader, &first_ms, &last_ms));
+   CU_ASSERT_EQUAL(first_ms, t0);
+   CU_ASSERT_EQUAL(last_ms, t0 + 30000);
+
+   CU_ASSERT_PTR_NULL(mu_badv_history_table_at(reader, t0 - 1, NULL, &error));
+   CU_ASSERT_EQUAL(error, ENOENT);
+
+   // Between the keyframes: the keyframe and the first delta.
+   past = mu_badv_history_table_at(reader, t0 + 15000, &recorded, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(past);
+   CU_ASSERT_EQUAL(recorded, t0 + 10000);
+   CU_ASSERT_EQUAL(past->n_originators, 50);
+   CU_ASSERT_EQUAL(past->originators[3].metric, 17);
+   CU_ASSERT_EQUAL(past->originators[3].last_seen_msecs, 0);
+   CU_ASSERT_EQUAL(past->originators[7].last_seen_msecs,
+                   history_last_seen(t0 + 10000, seen_at[7]));
+   mu_badv_orig_table_free(past);
+
+   past = mu_badv_history_table_at(reader, t0 + 29999, &recorded, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(past);
+   CU_ASSERT_EQUAL(recorded, t0 + 20000);
+   CU_ASSERT_EQUAL(past->n_originators, 49);
+   CU_ASSERT_EQUAL(past->originators[3].last_seen_msecs, 10000);
+   CU_ASSERT_EQUAL(past->originators[7].last_seen_msecs,
+                   history_last_seen(t0 + 20000, seen_at[7]));
+   mu_badv_orig_table_free(past);
+   mu_badv_history_reader_close(reader);
+
+   // Tear the last record: it is dropped, by readers and by the writer.
+   CU_ASSERT_EQUAL_FATAL(stat(path, &status), 0);
+   CU_ASSERT_EQUAL_FATAL(truncate(path, status.st_size - 3), 0);
+   reader = mu_badv_history_reader_open(path, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+   CU_ASSERT_TRUE(mu_badv_history_span(reader, NULL, &last_ms));
+   CU_ASSERT_EQUAL(last_ms, t0 + 20000);
+   mu_badv_history_reader_close(reader);
+
+   writer = mu_badv_history_writer_open(path, &config, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(writer);
+   CU_ASSERT_TRUE(mu_badv_history_append(writer, table, t0 + 40000, &error));
+   mu_badv_history_writer_close(writer);
+
+   reader = mu_badv_history_reader_open(path, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+   CU_ASSERT_TRUE(mu_badv_history_span(reader, NULL, &last_ms));
+   CU_ASSERT_EQUAL(last_ms, t0 + 40000);
+   past = mu_badv_history_table_at(reader, t0 + 40000, NULL, &error);
+   CU_ASSERT_PTR_NOT_NULL(past);
+   if (past) {
+      CU_ASSERT_EQUAL(past->originators[0].metric, 1);
+   }
+   mu_badv_orig_table_free(past);
+   mu_badv_history_reader_close(reader);
+
+   mu_badv_orig_table_free(table);
+}
+
+void check_shm_snapshot (void)
+{
+   const  char                  *long_name =
+      "bat0-with-a-name-far-too-long-for-any-interface";
+   struct mu_badv_shm_publisher *publisher = NULL;
+   struct mu_badv_orig_table    *published = NULL;
+   struct mu_badv_orig_table    *table     = NULL;
+   unsigned int                  n_100     = 0;
+   unsigned int                  n_150     = 0;
+   unsigned int                  n_200     = 0;
+   int                           error     = 0;
+
+   // Over-long names are rejected before anything is copied or opened.
+   CU_ASSERT_PTR_NULL(mu_badv_shm_publisher_new(long_name, &error));
+   CU_ASSERT_EQUAL(error, ENAMETOOLONG);
+   CU_ASSERT_FALSE(mu_badv_shm_attach(long_name, &error));
+   CU_ASSERT_EQUAL(error, ENAMETOOLONG);
+
+   CU_ASSERT_TRUE_FATAL(write_originators(150, 2));
+   n_150 = mu_badv_mesh_n_nodes(TEST_IF, &error);
+   CU_ASSERT_TRUE_FATAL(write_originators(200, 4));
+   n_200 = mu_badv_mesh_n_nodes(TEST_IF, &error);
+   CU_ASSERT_TRUE_FATAL(write_originators(100, 3));
+   n_100 = mu_badv_mesh_n_nodes(TEST_IF, &error);
+   published = mu_badv_orig_table_read(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(published);
+
+   publisher = mu_badv_shm_publisher_new(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(publisher);
+   CU_ASSERT_TRUE(mu_badv_shm_publish(publisher, &error));
+   CU_ASSERT_TRUE_FATAL(mu_badv_shm_attach(TEST_IF, &error));
+
+   // Answered from the snapshot, not from the changed debugfs table.
+   CU_ASSERT_TRUE_FATAL(write_originators(150, 2));
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), n_100);
+   table = mu_badv_orig_table_read(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+   CU_ASSERT_TRUE(same_tables(table, published));
+   mu_badv_orig_table_free(table);
+
+   // A stopped publisher unlinks the segment, queries read debugfs.
+   mu_badv_shm_publisher_free(publisher);
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), n_150);
+
+   // A restarted publisher is followed without attaching again.
+   publisher = mu_badv_shm_publisher_new(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(publisher);
+   CU_ASSERT_TRUE(mu_badv_shm_publish(publisher, &error));
+   CU_ASSERT_TRUE_FATAL(write_originators(200, 4));
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), n_150);
+
+   mu_badv_shm_detach(TEST_IF);
+   CU_ASSERT_EQUAL(mu_badv_mesh_n_nodes(TEST_IF, &error), n_200);
+
+   mu_badv_shm_publisher_free(publisher);
+   mu_badv_orig_table_free(published);
+}
+
+#define SHM_PUBLISHES 300
+
+/// The originators table and its two versions, "a" and "b".
+static char shm_paths[3][128];
+static bool shm_publishing;
+
+/* Replaces the originators table by either version in turn, atomically so
+ * debugfs readers see a whole table too, and publishes each.
+ */
+static void *publish_versions (void *publisher)
+{
+   char         swap[160];
+   int          error = 0;
+   unsigned int n_ok  = 0;
+
+   snprintf(swap, sizeof(swap), "%s.swap", shm_paths[0]);
+   for (unsigned int i = 0; i < SHM_PUBLISHES; i++) {
+      unlink(swap);  // Left over when both links named the same file.
+      if (!link(shm_paths[1 + i % 2], swap) && !rename(swap, shm_paths[0])
+          && mu_badv_shm_publish(publisher, &error)) {
+         n_ok++;
+      }
+   }
+   __atomic_store_n(&shm_publishing, false, __ATOMIC_RELEASE);
+   unlink(swap);
+   return (void *) (uintptr_t) n_ok;
+}
+
+void check_shm_concurrent_reads (void)
+{
+   struct mu_badv_shm_publisher *publisher   = NULL;
+   struct mu_badv_orig_table    *versions[2] = {NULL, NULL};
+   struct mu_badv_orig_table    *table       = NULL;
+   pthread_t                     thread;
+   void                         *n_ok        = NULL;
+   size_t                        n_reads     = 0;
+   size_t                        n_torn      = 0;
+   int                           error       = 0;
+
+   snprintf(shm_paths[0], sizeof(shm_paths[0]),
+            "%s/batman_adv/" TEST_IF "/originators", fixture_root);
+   for (int v = 0; v < 2; v++) {
+      snprintf(shm_paths[1 + v], sizeof(shm_paths[1 + v]), "%s.%c",
+               shm_paths[0], 'a' + v);
+      CU_ASSERT_TRUE_FATAL(write_originators(v ? 500 : 300, v ? 5 : 3));
+      versions[v] = mu_badv_orig_table_read(TEST_IF, &error);
+      CU_ASSERT_PTR_NOT_NULL_FATAL(versions[v]);
+      CU_ASSERT_EQUAL_FATAL(rename(shm_paths[0], shm_paths[1 + v]), 0);
+   }
+   CU_ASSERT_EQUAL_FATAL(link(shm_paths[1], shm_paths[0]), 0);
+
+   publisher = mu_badv_shm_publisher_new(TEST_IF, &error);
+   CU_ASSERT_PTR_NOT_NULL_FATAL(publisher);
+   CU_ASSERT_TRUE(mu_badv_shm_publish(publisher, &error));
+   CU_ASSERT_TRUE_FATAL(mu_badv_shm_attach(TEST_IF, &error));
+
+   // Every copy has to be one whole version, never a mix of both.
+   shm_publishing = true;
+   CU_ASSERT_EQUAL_FATAL(pthread_create(&thread, NULL, publish_versions,
+                                        publisher), 0);
+   while (__atomic_load_n(&shm_publishing, __ATOMIC_ACQUIRE)) {
+      table = mu_badv_orig_table_read(TEST_IF, &error);
+      n_reads++;
+      if (!table || !(same_tables(table, versions[0])
+                      || same_tables(table, versions[1]))) {
+         n_torn++;
+      }
+      mu_badv_orig_table_free(table);
+   }
+   pthread_join(thread, &n_ok);
+
+   CU_ASSERT_EQUAL((uintptr_t) n_ok, SHM_PUBLISHES);
+   CU_ASSERT_TRUE(n_reads > 0);
+   CU_ASSERT_EQUAL(n_torn, 0);
+
+   mu_badv_shm_detach(TEST_IF);
+   mu_badv_shm_publisher_free(publisher);
+   unlink(shm_paths[1]);
+   unlink(shm_paths[2]);
+   mu_badv_orig_table_free(versions[0]);
+   mu_badv_orig_table_free(versions[1]);
+}
+
 int main (void)
 {
    unsigned int failures;
@@ -48,6 +1687,163 @@ int main (void)
       return CU_get_error();
    }
 
+   if (!CU_add_test (pSuite,
+                     "Test MAC address string conversion",
+                     check_mac_addr_conversion)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that allocations go through the allocator hooks",
+                     check_allocator_hooks)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that over-long interface names are refused",
+                     check_long_interface_name)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test node_store::for_each with a named callable",
+                     check_node_store_for_each)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test the staleness watcher against a brute-force model",
+                     check_staleness_model)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   pSuite = CU_add_suite ("meshutil batman_adv fixture suite",
+                          init_fixture_suite, clean_fixture_suite);
+
+   if (!pSuite) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that the originator index maps every key to its "
+                     "own entry",
+                     check_orig_index)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that parallel parsing gives the serial result",
+                     check_parallel_parse)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that top-k equals sorting and truncating the table",
+                     check_orig_top_k)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test parsing neighbours tables with malformed lines",
+                     check_neighbors_table)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test parsing a gateways table with malformed lines",
+                     check_gateways_table)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that the gateway selector keeps no failed parse",
+                     check_gw_selector)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test parsing a DAT cache table with malformed lines",
+                     check_dat_table)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test the MAC filter for false negatives and positives",
+                     check_mac_filter)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test merging the tables of two generated meshes",
+                     check_topology_merge)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that the cache answers within the time to live",
+                     check_cache_ttl)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that concurrent calls share one table read",
+                     check_cache_single_load)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test refresh queries timing out and being cancelled",
+                     check_refresh_query)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test writing and reading back a history log",
+                     check_history_round_trip)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test publishing, reading and following shm snapshots",
+                     check_shm_snapshot)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that shm readers never see a torn snapshot",
+                     check_shm_concurrent_reads)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
+   if (!CU_add_test (pSuite,
+                     "Test that the coroutine awaitables read the fixture "
+                     "tables",
+                     check_coro_awaitables)) {
+      CU_cleanup_registry();
+      return CU_get_error();
+   }
+
    CU_basic_set_mode (CU_BRM_VERBOSE);
    CU_basic_run_tests();
    failures = CU_get_number_of_failures();
@@ -0,0 +1,132 @@
+#ifdef __linux
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <future>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <CUnit/CUnit.h>
+
+#include "meshutil_coro.hpp"
+
+namespace {
+
+using meshutil::coro::inline_executor;
+
+/* The library has no task type; this one starts at once and is destroyed
+ * when it returns. The coroutines report through a promise, as inline_executor
+ * resumes them on the threads which completed the queries.
+ */
+struct detached_task {
+   struct promise_type {
+      detached_task       get_return_object() noexcept { return {}; }
+      std::suspend_never  initial_suspend()   noexcept { return {}; }
+      std::suspend_never  final_suspend()     noexcept { return {}; }
+      void                return_void()       noexcept {}
+      void                unhandled_exception() noexcept { std::terminate(); }
+   };
+};
+
+struct coro_results {
+   std::size_t              n_refreshed = 0;
+   bool                     if_up_threw = false;
+   std::error_code          if_up_error;
+   std::vector<std::size_t> n_all;
+};
+
+/// Writes an originator table of n_nodes one hop neighbours, false on error.
+bool write_originators(const char *const interface_name,
+                       const std::size_t n_nodes)
+{
+   const std::string dir = std::string(std::getenv("MESHUTIL_DEBUGFS_ROOT"))
+                           + "/batman_adv/" + interface_name;
+   const std::string path = dir + "/originators";
+   std::FILE        *file = nullptr;
+
+   mkdir(dir.c_str(), 0755);
+   file = std::fopen(path.c_str(), "w");
+   if (!file) {
+      return false;
+   }
+   std::fprintf(file, "[B.A.T.M.A.N. adv 2016.1, MainIF/MAC: "
+                      "eth0/02:ba:7a:df:04:00 (%s/02:ba:7a:df:04:00 "
+                      "BATMAN_IV)]\n"
+                      "   Originator        last-seen (#/255) "
+                      "Nexthop           [outgoingIF]: "
+                      "Potential nexthops ...\n", interface_name);
+   for (std::size_t i = 0; i < n_nodes; i++) {
+      std::fprintf(file, "02:ba:00:00:%02x:01    0.100s   (255) "
+                         "02:ba:00:00:%02x:01 [      eth0]: "
+                         "02:ba:00:00:%02x:01 (255)\n",
+                   (unsigned int) i, (unsigned int) i, (unsigned int) i);
+   }
+   return std::fclose(file) == 0;
+}
+
+detached_task run_queries(std::promise<coro_results> &done)
+{
+   const std::vector<std::string> names = {"bat0", "bat1"};
+   coro_results                   results;
+
+   try {
+      const auto table = co_await meshutil::coro::async_refresh(
+                                     inline_executor{}, "bat0");
+      results.n_refreshed = table.size();
+
+      try {
+         (void) co_await meshutil::coro::async_if_up(inline_executor{},
+                                                     "mu-none0");
+      } catch (const std::system_error &e) {
+         results.if_up_threw = true;
+         results.if_up_error = e.code();
+      }
+
+      const auto all = co_await meshutil::coro::refresh_all(
+                                   inline_executor{}, names);
+      for (const auto &each : all) {
+         results.n_all.push_back(each.size());
+      }
+      done.set_value(std::move(results));
+   } catch (...) {
+      done.set_exception(std::current_exception());
+   }
+}
+
+}
+
+extern "C" void check_coro_awaitables (void)
+{
+   std::promise<coro_results> done;
+   std::future<coro_results>  result = done.get_future();
+
+   CU_ASSERT_FATAL(write_originators("bat0", 3));
+   CU_ASSERT_FATAL(write_originators("bat1", 5));
+
+   run_queries(done);
+   CU_ASSERT_FATAL(result.wait_for(std::chrono::seconds(10))
+                   == std::future_status::ready);
+
+   try {
+      const coro_results results = result.get();
+
+      CU_ASSERT_EQUAL(results.n_refreshed, 3);
+      CU_ASSERT(results.if_up_threw);
+      CU_ASSERT_NOT_EQUAL(results.if_up_error.value(), 0);
+      CU_ASSERT_EQUAL(results.n_all.size(), 2);
+      if (results.n_all.size() == 2) {
+         CU_ASSERT_EQUAL(results.n_all[0], 3);
+         CU_ASSERT_EQUAL(results.n_all[1], 5);
+      }
+   } catch (const std::exception &) {
+      CU_FAIL("a coroutine query threw");
+   }
+}
+
+#endif /* __linux */
@@ -0,0 +1,47 @@
+#ifdef __linux
+
+#include <cstddef>
+#include <cstdint>
+
+#include <CUnit/CUnit.h>
+
+#include "meshutil.hpp"
+
+namespace {
+
+using namespace meshutil::literals;
+
+static_assert("02:BA:7a:df:04:01"_mac.octets()[1] == 0xba);
+static_assert("02:ba:7a:df:04:01"_mac.octets()[5] == 0x01);
+
+struct node_state {
+   std::uint32_t seen;
+};
+
+}
+
+extern "C" void check_node_store_for_each (void)
+{
+   meshutil::badv::node_store<node_state> store;
+   std::size_t                            n_nodes = 0;
+   std::uint32_t                          sum     = 0;
+
+   store.add("02:ba:00:00:00:01"_mac).seen = 1;
+   store.add("02:ba:00:00:00:02"_mac).seen = 2;
+
+   auto count = [&](const meshutil::mac_addr &, node_state &state) {
+      n_nodes++;
+      sum += state.seen;
+   };
+   store.for_each(count);
+
+   CU_ASSERT_EQUAL(n_nodes, 2);
+   CU_ASSERT_EQUAL(sum, 3);
+
+   store.for_each([&](const meshutil::mac_addr &, node_state &state) {
+      state.seen = 0;
+   });
+   CU_ASSERT_EQUAL(store.find("02:ba:00:00:00:02"_mac)->seen, 0);
+}
+
+#endif /* __linux */
@@ -0,0 +1,717 @@
+/** @file meshutil_top.c
+ * Live monitor of a B.A.T.M.A.N. advanced mesh
+ */
+
+/*
+ * Copyright © 2012 Torsti Schulz
+ *
+ * This file is part of the meshutil library.
+ *
+ * libmeshutil is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libmeshutil is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @page pg_meshutil_top meshutil-top
+ *
+ *     meshutil-top [-i interface] [-d seconds] [-s column] [-r] [-b]
+ *                  [-n count]
+ *
+ * Shows the originators of a bat interface (-i, default bat0) as a table
+ * refreshed every -d seconds (default 1), sorted by the column -s: tq
+ * (default), seen, mac, if or hops, in reverse with -r. Above the table the
+ * state of the bat interface and, for every outgoing interface, the number of
+ * originators reached through it, its neighbours and the lowest and mean
+ * metric are shown.
+ *
+ * While running, t, l, m, i and h sort by TQ, last-seen, MAC address,
+ * interface and number of potential next hops, r reverses the order, + and -
+ * halve and double the refresh interval and q quits.
+ *
+ * The tables are read and parsed in the process on a single thread, with no
+ * other programs started. Only the rows that changed are redrawn, with plain
+ * ANSI escape sequences, so neither curses nor a terminfo database is needed.
+ * The memory used is that of one originator table plus one screen, whatever
+ * the size of the mesh.
+ *
+ * With -b, or when the output is not a terminal, every refresh prints all
+ * originators as plain text, and -n exits after count refreshes.
+ */
+
+#ifdef __linux
+
+/*******************************************************************************
+*   FEATURE TEST MACROS                                                        *
+*******************************************************************************/
+
+#define _XOPEN_SOURCE 700
+
+/*******************************************************************************
+*   HEADER FILES                                                               *
+*******************************************************************************/
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batman_adv.h"
+#include "batman_adv_debugfs.h"
+#include "batman_adv_neighbors.h"
+#include "batman_adv_originators.h"
+#include "meshutil.h"
+
+/*******************************************************************************
+*   CONSTANT DEFINITIONS                                                       *
+*******************************************************************************/
+
+/// Largest screen drawn, larger terminals show a part of it.
+#define MAX_ROWS 256
+#define MAX_COLS 160
+
+#define MIN_DELAY_MS 100
+#define MAX_DELAY_MS 60000
+
+/// Rows above the table of interfaces.
+#define STATUS_ROWS 2
+
+/*******************************************************************************
+*   TYPE DEFINITIONS                                                           *
+*******************************************************************************/
+
+enum sort_key {
+   SORT_TQ,
+   SORT_SEEN,
+   SORT_MAC,
+   SORT_IF,
+   SORT_HOPS
+};
+
+/// State of the bat interface and its tables at the last refresh.
+struct snapshot {
+          bool                       up;
+   struct mu_badv_orig_table        *table;
+   struct mu_badv_neighbor          *neighbors;
+          size_t                     n_neighbors;
+          bool                       have_neighbors;
+          int                        error;     ///< Of reading the table.
+          double                     read_ms;   ///< Time reading took.
+};
+
+struct screen {
+   unsigned int rows;
+   unsigned int cols;
+   unsigned int n_lines;                        ///< Lines on the terminal.
+   bool         valid;                          ///< lines match the terminal.
+   char         lines[MAX_ROWS][MAX_COLS + 1];
+   char         next[MAX_ROWS][MAX_COLS + 1];
+   char         out[MAX_ROWS * (MAX_COLS + 16) + 64];
+};
+
+/*******************************************************************************
+*   STATIC VARIABLES                                                           *
+*******************************************************************************/
+
+static const char *const sort_names[] = {"tq", "seen", "mac", "if", "hops"};
+
+static volatile sig_atomic_t quit    = 0;
+static volatile sig_atomic_t resized = 0;
+
+static struct termios saved_termios;
+static bool           raw_terminal = false;
+
+/// Table and order used by compare_rows(), qsort() takes no context.
+static const struct mu_badv_orig_table *sort_table   = NULL;
+static enum sort_key                    sort_key     = SORT_TQ;
+static bool                             sort_reverse = false;
+
+/*******************************************************************************
+*   DATA                                                                       *
+*******************************************************************************/
+
+static uint64_t now_ms(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static double now_secs(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static void snapshot_clear(struct snapshot *const snapshot)
+{
+   mu_badv_orig_table_free(snapshot->table);
+   mu_free(snapshot->neighbors);
+   memset(snapshot, 0, sizeof(struct snapshot));
+}
+
+/* The neighbours table is missing before batman_adv 2016.1, the outgoing
+ * interfaces then count the originators that are their own next hop.
+ */
+static void snapshot_read(      struct snapshot *const snapshot,
+                          const char            *const interface_name)
+{
+   int    error = 0;
+   double start = now_secs();
+
+   snapshot_clear(snapshot);
+   snapshot->up    = mu_badv_if_up(interface_name, &error);
+   snapshot->table = mu_badv_orig_table_read(interface_name,
+                                             &snapshot->error);
+   error = 0;
+   snapshot->neighbors = mu_badv_neighbors(interface_name,
+                                           &snapshot->n_neighbors, &error);
+   snapshot->have_neighbors = !error;
+   snapshot->read_ms        = (now_secs() - start) * 1000.0;
+}
+
+static int compare_rows(const void *const a, const void *const b)
+{
+   const struct mu_badv_originator *x = &sort_table->originators[
+                                           *(const uint32_t *) a];
+   const struct mu_badv_originator *y = &sort_table->originators[
+                                           *(const uint32_t *) b];
+   int order = 0;
+
+   switch (sort_key) {
+   case SORT_TQ:
+      order = (x->metric < y->metric) - (x->metric > y->metric);
+      break;
+   case SORT_SEEN:
+      order = (x->last_seen_msecs > y->last_seen_msecs)
+              - (x->last_seen_msecs < y->last_seen_msecs);
+      break;
+   case SORT_IF:
+      order = (x->if_id > y->if_id) - (x->if_id < y->if_id);
+      break;
+   case SORT_HOPS:
+      order = (x->n_hops < y->n_hops) - (x->n_hops > y->n_hops);
+      break;
+   case SORT_MAC:
+      break;
+   }
+   if (!order) {
+      order = memcmp(x->mac_addr.octet, y->mac_addr.octet, MU_MAC_ADDR_LEN);
+   }
+   return sort_reverse ? -order : order;
+}
+
+/// Sorts the originators into order, which grows as needed.
+static size_t sort_rows(const struct mu_badv_orig_table *const table,
+                              uint32_t                 **const order,
+                              size_t                    *const max_order)
+{
+   uint32_t *tmp = NULL;
+
+   if (!table) {
+      return 0;
+   }
+   if (table->n_originators > *max_order) {
+      tmp = realloc(*order, table->n_originators * sizeof(uint32_t));
+      if (!tmp) {
+         return 0;
+      }
+      *order     = tmp;
+      *max_order = table->n_originators;
+   }
+   for (size_t i = 0; i < table->n_originators; i++) {
+      (*order)[i] = (uint32_t) i;
+   }
+   sort_table = table;
+   qsort(*order, table->n_originators, sizeof(uint32_t), compare_rows);
+   return table->n_originators;
+}
+
+/*******************************************************************************
+*   FORMATTING                                                                 *
+*******************************************************************************/
+
+static const char *metric_name(const struct mu_badv_orig_table *const table)
+{
+   return table && table->metric_type == MU_BADV_METRIC_THROUGHPUT
+          ? "MBIT/S" : "TQ";
+}
+
+/// TQ as is, throughput in Mbit/s with one decimal.
+static void format_metric(      char                      *const str,
+                          const size_t                           size,
+                          const struct mu_badv_orig_table *const table,
+                          const double                           metric)
+{
+   if (table->metric_type == MU_BADV_METRIC_THROUGHPUT) {
+      snprintf(str, size, "%.1f", metric / 1000.0);
+   } else if (metric == (double) (uint32_t) metric) {
+      snprintf(str, size, "%u", (unsigned int) metric);
+   } else {
+      snprintf(str, size, "%.1f", metric);
+   }
+}
+
+static size_t if_neighbors(const struct snapshot         *const snapshot,
+                           const struct mu_badv_if_stats *const stats)
+{
+   size_t n = 0;
+
+   if (!snapshot->have_neighbors) {
+      return stats->n_neighbors;
+   }
+   for (size_t i = 0; i < snapshot->n_neighbors; i++) {
+      if (!strcmp(snapshot->neighbors[i].outgoing_if, stats->name)) {
+         n++;
+      }
+   }
+   return n;
+}
+
+static void format_status(      char            *const line,
+                          const size_t                 size,
+                          const struct snapshot *const snapshot,
+                          const char            *const interface_name,
+                          const unsigned int           delay_ms)
+{
+   const struct mu_badv_orig_table *table = snapshot->table;
+   char                             neighbors[24] = "-";
+
+   if (snapshot->have_neighbors) {
+      snprintf(neighbors, sizeof(neighbors), "%zu", snapshot->n_neighbors);
+   }
+   if (!table) {
+      snprintf(line, size, "meshutil-top  %s %s  error: %s",
+               interface_name, snapshot->up ? "up" : "down",
+               strerror(snapshot->error));
+      return;
+   }
+   snprintf(line, size, "meshutil-top  %s %s  originators %zu  neighbours %s"
+                        "  every %.1fs  sort %s%s  read %.1fms",
+            interface_name, snapshot->up ? "up" : "down",
+            table->n_originators, neighbors, delay_ms / 1000.0,
+            sort_names[sort_key], sort_reverse ? " (reverse)" : "",
+            snapshot->read_ms);
+}
+
+static void format_if(      char                    *const line,
+                      const size_t                         size,
+                      const struct snapshot         *const snapshot,
+                      const struct mu_badv_if_stats *const stats)
+{
+   char min[16];
+   char mean[16];
+
+   format_metric(min, sizeof(min), snapshot->table, stats->metric_min);
+   format_metric(mean, sizeof(mean), snapshot->table,
+                 (double) stats->metric_sum / stats->n_originators);
+   snprintf(line, size, "%-16s %7u %6zu %7s %7s", stats->name,
+            stats->n_originators, if_neighbors(snapshot, stats), min, mean);
+}
+
+static void format_header(      char                      *const line,
+                          const size_t                           size,
+                          const struct mu_badv_orig_table *const table)
+{
+   snprintf(line, size, "%-17s  %-16s %6s %10s  %-17s %5s",
+            "ORIGINATOR", "IF", metric_name(table), "LAST-SEEN", "NEXT HOP",
+            "HOPS");
+}
+
+static void format_row(      char                      *const line,
+                       const size_t                           size,
+                       const struct mu_badv_orig_table *const table,
+                       const struct mu_badv_originator *const originator)
+{
+   char mac_addr[MU_MAC_ADDR_STR_LEN + 1];
+   char next_hop[MU_MAC_ADDR_STR_LEN + 1];
+   char metric[16];
+
+   mu_mac_addr_to_str(&originator->mac_addr, mac_addr);
+   if (mu_mac_addr_equal(&originator->next_hop, &originator->mac_addr)) {
+      strcpy(next_hop, "direct");
+   } else {
+      mu_mac_addr_to_str(&originator->next_hop, next_hop);
+   }
+   format_metric(metric, sizeof(metric), table, originator->metric);
+   snprintf(line, size, "%-17s  %-16s %6s %6u.%03us  %-17s %5u", mac_addr,
+            originator->outgoing_if, metric,
+            originator->last_seen_msecs / 1000,
+            originator->last_seen_msecs % 1000, next_hop, originator->n_hops);
+}
+
+/*******************************************************************************
+*   TERMINAL                                                                   *
+*******************************************************************************/
+
+static void on_signal(const int signal)
+{
+   if (signal == SIGWINCH) {
+      resized = 1;
+   } else {
+      quit = 1;
+   }
+}
+
+static void terminal_restore(void)
+{
+   static const char leave[] = "\033[?25h\033[?1049l";
+
+   if (raw_terminal) {
+      tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+      raw_terminal = false;
+      if (write(STDOUT_FILENO, leave, sizeof(leave) - 1) < 0) {
+         return;
+      }
+   }
+}
+
+/// Switches to the alternate screen and reads keys without echo.
+static bool terminal_setup(void)
+{
+   static const char enter[] = "\033[?1049h\033[?25l";
+   struct termios    raw;
+
+   if (tcgetattr(STDIN_FILENO, &saved_termios)) {
+      return false;
+   }
+   raw = saved_termios;
+   raw.c_lflag &= ~(tcflag_t) (ICANON | ECHO);
+   raw.c_cc[VMIN]  = 0;
+   raw.c_cc[VTIME] = 0;
+   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw)) {
+      return false;
+   }
+   raw_terminal = true;
+   atexit(terminal_restore);
+   return write(STDOUT_FILENO, enter, sizeof(enter) - 1) >= 0;
+}
+
+static void screen_size(struct screen *const screen)
+{
+   struct winsize size;
+
+   screen->rows = 24;
+   screen->cols = 80;
+   if (!ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) && size.ws_row
+       && size.ws_col) {
+      screen->rows = size.ws_row;
+      screen->cols = size.ws_col;
+   }
+   if (screen->rows > MAX_ROWS) {
+      screen->rows = MAX_ROWS;
+   }
+   if (screen->cols > MAX_COLS) {
+      screen->cols = MAX_COLS;
+   }
+   screen->valid = false;
+}
+
+/* Implementation notes:
+ * - Lines are compared with those on the terminal and only the changed ones
+ *   are moved to and rewritten, each followed by erase to end of line. The
+ *   whole update goes out in a single write().
+ */
+static void screen_flush(struct screen *const screen, const unsigned int n)
+{
+   size_t length = 0;
+   size_t room   = sizeof(screen->out);
+   int    added  = 0;
+
+   if (!screen->valid) {
+      length = (size_t) snprintf(screen->out, room, "\033[H\033[2J");
+      screen->n_lines = 0;
+   }
+   for (unsigned int row = 0; row < n || row < screen->n_lines; row++) {
+      if (row < n && row < screen->n_lines && screen->valid
+          && !strcmp(screen->lines[row], screen->next[row])) {
+         continue;
+      }
+      added = snprintf(screen->out + length, room - length, "\033[%u;1H%s\033[K",
+                       row + 1, row < n ? screen->next[row] : "");
+      if (added < 0 || (size_t) added >= room - length) {
+         break;
+      }
+      length += (size_t) added;
+      if (row < n) {
+         strcpy(screen->lines[row], screen->next[row]);
+      }
+   }
+   screen->n_lines = n;
+   screen->valid   = true;
+
+   for (size_t written = 0; written < length; ) {
+      ssize_t result = write(STDOUT_FILENO, screen->out + written,
+                             length - written);
+      if (result < 0 && errno != EINTR) {
+         break;
+      }
+      written += result > 0 ? (size_t) result : 0;
+   }
+}
+
+static void screen_draw(      struct screen   *const screen,
+                        const struct snapshot *const snapshot,
+                        const uint32_t        *const order,
+                        const size_t                 n_rows,
+                        const char            *const interface_name,
+                        const unsigned int           delay_ms)
+{
+   const struct mu_badv_orig_table *table = snapshot->table;
+   size_t                           size  = screen->cols + 1;
+   unsigned int                     n     = 0;
+
+   format_status(screen->next[n++], size, snapshot, interface_name, delay_ms);
+   screen->next[n++][0] = '\0';
+
+   if (table) {
+      snprintf(screen->next[n++], size, "%-16s %7s %6s %7s %7s", "IF",
+               "ORIGS", "NEIGH", "MIN", "MEAN");
+      for (size_t i = 0; i < table->n_ifs && n < screen->rows; i++) {
+         format_if(screen->next[n++], size, snapshot, &table->ifs[i]);
+      }
+      if (n < screen->rows) {
+         screen->next[n++][0] = '\0';
+      }
+      if (n < screen->rows) {
+         format_header(screen->next[n++], size, table);
+      }
+      for (size_t i = 0; i < n_rows && n < screen->rows; i++) {
+         format_row(screen->next[n++], size, table,
+                    &table->originators[order[i]]);
+      }
+   }
+
+   if (n > screen->rows) {
+      n = screen->rows;
+   }
+   screen_flush(screen, n);
+}
+
+static void print_batch(const struct snapshot *const snapshot,
+                        const uint32_t        *const order,
+                        const size_t                 n_rows,
+                        const char            *const interface_name,
+                        const unsigned int           delay_ms)
+{
+   const struct mu_badv_orig_table *table = snapshot->table;
+   char                             line[MAX_COLS + 1];
+
+   format_status(line, sizeof(line), snapshot, interface_name, delay_ms);
+   printf("%s\n", line);
+   if (table) {
+      printf("%-16s %7s %6s %7s %7s\n", "IF", "ORIGS", "NEIGH", "MIN", "MEAN");
+      for (size_t i = 0; i < table->n_ifs; i++) {
+         format_if(line, sizeof(line), snapshot, &table->ifs[i]);
+         printf("%s\n", line);
+      }
+      format_header(line, sizeof(line), table);
+      printf("\n%s\n", line);
+      for (size_t i = 0; i < n_rows; i++) {
+         format_row(line, sizeof(line), table, &table->originators[order[i]]);
+         printf("%s\n", line);
+      }
+   }
+   printf("\n");
+   fflush(stdout);
+}
+
+/// Handles a key, returns true if the screen has to be redrawn.
+static bool handle_key(const char key, unsigned int *const delay_ms)
+{
+   switch (key) {
+   case 't': sort_key = SORT_TQ;               break;
+   case 'l': sort_key = SORT_SEEN;             break;
+   case 'm': sort_key = SORT_MAC;              break;
+   case 'i': sort_key = SORT_IF;               break;
+   case 'h': sort_key = SORT_HOPS;             break;
+   case 'r': sort_reverse = !sort_reverse;     break;
+   case '+':
+      *delay_ms = *delay_ms / 2 < MIN_DELAY_MS ? MIN_DELAY_MS : *delay_ms / 2;
+      break;
+   case '-':
+      *delay_ms = *delay_ms * 2 > MAX_DELAY_MS ? MAX_DELAY_MS : *delay_ms * 2;
+      break;
+   case 'q':
+      quit = 1;
+      return false;
+   default:
+      return false;
+   }
+   return true;
+}
+
+/*******************************************************************************
+*   MAIN                                                                       *
+*******************************************************************************/
+
+static void usage(const char *const program)
+{
+   fprintf(stderr, "Usage: %s [-i interface] [-d seconds] "
+                   "[-s tq|seen|mac|if|hops] [-r] [-b] [-n count]\n", program);
+}
+
+static bool parse_sort(const char *const name)
+{
+   for (size_t i = 0; i < sizeof(sort_names) / sizeof(sort_names[0]); i++) {
+      if (!strcmp(name, sort_names[i])) {
+         sort_key = (enum sort_key) i;
+         return true;
+      }
+   }
+   return false;
+}
+
+int main(int argc, char **argv)
+{
+   const char       *interface_name = BATMAN_ADV_DEFAULT_IF;
+   unsigned int      delay_ms       = 1000;
+   unsigned long     count          = 0;
+   unsigned long     n_refreshes    = 0;
+   bool              batch          = !isatty(STDOUT_FILENO);
+   bool              redraw         = false;
+   struct snapshot   snapshot;
+   struct screen    *screen         = NULL;
+   uint32_t         *order          = NULL;
+   size_t            max_order      = 0;
+   size_t            n_rows         = 0;
+   uint64_t          next_refresh   = 0;
+   uint64_t          now            = 0;
+   struct pollfd     input          = {STDIN_FILENO, POLLIN, 0};
+   struct sigaction  action;
+   char              keys[16];
+   ssize_t           n_keys;
+   int               option;
+
+   while ((option = getopt(argc, argv, "i:d:s:rbn:h")) != -1) {
+      switch (option) {
+      case 'i': interface_name = optarg;                         break;
+      case 'd': delay_ms = (unsigned int) (strtod(optarg, NULL) * 1000);
+                break;
+      case 's':
+         if (!parse_sort(optarg)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'r': sort_reverse = true;                             break;
+      case 'b': batch = true;                                    break;
+      case 'n': count = strtoul(optarg, NULL, 10);               break;
+      default:
+         usage(argv[0]);
+         return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+   if (delay_ms < MIN_DELAY_MS) {
+      delay_ms = MIN_DELAY_MS;
+   } else if (delay_ms > MAX_DELAY_MS) {
+      delay_ms = MAX_DELAY_MS;
+   }
+
+   // Parsing on one thread keeps the monitor to one CPU of a small router.
+   mu_badv_set_parallel_parse(1, 0);
+
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = on_signal;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGINT, &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+   sigaction(SIGWINCH, &action, NULL);
+
+   if (!batch) {
+      screen = calloc(1, sizeof(struct screen));
+      if (!screen || !terminal_setup()) {
+         free(screen);
+         screen = NULL;
+         batch  = true;
+      } else {
+         screen_size(screen);
+      }
+   }
+
+   memset(&snapshot, 0, sizeof(snapshot));
+   next_refresh = now_ms();
+   while (!quit) {
+      now = now_ms();
+      if (now >= next_refresh) {
+         snapshot_read(&snapshot, interface_name);
+         n_rows = sort_rows(snapshot.table, &order, &max_order);
+         next_refresh += delay_ms;
+         if (next_refresh <= now) {
+            next_refresh = now + delay_ms;
+         }
+         n_refreshes++;
+         redraw = true;
+      }
+      if (resized && screen) {
+         resized = 0;
+         screen_size(screen);
+         redraw = true;
+      }
+
+      if (redraw) {
+         redraw = false;
+         if (batch) {
+            print_batch(&snapshot, order, n_rows, interface_name, delay_ms);
+         } else {
+            screen_draw(screen, &snapshot, order, n_rows, interface_name,
+                        delay_ms);
+         }
+      }
+      if (count && n_refreshes >= count) {
+         break;
+      }
+
+      now = now_ms();
+      if (next_refresh <= now) {
+         continue;
+      }
+      if (batch) {
+         struct timespec delay = {
+            (time_t) ((next_refresh - now) / 1000),
+            (long) ((next_refresh - now) % 1000) * 1000000
+         };
+         nanosleep(&delay, NULL);
+         continue;
+      }
+
+      if (poll(&input, 1, (int) (next_refresh - now)) > 0
+          && (n_keys = read(STDIN_FILENO, keys, sizeof(keys))) > 0) {
+         for (ssize_t i = 0; i < n_keys; i++) {
+            if (handle_key(keys[i], &delay_ms)) {
+               redraw = true;
+            }
+         }
+         if (redraw) {
+            n_rows = sort_rows(snapshot.table, &order, &max_order);
+         }
+      }
+   }
+
+   terminal_restore();
+   snapshot_clear(&snapshot);
+   free(order);
+   free(screen);
+   return EXIT_SUCCESS;
+}
+
+#endif                          /* __linux */